@@ -1,6 +1,16 @@
+#include <atomic>
+#include "cpu_features.hpp"
 #include "aes256.hpp"
 
 namespace prologcoin { namespace common {
+
+#if PROLOGCOIN_X64
+// In aes256_x86.cpp
+void aes256_cbc_encrypt_aesni(const uint8_t round_key[240], uint8_t iv[16],
+			      uint8_t *buf, size_t len);
+void aes256_cbc_decrypt_aesni(const uint8_t round_key[240], uint8_t iv[16],
+			      uint8_t *buf, size_t len);
+#endif
     
 const uint8_t aes256::sbox[256]  = {
 0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
@@ -41,4 +51,64 @@ const uint8_t aes256::rsbox[256] = {
 const uint8_t aes256::Rcon[11] = {
   0x8d, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };  
 
+static std::atomic<int> aes256_impl(aes256::IMPL_AUTO);
+
+bool aes256::set_impl(impl_t impl)
+{
+    if (impl == IMPL_AUTO) {
+	impl = cpu_features::has_aes() ? IMPL_AESNI : IMPL_PORTABLE;
+    }
+    switch (impl) {
+    case IMPL_PORTABLE: break;
+    case IMPL_AESNI: if (!cpu_features::has_aes()) return false; break;
+    default: return false;
+    }
+    aes256_impl.store(impl);
+    return true;
+}
+
+aes256::impl_t aes256::get_impl()
+{
+    auto impl = static_cast<impl_t>(aes256_impl.load(std::memory_order_relaxed));
+    if (impl == IMPL_AUTO) {
+	set_impl(IMPL_AUTO);
+	impl = static_cast<impl_t>(aes256_impl.load());
+    }
+    return impl;
+}
+
+void aes256::cbc_encrypt(uint8_t *buf, size_t len)
+{
+#if PROLOGCOIN_X64
+    if (get_impl() == IMPL_AESNI) {
+	aes256_cbc_encrypt_aesni(round_key_, iv_, buf, len);
+	return;
+    }
+#endif
+    uint8_t *iv = iv_;
+    for (size_t i = 0; i < len; i += BLOCK_SIZE) {
+	xor_with_iv(&buf[i], iv);
+	encrypt_block(&buf[i]);
+	iv = &buf[i];
+    }
+    memcpy(iv_, iv, BLOCK_SIZE);
+}
+
+void aes256::cbc_decrypt(uint8_t *buf, size_t len)
+{
+#if PROLOGCOIN_X64
+    if (get_impl() == IMPL_AESNI) {
+	aes256_cbc_decrypt_aesni(round_key_, iv_, buf, len);
+	return;
+    }
+#endif
+    uint8_t next_iv[BLOCK_SIZE];
+    for (size_t i = 0; i < len; i += BLOCK_SIZE) {
+	memcpy(next_iv, &buf[i], BLOCK_SIZE);
+	decrypt_block(&buf[i]);
+	xor_with_iv(&buf[i], iv_);
+	memcpy(iv_, next_iv, BLOCK_SIZE);
+    }
+}
+
 }}
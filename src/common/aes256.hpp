@@ -30,29 +30,20 @@ public:
       cbc_encrypt(&buf[0], buf.size());
   }
   
-  void cbc_encrypt(uint8_t *buf, size_t len) {
-    uint8_t *iv = iv_;
-    for (size_t i = 0; i < len; i += BLOCK_SIZE) {
-      xor_with_iv(&buf[i], iv);
-      encrypt_block(&buf[i]);
-      iv = &buf[i];
-    }
-    memcpy(iv_, iv, BLOCK_SIZE);
-  }
+  void cbc_encrypt(uint8_t *buf, size_t len);
 
   void cbc_decrypt(std::vector<uint8_t> &buf) {
     cbc_decrypt(&buf[0], buf.size());
   }
   
-  void cbc_decrypt(uint8_t *buf, size_t len) {
-    uint8_t next_iv[BLOCK_SIZE];
-    for (size_t i = 0; i < len; i += BLOCK_SIZE) {
-      memcpy(next_iv, &buf[i], BLOCK_SIZE);
-      decrypt_block(&buf[i]);
-      xor_with_iv(&buf[i], iv_);
-      memcpy(iv_, next_iv, BLOCK_SIZE);
-    }
-  }
+  void cbc_decrypt(uint8_t *buf, size_t len);
+
+  // Implementation of the block cipher. AUTO (the default) uses AES-NI
+  // if the CPU has it; PORTABLE is the plain C++ version below. Returns
+  // false if it isn't supported.
+  enum impl_t { IMPL_AUTO, IMPL_PORTABLE, IMPL_AESNI };
+  static bool set_impl(impl_t impl);
+  static impl_t get_impl();
   
 private:
   void xor_with_iv(uint8_t *buf, const uint8_t *iv) {
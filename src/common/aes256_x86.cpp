@@ -0,0 +1,103 @@
+//
+// AES-256 in CBC mode with AES-NI. Same results as the portable
+// version in aes256.hpp (the round keys are the ones it expands.)
+// Encryption is sequential by nature, but decryption isn't, so it
+// does four blocks at a time to keep the AES unit busy.
+//
+
+#include <stdint.h>
+#include <string.h>
+#include "cpu_features.hpp"
+
+#if PROLOGCOIN_X64
+
+#include <immintrin.h>
+
+namespace prologcoin { namespace common {
+
+static const size_t NUM_ROUND_KEYS = 15;
+
+PROLOGCOIN_TARGET("aes,sse2")
+static inline __m128i encrypt_block(const __m128i k[NUM_ROUND_KEYS], __m128i x)
+{
+    x = _mm_xor_si128(x, k[0]);
+    for (size_t r = 1; r < NUM_ROUND_KEYS - 1; r++) {
+	x = _mm_aesenc_si128(x, k[r]);
+    }
+    return _mm_aesenclast_si128(x, k[NUM_ROUND_KEYS - 1]);
+}
+
+PROLOGCOIN_TARGET("aes,sse2")
+void aes256_cbc_encrypt_aesni(const uint8_t round_key[240], uint8_t iv[16],
+			      uint8_t *buf, size_t len)
+{
+    __m128i k[NUM_ROUND_KEYS];
+    for (size_t r = 0; r < NUM_ROUND_KEYS; r++) {
+	k[r] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(round_key + 16*r));
+    }
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iv));
+    for (size_t i = 0; i < len; i += 16) {
+	auto *p = reinterpret_cast<__m128i *>(buf + i);
+	x = encrypt_block(k, _mm_xor_si128(x, _mm_loadu_si128(p)));
+	_mm_storeu_si128(p, x);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(iv), x);
+}
+
+PROLOGCOIN_TARGET("aes,sse2")
+void aes256_cbc_decrypt_aesni(const uint8_t round_key[240], uint8_t iv[16],
+			      uint8_t *buf, size_t len)
+{
+    // The equivalent inverse cipher: the round keys in reverse order,
+    // all but the first and last through InvMixColumns.
+    __m128i k[NUM_ROUND_KEYS];
+    for (size_t r = 0; r < NUM_ROUND_KEYS; r++) {
+	__m128i rk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(round_key + 16*(NUM_ROUND_KEYS - 1 - r)));
+	k[r] = (r == 0 || r == NUM_ROUND_KEYS - 1) ? rk : _mm_aesimc_si128(rk);
+    }
+
+    __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iv));
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+	auto *p = reinterpret_cast<__m128i *>(buf + i);
+	__m128i c0 = _mm_loadu_si128(p + 0);
+	__m128i c1 = _mm_loadu_si128(p + 1);
+	__m128i c2 = _mm_loadu_si128(p + 2);
+	__m128i c3 = _mm_loadu_si128(p + 3);
+	__m128i x0 = _mm_xor_si128(c0, k[0]);
+	__m128i x1 = _mm_xor_si128(c1, k[0]);
+	__m128i x2 = _mm_xor_si128(c2, k[0]);
+	__m128i x3 = _mm_xor_si128(c3, k[0]);
+	for (size_t r = 1; r < NUM_ROUND_KEYS - 1; r++) {
+	    x0 = _mm_aesdec_si128(x0, k[r]);
+	    x1 = _mm_aesdec_si128(x1, k[r]);
+	    x2 = _mm_aesdec_si128(x2, k[r]);
+	    x3 = _mm_aesdec_si128(x3, k[r]);
+	}
+	x0 = _mm_aesdeclast_si128(x0, k[NUM_ROUND_KEYS - 1]);
+	x1 = _mm_aesdeclast_si128(x1, k[NUM_ROUND_KEYS - 1]);
+	x2 = _mm_aesdeclast_si128(x2, k[NUM_ROUND_KEYS - 1]);
+	x3 = _mm_aesdeclast_si128(x3, k[NUM_ROUND_KEYS - 1]);
+	_mm_storeu_si128(p + 0, _mm_xor_si128(x0, prev));
+	_mm_storeu_si128(p + 1, _mm_xor_si128(x1, c0));
+	_mm_storeu_si128(p + 2, _mm_xor_si128(x2, c1));
+	_mm_storeu_si128(p + 3, _mm_xor_si128(x3, c2));
+	prev = c3;
+    }
+    for (; i < len; i += 16) {
+	auto *p = reinterpret_cast<__m128i *>(buf + i);
+	__m128i c = _mm_loadu_si128(p);
+	__m128i x = _mm_xor_si128(c, k[0]);
+	for (size_t r = 1; r < NUM_ROUND_KEYS - 1; r++) {
+	    x = _mm_aesdec_si128(x, k[r]);
+	}
+	x = _mm_aesdeclast_si128(x, k[NUM_ROUND_KEYS - 1]);
+	_mm_storeu_si128(p, _mm_xor_si128(x, prev));
+	prev = c;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(iv), prev);
+}
+
+}}
+
+#endif
@@ -0,0 +1,519 @@
+#pragma once
+
+#ifndef _common_big_limbs_hpp
+#define _common_big_limbs_hpp
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace prologcoin { namespace common {
+
+//
+// Fixed width unsigned integer kernels on little endian 64-bit limbs.
+// All operations are modulo 2^(64*n); big_apply below picks n so
+// that its results are exact. These work directly on the bytes of BIG
+// cells so bignum arithmetic does not need to go through
+// boost::multiprecision::cpp_int.
+//
+namespace limbs {
+
+//
+// 64x64->128 bit multiply, 128/64 bit divide, count leading zeros
+// and byte swap. GCC and clang have unsigned __int128 and builtins
+// for these, MSVC (x64) has intrinsics. The portable versions work
+// on 32-bit halves; they are also what the others are tested against.
+//
+namespace portable {
+
+inline uint64_t mul_64(uint64_t a, uint64_t b, uint64_t &hi)
+{
+    const uint64_t M = 0xffffffff;
+    uint64_t a0 = a & M, a1 = a >> 32, b0 = b & M, b1 = b >> 32;
+    uint64_t p00 = a0*b0, p01 = a0*b1, p10 = a1*b0, p11 = a1*b1;
+    uint64_t mid = (p00 >> 32) + (p01 & M) + (p10 & M);
+    hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+    return (mid << 32) | (p00 & M);
+}
+
+inline unsigned clz_64(uint64_t x)
+{
+    unsigned n = 0;
+    for (unsigned s = 32; s > 0; s >>= 1) {
+	if ((x >> (64 - s)) == 0) {
+	    n += s;
+	    x <<= s;
+	}
+    }
+    return n;
+}
+
+// (hi:lo) / d with hi < d (so the quotient fits.) Hacker's Delight
+// divlu: two steps of 32-bit digits on the normalized divisor.
+inline uint64_t div_128(uint64_t hi, uint64_t lo, uint64_t d, uint64_t &rem)
+{
+    const uint64_t B = uint64_t(1) << 32;
+    unsigned s = clz_64(d);
+    d <<= s;
+    uint64_t dn1 = d >> 32, dn0 = d & (B - 1);
+    uint64_t un32 = s ? (hi << s) | (lo >> (64 - s)) : hi;
+    uint64_t un10 = lo << s;
+    uint64_t un1 = un10 >> 32, un0 = un10 & (B - 1);
+
+    uint64_t q1 = un32 / dn1, rhat = un32 - q1*dn1;
+    while (q1 >= B || q1*dn0 > B*rhat + un1) {
+	q1--;
+	rhat += dn1;
+	if (rhat >= B) break;
+    }
+    uint64_t un21 = un32*B + un1 - q1*d;
+
+    uint64_t q0 = un21 / dn1;
+    rhat = un21 - q0*dn1;
+    while (q0 >= B || q0*dn0 > B*rhat + un0) {
+	q0--;
+	rhat += dn1;
+	if (rhat >= B) break;
+    }
+    rem = (un21*B + un0 - q0*d) >> s;
+    return q1*B + q0;
+}
+
+inline uint64_t bswap_64(uint64_t x)
+{
+    x = ((x & 0x00ff00ff00ff00ffULL) << 8) | ((x >> 8) & 0x00ff00ff00ff00ffULL);
+    x = ((x & 0x0000ffff0000ffffULL) << 16) | ((x >> 16) & 0x0000ffff0000ffffULL);
+    return (x << 32) | (x >> 32);
+}
+
+}
+
+inline uint64_t mul_64(uint64_t a, uint64_t b, uint64_t &hi)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 p = static_cast<unsigned __int128>(a) * b;
+    hi = static_cast<uint64_t>(p >> 64);
+    return static_cast<uint64_t>(p);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return _umul128(a, b, &hi);
+#else
+    return portable::mul_64(a, b, hi);
+#endif
+}
+
+// d != 0
+inline unsigned clz_64(uint64_t d)
+{
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_clzll(d));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanReverse64(&i, d);
+    return 63 - static_cast<unsigned>(i);
+#else
+    return portable::clz_64(d);
+#endif
+}
+
+// (hi:lo) / d with hi < d
+inline uint64_t div_128(uint64_t hi, uint64_t lo, uint64_t d, uint64_t &rem)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 n = (static_cast<unsigned __int128>(hi) << 64) | lo;
+    rem = static_cast<uint64_t>(n % d);
+    return static_cast<uint64_t>(n / d);
+#elif defined(_MSC_VER) && defined(_M_X64) && _MSC_VER >= 1920
+    return _udiv128(hi, lo, d, &rem);
+#else
+    return portable::div_128(hi, lo, d, rem);
+#endif
+}
+
+inline uint64_t bswap_64(uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_bswap64(x);
+#elif defined(_MSC_VER)
+    return _byteswap_uint64(x);
+#else
+    return portable::bswap_64(x);
+#endif
+}
+
+// r = a + b + carry_in, returns the carry out (0 or 1)
+inline uint64_t add_carry(uint64_t a, uint64_t b, uint64_t carry, uint64_t &r)
+{
+    uint64_t s = a + b;
+    uint64_t c = s < a;
+    r = s + carry;
+    return c | (r < s);
+}
+
+// r = a - b - borrow_in, returns the borrow out (0 or 1)
+inline uint64_t sub_borrow(uint64_t a, uint64_t b, uint64_t borrow, uint64_t &r)
+{
+    uint64_t d = a - b;
+    uint64_t c = a < b;
+    r = d - borrow;
+    return c | (d < borrow);
+}
+
+inline uint64_t add(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+	carry = add_carry(a[i], b[i], carry, r[i]);
+    }
+    return carry;
+}
+
+inline uint64_t sub(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < n; i++) {
+	borrow = sub_borrow(a[i], b[i], borrow, r[i]);
+    }
+    return borrow;
+}
+
+// r = a*b (truncated to n limbs.) r must not alias a or b.
+inline void mul(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    memset(r, 0, n*sizeof(uint64_t));
+    for (size_t i = 0; i < n; i++) {
+	if (a[i] == 0) {
+	    continue;
+	}
+	uint64_t carry = 0;
+	for (size_t j = 0; i + j < n; j++) {
+	    uint64_t hi;
+	    uint64_t lo = mul_64(a[i], b[j], hi);
+	    lo += carry;
+	    hi += lo < carry;
+	    lo += r[i+j];
+	    hi += lo < r[i+j];
+	    r[i+j] = lo;
+	    carry = hi;
+	}
+    }
+}
+
+inline int compare(const uint64_t *a, const uint64_t *b, size_t n)
+{
+    for (size_t i = n; i-- > 0;) {
+	if (a[i] != b[i]) {
+	    return a[i] < b[i] ? -1 : 1;
+	}
+    }
+    return 0;
+}
+
+inline bool is_zero(const uint64_t *a, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+	if (a[i] != 0) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+// Number of significant limbs
+inline size_t length(const uint64_t *a, size_t n)
+{
+    while (n > 0 && a[n-1] == 0) {
+	n--;
+    }
+    return n;
+}
+
+// q = a / b, r = a % b (b != 0.) q and r must not alias a or b.
+// Knuth's algorithm D (TAOCP vol 2, 4.3.1) with 64-bit digits.
+inline void divmod(uint64_t *q, uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n)
+{
+    memset(q, 0, n*sizeof(uint64_t));
+    memset(r, 0, n*sizeof(uint64_t));
+
+    size_t an = length(a, n);
+    size_t bn = length(b, n);
+    if (an < bn) {
+	memcpy(r, a, n*sizeof(uint64_t));
+	return;
+    }
+
+    if (bn == 1) {
+	// Short division, the common case of dividing by a small number
+	uint64_t rem = 0;
+	for (size_t i = an; i-- > 0;) {
+	    q[i] = div_128(rem, a[i], b[0], rem);
+	}
+	r[0] = rem;
+	return;
+    }
+
+    // Normalized copies (divisor's top bit set)
+    uint64_t small[2*8+1];
+    std::vector<uint64_t> large;
+    uint64_t *un = small;
+    if (an + 1 + bn > sizeof(small)/sizeof(small[0])) {
+	large.resize(an + 1 + bn);
+	un = &large[0];
+    }
+    uint64_t *vn = un + an + 1;
+
+    unsigned s = clz_64(b[bn-1]);
+    for (size_t i = bn - 1; i > 0; i--) {
+	vn[i] = s ? (b[i] << s) | (b[i-1] >> (64-s)) : b[i];
+    }
+    vn[0] = b[0] << s;
+    un[an] = s ? a[an-1] >> (64-s) : 0;
+    for (size_t i = an - 1; i > 0; i--) {
+	un[i] = s ? (a[i] << s) | (a[i-1] >> (64-s)) : a[i];
+    }
+    un[0] = a[0] << s;
+
+    for (size_t j = an - bn + 1; j-- > 0;) {
+	// Estimate the quotient digit from the top two digits. The top
+	// digit of the remainder is at most that of the divisor; if
+	// it's equal, qhat = BASE-1 and rhat = un[j+bn-1] + vn[bn-1].
+	uint64_t qhat, rhat;
+	bool rhat_overflow = false;
+	if (un[j+bn] >= vn[bn-1]) {
+	    qhat = ~uint64_t(0);
+	    rhat = un[j+bn-1] + vn[bn-1];
+	    rhat_overflow = rhat < vn[bn-1];
+	} else {
+	    qhat = div_128(un[j+bn], un[j+bn-1], vn[bn-1], rhat);
+	}
+	while (!rhat_overflow) {
+	    // qhat*vn[bn-2] > rhat:un[j+bn-2] ?
+	    uint64_t p_hi;
+	    uint64_t p_lo = mul_64(qhat, vn[bn-2], p_hi);
+	    if (p_hi < rhat || (p_hi == rhat && p_lo <= un[j+bn-2])) {
+		break;
+	    }
+	    qhat--;
+	    rhat += vn[bn-1];
+	    rhat_overflow = rhat < vn[bn-1];
+	}
+
+	// Multiply and subtract
+	uint64_t k = 0, borrow = 0;
+	for (size_t i = 0; i < bn; i++) {
+	    uint64_t p_hi;
+	    uint64_t p_lo = mul_64(qhat, vn[i], p_hi);
+	    p_lo += k;
+	    p_hi += p_lo < k;
+	    borrow = sub_borrow(un[i+j], p_lo, borrow, un[i+j]);
+	    k = p_hi;
+	}
+	borrow = sub_borrow(un[j+bn], k, borrow, un[j+bn]);
+
+	q[j] = qhat;
+	if (borrow) {
+	    // Subtracted too much, add back
+	    q[j]--;
+	    uint64_t c = 0;
+	    for (size_t i = 0; i < bn; i++) {
+		c = add_carry(un[i+j], vn[i], c, un[i+j]);
+	    }
+	    un[j+bn] += c;
+	}
+    }
+
+    for (size_t i = 0; i < bn; i++) {
+	r[i] = s ? (un[i] >> s) | (un[i+1] << (64-s)) : un[i];
+    }
+}
+
+// Big endian bytes (as stored in BIG cells) to limbs.
+inline void from_bytes(uint64_t *r, size_t n, const uint8_t *bytes, size_t nbytes)
+{
+    memset(r, 0, n*sizeof(uint64_t));
+    size_t i = 0;
+    for (; i < n && (i+1)*8 <= nbytes; i++) {
+	uint64_t v;
+	memcpy(&v, bytes + nbytes - (i+1)*8, sizeof(v));
+	r[i] = bswap_64(v);
+    }
+    for (size_t j = i*8; j < nbytes && j < n*8; j++) {
+	r[j/8] |= static_cast<uint64_t>(bytes[nbytes-1-j]) << (8*(j%8));
+    }
+}
+
+inline void to_bytes(uint8_t *bytes, size_t nbytes, const uint64_t *a, size_t n)
+{
+    size_t i = 0;
+    for (; i < n && (i+1)*8 <= nbytes; i++) {
+	uint64_t v = bswap_64(a[i]);
+	memcpy(bytes + nbytes - (i+1)*8, &v, sizeof(v));
+    }
+    for (size_t j = i*8; j < nbytes; j++) {
+	bytes[nbytes-1-j] = (j < n*8) ? static_cast<uint8_t>(a[j/8] >> (8*(j%8))) : 0;
+    }
+}
+
+
+}
+
+//
+// Limb storage for an integer of a given bit width. Widths up to 256
+// and 512 bits use fixed arrays (no allocation, and the kernels get
+// a constant limb count); anything wider falls back to a vector.
+//
+template<size_t N> class fixed_limbs {
+public:
+    inline fixed_limbs(size_t) { data_.fill(0); }
+
+    inline uint64_t * data() { return &data_[0]; }
+    inline const uint64_t * data() const { return &data_[0]; }
+    inline size_t size() const { return N; }
+
+private:
+    std::array<uint64_t, N> data_;
+};
+
+class generic_limbs {
+public:
+    inline generic_limbs(size_t num_limbs) : data_(num_limbs, 0) { }
+
+    inline uint64_t * data() { return &data_[0]; }
+    inline const uint64_t * data() const { return &data_[0]; }
+    inline size_t size() const { return data_.size(); }
+
+private:
+    std::vector<uint64_t> data_;
+};
+
+enum big_op { BIG_ADD, BIG_SUB, BIG_MUL, BIG_DIV0, BIG_DIV, BIG_REM, BIG_MOD,
+	      BIG_MAX, BIG_MIN };
+
+//
+// A signed integer as a magnitude (big endian bytes, as stored in BIG
+// cells) and a sign. Zero is never negative.
+//
+struct big_operand {
+    bool negative;
+    const uint8_t *bytes;
+    size_t num_bytes;
+};
+
+// Number of bytes the magnitude of a op b may need. The result is
+// exact: + and - get a byte for the carry, * gets the sum of the
+// widths, and a quotient, remainder, max or min is never wider than
+// the widest argument.
+inline size_t big_result_bytes(big_op op, size_t na, size_t nb)
+{
+    switch (op) {
+    case BIG_ADD: case BIG_SUB: return std::max(na, nb) + 1;
+    case BIG_MUL: return na + nb;
+    default: return std::max(na, nb);
+    }
+}
+
+//
+// r = a op b, exactly. // and rem truncate toward zero (rem has the
+// sign of a), div and mod round toward negative infinity (mod has the
+// sign of b.) The magnitude is stored in r, which must be
+// big_result_bytes(op, a.num_bytes, b.num_bytes) bytes, and its sign
+// in r_negative. Returns false on division by zero. L is the limb
+// storage (fixed_limbs or generic_limbs) which must hold at least
+// (num_bytes+7)/8 limbs of the result.
+//
+template<typename L> inline bool big_apply(big_op op, const big_operand &a,
+					   const big_operand &b,
+					   uint8_t *r, bool &r_negative)
+{
+    size_t nbytes = big_result_bytes(op, a.num_bytes, b.num_bytes);
+    size_t n = (nbytes + 7) / 8;
+    L x(n), y(n), z(n), w(n);
+    // Limb count is constant for the fixed storage so the kernels
+    // below get unrolled.
+    n = x.size();
+    limbs::from_bytes(x.data(), n, a.bytes, a.num_bytes);
+    limbs::from_bytes(y.data(), n, b.bytes, b.num_bytes);
+    bool a_neg = a.negative, b_neg = b.negative, neg = false;
+    switch (op) {
+    case BIG_SUB:
+	b_neg = !b_neg;
+	// Fall through
+    case BIG_ADD:
+	if (a_neg == b_neg) {
+	    limbs::add(z.data(), x.data(), y.data(), n);
+	    neg = a_neg;
+	} else if (limbs::compare(x.data(), y.data(), n) >= 0) {
+	    limbs::sub(z.data(), x.data(), y.data(), n);
+	    neg = a_neg;
+	} else {
+	    limbs::sub(z.data(), y.data(), x.data(), n);
+	    neg = b_neg;
+	}
+	break;
+    case BIG_MUL:
+	limbs::mul(z.data(), x.data(), y.data(), n);
+	neg = a_neg != b_neg;
+	break;
+    case BIG_DIV0: case BIG_DIV: case BIG_REM: case BIG_MOD: {
+	if (limbs::is_zero(y.data(), n)) {
+	    return false;
+	}
+	limbs::divmod(z.data(), w.data(), x.data(), y.data(), n);
+	bool inexact = !limbs::is_zero(w.data(), n);
+	bool floor = inexact && a_neg != b_neg;
+	if (op == BIG_DIV0 || op == BIG_DIV) {
+	    // -(q+1) when rounding toward negative infinity. q+1 fits
+	    // as a nonzero remainder means |b| >= 2, so q <= |a|/2.
+	    if (op == BIG_DIV && floor) {
+		for (size_t i = 0; i < n; i++) {
+		    if (++z.data()[i] != 0) {
+			break;
+		    }
+		}
+	    }
+	    neg = a_neg != b_neg;
+	} else {
+	    // |b| - r for mod when the signs differ
+	    if (op == BIG_MOD && floor) {
+		limbs::sub(w.data(), y.data(), w.data(), n);
+	    }
+	    z = w;
+	    neg = (op == BIG_REM) ? a_neg : b_neg;
+	}
+	break;
+    }
+    case BIG_MAX: case BIG_MIN: {
+	int cmp = (a_neg != b_neg) ? (a_neg ? -1 : 1)
+	    : (a_neg ? -limbs::compare(x.data(), y.data(), n)
+		     : limbs::compare(x.data(), y.data(), n));
+	bool take_a = (op == BIG_MAX) ? cmp >= 0 : cmp <= 0;
+	z = take_a ? x : y;
+	neg = take_a ? a_neg : b_neg;
+	break;
+    }
+    }
+    r_negative = neg && !limbs::is_zero(z.data(), n);
+    limbs::to_bytes(r, nbytes, z.data(), n);
+    return true;
+}
+
+inline bool big_apply(big_op op, const big_operand &a, const big_operand &b,
+		      uint8_t *r, bool &r_negative)
+{
+    size_t nbytes = big_result_bytes(op, a.num_bytes, b.num_bytes);
+    if (nbytes <= 32) {
+	return big_apply<fixed_limbs<4> >(op, a, b, r, r_negative);
+    } else if (nbytes <= 64) {
+	return big_apply<fixed_limbs<8> >(op, a, b, r, r_negative);
+    } else {
+	return big_apply<generic_limbs>(op, a, b, r, r_negative);
+    }
+}
+
+}}
+
+#endif
@@ -15,8 +15,16 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
+#include <atomic>
+#include <algorithm>
+#include <vector>
 
 #include "blake2.hpp"
+#include "blake2_impl.hpp"
+
+#if PROLOGCOIN_X64 && !defined(NATIVE_LITTLE_ENDIAN)
+#define NATIVE_LITTLE_ENDIAN
+#endif
 
 #if !defined(__cplusplus) && (!defined(__STDC_VERSION__) || __STDC_VERSION__ < 199901L)
   #if   defined(_MSC_VER)
@@ -182,7 +190,7 @@ static BLAKE2_INLINE void secure_zero_memory(void *v, size_t n)
    https://blake2.net.
 */
 
-static const uint64_t blake2b_IV[8] =
+const uint64_t blake2b_IV[8] =
 {
   0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
   0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
@@ -190,7 +198,7 @@ static const uint64_t blake2b_IV[8] =
   0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
 };
 
-static const uint8_t blake2b_sigma[12][16] =
+const uint8_t blake2b_sigma[12][16] =
 {
   {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
   { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 } ,
@@ -336,7 +344,7 @@ int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t k
     G(r,7,v[ 3],v[ 4],v[ 9],v[14]); \
   } while(0)
 
-static void blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+static void blake2b_compress_ref( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
 {
   uint64_t m[16];
   uint64_t v[16];
@@ -380,6 +388,66 @@ static void blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOC
 #undef G
 #undef ROUND
 
+typedef void (*blake2b_compress_fn)( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] );
+
+static std::atomic<blake2b_compress_fn> blake2b_compress_impl(nullptr);
+static std::atomic<int> blake2b_current_impl(BLAKE2B_IMPL_AUTO);
+
+int blake2b_set_impl( blake2b_impl impl )
+{
+  blake2b_compress_fn fn = NULL;
+
+  if( impl == BLAKE2B_IMPL_AUTO )
+  {
+#if PROLOGCOIN_X64
+    if( cpu_features::has_avx2() ) impl = BLAKE2B_IMPL_AVX2;
+    else if( cpu_features::has_sse41() ) impl = BLAKE2B_IMPL_SSE41;
+    else
+#endif
+    impl = BLAKE2B_IMPL_REF;
+  }
+
+  switch( impl )
+  {
+  case BLAKE2B_IMPL_REF:
+    fn = blake2b_compress_ref;
+    break;
+#if PROLOGCOIN_X64
+  case BLAKE2B_IMPL_SSE41:
+    if( cpu_features::has_sse41() ) fn = blake2b_compress_sse41;
+    break;
+  case BLAKE2B_IMPL_AVX2:
+    if( cpu_features::has_avx2() ) fn = blake2b_compress_avx2;
+    break;
+#endif
+  default:
+    break;
+  }
+
+  if( fn == NULL ) return -1;
+
+  blake2b_current_impl.store( impl );
+  blake2b_compress_impl.store( fn );
+  return 0;
+}
+
+blake2b_impl blake2b_get_impl( void )
+{
+  if( blake2b_compress_impl.load() == NULL ) blake2b_set_impl( BLAKE2B_IMPL_AUTO );
+  return static_cast<blake2b_impl>( blake2b_current_impl.load() );
+}
+
+static BLAKE2_INLINE void blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+{
+  blake2b_compress_fn fn = blake2b_compress_impl.load( std::memory_order_relaxed );
+  if( fn == NULL )
+  {
+    blake2b_set_impl( BLAKE2B_IMPL_AUTO );
+    fn = blake2b_compress_impl.load();
+  }
+  fn( S, block );
+}
+
 int blake2b_update( blake2b_state *S, const void *pin, size_t inlen )
 {
   const unsigned char * in = (const unsigned char *)pin;
@@ -465,6 +533,113 @@ int blake2( void *out, size_t outlen, const void *in, size_t inlen, const void *
   return blake2b(out, outlen, in, inlen, key, keylen);
 }
 
+#if PROLOGCOIN_X64
+static size_t blake2b_num_blocks( size_t inlen )
+{
+  return inlen == 0 ? 1 : ( inlen + BLAKE2B_BLOCKBYTES - 1 ) / BLAKE2B_BLOCKBYTES;
+}
+
+/* Four messages in the lanes of blake2b_compress_x4_avx2. All but the
+   last block of a message are compressed straight from the input; the
+   last one is padded like blake2b_final does. */
+static void blake2b_x4( void *const out[4], size_t outlen, const void *const in[4], const size_t inlen[4] )
+{
+  uint64_t h[8][4];
+  uint64_t t[4], f[4], active[4];
+  uint8_t last[4][BLAKE2B_BLOCKBYTES];
+  const uint8_t *block[4];
+  size_t nblocks[4], max_blocks = 0;
+  size_t i, j, b;
+
+  for( i = 0; i < 8; ++i )
+    for( j = 0; j < 4; ++j )
+      h[i][j] = blake2b_IV[i];
+
+  for( j = 0; j < 4; ++j )
+  {
+    h[0][j] ^= 0x01010000 ^ outlen;
+    nblocks[j] = blake2b_num_blocks( inlen[j] );
+    if( nblocks[j] > max_blocks ) max_blocks = nblocks[j];
+    size_t offset = ( nblocks[j] - 1 ) * BLAKE2B_BLOCKBYTES;
+    memset( last[j], 0, BLAKE2B_BLOCKBYTES );
+    if( inlen[j] > offset )
+      memcpy( last[j], ( const uint8_t * )in[j] + offset, inlen[j] - offset );
+  }
+
+  for( b = 0; b < max_blocks; ++b )
+  {
+    for( j = 0; j < 4; ++j )
+    {
+      if( b + 1 < nblocks[j] )
+      {
+        block[j] = ( const uint8_t * )in[j] + b * BLAKE2B_BLOCKBYTES;
+        t[j] = ( b + 1 ) * BLAKE2B_BLOCKBYTES;
+        f[j] = 0;
+        active[j] = (uint64_t)-1;
+      }
+      else
+      {
+        block[j] = last[j];
+        t[j] = inlen[j];
+        f[j] = (uint64_t)-1;
+        active[j] = ( b + 1 == nblocks[j] ) ? (uint64_t)-1 : 0;
+      }
+    }
+    blake2b_compress_x4_avx2( h, block, t, f, active );
+  }
+
+  for( j = 0; j < 4; ++j )
+  {
+    uint8_t buffer[BLAKE2B_OUTBYTES];
+    for( i = 0; i < 8; ++i )
+      store64( buffer + sizeof( h[i][j] ) * i, h[i][j] );
+    memcpy( out[j], buffer, outlen );
+  }
+}
+#endif
+
+int blake2b_many( size_t n, void *const out[], size_t outlen, const void *const in[], const size_t inlen[] )
+{
+  size_t i = 0;
+
+  if( !outlen || outlen > BLAKE2B_OUTBYTES ) return -1;
+
+#if PROLOGCOIN_X64
+  if( n >= 4 && blake2b_get_impl() == BLAKE2B_IMPL_AVX2 )
+  {
+    /* A group takes as long as its longest message, so group messages
+       of about the same length together. */
+    std::vector<size_t> order( n );
+    for( i = 0; i < n; ++i ) order[i] = i;
+    std::stable_sort( order.begin(), order.end(),
+                      [&]( size_t a, size_t b ) { return blake2b_num_blocks( inlen[a] ) < blake2b_num_blocks( inlen[b] ); } );
+
+    for( i = 0; i + 4 <= n; i += 4 )
+    {
+      void *o[4];
+      const void *p[4];
+      size_t len[4];
+      for( size_t j = 0; j < 4; ++j )
+      {
+        o[j] = out[order[i+j]];
+        p[j] = in[order[i+j]];
+        len[j] = inlen[order[i+j]];
+        if( NULL == p[j] && len[j] > 0 ) return -1;
+        if( NULL == o[j] ) return -1;
+      }
+      blake2b_x4( o, outlen, p, len );
+    }
+    for( ; i < n; ++i )
+      if( blake2b( out[order[i]], outlen, in[order[i]], inlen[order[i]], NULL, 0 ) < 0 ) return -1;
+    return 0;
+  }
+#endif
+
+  for( ; i < n; ++i )
+    if( blake2b( out[i], outlen, in[i], inlen[i], NULL, 0 ) < 0 ) return -1;
+  return 0;
+}
+
 #if defined(SUPERCOP)
 int crypto_hash( unsigned char *out, unsigned char *in, unsigned long long inlen )
 {
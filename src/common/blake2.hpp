@@ -182,6 +182,27 @@ int blake2bp( void *out, size_t outlen, const void *in, size_t inlen, const void
 int blake2xs( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen );
 int blake2xb( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen );
 
+/* The blake2b compression function used by all of the above. The
+   default (AUTO) is the fastest one the CPU supports; the others are
+   for testing and benchmarking. Returns -1 if the CPU doesn't support
+   the one asked for. */
+typedef enum blake2b_impl
+{
+    BLAKE2B_IMPL_AUTO,
+    BLAKE2B_IMPL_REF,
+    BLAKE2B_IMPL_SSE41,
+    BLAKE2B_IMPL_AVX2
+} blake2b_impl;
+
+int blake2b_set_impl( blake2b_impl impl );
+blake2b_impl blake2b_get_impl( void );
+
+/* Unkeyed blake2b of n messages: out[i] = blake2b(in[i]). With the
+   AVX2 implementation they are hashed four at a time, one message per
+   vector lane, which is much faster than one by one for short messages
+   (leaves and branches of merkle tries.) */
+int blake2b_many( size_t n, void *const out[], size_t outlen, const void *const in[], const size_t inlen[] );
+
 /* This is simply an alias for blake2b */
 int blake2( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen );
 
@@ -0,0 +1,29 @@
+/*
+   Internal to blake2.cpp and blake2_x86.cpp: the constants and the
+   SIMD versions of the compression function.
+*/
+#ifndef _common_BLAKE2_IMPL_H
+#define _common_BLAKE2_IMPL_H
+
+#include "cpu_features.hpp"
+#include "blake2.hpp"
+
+namespace prologcoin { namespace common {
+
+extern const uint64_t blake2b_IV[8];
+extern const uint8_t blake2b_sigma[12][16];
+
+#if PROLOGCOIN_X64
+void blake2b_compress_sse41( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] );
+void blake2b_compress_avx2( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] );
+
+/* Four independent states, h[word][lane]. Lanes with active[lane] == 0
+   are left as they are. */
+void blake2b_compress_x4_avx2( uint64_t h[8][4], const uint8_t *const block[4],
+                               const uint64_t t[4], const uint64_t f[4],
+                               const uint64_t active[4] );
+#endif
+
+}}
+
+#endif
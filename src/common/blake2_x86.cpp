@@ -0,0 +1,268 @@
+//
+// SSE4.1 and AVX2 versions of the blake2b compression function. They
+// compute the same thing as blake2b_compress_ref in blake2.cpp, with
+// each row of the 4x4 state held in vector registers, so the four G
+// functions of a column (or diagonal) step run side by side. There's
+// also an AVX2 version that compresses four messages at once (used by
+// blake2b_many.)
+//
+
+#include <string.h>
+#include "blake2_impl.hpp"
+
+#if PROLOGCOIN_X64
+
+#include <immintrin.h>
+
+namespace prologcoin { namespace common {
+
+//
+// SSE4.1: each row is two registers (lo = words 0,1; hi = words 2,3.)
+//
+
+PROLOGCOIN_TARGET("sse4.1")
+static inline __m128i rotr63_128(__m128i x)
+{
+    return _mm_xor_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x));
+}
+
+#define G_SSE41(a_lo, a_hi, b_lo, b_hi, c_lo, c_hi, d_lo, d_hi, m0_lo, m0_hi, m1_lo, m1_hi) \
+    do {								\
+	a_lo = _mm_add_epi64(_mm_add_epi64(a_lo, m0_lo), b_lo);		\
+	a_hi = _mm_add_epi64(_mm_add_epi64(a_hi, m0_hi), b_hi);		\
+	d_lo = _mm_shuffle_epi32(_mm_xor_si128(d_lo, a_lo), _MM_SHUFFLE(2,3,0,1)); \
+	d_hi = _mm_shuffle_epi32(_mm_xor_si128(d_hi, a_hi), _MM_SHUFFLE(2,3,0,1)); \
+	c_lo = _mm_add_epi64(c_lo, d_lo);				\
+	c_hi = _mm_add_epi64(c_hi, d_hi);				\
+	b_lo = _mm_shuffle_epi8(_mm_xor_si128(b_lo, c_lo), r24);	\
+	b_hi = _mm_shuffle_epi8(_mm_xor_si128(b_hi, c_hi), r24);	\
+	a_lo = _mm_add_epi64(_mm_add_epi64(a_lo, m1_lo), b_lo);		\
+	a_hi = _mm_add_epi64(_mm_add_epi64(a_hi, m1_hi), b_hi);		\
+	d_lo = _mm_shuffle_epi8(_mm_xor_si128(d_lo, a_lo), r16);	\
+	d_hi = _mm_shuffle_epi8(_mm_xor_si128(d_hi, a_hi), r16);	\
+	c_lo = _mm_add_epi64(c_lo, d_lo);				\
+	c_hi = _mm_add_epi64(c_hi, d_hi);				\
+	b_lo = rotr63_128(_mm_xor_si128(b_lo, c_lo));			\
+	b_hi = rotr63_128(_mm_xor_si128(b_hi, c_hi));			\
+    } while (0)
+
+PROLOGCOIN_TARGET("sse4.1")
+void blake2b_compress_sse41(blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES])
+{
+    const __m128i r16 = _mm_setr_epi8(2,3,4,5,6,7,0,1, 10,11,12,13,14,15,8,9);
+    const __m128i r24 = _mm_setr_epi8(3,4,5,6,7,0,1,2, 11,12,13,14,15,8,9,10);
+
+    uint64_t m[16];
+    memcpy(m, block, sizeof(m));
+
+    __m128i row1l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&S->h[0]));
+    __m128i row1h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&S->h[2]));
+    __m128i row2l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&S->h[4]));
+    __m128i row2h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&S->h[6]));
+    __m128i row3l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&blake2b_IV[0]));
+    __m128i row3h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&blake2b_IV[2]));
+    __m128i row4l = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&blake2b_IV[4])),
+				  _mm_loadu_si128(reinterpret_cast<const __m128i *>(&S->t[0])));
+    __m128i row4h = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&blake2b_IV[6])),
+				  _mm_loadu_si128(reinterpret_cast<const __m128i *>(&S->f[0])));
+
+    const __m128i orig1l = row1l, orig1h = row1h, orig2l = row2l, orig2h = row2h;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 12
+#endif
+    for (size_t r = 0; r < 12; r++) {
+	const uint8_t *s = blake2b_sigma[r];
+	__m128i t0, t1;
+
+	// Columns
+	G_SSE41(row1l, row1h, row2l, row2h, row3l, row3h, row4l, row4h,
+		_mm_set_epi64x(m[s[2]], m[s[0]]), _mm_set_epi64x(m[s[6]], m[s[4]]),
+		_mm_set_epi64x(m[s[3]], m[s[1]]), _mm_set_epi64x(m[s[7]], m[s[5]]));
+
+	// Rotate rows 2, 3 and 4 so that the diagonals line up
+	t0 = _mm_alignr_epi8(row2h, row2l, 8);
+	t1 = _mm_alignr_epi8(row2l, row2h, 8);
+	row2l = t0; row2h = t1;
+	t0 = row3l; row3l = row3h; row3h = t0;
+	t0 = _mm_alignr_epi8(row4l, row4h, 8);
+	t1 = _mm_alignr_epi8(row4h, row4l, 8);
+	row4l = t0; row4h = t1;
+
+	// Diagonals
+	G_SSE41(row1l, row1h, row2l, row2h, row3l, row3h, row4l, row4h,
+		_mm_set_epi64x(m[s[10]], m[s[8]]), _mm_set_epi64x(m[s[14]], m[s[12]]),
+		_mm_set_epi64x(m[s[11]], m[s[9]]), _mm_set_epi64x(m[s[15]], m[s[13]]));
+
+	// And back
+	t0 = _mm_alignr_epi8(row2l, row2h, 8);
+	t1 = _mm_alignr_epi8(row2h, row2l, 8);
+	row2l = t0; row2h = t1;
+	t0 = row3l; row3l = row3h; row3h = t0;
+	t0 = _mm_alignr_epi8(row4h, row4l, 8);
+	t1 = _mm_alignr_epi8(row4l, row4h, 8);
+	row4l = t0; row4h = t1;
+    }
+
+    row1l = _mm_xor_si128(_mm_xor_si128(row1l, row3l), orig1l);
+    row1h = _mm_xor_si128(_mm_xor_si128(row1h, row3h), orig1h);
+    row2l = _mm_xor_si128(_mm_xor_si128(row2l, row4l), orig2l);
+    row2h = _mm_xor_si128(_mm_xor_si128(row2h, row4h), orig2h);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&S->h[0]), row1l);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&S->h[2]), row1h);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&S->h[4]), row2l);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&S->h[6]), row2h);
+}
+
+#undef G_SSE41
+
+//
+// AVX2: each row is one register.
+//
+
+PROLOGCOIN_TARGET("avx2")
+static inline __m256i rotr63_256(__m256i x)
+{
+    return _mm256_xor_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x));
+}
+
+#define G_AVX2(a, b, c, d, m0, m1)					\
+    do {								\
+	a = _mm256_add_epi64(_mm256_add_epi64(a, m0), b);		\
+	d = _mm256_shuffle_epi32(_mm256_xor_si256(d, a), _MM_SHUFFLE(2,3,0,1)); \
+	c = _mm256_add_epi64(c, d);					\
+	b = _mm256_shuffle_epi8(_mm256_xor_si256(b, c), r24);		\
+	a = _mm256_add_epi64(_mm256_add_epi64(a, m1), b);		\
+	d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), r16);		\
+	c = _mm256_add_epi64(c, d);					\
+	b = rotr63_256(_mm256_xor_si256(b, c));				\
+    } while (0)
+
+#define SET4(m, s, i0, i1, i2, i3) \
+    _mm256_set_epi64x(m[s[i3]], m[s[i2]], m[s[i1]], m[s[i0]])
+
+PROLOGCOIN_TARGET("avx2")
+void blake2b_compress_avx2(blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES])
+{
+    const __m256i r16 = _mm256_setr_epi8(2,3,4,5,6,7,0,1, 10,11,12,13,14,15,8,9,
+					 2,3,4,5,6,7,0,1, 10,11,12,13,14,15,8,9);
+    const __m256i r24 = _mm256_setr_epi8(3,4,5,6,7,0,1,2, 11,12,13,14,15,8,9,10,
+					 3,4,5,6,7,0,1,2, 11,12,13,14,15,8,9,10);
+
+    uint64_t m[16];
+    memcpy(m, block, sizeof(m));
+
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&S->h[0]));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&S->h[4]));
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&blake2b_IV[0]));
+    __m256i d = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(&blake2b_IV[4])),
+				 _mm256_set_epi64x(S->f[1], S->f[0], S->t[1], S->t[0]));
+
+    const __m256i orig_a = a, orig_b = b;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 12
+#endif
+    for (size_t r = 0; r < 12; r++) {
+	const uint8_t *s = blake2b_sigma[r];
+
+	// Columns
+	G_AVX2(a, b, c, d, SET4(m, s, 0, 2, 4, 6), SET4(m, s, 1, 3, 5, 7));
+
+	// Rotate rows 2, 3 and 4 so that the diagonals line up
+	b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0,3,2,1));
+	c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2));
+	d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2,1,0,3));
+
+	// Diagonals
+	G_AVX2(a, b, c, d, SET4(m, s, 8, 10, 12, 14), SET4(m, s, 9, 11, 13, 15));
+
+	// And back
+	b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2,1,0,3));
+	c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2));
+	d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0,3,2,1));
+    }
+
+    a = _mm256_xor_si256(_mm256_xor_si256(a, c), orig_a);
+    b = _mm256_xor_si256(_mm256_xor_si256(b, d), orig_b);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&S->h[0]), a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&S->h[4]), b);
+}
+
+#undef SET4
+
+//
+// AVX2, four messages at once: word i of the state is one register
+// with a lane per message, so the G functions are the scalar ones
+// done four times over. The message words are transposed into the
+// same layout. Lanes that are not active keep their state.
+//
+
+PROLOGCOIN_TARGET("avx2")
+static inline void transpose4(__m256i &r0, __m256i &r1, __m256i &r2, __m256i &r3)
+{
+    __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+    r0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+    r1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+    r2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+    r3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+}
+
+PROLOGCOIN_TARGET("avx2")
+void blake2b_compress_x4_avx2(uint64_t h[8][4], const uint8_t *const block[4],
+			      const uint64_t t[4], const uint64_t f[4],
+			      const uint64_t active[4])
+{
+    const __m256i r16 = _mm256_setr_epi8(2,3,4,5,6,7,0,1, 10,11,12,13,14,15,8,9,
+					 2,3,4,5,6,7,0,1, 10,11,12,13,14,15,8,9);
+    const __m256i r24 = _mm256_setr_epi8(3,4,5,6,7,0,1,2, 11,12,13,14,15,8,9,10,
+					 3,4,5,6,7,0,1,2, 11,12,13,14,15,8,9,10);
+
+    __m256i m[16];
+    for (size_t i = 0; i < 16; i += 4) {
+	m[i+0] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block[0] + 8*i));
+	m[i+1] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block[1] + 8*i));
+	m[i+2] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block[2] + 8*i));
+	m[i+3] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block[3] + 8*i));
+	transpose4(m[i+0], m[i+1], m[i+2], m[i+3]);
+    }
+
+    __m256i v[16], orig[8];
+    for (size_t i = 0; i < 8; i++) {
+	orig[i] = v[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&h[i][0]));
+	v[i+8] = _mm256_set1_epi64x(static_cast<int64_t>(blake2b_IV[i]));
+    }
+    v[12] = _mm256_xor_si256(v[12], _mm256_loadu_si256(reinterpret_cast<const __m256i *>(t)));
+    v[14] = _mm256_xor_si256(v[14], _mm256_loadu_si256(reinterpret_cast<const __m256i *>(f)));
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 12
+#endif
+    for (size_t r = 0; r < 12; r++) {
+	const uint8_t *s = blake2b_sigma[r];
+	G_AVX2(v[0], v[4], v[ 8], v[12], m[s[ 0]], m[s[ 1]]);
+	G_AVX2(v[1], v[5], v[ 9], v[13], m[s[ 2]], m[s[ 3]]);
+	G_AVX2(v[2], v[6], v[10], v[14], m[s[ 4]], m[s[ 5]]);
+	G_AVX2(v[3], v[7], v[11], v[15], m[s[ 6]], m[s[ 7]]);
+	G_AVX2(v[0], v[5], v[10], v[15], m[s[ 8]], m[s[ 9]]);
+	G_AVX2(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+	G_AVX2(v[2], v[7], v[ 8], v[13], m[s[12]], m[s[13]]);
+	G_AVX2(v[3], v[4], v[ 9], v[14], m[s[14]], m[s[15]]);
+    }
+
+    const __m256i keep = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(active));
+    for (size_t i = 0; i < 8; i++) {
+	__m256i x = _mm256_xor_si256(_mm256_xor_si256(v[i], v[i+8]), orig[i]);
+	x = _mm256_blendv_epi8(orig[i], x, keep);
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(&h[i][0]), x);
+    }
+}
+
+#undef G_AVX2
+
+}}
+
+#endif
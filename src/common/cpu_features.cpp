@@ -0,0 +1,71 @@
+#include "cpu_features.hpp"
+
+#if PROLOGCOIN_X64
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace prologcoin { namespace common {
+
+#if PROLOGCOIN_X64
+static void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (size_t i = 0; i < 4; i++) {
+	regs[i] = static_cast<unsigned>(info[i]);
+    }
+#else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3])) {
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    }
+#endif
+}
+
+// The OS must save the YMM registers for AVX to be usable
+static bool os_saves_ymm()
+{
+#if defined(_MSC_VER)
+    return (_xgetbv(0) & 6) == 6;
+#else
+    unsigned lo, hi;
+    __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (lo & 6) == 6;
+#endif
+}
+#endif
+
+cpu_features::cpu_features()
+    : sse41_(false), avx2_(false), sha_(false), aes_(false)
+{
+#if PROLOGCOIN_X64
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    unsigned max_leaf = regs[0];
+
+    cpuid(1, 0, regs);
+    unsigned ecx1 = regs[2];
+    sse41_ = (ecx1 & (1u << 19)) != 0;
+    aes_ = (ecx1 & (1u << 25)) != 0;
+    bool avx = (ecx1 & (1u << 28)) != 0 && (ecx1 & (1u << 27)) != 0 &&
+	       os_saves_ymm();
+
+    if (max_leaf >= 7) {
+	cpuid(7, 0, regs);
+	avx2_ = avx && (regs[1] & (1u << 5)) != 0;
+	sha_ = sse41_ && (regs[1] & (1u << 29)) != 0;
+    }
+#endif
+}
+
+const cpu_features & cpu_features::get()
+{
+    static const cpu_features features;
+    return features;
+}
+
+}}
@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef _common_cpu_features_hpp
+#define _common_cpu_features_hpp
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PROLOGCOIN_X64 1
+#endif
+
+// The SIMD code paths are compiled for their instruction set one
+// function at a time, so that the rest of the tree doesn't need any
+// special flags. Whether they are used is decided at runtime.
+#if defined(_MSC_VER)
+#define PROLOGCOIN_TARGET(isa)
+#else
+#define PROLOGCOIN_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace prologcoin { namespace common {
+
+//
+// What the CPU we're running on supports (x86-64 only; everything is
+// false elsewhere.) Detected once.
+//
+class cpu_features {
+public:
+    static inline bool has_sse41() { return get().sse41_; }
+    static inline bool has_avx2() { return get().avx2_; }
+    static inline bool has_sha() { return get().sha_; }
+    static inline bool has_aes() { return get().aes_; }
+
+private:
+    cpu_features();
+
+    static const cpu_features & get();
+
+    bool sse41_;
+    bool avx2_;
+    bool sha_;
+    bool aes_;
+};
+
+}}
+
+#endif
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "crc32c.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X64 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace prologcoin { namespace common {
+
+//
+// Portable version (slicing by 4.)
+//
+
+static const uint32_t CRC32C_POLY = 0x82f63b78; // Reversed 0x1edc6f41
+
+struct crc32c_table {
+    crc32c_table() {
+	for (uint32_t i = 0; i < 256; i++) {
+	    uint32_t c = i;
+	    for (size_t k = 0; k < 8; k++) {
+		c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : (c >> 1);
+	    }
+	    t[0][i] = c;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+	    for (size_t j = 1; j < 4; j++) {
+		t[j][i] = (t[j-1][i] >> 8) ^ t[0][t[j-1][i] & 0xff];
+	    }
+	}
+    }
+
+    uint32_t t[4][256];
+};
+
+static const crc32c_table & get_table() {
+    static crc32c_table table;
+    return table;
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    auto &t = get_table().t;
+    while (len > 0 && (reinterpret_cast<uintptr_t>(p) & 3) != 0) {
+	crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+	len--;
+    }
+    while (len >= 4) {
+	uint32_t w;
+	memcpy(&w, p, sizeof(w));
+	// Little endian assumed (as the rest of the db code)
+	crc ^= w;
+	crc = t[3][crc & 0xff] ^ t[2][(crc >> 8) & 0xff] ^
+	      t[1][(crc >> 16) & 0xff] ^ t[0][crc >> 24];
+	p += 4;
+	len -= 4;
+    }
+    while (len > 0) {
+	crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+	len--;
+    }
+    return crc;
+}
+
+//
+// Hardware version (SSE4.2)
+//
+
+#if CRC32C_X64
+
+#if defined(__GNUC__)
+__attribute__((target("sse4.2")))
+#endif
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t c = crc;
+    while (len > 0 && (reinterpret_cast<uintptr_t>(p) & 7) != 0) {
+	c = _mm_crc32_u8(static_cast<uint32_t>(c), *p++);
+	len--;
+    }
+    while (len >= 8) {
+	uint64_t w;
+	memcpy(&w, p, sizeof(w));
+	c = _mm_crc32_u64(c, w);
+	p += 8;
+	len -= 8;
+    }
+    while (len > 0) {
+	c = _mm_crc32_u8(static_cast<uint32_t>(c), *p++);
+	len--;
+    }
+    return static_cast<uint32_t>(c);
+}
+
+static bool detect_sse42()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") != 0;
+#endif
+}
+
+#endif
+
+bool crc32c::has_hardware_support()
+{
+#if CRC32C_X64
+    static const bool has_sse42 = detect_sse42();
+    return has_sse42;
+#else
+    return false;
+#endif
+}
+
+uint32_t crc32c::extend(uint32_t state, const uint8_t *p, size_t len)
+{
+#if CRC32C_X64
+    if (has_hardware_support()) {
+	return crc32c_hw(state, p, len);
+    }
+#endif
+    return crc32c_sw(state, p, len);
+}
+
+}}
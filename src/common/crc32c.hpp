@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef _common_crc32c_hpp
+#define _common_crc32c_hpp
+
+namespace prologcoin { namespace common {
+
+//
+// CRC-32C (Castagnoli.) Used for detecting torn or corrupted records
+// on disk; it is not a cryptographic hash. If the CPU supports the
+// SSE4.2 crc32 instruction (checked at runtime) we use that, otherwise
+// we fall back to a portable table driven implementation.
+//
+class crc32c {
+public:
+    inline crc32c() : state_(INIT) { }
+
+    inline void reset() { state_ = INIT; }
+
+    inline void update(const void *p, size_t len) {
+	state_ = extend(state_, reinterpret_cast<const uint8_t *>(p), len);
+    }
+
+    inline uint32_t finalize() const {
+	return state_ ^ INIT;
+    }
+
+    static inline uint32_t checksum(const void *p, size_t len) {
+	return extend(INIT, reinterpret_cast<const uint8_t *>(p), len) ^ INIT;
+    }
+
+    static bool has_hardware_support();
+
+private:
+    static const uint32_t INIT = 0xffffffff;
+
+    static uint32_t extend(uint32_t state, const uint8_t *p, size_t len);
+
+    uint32_t state_;
+};
+
+}}
+
+#endif
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include "gcs_filter.hpp"
+#include "sha256.hpp"
+
+namespace prologcoin { namespace common {
+
+namespace {
+
+class bit_writer {
+public:
+    bit_writer(gcs_filter::buffer_t &out) : out_(out), acc_(0), nbits_(0) { }
+
+    inline void write(uint64_t value, unsigned int nbits) {
+	while (nbits > 0) {
+	    unsigned int n = std::min(nbits, 8 - nbits_);
+	    unsigned int bits = static_cast<unsigned int>((value >> (nbits - n)) & ((1u << n) - 1));
+	    acc_ = static_cast<uint8_t>((acc_ << n) | bits);
+	    nbits_ += n;
+	    nbits -= n;
+	    if (nbits_ == 8) {
+		out_.push_back(acc_);
+		acc_ = 0;
+		nbits_ = 0;
+	    }
+	}
+    }
+
+    inline void flush() {
+	if (nbits_ > 0) {
+	    out_.push_back(static_cast<uint8_t>(acc_ << (8 - nbits_)));
+	    acc_ = 0;
+	    nbits_ = 0;
+	}
+    }
+
+private:
+    gcs_filter::buffer_t &out_;
+    uint8_t acc_;
+    unsigned int nbits_;
+};
+
+class bit_reader {
+public:
+    bit_reader(const uint8_t *data, size_t len) : data_(data), len_(len), pos_(0) { }
+
+    inline bool read_bit(unsigned int &bit) {
+	if (pos_ >= len_ * 8) {
+	    return false;
+	}
+	bit = (data_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1;
+	pos_++;
+	return true;
+    }
+
+    inline bool read(unsigned int nbits, uint64_t &value) {
+	value = 0;
+	for (unsigned int i = 0; i < nbits; i++) {
+	    unsigned int bit;
+	    if (!read_bit(bit)) {
+		return false;
+	    }
+	    value = (value << 1) | bit;
+	}
+	return true;
+    }
+
+private:
+    const uint8_t *data_;
+    size_t len_;
+    size_t pos_;
+};
+
+// The high 64 bits of a * b
+inline uint64_t mul_high(uint64_t a, uint64_t b)
+{
+    uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+    uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+}
+
+}
+
+uint64_t gcs_filter::hash_to_range(uint64_t key, const std::string &item,
+				   uint64_t range)
+{
+    uint8_t key_bytes[8];
+    for (size_t i = 0; i < 8; i++) {
+	key_bytes[i] = static_cast<uint8_t>(key >> (8 * i));
+    }
+    sha256 h;
+    h.update(key_bytes, sizeof(key_bytes));
+    h.update(item.data(), item.size());
+    uint8_t dig[sha256::HASH_SIZE];
+    h.finalize(dig);
+    uint64_t v = 0;
+    for (size_t i = 0; i < 8; i++) {
+	v = (v << 8) | dig[i];
+    }
+    return mul_high(v, range);
+}
+
+void gcs_filter::build(uint64_t key, const std::vector<std::string> &items,
+		       buffer_t &out)
+{
+    std::vector<std::string> unique(items);
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+    uint64_t n = unique.size();
+    std::vector<uint64_t> values;
+    values.reserve(n);
+    for (auto &item : unique) {
+	values.push_back(hash_to_range(key, item, n * M));
+    }
+    std::sort(values.begin(), values.end());
+
+    out.clear();
+    out.push_back(static_cast<uint8_t>(n >> 24));
+    out.push_back(static_cast<uint8_t>(n >> 16));
+    out.push_back(static_cast<uint8_t>(n >> 8));
+    out.push_back(static_cast<uint8_t>(n));
+
+    bit_writer w(out);
+    uint64_t last = 0;
+    for (auto v : values) {
+	uint64_t delta = v - last;
+	last = v;
+	for (uint64_t q = delta >> P; q > 0; q--) {
+	    w.write(1, 1);
+	}
+	w.write(0, 1);
+	w.write(delta, P);
+    }
+    w.flush();
+}
+
+gcs_filter::gcs_filter(uint64_t key, const uint8_t *data, size_t len)
+    : key_(key), data_(data), len_(len), n_(0)
+{
+    if (len_ >= 4) {
+	n_ = (static_cast<size_t>(data[0]) << 24) |
+	     (static_cast<size_t>(data[1]) << 16) |
+	     (static_cast<size_t>(data[2]) << 8) |
+	     static_cast<size_t>(data[3]);
+    }
+}
+
+bool gcs_filter::match(const std::string &item) const
+{
+    return match_any(std::vector<std::string>{item});
+}
+
+bool gcs_filter::match_any(const std::vector<std::string> &items) const
+{
+    if (n_ == 0 || items.empty()) {
+	return false;
+    }
+
+    uint64_t range = static_cast<uint64_t>(n_) * M;
+    std::vector<uint64_t> wanted;
+    wanted.reserve(items.size());
+    for (auto &item : items) {
+	wanted.push_back(hash_to_range(key_, item, range));
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    // Walk both sorted sequences
+    bit_reader r(data_ + 4, len_ - 4);
+    auto it = wanted.begin();
+    uint64_t value = 0;
+    for (size_t i = 0; i < n_; i++) {
+	uint64_t q = 0;
+	unsigned int bit;
+	for (;;) {
+	    if (!r.read_bit(bit)) {
+		// Truncated; can't rule anything out
+		return true;
+	    }
+	    if (bit == 0) break;
+	    q++;
+	}
+	uint64_t rem;
+	if (!r.read(P, rem)) {
+	    return true;
+	}
+	value += (q << P) | rem;
+	while (it != wanted.end() && *it < value) {
+	    ++it;
+	}
+	if (it == wanted.end()) {
+	    return false;
+	}
+	if (*it == value) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+}}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#ifndef _common_gcs_filter_hpp
+#define _common_gcs_filter_hpp
+
+namespace prologcoin { namespace common {
+
+//
+// Golomb-coded set (as in BIP 158.) A compact probabilistic set of
+// byte strings: match() is never wrong for an item that was added,
+// and wrong for other items with probability about 1/M.
+//
+// Each item is hashed (sha256, keyed) to a number in [0, N*M), the
+// numbers are sorted and the differences between them are Golomb-Rice
+// coded with P bits of remainder, which takes about P + 1.5 bits per
+// item. The encoding is the number of items (4 bytes, big endian)
+// followed by the bit stream.
+//
+class gcs_filter {
+public:
+    using buffer_t = std::vector<uint8_t>;
+
+    static const unsigned int P = 19;
+    static const uint64_t M = 784931;
+
+    static void build(uint64_t key, const std::vector<std::string> &items,
+		      buffer_t &out);
+
+    gcs_filter(uint64_t key, const uint8_t *data, size_t len);
+
+    inline size_t size() const { return n_; }
+
+    bool match(const std::string &item) const;
+
+    // True if any of the items match (one pass over the filter.)
+    bool match_any(const std::vector<std::string> &items) const;
+
+private:
+    static uint64_t hash_to_range(uint64_t key, const std::string &item,
+				  uint64_t range);
+
+    uint64_t key_;
+    const uint8_t *data_;
+    size_t len_;
+    size_t n_;
+};
+
+}}
+
+#endif
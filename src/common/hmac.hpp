@@ -16,24 +16,33 @@ public:
 
   inline hmac() { }
 
+  // The hash states after the inner and outer key blocks are the
+  // same for every message, so they're computed once here. (PBKDF2
+  // copies them for every iteration.)
   inline void init(const void *key, size_t key_len) {
+    uint8_t key_block[BLOCK_SIZE];
     if (key_len > BLOCK_SIZE) {
       Hash h;
       h.update(key, key_len);
-      h.finalize(key_block_);
+      h.finalize(key_block);
       if (BLOCK_SIZE > HASH_SIZE) {
-	memset(&key_block_[h.HASH_SIZE], 0, BLOCK_SIZE - HASH_SIZE);
+	memset(&key_block[h.HASH_SIZE], 0, BLOCK_SIZE - HASH_SIZE);
       }
     } else {
-      memcpy(key_block_, key, key_len);
-      memset(&key_block_[key_len], 0, BLOCK_SIZE - key_len);
+      memcpy(key_block, key, key_len);
+      memset(&key_block[key_len], 0, BLOCK_SIZE - key_len);
     }
-    uint8_t inner_block[BLOCK_SIZE];
+    uint8_t pad_block[BLOCK_SIZE];
     for (size_t i = 0; i < BLOCK_SIZE; i++) {
-      inner_block[i] = key_block_[i] ^ 0x36;
+      pad_block[i] = key_block[i] ^ 0x36;
     }
     inner_hash_.init();
-    inner_hash_.update(inner_block, BLOCK_SIZE);
+    inner_hash_.update(pad_block, BLOCK_SIZE);
+    for (size_t i = 0; i < BLOCK_SIZE; i++) {
+      pad_block[i] = key_block[i] ^ 0x5c;
+    }
+    outer_hash_.init();
+    outer_hash_.update(pad_block, BLOCK_SIZE);
   }
 
   inline void update(const void *p, size_t len) {
@@ -41,14 +50,9 @@ public:
   }
 
   inline void finalize(uint8_t digest[HASH_SIZE]) {
-    Hash outer;
-    uint8_t outer_block[BLOCK_SIZE];
-    for (size_t i = 0; i < BLOCK_SIZE; i++) {
-      outer_block[i] = key_block_[i] ^ 0x5c;
-    }
-    outer.update(outer_block, BLOCK_SIZE);
     uint8_t inner_digest[HASH_SIZE];
     inner_hash_.finalize(inner_digest);
+    Hash outer = outer_hash_;
     outer.update(inner_digest, HASH_SIZE);
     outer.finalize(digest);
   }
@@ -59,7 +63,7 @@ public:
   
 private:      
   Hash inner_hash_;
-  uint8_t key_block_[Hash::BLOCK_SIZE];
+  Hash outer_hash_;
 };
 
 }}
@@ -1,3 +1,9 @@
+#pragma once
+
+#ifndef _common_lru_cache_hpp
+#define _common_lru_cache_hpp
+
+#include <cstddef>
 #include <unordered_map>
 #include <list>
 #include <vector>
@@ -22,11 +28,30 @@ public:
 
     inline void set_callback(C &callback) { callback_ = callback; }
 
+    inline size_t size() const { return access_.size(); }
+    inline size_t capacity() const { return capacity_; }
+
+    // Shrinking evicts the least recently used elements
+    inline void set_capacity(size_t capacity) {
+	capacity_ = capacity;
+	while (access_.size() > capacity_) {
+	    evictions_++;
+	    erase(access_.back());
+	}
+    }
+
+    // Statistics (find() hits and misses, evictions due to capacity)
+    inline size_t hits() const { return hits_; }
+    inline size_t misses() const { return misses_; }
+    inline size_t evictions() const { return evictions_; }
+    inline void reset_stats() { hits_ = misses_ = evictions_ = 0; }
+
     inline void insert(const K &key, const V &value) {
         auto it = map_.find(key);
 	if (it == map_.end()) {
 	    if (access_.size() >= capacity_) {
 	        auto removed_key = access_.back();
+		evictions_++;
 		erase(removed_key);
 	    }
 	    access_.push_front(key);
@@ -34,12 +59,19 @@ public:
 	}
     }
 
+    // Does not count as an access (nor a hit or miss)
+    inline bool contains(const K &key) const {
+	return map_.find(key) != map_.end();
+    }
+
     inline V * find(const K &key)
     {
         auto it = map_.find(key);
 	if (it == map_.end()) {
+	    misses_++;
 	    return nullptr;
 	}
+	hits_++;
 	auto &v = it->second.first;
 	auto &access_it = it->second.second;
 	access_.erase(access_it);
@@ -80,8 +112,12 @@ private:
     std::unordered_map<K, std::pair<V , access_iterator_type> > map_;
     std::list<K> access_;
     C callback_;
-
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    size_t evictions_ = 0;
 };
 
 }}
 
+#endif
+
@@ -42,6 +42,14 @@ public:
         blake2b_update(s, &value_, sizeof(value_));
     }
 
+    // The same bytes as above, but appended to a message
+    inline void compute_hash(std::vector<uint8_t> &msg) {
+        auto *k = reinterpret_cast<const uint8_t *>(&key_);
+        auto *v = reinterpret_cast<const uint8_t *>(&value_);
+        msg.insert(msg.end(), k, k + sizeof(key_));
+        msg.insert(msg.end(), v, v + sizeof(value_));
+    }
+
     inline uint64_t key() const {
         return key_;
     }
@@ -71,6 +79,10 @@ public:
     inline void compute_hash(blake2b_state *s) {
 	blake2b_update(s, &key_, sizeof(key_));
     }
+    inline void compute_hash(std::vector<uint8_t> &msg) {
+	auto *k = reinterpret_cast<const uint8_t *>(&key_);
+	msg.insert(msg.end(), k, k + sizeof(key_));
+    }
     inline uint64_t key() const {
 	return key_;
     }
@@ -127,6 +139,9 @@ private:
     static const size_t MAX_BRANCH_BITS = 5;
     static const size_t MAX_BRANCH = 1 << MAX_BRANCH_BITS;
 
+    // Number of branches hashed together by rehash_all
+    static const size_t REHASH_BATCH = 64;
+
     typedef typename detail::derive_word_t<MAX_BRANCH_BITS>::word_t word_t;
   
 public:
@@ -153,20 +168,54 @@ public:
         return t->num_bytes_helper();
     }
 
+    // Rehash the whole trie. The branches are collected level by level
+    // and each level (deepest first) is hashed in batches with
+    // blake2b_many, so that many branches are hashed side by side.
     inline void rehash_all() {
-	auto m = mask_;
-	if (m == 0) {
-	    return;
+	std::vector<merkle_trie_branch *> order;
+	std::vector<size_t> level_start;
+	if (mask_ != 0) {
+	    order.push_back(this);
 	}
-        for (size_t i = lsb(m); i < MAX_BRANCH;) {
-	    if (is_branch(i)) {
-	        merkle_trie_branch *child = get_branch(i);
-		child->rehash_all();
+	for (size_t at = 0; at < order.size(); ) {
+	    size_t level_end = order.size();
+	    level_start.push_back(at);
+	    for (; at < level_end; at++) {
+		auto *b = order[at];
+		word_t m = b->mask_;
+		for (size_t i = lsb(m); m != 0; ) {
+		    if (b->is_branch(i)) {
+			order.push_back(b->get_branch(i));
+		    }
+		    m &= (static_cast<word_t>(-1) << i) << 1;
+		    i = lsb(m);
+		}
 	    }
-	    m &= (static_cast<word_t>(-1) << i) << 1;
-	    i = (m == 0) ? MAX_BRANCH : lsb(m);
-        }
-	recompute_hash();
+	}
+
+	std::vector<uint8_t> msgs[REHASH_BATCH];
+	const void *in[REHASH_BATCH];
+	size_t inlen[REHASH_BATCH];
+	void *out[REHASH_BATCH];
+	size_t level_end = order.size();
+	while (!level_start.empty()) {
+	    size_t from = level_start.back();
+	    level_start.pop_back();
+	    for (size_t at = from; at < level_end; at += REHASH_BATCH) {
+		size_t n = level_end - at;
+		if (n > REHASH_BATCH) n = REHASH_BATCH;
+		for (size_t j = 0; j < n; j++) {
+		    auto *b = order[at+j];
+		    msgs[j].clear();
+		    b->hash_message(msgs[j]);
+		    in[j] = msgs[j].data();
+		    inlen[j] = msgs[j].size();
+		    out[j] = &b->hash_.data[0];
+		}
+		blake2b_many(n, out, sizeof(hash_t::data_t), in, inlen);
+	    }
+	    level_end = from;
+	}
     }
 
     template<typename U> inline merkle_trie_leaf<T> & insert_part(merkle_trie_branch *&parent, size_t _at_part, bool rehash, uint64_t _key, U &updater) {
@@ -397,6 +446,21 @@ private:
         blake2b_final(&s[0], &hash_.data[0], sizeof(hash_));
     }
 
+    // What recompute_hash hashes, as one message
+    inline void hash_message(std::vector<uint8_t> &msg) {
+	word_t m = mask_;
+	for (size_t i = lsb(m); m != 0; ) {
+	    if (is_leaf(i)) {
+		get_leaf(i)->compute_hash(msg);
+	    } else {
+		auto &h = get_branch(i)->hash();
+		msg.insert(msg.end(), &h.data[0], &h.data[0] + sizeof(h));
+	    }
+	    m &= (static_cast<word_t>(-1) << i) << 1;
+	    i = lsb(m);
+	}
+    }
+
     inline void internal_integrity_check() {
         assert(mask_ != 0);
 	word_t m = mask_;
@@ -1,9 +1,54 @@
 #include <iostream>
+#include <atomic>
+#include <vector>
+#include <string.h>
 #include <boost/endian/conversion.hpp>
+#include "cpu_features.hpp"
 #include "sha256.hpp"
 
 namespace prologcoin { namespace common {
 
+#if PROLOGCOIN_X64
+// In sha256_x86.cpp
+void sha256_transform_shani(uint32_t s[8], const uint8_t *data, size_t n);
+void sha256_transform_x8_avx2(uint32_t s[8][8], const uint8_t * const data[8],
+			      const size_t n[8]);
+#endif
+
+static std::atomic<int> sha256_impl(sha256::IMPL_AUTO);
+
+bool sha256::set_impl(impl_t impl)
+{
+    if (impl == IMPL_AUTO) {
+	impl = IMPL_SCALAR;
+#if PROLOGCOIN_X64
+	if (cpu_features::has_sha()) {
+	    impl = IMPL_SHANI;
+	} else if (cpu_features::has_avx2()) {
+	    impl = IMPL_AVX2;
+	}
+#endif
+    }
+    switch (impl) {
+    case IMPL_SCALAR: break;
+    case IMPL_SHANI: if (!cpu_features::has_sha()) return false; break;
+    case IMPL_AVX2: if (!cpu_features::has_avx2()) return false; break;
+    default: return false;
+    }
+    sha256_impl.store(impl);
+    return true;
+}
+
+sha256::impl_t sha256::get_impl()
+{
+    auto impl = static_cast<impl_t>(sha256_impl.load(std::memory_order_relaxed));
+    if (impl == IMPL_AUTO) {
+	set_impl(IMPL_AUTO);
+	impl = static_cast<impl_t>(sha256_impl.load());
+    }
+    return impl;
+}
+
 const uint8_t sha256::PADDING[64] = {
     0x80,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,
     0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,
@@ -40,6 +85,12 @@ void sha256::init() {
 #define BE32(x) boost::endian::native_to_big(x)
     
 void sha256::block() {
+#if PROLOGCOIN_X64
+    if (get_impl() == IMPL_SHANI) {
+	sha256_transform_shani(s_, buffer_, 1);
+	return;
+    }
+#endif
     uint32_t a = s_[0], b = s_[1], c = s_[2], d = s_[3];
     uint32_t e = s_[4], f = s_[5], g = s_[6], h = s_[7];
     uint32_t w0, w1, w2, w3, w4, w5, w6, w7;
@@ -123,19 +174,42 @@ void sha256::block() {
     s_[7] += h;
 }
 
+// Whole blocks straight from the input
+void sha256::blocks(const uint8_t *data, size_t n) {
+#if PROLOGCOIN_X64
+    if (get_impl() == IMPL_SHANI) {
+	sha256_transform_shani(s_, data, n);
+	return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++, data += BLOCK_SIZE) {
+	std::copy(data, &data[BLOCK_SIZE], &buffer_[0]);
+	block();
+    }
+}
+
 void sha256::update(const void *p, size_t len) {
     auto data = reinterpret_cast<const uint8_t *>(p);
     size_t n = total_size_ & 0x3F;
     total_size_ += len;
-    while (len >= 64 - n) {
-        size_t chunk_len = 64 - n;
+    if (n > 0) {
+	size_t chunk_len = 64 - n;
+	if (len < chunk_len) {
+	    std::copy(data, &data[len], &buffer_[n]);
+	    return;
+	}
 	std::copy(data, &data[chunk_len], &buffer_[n]);
-        data += chunk_len;
-        len -= chunk_len;
-        block();
-        n = 0;
+	data += chunk_len;
+	len -= chunk_len;
+	block();
+    }
+    size_t num_blocks = len / BLOCK_SIZE;
+    if (num_blocks > 0) {
+	blocks(data, num_blocks);
+	data += num_blocks * BLOCK_SIZE;
+	len -= num_blocks * BLOCK_SIZE;
     }
-    std::copy(data, &data[len], &buffer_[n]);
+    std::copy(data, &data[len], &buffer_[0]);
 }
 
 void sha256::finalize(uint8_t digest[sha256::HASH_SIZE]) {
@@ -155,4 +229,63 @@ void sha256::finalize(uint8_t digest[sha256::HASH_SIZE]) {
     std::copy(&digest_[0], &digest_[HASH_SIZE], digest);
 }
 
+// Append the padding and the length, like finalize() does
+static void sha256_pad(const uint8_t *msg, size_t len, std::vector<uint8_t> &out)
+{
+    size_t padded = (len + 9 + 63) & ~static_cast<size_t>(63);
+    out.assign(padded, 0);
+    if (len > 0) {
+	memcpy(&out[0], msg, len);
+    }
+    out[len] = 0x80;
+    uint64_t bits = static_cast<uint64_t>(len) << 3;
+    for (size_t i = 0; i < 8; i++) {
+	out[padded - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+void sha256::hash_many(size_t n, const uint8_t * const msgs[],
+		       const size_t lens[], uint8_t digests[][HASH_SIZE]) {
+#if PROLOGCOIN_X64
+    if (get_impl() == IMPL_AVX2) {
+	static const size_t LANES = 8;
+	std::vector<uint8_t> padded[LANES];
+	const sha256 h0;
+	for (size_t i = 0; i < n; i += LANES) {
+	    size_t m = std::min(LANES, n - i);
+	    uint32_t state[LANES][8];
+	    const uint8_t *data[LANES];
+	    size_t num_blocks[LANES];
+	    for (size_t j = 0; j < LANES; j++) {
+		memcpy(state[j], h0.s_, sizeof(state[j]));
+		if (j < m) {
+		    sha256_pad(msgs[i+j], lens[i+j], padded[j]);
+		    data[j] = &padded[j][0];
+		    num_blocks[j] = padded[j].size() / BLOCK_SIZE;
+		} else {
+		    data[j] = nullptr;
+		    num_blocks[j] = 0;
+		}
+	    }
+	    sha256_transform_x8_avx2(state, data, num_blocks);
+	    for (size_t j = 0; j < m; j++) {
+		for (size_t k = 0; k < 8; k++) {
+		    uint32_t v = state[j][k];
+		    digests[i+j][4*k] = static_cast<uint8_t>(v >> 24);
+		    digests[i+j][4*k+1] = static_cast<uint8_t>(v >> 16);
+		    digests[i+j][4*k+2] = static_cast<uint8_t>(v >> 8);
+		    digests[i+j][4*k+3] = static_cast<uint8_t>(v);
+		}
+	    }
+	}
+	return;
+    }
+#endif
+    for (size_t i = 0; i < n; i++) {
+	sha256 h;
+	h.update(msgs[i], lens[i]);
+	h.finalize(digests[i]);
+    }
+}
+
 }}
@@ -27,8 +27,22 @@ public:
   }
   void finalize(uint8_t digest[HASH_SIZE]);
 
+  // Hash n independent messages; digests[i] is the hash of msgs[i].
+  // With AVX2 (and no SHA extensions) eight messages are hashed at
+  // a time, one per vector lane, which pays off for many short ones.
+  static void hash_many(size_t n, const uint8_t * const msgs[],
+			const size_t lens[], uint8_t digests[][HASH_SIZE]);
+
+  // Implementation of the compression function. AUTO (the default)
+  // picks the fastest one the CPU supports; the others are for
+  // testing and benchmarking. Returns false if it isn't supported.
+  enum impl_t { IMPL_AUTO, IMPL_SCALAR, IMPL_SHANI, IMPL_AVX2 };
+  static bool set_impl(impl_t impl);
+  static impl_t get_impl();
+
 private:
    void block();
+   void blocks(const uint8_t *data, size_t n);
    union {
      uint32_t s_[8];
      uint8_t digest_[32];
@@ -0,0 +1,191 @@
+//
+// SHA-256 compression with the SHA extensions (one message) and with
+// AVX2 (eight messages at a time, one per 32-bit lane.) Same results
+// as sha256::block() in sha256.cpp.
+//
+
+#include <stdint.h>
+#include <string.h>
+#include "cpu_features.hpp"
+
+#if PROLOGCOIN_X64
+
+#include <immintrin.h>
+
+namespace prologcoin { namespace common {
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+//
+// SHA extensions. The state is kept as ABEF and CDGH (the layout
+// sha256rnds2 wants) and four rounds are done per message quad.
+//
+
+PROLOGCOIN_TARGET("sha,sse4.1")
+void sha256_transform_shani(uint32_t s[8], const uint8_t *data, size_t n)
+{
+    const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&s[0])), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&s[4])), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);    // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);         // CDGH
+
+    for (; n > 0; n--, data += 64) {
+	const __m128i abef = state0, cdgh = state1;
+	__m128i msg[4];
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 16
+#endif
+	for (size_t i = 0; i < 16; i++) {
+	    __m128i &x = msg[i & 3];
+	    if (i < 4) {
+		x = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16*i)), BSWAP);
+	    }
+	    __m128i m = _mm_add_epi32(x, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&K[4*i])));
+	    state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+	    if (i >= 3 && i < 15) {
+		// Next four words of the schedule
+		__m128i &next = msg[(i + 1) & 3];
+		next = _mm_add_epi32(next, _mm_alignr_epi8(x, msg[(i + 3) & 3], 4));
+		next = _mm_sha256msg2_epu32(next, x);
+	    }
+	    m = _mm_shuffle_epi32(m, 0x0E);
+	    state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+	    if (i >= 1 && i < 13) {
+		__m128i &prev = msg[(i + 3) & 3];
+		prev = _mm_sha256msg1_epu32(prev, x);
+	    }
+	}
+
+	state0 = _mm_add_epi32(state0, abef);
+	state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);               // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);            // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);         // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);            // HGFE
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&s[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&s[4]), state1);
+}
+
+//
+// AVX2, eight lanes. Lane j works on data[j] (n[j] blocks); a lane
+// that has run out of blocks keeps its state.
+//
+
+PROLOGCOIN_TARGET("avx2")
+static inline __m256i rotr(__m256i x, int c)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, c), _mm256_slli_epi32(x, 32 - c));
+}
+
+PROLOGCOIN_TARGET("avx2")
+static inline uint32_t load_be32(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+	   (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+PROLOGCOIN_TARGET("avx2")
+void sha256_transform_x8_avx2(uint32_t s[8][8], const uint8_t * const data[8],
+			      const size_t n[8])
+{
+    __m256i st[8];
+    for (size_t k = 0; k < 8; k++) {
+	st[k] = _mm256_setr_epi32(s[0][k], s[1][k], s[2][k], s[3][k],
+				  s[4][k], s[5][k], s[6][k], s[7][k]);
+    }
+
+    size_t max_n = 0;
+    for (size_t j = 0; j < 8; j++) {
+	if (n[j] > max_n) max_n = n[j];
+    }
+
+    for (size_t b = 0; b < max_n; b++) {
+	const uint8_t *p[8];
+	int active[8];
+	for (size_t j = 0; j < 8; j++) {
+	    active[j] = (b < n[j]) ? -1 : 0;
+	    p[j] = active[j] ? data[j] + 64*b : nullptr;
+	}
+	const __m256i mask = _mm256_setr_epi32(active[0], active[1], active[2], active[3],
+					       active[4], active[5], active[6], active[7]);
+
+	__m256i w[16];
+	for (size_t t = 0; t < 16; t++) {
+	    uint32_t v[8];
+	    for (size_t j = 0; j < 8; j++) {
+		v[j] = p[j] ? load_be32(p[j] + 4*t) : 0;
+	    }
+	    w[t] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v));
+	}
+
+	__m256i a = st[0], bb = st[1], c = st[2], d = st[3];
+	__m256i e = st[4], f = st[5], g = st[6], h = st[7];
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 64
+#endif
+	for (size_t t = 0; t < 64; t++) {
+	    if (t >= 16) {
+		__m256i w2 = w[(t - 2) & 15], w15 = w[(t - 15) & 15];
+		__m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr(w2, 17), rotr(w2, 19)),
+					      _mm256_srli_epi32(w2, 10));
+		__m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr(w15, 7), rotr(w15, 18)),
+					      _mm256_srli_epi32(w15, 3));
+		w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s1),
+					     _mm256_add_epi32(w[(t - 7) & 15], s0));
+	    }
+	    __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(rotr(e, 6), rotr(e, 11)), rotr(e, 25));
+	    __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+	    __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1),
+					  _mm256_add_epi32(ch, _mm256_add_epi32(
+						_mm256_set1_epi32(static_cast<int>(K[t])), w[t & 15])));
+	    __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(rotr(a, 2), rotr(a, 13)), rotr(a, 22));
+	    __m256i maj = _mm256_or_si256(_mm256_and_si256(a, bb),
+					  _mm256_and_si256(c, _mm256_or_si256(a, bb)));
+	    __m256i t2 = _mm256_add_epi32(S0, maj);
+	    h = g; g = f; f = e;
+	    e = _mm256_add_epi32(d, t1);
+	    d = c; c = bb; bb = a;
+	    a = _mm256_add_epi32(t1, t2);
+	}
+
+	const __m256i out[8] = { a, bb, c, d, e, f, g, h };
+	for (size_t k = 0; k < 8; k++) {
+	    st[k] = _mm256_blendv_epi8(st[k], _mm256_add_epi32(st[k], out[k]), mask);
+	}
+    }
+
+    for (size_t k = 0; k < 8; k++) {
+	uint32_t v[8];
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(v), st[k]);
+	for (size_t j = 0; j < 8; j++) {
+	    s[j][k] = v[j];
+	}
+    }
+}
+
+}}
+
+#endif
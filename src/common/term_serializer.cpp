@@ -13,6 +13,48 @@ term_serializer::~term_serializer()
 }
 
 void term_serializer::write(buffer_t &bytes, const term t)
+{
+    write_term(bytes, t);
+}
+
+void term_serializer::write(sink &out, const term t)
+{
+    sink_buffer bytes(out);
+    write_term(bytes, t);
+    bytes.flush(bytes.size());
+}
+
+void term_serializer::sink_buffer::flush(size_t upto)
+{
+    size_t n = upto - base_;
+    if (n == 0) {
+	return;
+    }
+    out_.write(&data_[0], n);
+    data_.erase(data_.begin(), data_.begin() + n);
+    base_ = upto;
+}
+
+void term_serializer::flush_window(sink_buffer &bytes)
+{
+    if (bytes.window_size() < SINK_CHUNK_SIZE) {
+	return;
+    }
+    // Argument slots still on the stack get filled in later;
+    // everything below the lowest of them is final.
+    size_t upto = bytes.size();
+    for (auto &e : stack_) {
+	if (e.first < upto) upto = e.first;
+    }
+    // Only move the window if that frees at least half of it, so
+    // a slot that stays open for long doesn't make this quadratic.
+    size_t keep = bytes.size() - upto;
+    if (keep <= bytes.window_size() - keep) {
+	bytes.flush(upto);
+    }
+}
+
+template<typename Buffer> void term_serializer::write_term(Buffer &bytes, const term t)
 {
     term_index_.clear();
     
@@ -53,10 +95,11 @@ void term_serializer::write(buffer_t &bytes, const term t)
 	    write_big_cell(bytes,offset,reinterpret_cast<const big_cell &>(t1));
 	    break;
 	}
+	flush_window(bytes);
     }
 }
 
-void term_serializer::write_encoded_string(buffer_t &bytes, const std::string &str) {
+template<typename Buffer> void term_serializer::write_encoded_string(Buffer &bytes, const std::string &str) {
     // Write a series of INT cells, with 7 bytes
     // of data, the lower 5 bits tells (before tag)
     // tells whether this continues or not.
@@ -67,7 +110,7 @@ void term_serializer::write_encoded_string(buffer_t &bytes, const std::string &s
     }
 }
 
-void term_serializer::write_all_header(buffer_t &bytes,const term t)
+template<typename Buffer> void term_serializer::write_all_header(Buffer &bytes,const term t)
 {
     write_con_cell(bytes, bytes.size(), con_cell("ver1",0));
     write_con_cell(bytes, bytes.size(), con_cell("remap", 0));
@@ -114,7 +157,7 @@ void term_serializer::write_all_header(buffer_t &bytes,const term t)
     write_con_cell(bytes, bytes.size(), con_cell("pamer", 0));
 }
 
-void term_serializer::write_str_cell(buffer_t &bytes, size_t offset,
+template<typename Buffer> void term_serializer::write_str_cell(Buffer &bytes, size_t offset,
 				     const str_cell c)
 {
     // If we've seen this before, then we just reuse what we have
@@ -136,7 +179,7 @@ void term_serializer::write_str_cell(buffer_t &bytes, size_t offset,
     }
 }
 
-void term_serializer::write_big_cell(buffer_t &bytes, size_t offset,
+template<typename Buffer> void term_serializer::write_big_cell(Buffer &bytes, size_t offset,
 				     const big_cell c)
 {
     // If we've seen this before, then we just reuse what we have
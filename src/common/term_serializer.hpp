@@ -212,10 +212,22 @@ class term_serializer {
 public:
     typedef std::vector<uint8_t> buffer_t;
 
+    // Receives the serialized bytes in order, a chunk at a time.
+    class sink {
+    public:
+	virtual ~sink() { }
+	virtual void write(const uint8_t *data, size_t n) = 0;
+    };
+
     term_serializer(term_env &env);
     ~term_serializer();
 
     void write(buffer_t &bytes, const term t);
+
+    // Same bytes as write(buffer_t &, t), but only a window of the
+    // output is kept in memory; the rest has already been given to
+    // the sink.
+    void write(sink &out, const term t);
     term read(const buffer_t &bytes);
     term read(const buffer_t &bytes, size_t n);
 
@@ -235,7 +247,7 @@ public:
 	  return c;
 	}
 
-    static inline void write_cell(buffer_t &bytes, size_t offset, const untagged_cell c)
+    template<typename Buffer> static inline void write_cell(Buffer &bytes, size_t offset, const untagged_cell c)
         { auto v = c.raw_value();
 	  if (offset == bytes.size()) {
 	      bytes.resize(offset+8);
@@ -247,6 +259,33 @@ public:
         }
 
 private:
+    // A buffer_t look-alike (offsets are from the start of the
+    // serialized term) where everything below base has been flushed
+    // to the sink.
+    class sink_buffer {
+    public:
+	sink_buffer(sink &out) : out_(out), base_(0) { }
+
+	inline size_t size() const { return base_ + data_.size(); }
+	inline void resize(size_t n) { data_.resize(n - base_); }
+	inline uint8_t & operator [] (size_t offset) { return data_[offset - base_]; }
+	inline size_t window_size() const { return data_.size(); }
+
+	void flush(size_t upto);
+
+    private:
+	sink &out_;
+	size_t base_;
+	buffer_t data_;
+    };
+
+    // Flush window below this many bytes isn't worth it
+    static const size_t SINK_CHUNK_SIZE = 4096;
+
+    template<typename Buffer> void write_term(Buffer &bytes, const term t);
+    inline void flush_window(buffer_t &) { }
+    void flush_window(sink_buffer &bytes);
+
     static inline uint8_t read_byte(const buffer_t &bytes, size_t from_offset)
         { return bytes[from_offset]; }
 
@@ -261,13 +300,13 @@ private:
 
     inline size_t cell_count(size_t offset)
         { return offset / sizeof(cell); }
-    inline size_t cell_count(buffer_t &bytes)
+    template<typename Buffer> inline size_t cell_count(Buffer &bytes)
         { return cell_count(bytes.size()); }
 
-    inline void write_int_cell(buffer_t &bytes, size_t offset, const int_cell c)
+    template<typename Buffer> inline void write_int_cell(Buffer &bytes, size_t offset, const int_cell c)
         { write_cell(bytes, offset, c); }
 
-    inline void write_con_cell(buffer_t &bytes, size_t offset,const con_cell c)
+    template<typename Buffer> inline void write_con_cell(Buffer &bytes, size_t offset,const con_cell c)
         { if (c.is_direct()) {
 	      write_cell(bytes, offset, c);
 	  } else {
@@ -276,11 +315,11 @@ private:
 	  }
 	}
 
-    inline void write_ref_cell(buffer_t &bytes, size_t offset, const ref_cell c)
+    template<typename Buffer> inline void write_ref_cell(Buffer &bytes, size_t offset, const ref_cell c)
     { write_cell(bytes, offset, remapped_term(c.unwatch(), cell_count(offset))); }
 
-    void write_str_cell(buffer_t &bytes, size_t offset, const str_cell c);
-    void write_big_cell(buffer_t &bytes, size_t offset, const big_cell c);
+    template<typename Buffer> void write_str_cell(Buffer &bytes, size_t offset, const str_cell c);
+    template<typename Buffer> void write_big_cell(Buffer &bytes, size_t offset, const big_cell c);
 
     inline bool is_indexed(const term t)
         { return term_index_.is_indexed(t); }
@@ -312,8 +351,8 @@ private:
     inline size_t index_term(const term t, size_t cell_index)
         { return term_index_.to_index(t, cell_index); }
 
-    void write_encoded_string(buffer_t &bytes, const std::string &str);
-    void write_all_header(buffer_t &bytes, const term t);
+    template<typename Buffer> void write_encoded_string(Buffer &bytes, const std::string &str);
+    template<typename Buffer> void write_all_header(Buffer &bytes, const term t);
 
     term read(const buffer_t &bytes, size_t n, size_t heap_start,
 	      std::vector<bool> &used, size_t &offset,
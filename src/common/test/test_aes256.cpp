@@ -1,5 +1,7 @@
 #include <common/aes256.hpp>
 #include <common/hex.hpp>
+#include <common/utime.hpp>
+#include <vector>
 #include <iostream>
 #include <assert.h>
 #include <string>
@@ -13,19 +15,17 @@ static void header( const std::string &str )
     std::cout << "\n";
 }
 
-static void test_aes256()
-{
-    header("test_aes256");
+static const uint8_t key[32] = {0x60,0x3D,0xEB,0x10,0x15,0xCA,0x71,0xBE,
+				0x2B,0x73,0xAE,0xF0,0x85,0x7D,0x77,0x81,
+				0x1F,0x35,0x2C,0x07,0x3B,0x61,0x08,0xD7,
+				0x2D,0x98,0x10,0xA3,0x09,0x14,0xDF,0xF4};
+static const uint8_t iv[16] = {0x9C,0xFC,0x4E,0x96,0x7E,0xDB,0x80,0x8D,
+			       0x67,0x9F,0x77,0x7B,0xC6,0x70,0x2C,0x7D};
+static const uint8_t msg[16] = {0x30,0xC8,0x1C,0x46,0xA3,0x5C,0xE4,0x11,
+				0xE5,0xFB,0xC1,0x19,0x1A,0x0A,0x52,0xEF};
 
-    const uint8_t key[32] = {0x60,0x3D,0xEB,0x10,0x15,0xCA,0x71,0xBE,
-			     0x2B,0x73,0xAE,0xF0,0x85,0x7D,0x77,0x81,
-			     0x1F,0x35,0x2C,0x07,0x3B,0x61,0x08,0xD7,
-			     0x2D,0x98,0x10,0xA3,0x09,0x14,0xDF,0xF4};
-    const uint8_t iv[16] = {0x9C,0xFC,0x4E,0x96,0x7E,0xDB,0x80,0x8D,
-			    0x67,0x9F,0x77,0x7B,0xC6,0x70,0x2C,0x7D};
-    const uint8_t msg[16] = {0x30,0xC8,0x1C,0x46,0xA3,0x5C,0xE4,0x11,
-			     0xE5,0xFB,0xC1,0x19,0x1A,0x0A,0x52,0xEF};
-    
+static void check_aes256(const std::string &name, std::vector<uint8_t> &expect_big)
+{
     aes256 aes(key, 32);
     aes.set_iv(iv, 16);
     uint8_t data[16];
@@ -38,6 +38,57 @@ static void test_aes256()
     aes.set_iv(iv, 16);
     aes.cbc_decrypt(data, 16);
     assert(memcmp(data, msg, 16) == 0);
+
+    // 64 KB, with a tail that isn't a multiple of four blocks. Then
+    // one more block, to check the IV that encryption continues from.
+    std::vector<uint8_t> big(65536 + 3*16);
+    for (size_t i = 0; i < big.size(); i++) {
+	big[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+    }
+    auto buf = big;
+    buf.insert(buf.end(), msg, msg + 16);
+    aes.set_iv(iv, 16);
+    auto t0 = utime::now();
+    aes.cbc_encrypt(&buf[0], big.size());
+    auto t1 = utime::now();
+    aes.cbc_encrypt(&buf[big.size()], 16);
+    if (expect_big.empty()) {
+	expect_big = buf;
+    }
+    assert(buf == expect_big);
+
+    aes.set_iv(iv, 16);
+    auto t2 = utime::now();
+    aes.cbc_decrypt(&buf[0], big.size());
+    auto t3 = utime::now();
+    aes.cbc_decrypt(&buf[big.size()], 16);
+    assert(memcmp(&buf[0], &big[0], big.size()) == 0);
+    assert(memcmp(&buf[big.size()], msg, 16) == 0);
+
+    std::cout << "aes256 " << name << ": encrypt " << (t1-t0).in_us()
+	      << " us, decrypt " << (t3-t2).in_us() << " us ("
+	      << big.size() << " bytes)" << std::endl;
+}
+
+static void test_aes256()
+{
+    header("test_aes256");
+
+    static const struct { aes256::impl_t impl; const char *name; } impls[] = {
+	{ aes256::IMPL_PORTABLE, "portable" },
+	{ aes256::IMPL_AESNI, "aes-ni" }
+    };
+
+    auto old_impl = aes256::get_impl();
+    std::vector<uint8_t> expect_big;
+    for (auto &i : impls) {
+	if (!aes256::set_impl(i.impl)) {
+	    std::cout << "aes256 " << i.name << ": not supported" << std::endl;
+	    continue;
+	}
+	check_aes256(i.name, expect_big);
+    }
+    aes256::set_impl(old_impl);
 }
 
 int main( int argc, char *argv[] )
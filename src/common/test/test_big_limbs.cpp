@@ -0,0 +1,227 @@
+#include <iostream>
+#include <iomanip>
+#include <assert.h>
+#include <vector>
+#include <boost/multiprecision/cpp_int.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <common/big_limbs.hpp>
+#include <common/random.hpp>
+
+using namespace prologcoin::common;
+using namespace boost::multiprecision;
+
+static void header( const std::string &str )
+{
+    std::cout << "\n";
+    std::cout << "--- [" + str + "] " + std::string(60 - str.length(), '-') << "\n";
+    std::cout << "\n";
+}
+
+static cpp_int to_cpp_int(const std::vector<uint8_t> &bytes)
+{
+    cpp_int i;
+    import_bits(i, bytes.begin(), bytes.end(), 8);
+    return i;
+}
+
+static std::vector<uint8_t> to_bytes(const cpp_int &i, size_t nbytes)
+{
+    std::vector<uint8_t> bytes;
+    export_bits(i, std::back_inserter(bytes), 8);
+    while (bytes.size() < nbytes) {
+	bytes.insert(bytes.begin(), 0);
+    }
+    return bytes;
+}
+
+// What arithmetics used to do: convert, compute, convert back.
+static cpp_int reference(big_op op, const cpp_int &a, const cpp_int &b)
+{
+    // cpp_int's / and % truncate toward zero (// and rem)
+    cpp_int q, m;
+    if (op >= BIG_DIV0 && op <= BIG_MOD) {
+	q = a / b;
+	m = a % b;
+    }
+    bool floor = m != 0 && ((a < 0) != (b < 0));
+    switch (op) {
+    case BIG_ADD: return a + b;
+    case BIG_SUB: return a - b;
+    case BIG_MUL: return a * b;
+    case BIG_DIV0: return q;
+    case BIG_DIV: return floor ? q - 1 : q;
+    case BIG_REM: return m;
+    case BIG_MOD: return floor ? m + b : m;
+    case BIG_MAX: return std::max(a, b);
+    case BIG_MIN: return std::min(a, b);
+    }
+    return 0;
+}
+
+static void random_bytes(std::vector<uint8_t> &bytes, size_t significant)
+{
+    std::fill(bytes.begin(), bytes.end(), 0);
+    random::next_bytes(&bytes[bytes.size()-significant], significant);
+}
+
+static big_operand operand(const std::vector<uint8_t> &bytes, bool negative)
+{
+    big_operand op;
+    op.negative = negative && to_cpp_int(bytes) != 0;
+    op.bytes = &bytes[0];
+    op.num_bytes = bytes.size();
+    return op;
+}
+
+static cpp_int value(const big_operand &op)
+{
+    cpp_int i;
+    import_bits(i, op.bytes, op.bytes + op.num_bytes, 8);
+    return op.negative ? -i : i;
+}
+
+static void test_big_limbs()
+{
+    header( "test_big_limbs" );
+
+    static const big_op OPS[] = { BIG_ADD, BIG_SUB, BIG_MUL, BIG_DIV0, BIG_DIV,
+				  BIG_REM, BIG_MOD, BIG_MAX, BIG_MIN };
+    static const size_t WIDTHS[] = { 8, 64, 72, 256, 264, 512, 1024, 2056 };
+
+    for (auto num_bits : WIDTHS) {
+	size_t nbytes = num_bits / 8;
+	for (size_t k = 0; k < 200; k++) {
+	    // Also divide by small and medium sized numbers
+	    std::vector<uint8_t> a(nbytes), b(1 + (k % nbytes));
+	    random_bytes(a, nbytes);
+	    random_bytes(b, b.size());
+	    if (k % 3 == 0) {
+		// Top bits of the divisor set (quotient digit estimates
+		// need correcting more often)
+		b[0] = 0xff;
+	    }
+	    if (k % 7 == 0) {
+		// Results that cancel out
+		b = a;
+	    }
+	    auto x = operand(a, k % 2 == 1), y = operand(b, (k / 2) % 2 == 1);
+	    if (k % 5 == 0) {
+		std::swap(x, y);
+	    }
+	    auto xi = value(x), yi = value(y);
+	    for (auto op : OPS) {
+		std::vector<uint8_t> r(big_result_bytes(op, x.num_bytes, y.num_bytes));
+		bool negative = false;
+		bool ok = big_apply(op, x, y, &r[0], negative);
+		if (yi == 0 && op >= BIG_DIV0 && op <= BIG_MOD) {
+		    assert(!ok);
+		    continue;
+		}
+		assert(ok);
+		auto expect = reference(op, xi, yi);
+		auto result = negative ? -to_cpp_int(r) : to_cpp_int(r);
+		if (result != expect || (negative && result == 0)) {
+		    std::cout << "Mismatch for op=" << op << " num_bits=" << num_bits << ": "
+			      << xi << " op " << yi << " = " << result
+			      << " (expected " << expect << ")" << std::endl;
+		    assert(result == expect);
+		}
+	    }
+	}
+	std::cout << "Width " << std::setw(4) << num_bits << ": OK" << std::endl;
+    }
+}
+
+// The portable 64-bit primitives (used where there's neither
+// unsigned __int128 nor MSVC intrinsics) against the native ones.
+static void test_big_limbs_portable()
+{
+    header( "test_big_limbs_portable" );
+
+    std::vector<uint64_t> values = { 0, 1, 2, 3, 0xffffffff, 0x100000000ULL,
+				     0x7fffffffffffffffULL, 0x8000000000000000ULL,
+				     0xfffffffffffffffeULL, 0xffffffffffffffffULL };
+    for (size_t i = 0; i < 200; i++) {
+	uint64_t v;
+	random::next_bytes(reinterpret_cast<uint8_t *>(&v), sizeof(v));
+	values.push_back(v >> (i % 64));
+    }
+
+    size_t n = 0;
+    for (auto a : values) {
+	assert(limbs::portable::bswap_64(a) == limbs::bswap_64(a));
+	if (a != 0) {
+	    assert(limbs::portable::clz_64(a) == limbs::clz_64(a));
+	}
+	for (auto b : values) {
+	    uint64_t hi0, hi1;
+	    uint64_t lo0 = limbs::portable::mul_64(a, b, hi0);
+	    uint64_t lo1 = limbs::mul_64(a, b, hi1);
+	    assert(lo0 == lo1 && hi0 == hi1);
+	    for (auto d : { b, b | 1, ~b }) {
+		if (d == 0) {
+		    continue;
+		}
+		uint64_t hi = a % d; // The quotient must fit
+		uint64_t rem0, rem1;
+		uint64_t q0 = limbs::portable::div_128(hi, b, d, rem0);
+		uint64_t q1 = limbs::div_128(hi, b, d, rem1);
+		assert(q0 == q1 && rem0 == rem1);
+		n++;
+	    }
+	}
+    }
+    std::cout << "Checked " << n << " divisions: OK" << std::endl;
+}
+
+static void test_big_limbs_benchmark()
+{
+    header( "test_big_limbs_benchmark" );
+
+    static const size_t N = 100000;
+    static const big_op OPS[] = { BIG_ADD, BIG_MUL, BIG_MOD };
+    static const char *NAMES[] = { "add", "mul", "mod" };
+
+    for (size_t num_bits : { 256, 512 }) {
+	size_t nbytes = num_bits / 8;
+	std::vector<uint8_t> a(nbytes), b(nbytes / 2);
+	random_bytes(a, nbytes);
+	random_bytes(b, nbytes / 2);
+	auto x = operand(a, false), y = operand(b, false);
+	for (size_t k = 0; k < sizeof(OPS)/sizeof(OPS[0]); k++) {
+	    auto op = OPS[k];
+	    std::vector<uint8_t> r(big_result_bytes(op, nbytes, nbytes / 2));
+	    bool negative;
+
+	    auto start = boost::posix_time::microsec_clock::local_time();
+	    for (size_t i = 0; i < N; i++) {
+		big_apply(op, x, y, &r[0], negative);
+		a[nbytes-1] ^= r[r.size()-1];
+	    }
+	    auto stop = boost::posix_time::microsec_clock::local_time();
+	    auto limbs_us = (stop - start).total_microseconds();
+
+	    start = boost::posix_time::microsec_clock::local_time();
+	    for (size_t i = 0; i < N; i++) {
+		auto ai = to_cpp_int(a), bi = to_cpp_int(b);
+		r = to_bytes(reference(op, ai, bi), r.size());
+		a[nbytes-1] ^= r[r.size()-1];
+	    }
+	    stop = boost::posix_time::microsec_clock::local_time();
+	    auto cpp_int_us = (stop - start).total_microseconds();
+
+	    std::cout << std::setw(3) << num_bits << "-bit " << NAMES[k]
+		      << ": limbs " << std::setw(6) << (1000*limbs_us/N) << " ns/op"
+		      << ", cpp_int round-trip " << std::setw(6) << (1000*cpp_int_us/N)
+		      << " ns/op" << std::endl;
+	}
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    test_big_limbs();
+    test_big_limbs_portable();
+    test_big_limbs_benchmark();
+    return 0;
+}
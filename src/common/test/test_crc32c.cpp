@@ -0,0 +1,77 @@
+#include <common/crc32c.hpp>
+#include <iostream>
+#include <iomanip>
+#include <assert.h>
+#include <string>
+#include <string.h>
+
+using namespace prologcoin::common;
+
+static void header( const std::string &str )
+{
+    std::cout << "\n";
+    std::cout << "--- [" + str + "] " + std::string(60 - str.length(), '-') << "\n";
+    std::cout << "\n";
+}
+
+static void test_crc32c()
+{
+    header("test_crc32c");
+
+    std::cout << "Hardware support: "
+	      << (crc32c::has_hardware_support() ? "yes" : "no") << std::endl;
+
+    const char *msg = "123456789";
+    uint32_t c = crc32c::checksum(msg, strlen(msg));
+    std::cout << "CRC32C of '123456789' is: " << std::hex << c << std::dec
+	      << std::endl;
+    assert(c == 0xe3069283);
+
+    // RFC 3720, B.4: 32 bytes of zeros
+    uint8_t zeros[32];
+    memset(zeros, 0, sizeof(zeros));
+    assert(crc32c::checksum(zeros, sizeof(zeros)) == 0x8a9136aa);
+
+    // RFC 3720, B.4: 32 bytes of ones
+    uint8_t ones[32];
+    memset(ones, 0xff, sizeof(ones));
+    assert(crc32c::checksum(ones, sizeof(ones)) == 0x62a8ab43);
+
+    assert(crc32c::checksum(nullptr, 0) == 0);
+}
+
+static void test_crc32c_incremental()
+{
+    header("test_crc32c_incremental");
+
+    uint8_t data[1031];
+    for (size_t i = 0; i < sizeof(data); i++) {
+	data[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+
+    // Split at every possible (unaligned) point and compare with
+    // the one-shot checksum.
+    uint32_t expect = crc32c::checksum(data, sizeof(data));
+    for (size_t split = 0; split <= sizeof(data); split += 13) {
+	crc32c c;
+	c.update(data, split);
+	c.update(data + split, sizeof(data) - split);
+	assert(c.finalize() == expect);
+    }
+
+    // Any single bit flip must be detected
+    for (size_t i = 0; i < sizeof(data); i += 17) {
+	data[i] ^= 0x10;
+	assert(crc32c::checksum(data, sizeof(data)) != expect);
+	data[i] ^= 0x10;
+    }
+    std::cout << "OK" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    test_crc32c();
+    test_crc32c_incremental();
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <common/gcs_filter.hpp>
+#include <iostream>
+#include <assert.h>
+#include <string>
+#include <vector>
+
+using namespace prologcoin::common;
+
+static void header( const std::string &str )
+{
+    std::cout << "\n";
+    std::cout << "--- [" + str + "] " + std::string(60 - str.length(), '-') << "\n";
+    std::cout << "\n";
+}
+
+static std::string item(const std::string &prefix, size_t i)
+{
+    return prefix + std::to_string(i);
+}
+
+static void test_gcs_filter()
+{
+    header("test_gcs_filter");
+
+    static const size_t N = 1000;
+    static const size_t NUM_PROBES = 100000;
+
+    std::vector<std::string> items;
+    for (size_t i = 0; i < N; i++) {
+	items.push_back(item("addr", i));
+    }
+    gcs_filter::buffer_t buf;
+    gcs_filter::build(42, items, buf);
+
+    std::cout << "Filter of " << N << " items: " << buf.size() << " bytes ("
+	      << (buf.size() * 8.0 / N) << " bits per item)" << std::endl;
+    assert(buf.size() * 8 < N * (gcs_filter::P + 3));
+
+    gcs_filter f(42, &buf[0], buf.size());
+    assert(f.size() == N);
+
+    // No false negatives
+    for (auto &it : items) {
+	assert(f.match(it));
+    }
+
+    // Few false positives
+    size_t false_positives = 0;
+    for (size_t i = 0; i < NUM_PROBES; i++) {
+	if (f.match(item("other", i))) {
+	    false_positives++;
+	}
+    }
+    std::cout << "False positives: " << false_positives << " of "
+	      << NUM_PROBES << std::endl;
+    assert(false_positives < 10);
+
+    // Another key gives another filter
+    gcs_filter f2(43, &buf[0], buf.size());
+    size_t matches = 0;
+    for (auto &it : items) {
+	if (f2.match(it)) matches++;
+    }
+    assert(matches < 10);
+}
+
+static void test_gcs_filter_match_any()
+{
+    header("test_gcs_filter_match_any");
+
+    std::vector<std::string> items{"a", "b", "c", "b"};
+    gcs_filter::buffer_t buf;
+    gcs_filter::build(7, items, buf);
+
+    gcs_filter f(7, &buf[0], buf.size());
+    assert(f.size() == 3);
+    assert(f.match_any({"x", "y", "c"}));
+    assert(!f.match_any({"x", "y", "z"}));
+    assert(!f.match_any({}));
+
+    // Empty set matches nothing
+    gcs_filter::build(7, std::vector<std::string>(), buf);
+    assert(buf.size() == 4);
+    gcs_filter empty(7, &buf[0], buf.size());
+    assert(!empty.match("a"));
+}
+
+int main(int argc, char *argv[])
+{
+    test_gcs_filter();
+    test_gcs_filter_match_any();
+    return 0;
+}
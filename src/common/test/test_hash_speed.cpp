@@ -0,0 +1,248 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <assert.h>
+#include <string.h>
+#include <common/blake2.hpp>
+#include <common/sha256.hpp>
+#include <common/hex.hpp>
+#include <common/utime.hpp>
+
+using namespace prologcoin::common;
+
+static void header( const std::string &str )
+{
+    std::cout << "\n";
+    std::cout << "--- [" + str + "] " + std::string(60 - str.length(), '-') << "\n";
+    std::cout << "\n";
+}
+
+static std::vector<uint8_t> test_data(size_t n)
+{
+    std::vector<uint8_t> data(n);
+    uint32_t x = 4711;
+    for (size_t i = 0; i < n; i++) {
+	x = x * 1103515245 + 12345;
+	data[i] = static_cast<uint8_t>(x >> 16);
+    }
+    return data;
+}
+
+static void report(const std::string &what, size_t bytes, uint64_t us)
+{
+    double mb_s = static_cast<double>(bytes) / std::max(us, static_cast<uint64_t>(1));
+    std::cout << std::setw(40) << std::left << what << std::right
+	      << std::setw(10) << std::fixed << std::setprecision(1) << mb_s
+	      << " MB/s" << std::endl;
+}
+
+static const size_t BIG_SIZE = 1024*1024;
+static const size_t BIG_ROUNDS = 64;
+static const size_t SMALL_SIZE = 64;
+static const size_t SMALL_COUNT = 200000;
+
+static std::string blake2b_digests(const std::vector<uint8_t> &data)
+{
+    // Every length around the block size, and some bigger ones
+    std::string all;
+    for (size_t len = 0; len <= 300; len++) {
+	uint8_t out[64];
+	blake2b(out, sizeof(out), &data[0], len, nullptr, 0);
+	all += hex::to_string(out, sizeof(out));
+    }
+    for (size_t len = 1000; len < data.size(); len *= 3) {
+	uint8_t out[32];
+	blake2b(out, sizeof(out), &data[0], len, nullptr, 0);
+	all += hex::to_string(out, sizeof(out));
+    }
+
+    // Messages of different lengths (and number of blocks) in
+    // the same group of lanes
+    static const size_t N = 37;
+    const void *msgs[N];
+    size_t lens[N];
+    uint8_t digests[N][32];
+    void *outs[N];
+    for (size_t i = 0; i < N; i++) {
+	msgs[i] = &data[i * 100];
+	lens[i] = (i * 37) % 300;
+	outs[i] = digests[i];
+    }
+    assert(blake2b_many(N, outs, 32, msgs, lens) == 0);
+    for (size_t i = 0; i < N; i++) {
+	uint8_t one[32];
+	blake2b(one, sizeof(one), msgs[i], lens[i], nullptr, 0);
+	assert(memcmp(one, digests[i], sizeof(one)) == 0);
+	all += hex::to_string(digests[i], sizeof(digests[i]));
+    }
+    return all;
+}
+
+static void test_blake2b()
+{
+    header("test_blake2b");
+
+    static const struct { blake2b_impl impl; const char *name; } impls[] = {
+	{ BLAKE2B_IMPL_REF, "ref" },
+	{ BLAKE2B_IMPL_SSE41, "sse4.1" },
+	{ BLAKE2B_IMPL_AVX2, "avx2" }
+    };
+
+    auto data = test_data(BIG_SIZE);
+    auto old_impl = blake2b_get_impl();
+
+    std::string expect;
+    for (auto &i : impls) {
+	if (blake2b_set_impl(i.impl) != 0) {
+	    std::cout << "blake2b " << i.name << ": not supported" << std::endl;
+	    continue;
+	}
+
+	uint8_t out[64];
+	blake2b(out, sizeof(out), "abc", 3, nullptr, 0);
+	assert(hex::to_string(out, sizeof(out)) == "ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d17d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923");
+
+	auto digests = blake2b_digests(data);
+	if (expect.empty()) {
+	    expect = digests;
+	}
+	assert(digests == expect);
+
+	utime t0 = utime::now();
+	for (size_t r = 0; r < BIG_ROUNDS; r++) {
+	    blake2b(out, 32, &data[0], data.size(), nullptr, 0);
+	}
+	utime t1 = utime::now();
+	for (size_t r = 0; r < SMALL_COUNT; r++) {
+	    blake2b(out, 32, &data[(r * SMALL_SIZE) % BIG_SIZE], SMALL_SIZE, nullptr, 0);
+	}
+	utime t2 = utime::now();
+	static const size_t BATCH = 32;
+	const void *msgs[BATCH];
+	size_t lens[BATCH];
+	uint8_t outs_data[BATCH][32];
+	void *outs[BATCH];
+	for (size_t r = 0; r < SMALL_COUNT; r += BATCH) {
+	    for (size_t j = 0; j < BATCH; j++) {
+		msgs[j] = &data[((r + j) * SMALL_SIZE) % BIG_SIZE];
+		lens[j] = SMALL_SIZE;
+		outs[j] = outs_data[j];
+	    }
+	    blake2b_many(BATCH, outs, 32, msgs, lens);
+	}
+	utime t3 = utime::now();
+	report(std::string("blake2b ") + i.name + " (1MB)", BIG_SIZE*BIG_ROUNDS, (t1-t0).in_us());
+	report(std::string("blake2b ") + i.name + " (64 bytes)", SMALL_SIZE*SMALL_COUNT, (t2-t1).in_us());
+	report(std::string("blake2b_many ") + i.name + " (64 bytes)", SMALL_SIZE*SMALL_COUNT, (t3-t2).in_us());
+    }
+
+    blake2b_set_impl(old_impl);
+}
+
+static std::string sha256_digests(const std::vector<uint8_t> &data)
+{
+    std::string all;
+    for (size_t len = 0; len <= 200; len++) {
+	sha256 h;
+	h.update(&data[0], len);
+	all += h.finalize();
+    }
+    // Odd sized updates
+    sha256 h;
+    for (size_t off = 0, len = 1; off + len < data.size(); off += len, len = len * 2 + 1) {
+	h.update(&data[off], len);
+    }
+    all += h.finalize();
+
+    // Messages of different lengths (and number of blocks) in
+    // the same group of lanes
+    static const size_t N = 37;
+    const uint8_t *msgs[N];
+    size_t lens[N];
+    uint8_t digests[N][sha256::HASH_SIZE];
+    for (size_t i = 0; i < N; i++) {
+	msgs[i] = &data[i * 100];
+	lens[i] = (i * 37) % 300;
+    }
+    sha256::hash_many(N, msgs, lens, digests);
+    for (size_t i = 0; i < N; i++) {
+	sha256 h;
+	h.update(msgs[i], lens[i]);
+	uint8_t one[sha256::HASH_SIZE];
+	h.finalize(one);
+	assert(memcmp(one, digests[i], sizeof(one)) == 0);
+	all += hex::to_string(digests[i], sha256::HASH_SIZE);
+    }
+    return all;
+}
+
+static void test_sha256()
+{
+    header("test_sha256");
+
+    static const struct { sha256::impl_t impl; const char *name; } impls[] = {
+	{ sha256::IMPL_SCALAR, "scalar" },
+	{ sha256::IMPL_SHANI, "sha-ni" },
+	{ sha256::IMPL_AVX2, "avx2" }
+    };
+
+    auto data = test_data(BIG_SIZE);
+    auto old_impl = sha256::get_impl();
+
+    std::vector<const uint8_t *> msgs(SMALL_COUNT);
+    std::vector<size_t> lens(SMALL_COUNT, SMALL_SIZE);
+    std::vector<uint8_t> digests(SMALL_COUNT * sha256::HASH_SIZE);
+    for (size_t r = 0; r < SMALL_COUNT; r++) {
+	msgs[r] = &data[(r * SMALL_SIZE) % BIG_SIZE];
+    }
+
+    std::string expect;
+    for (auto &i : impls) {
+	if (!sha256::set_impl(i.impl)) {
+	    std::cout << "sha256 " << i.name << ": not supported" << std::endl;
+	    continue;
+	}
+
+	sha256 abc;
+	abc.update("abc", 3);
+	assert(abc.finalize() == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+	auto all = sha256_digests(data);
+	if (expect.empty()) {
+	    expect = all;
+	}
+	assert(all == expect);
+
+	uint8_t out[sha256::HASH_SIZE];
+	utime t0 = utime::now();
+	for (size_t r = 0; r < BIG_ROUNDS; r++) {
+	    sha256 h;
+	    h.update(&data[0], data.size());
+	    h.finalize(out);
+	}
+	utime t1 = utime::now();
+	for (size_t r = 0; r < SMALL_COUNT; r++) {
+	    sha256 h;
+	    h.update(msgs[r], SMALL_SIZE);
+	    h.finalize(out);
+	}
+	utime t2 = utime::now();
+	sha256::hash_many(SMALL_COUNT, &msgs[0], &lens[0],
+		  reinterpret_cast<uint8_t (*)[sha256::HASH_SIZE]>(&digests[0]));
+	utime t3 = utime::now();
+	report(std::string("sha256 ") + i.name + " (1MB)", BIG_SIZE*BIG_ROUNDS, (t1-t0).in_us());
+	report(std::string("sha256 ") + i.name + " (64 bytes)", SMALL_SIZE*SMALL_COUNT, (t2-t1).in_us());
+	report(std::string("sha256 ") + i.name + " (64 bytes, hash_many)", SMALL_SIZE*SMALL_COUNT, (t3-t2).in_us());
+    }
+
+    sha256::set_impl(old_impl);
+}
+
+int main(int argc, char *argv[])
+{
+    test_blake2b();
+    test_sha256();
+
+    return 0;
+}
@@ -91,10 +91,49 @@ static void test_lru_cache_2()
     }
 }
 
+static void test_lru_cache_stats()
+{
+    header("test_lru_cache_stats");
+
+    lru_cache<int, int> cache(100);
+
+    for (int i = 0; i < 150; i++) {
+        cache.insert(i, i);
+    }
+    assert(cache.size() == 100);
+    assert(cache.evictions() == 50);
+
+    for (int i = 0; i < 150; i++) {
+        cache.find(i);
+    }
+    std::cout << "Hits: " << cache.hits() << " Misses: " << cache.misses()
+	      << " Evictions: " << cache.evictions() << std::endl;
+    assert(cache.hits() == 100 && cache.misses() == 50);
+
+    // contains() must not touch the statistics or the LRU order
+    assert(cache.contains(50) && !cache.contains(0));
+    assert(cache.hits() == 100 && cache.misses() == 50);
+
+    // Shrinking evicts the least recently used
+    cache.find(60);
+    cache.set_capacity(10);
+    assert(cache.size() == 10);
+    assert(cache.capacity() == 10);
+    assert(cache.evictions() == 140);
+    assert(cache.contains(60));
+    for (int i = 141; i < 150; i++) {
+        assert(cache.contains(i));
+    }
+
+    cache.reset_stats();
+    assert(cache.hits() == 0 && cache.misses() == 0 && cache.evictions() == 0);
+}
+
 int main(int argc, char *argv[])
 {
     test_lru_cache_1();
     test_lru_cache_2();    
+    test_lru_cache_stats();
 
     return 0;
 }
@@ -257,6 +257,59 @@ static void test_merkle_trie_hash()
     std::cout << "Time: " << (time_end - time_start).in_ms() << std::endl;
 }
 
+static void insert_key(merkle_trie<uint64_t,60> &mtrie, uint64_t key)
+{
+    mtrie.insert(key, key * 3);
+}
+
+static void insert_key(merkle_trie<void,60> &mtrie, uint64_t key)
+{
+    mtrie.insert(key);
+}
+
+// rehash_all hashes the branches in batches (blake2b_many); it must
+// give the same root as rehashing one branch at a time, whatever
+// blake2b implementation is used.
+template<typename T> static void rehash_all_check(const char *what, size_t n, uint64_t sparseness)
+{
+    merkle_trie<T,60> auto_trie;
+    merkle_trie<T,60> bulk_trie; bulk_trie.set_auto_rehash(false);
+    for (size_t i = 0; i < n; i++) {
+        auto key = random::next_int(sparseness);
+	insert_key(auto_trie, key);
+	insert_key(bulk_trie, key);
+    }
+    auto expect = auto_trie.hash();
+
+    static const struct { blake2b_impl impl; const char *name; } impls[] = {
+	{ BLAKE2B_IMPL_REF, "ref" },
+	{ BLAKE2B_IMPL_AVX2, "avx2" }
+    };
+    auto old_impl = blake2b_get_impl();
+    for (auto &i : impls) {
+	if (blake2b_set_impl(i.impl) != 0) {
+	    std::cout << what << " " << i.name << ": not supported" << std::endl;
+	    continue;
+	}
+	auto t0 = utime::now();
+	bulk_trie.rehash_all();
+	auto t1 = utime::now();
+	std::cout << what << " " << i.name << ": rehash_all of " << n << " keys took "
+		  << (t1-t0).in_ms() << " ms" << std::endl;
+	auto hash = bulk_trie.hash();
+	assert(hash == expect);
+    }
+    blake2b_set_impl(old_impl);
+}
+
+static void test_merkle_trie_rehash_all()
+{
+    header( "test_merkle_trie_rehash_all" );
+
+    rehash_all_check<uint64_t>("merkle_trie<uint64_t>", 100000, 1000000000);
+    rehash_all_check<void>("merkle_trie<void>", 100000, 1000000);
+}
+
 static void test_merkle_trie_remove()
 {
     header( "test_merkle_trie_remove" );
@@ -510,6 +563,7 @@ int main(int argc, char *argv[])
     test_merkle_trie_iterator_reverse();    
     test_merkle_trie_iterator_erase();
     test_merkle_trie_hash();
+    test_merkle_trie_rehash_all();
     test_merkle_trie_remove();
     test_merkle_trie_bitset();
 #if PERFORMANCE_TEST
@@ -1,5 +1,7 @@
 #include <common/pbkdf2.hpp>
 #include <common/sha1.hpp>
+#include <common/sha512.hpp>
+#include <common/utime.hpp>
 #include <common/hex.hpp>
 #include <iostream>
 #include <assert.h>
@@ -43,9 +45,37 @@ static void test_pbkdf2()
     }
 }
 
+static void test_pbkdf2_sha512()
+{
+    header("test_pbkdf2_sha512");
+
+    {
+        pbkdf2_t<hmac<sha512> > pd("salt", 4, 1, 64);
+        pd.set_password("password", 8);
+        std::string str = hex::to_string(pd.get_key(), 64);
+        assert(str == "867f70cf1ade02cff3752599a3a53dc4af34c7a669815ae5d513554e1c8cf252c02d470a285a0501bad999bfe943c08f050235d7d68b1da55e63f73b60a57fce");
+    }
+
+    {
+        pbkdf2_t<hmac<sha512> > pd("salt", 4, 4096, 64);
+        pd.set_password("password", 8);
+        std::string str = hex::to_string(pd.get_key(), 64);
+        assert(str == "d197b1b33db0143e018b12f3d1d1479e6cdebdcc97c5c0f87f6902e072f457b5143f30602641b3d55cd335988cb36b84376060ecd532e039b742a239434af2d5");
+    }
+
+    // What encrypt/4 does to derive a wallet key
+    static const size_t ITER = 100000;
+    auto t0 = utime::now();
+    pbkdf2_t<hmac<sha512> > pd("encrypted", 9, ITER, 64);
+    pd.set_password("my wallet password", 18);
+    auto t1 = utime::now();
+    std::cout << "pbkdf2 hmac<sha512> " << ITER << " iterations: " << (t1-t0).in_ms() << " ms" << std::endl;
+}
+
 int main(int argc, char *argv[])
 {
     test_pbkdf2();
+    test_pbkdf2_sha512();
 
     return 0;
 }
@@ -380,12 +380,78 @@ static void test_term_serializer_exceptions()
 
 }
 
+class collect_sink : public term_serializer::sink {
+public:
+    collect_sink() : num_chunks(0) { }
+
+    virtual void write(const uint8_t *data, size_t n) override
+    { bytes.insert(bytes.end(), data, data + n); num_chunks++; }
+
+    term_serializer::buffer_t bytes;
+    size_t num_chunks;
+};
+
+static void test_term_serializer_sink()
+{
+    header( "test_term_serializer_sink()" );
+
+    term_env env;
+
+    // A long list with shared subterms, named variables, non-direct
+    // atoms and bignums.
+    term shared = env.parse("shared(X, averyveryverylongatomname).");
+    term big = env.parse("1234567890123456789012345678901234567890.");
+    term lst = env.EMPTY_LIST;
+    for (size_t i = 0; i < 20000; i++) {
+	term elem = env.new_term(con_cell("item",3),
+				 {int_cell(i), shared,
+				  (i % 100 == 0) ? big : env.new_ref()});
+	lst = env.new_dotted_pair(elem, lst);
+    }
+    term t = env.new_term(con_cell("top",3),
+			  {env.parse("tail(Y, Y, [a,b,c])."), shared, lst});
+
+    term_serializer ser(env);
+    term_serializer::buffer_t buf;
+    ser.write(buf, t);
+
+    collect_sink out;
+    ser.write(out, t);
+
+    std::cout << "Buffer: " << buf.size() << " bytes, sink: "
+	      << out.bytes.size() << " bytes in " << out.num_chunks
+	      << " chunks\n";
+
+    assert(out.bytes == buf);
+    assert(out.num_chunks > 1);
+
+    // Here the slot for the second argument stays open while the
+    // list is written, so nothing can be flushed until the end.
+    term t2 = env.new_term(con_cell("top",3),
+			   {lst, env.parse("tail(Y, Y, [a,b,c])."), shared});
+    buf.clear();
+    ser.write(buf, t2);
+    collect_sink out2;
+    ser.write(out2, t2);
+    assert(out2.bytes == buf);
+
+    // A term that fits in one chunk
+    term small = env.parse("foo(1, bar(kallekula, [1,2,baz]), Foo, Foo).");
+    buf.clear();
+    ser.write(buf, small);
+    collect_sink out3;
+    ser.write(out3, small);
+    assert(out3.bytes == buf);
+    assert(out3.num_chunks == 1);
+}
+
 int main( int argc, char *argv[] )
 {
     test_term_serializer_simple();
     test_term_serializer_bignum();
     test_term_serializer_clause();
     test_term_serializer_exceptions();
+    test_term_serializer_sink();
 
     return 0;
 }
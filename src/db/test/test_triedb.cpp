@@ -3,6 +3,7 @@
 #include <common/merkle_trie.hpp>
 #include <common/hex.hpp>
 #include <common/random.hpp>
+#include <common/blake2.hpp>
 #include <boost/algorithm/string.hpp>
 #include <iostream>
 #include <boost/filesystem.hpp>
@@ -358,6 +359,278 @@ static void test_increasing()
     
 }
 
+static boost::filesystem::path last_bucket_file(const std::string &dir)
+{
+    boost::filesystem::path last;
+    size_t last_index = 0;
+    boost::filesystem::recursive_directory_iterator it(dir), it_end;
+    for (; it != it_end; ++it) {
+	auto name = it->path().filename().string();
+	if (!boost::starts_with(name, "bucket_")) {
+	    continue;
+	}
+	size_t index = boost::lexical_cast<size_t>(
+	    name.substr(7, name.find('.') - 7));
+	if (last.empty() || index >= last_index) {
+	    last = it->path();
+	    last_index = index;
+	}
+    }
+    return last;
+}
+
+static void flip_byte(const boost::filesystem::path &file_path, int64_t offset)
+{
+    std::fstream f(file_path.string(), std::fstream::in | std::fstream::out | std::fstream::binary);
+    f.seekg(offset, offset < 0 ? std::fstream::end : std::fstream::beg);
+    auto pos = f.tellg();
+    char ch = 0;
+    f.read(&ch, 1);
+    ch ^= 0x5a;
+    f.seekp(pos);
+    f.write(&ch, 1);
+}
+
+static void test_recovery()
+{
+    header("test_recovery");
+
+    const size_t N = 100;
+
+    triedb_params params;
+    params.set_bucket_size(4096);
+    params.set_cache_num_streams(4);
+    params.set_cache_num_nodes(1024);
+    params.set_ordered_durability(true);
+
+    triedb::erase_all(test_dir);
+
+    {
+	triedb db(params, test_dir);
+	auto at_root = db.new_root();
+	for (size_t i = 0; i < N; i++) {
+	    db.insert(at_root, i, nullptr, 0);
+	    at_root = db.new_root(at_root);
+	    db.flush();
+	}
+    }
+
+    std::cout << "Append a torn tail to the last bucket..." << std::endl;
+    {
+	std::ofstream f(last_bucket_file(test_dir).string(), std::ofstream::app | std::ofstream::binary);
+	f.write("\x40\x00\x00\x00garbage", 11);
+    }
+
+    {
+	triedb db(test_dir);
+	assert(db.find_roots(N).size() == 1);
+	auto at_root = db.find_root(N);
+	assert(db.num_entries(at_root) == N);
+	// Appending after the truncated tail must work
+	db.insert(at_root, N, nullptr, 0);
+	db.new_root(at_root);
+	db.flush();
+    }
+
+    std::cout << "Corrupt the last root record..." << std::endl;
+    flip_byte(boost::filesystem::path(test_dir) / "roots.bin", -3);
+
+    {
+	triedb db(test_dir);
+	assert(db.find_roots(N+1).empty());
+	auto at_root = db.find_root(N);
+	assert(db.find(at_root, N) != nullptr);
+    }
+
+    std::cout << "Corrupt the last data record..." << std::endl;
+    flip_byte(last_bucket_file(test_dir), -1);
+
+    {
+	// Root N was (re)written by the last flush and depends on it.
+	triedb db(test_dir);
+	assert(db.find_roots(N).empty());
+	auto at_root = db.find_root(N-1);
+	assert(db.num_entries(at_root) == N);
+	assert(db.find(at_root, N) == nullptr);
+	for (size_t i = 0; i < N; i++) {
+	    assert(db.find(at_root, i) != nullptr);
+	}
+    }
+
+    std::cout << "Corrupt an old record (outside recovery range)..." << std::endl;
+    uint64_t ptr = 0;
+    {
+	triedb db(test_dir);
+	const triedb &cdb = db;
+	ptr = cdb.get_root(cdb.find_root(0)).ptr();
+    }
+    size_t bucket_index = ptr / params.bucket_size();
+    auto bucket_file = boost::filesystem::path(test_dir) / "buckets_0_63" / ("bucket_" + boost::lexical_cast<std::string>(bucket_index) + ".data.bin");
+    flip_byte(bucket_file, ptr - bucket_index * params.bucket_size() + triedb_params::VERSION_SZ + 10);
+
+    {
+	triedb db(test_dir);
+	bool caught = false;
+	try {
+	    db.get_root_branch(db.find_root(0));
+	} catch (triedb_checksum_exception &ex) {
+	    std::cout << "Expected exception: " << ex.what() << std::endl;
+	    caught = true;
+	}
+	assert(caught);
+    }
+}
+
+static void test_shared_storage()
+{
+    header("test_shared_storage");
+
+    const size_t N = 50;
+
+    triedb_params params;
+    params.set_bucket_size(4096);
+    params.set_ordered_durability(true);
+
+    triedb::erase_all(test_dir);
+
+    {
+	triedb_storage storage(params, test_dir);
+	triedb db0(storage, 0);
+	triedb db1(storage, 1);
+	auto root0 = db0.new_root();
+	auto root1 = db1.new_root();
+	for (size_t i = 0; i < N; i++) {
+	    db0.insert(root0, i, nullptr, 0);
+	    db1.insert(root1, 1000 + 2*i, nullptr, 0);
+	    root0 = db0.new_root(root0);
+	    root1 = db1.new_root(root1);
+	    // One flush makes both databases durable; with one sync of
+	    // the data (bucket + new directory entries) and one of the roots.
+	    size_t before = storage.num_syncs();
+	    storage.flush();
+	    size_t syncs = storage.num_syncs() - before;
+	    assert(syncs >= 2 && syncs <= 4);
+	}
+    }
+
+    std::cout << "Reopen and check that roots are kept apart..." << std::endl;
+    {
+	triedb_storage storage(test_dir);
+	triedb db1(storage, 1);
+	triedb db0(storage, 0);
+	assert(db0.find_roots(N).size() == 1);
+	assert(db1.find_roots(N).size() == 1);
+	auto root0 = db0.find_root(N);
+	auto root1 = db1.find_root(N);
+	assert(db0.num_entries(root0) == N);
+	assert(db1.num_entries(root1) == N);
+	for (size_t i = 0; i < N; i++) {
+	    assert(db0.find(root0, i) != nullptr);
+	    assert(db0.find(root0, 1000 + 2*i) == nullptr);
+	    assert(db1.find(root1, 1000 + 2*i) != nullptr);
+	}
+
+	// An index can only be attached once
+	bool caught = false;
+	try {
+	    triedb dup(storage, 0);
+	} catch (triedb_exception &ex) {
+	    std::cout << "Expected exception: " << ex.what() << std::endl;
+	    caught = true;
+	}
+	assert(caught);
+
+	// Erasing one database leaves the others alone
+	db0.erase_all();
+	assert(db0.find_roots(N).empty());
+	assert(db1.num_entries(root1) == N);
+    }
+
+    std::cout << "Reopen and check that only the erased database is gone..." << std::endl;
+    {
+	triedb_storage storage(test_dir);
+	triedb db0(storage, 0);
+	triedb db1(storage, 1);
+	assert(db0.find_roots(N).empty());
+	assert(db1.find_roots(N).size() == 1);
+	auto root1 = db1.find_root(N);
+	assert(db1.num_entries(root1) == N);
+	for (size_t i = 0; i < N; i++) {
+	    assert(db1.find(root1, 1000 + 2*i) != nullptr);
+	}
+    }
+}
+
+static void test_hash_leaves()
+{
+    header("test_hash_leaves");
+
+    const size_t N = 5000;
+
+    triedb::erase_all(test_dir);
+    triedb db(test_dir);
+
+    std::cout << "Insert " << N << " leaves of different sizes..." << std::endl;
+    auto root = db.new_root();
+    std::vector<triedb_leaf> leaves;
+    for (size_t i = 0; i < N; i++) {
+	std::vector<uint8_t> data((i % 97 == 0) ? 2000 : (i * 7) % 300);
+	for (size_t j = 0; j < data.size(); j++) {
+	    data[j] = static_cast<uint8_t>(i + j);
+	}
+	db.insert(root, i, data.data(), data.size());
+	root = db.new_root(root);
+	leaves.emplace_back(i, data.data(), data.size());
+    }
+
+    // Same hashes as the leaf hasher (and the ones stored on insert)
+    std::vector<triedb_leaf *> ptrs;
+    for (auto &leaf : leaves) {
+	ptrs.push_back(&leaf);
+    }
+    db.hash_leaves(&ptrs[0], ptrs.size());
+    for (size_t i = 0; i < N; i++) {
+	triedb_leaf one(i, leaves[i].custom_data(), leaves[i].custom_data_size());
+	triedb::leaf_hasher(&one);
+	assert(leaves[i].equal_hash(one));
+	assert(db.find(root, i)->equal_hash(one));
+    }
+
+    merkle_root mr;
+    db.get(root, 0, N, true, mr);
+
+    static const struct { blake2b_impl impl; const char *name; } impls[] = {
+	{ BLAKE2B_IMPL_REF, "ref" },
+	{ BLAKE2B_IMPL_AVX2, "avx2" }
+    };
+    auto old_impl = blake2b_get_impl();
+    for (auto &i : impls) {
+	if (blake2b_set_impl(i.impl) != 0) {
+	    std::cout << "validate " << i.name << ": not supported" << std::endl;
+	    continue;
+	}
+	auto t0 = utime::now();
+	assert(mr.validate(&db, 0, N));
+	auto t1 = utime::now();
+	std::cout << "validate " << i.name << ": " << (t1-t0).in_us() << " us" << std::endl;
+    }
+    blake2b_set_impl(old_impl);
+
+    // A custom leaf hasher is called leaf by leaf
+    size_t num_calls = 0;
+    db.set_leaf_hasher([&](triedb_leaf *leaf) {
+	    triedb::leaf_hasher(leaf);
+	    num_calls++;
+	});
+    assert(mr.validate(&db, 0, N));
+    assert(num_calls == N);
+    db.set_leaf_hasher([](triedb_leaf *leaf) {
+	    uint8_t zeros[32] = { 0 };
+	    leaf->set_hash(zeros, sizeof(zeros));
+	});
+    assert(!mr.validate(&db, 0, N));
+}
+
 int main(int argc, char *argv[])
 {
     home_dir = find_home_dir(argv[0]);
@@ -368,6 +641,9 @@ int main(int argc, char *argv[])
      
     test_basic();
     test_increasing();
+    test_recovery();
+    test_shared_storage();
+    test_hash_leaves();
 
     return 0;
 }
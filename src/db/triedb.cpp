@@ -5,11 +5,59 @@
 #include "../common/blake2.hpp"
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace prologcoin::common;
 
 namespace prologcoin { namespace db {
 
+//
+// Make sure the contents of the file have reached the disk. We open
+// the file again as fstream does not give us the file descriptor;
+// fsync operates on the file and not on the descriptor so this is
+// fine.
+//
+static void fsync_path(const boost::filesystem::path &path, bool is_dir)
+{
+#if defined(_WIN32)
+    if (is_dir) {
+	return; // Not needed (nor possible) on Windows
+    }
+    int fd = _open(path.string().c_str(), _O_RDWR | _O_BINARY);
+    if (fd == -1 || _commit(fd) != 0) {
+	if (fd != -1) _close(fd);
+	throw triedb_write_exception("Failed to sync " + path.string());
+    }
+    _close(fd);
+#else
+    int fd = ::open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+	throw triedb_write_exception("Failed to open " + path.string() + " for sync");
+    }
+    int r = ::fsync(fd);
+    ::close(fd);
+    if (r != 0 && !is_dir) {
+	throw triedb_write_exception("Failed to sync " + path.string());
+    }
+#endif
+}
+
+static inline void write_checksum(uint8_t *buffer, size_t n)
+{
+    write_uint32(&buffer[n], crc32c::checksum(buffer, n));
+}
+
+static inline bool check_checksum(const uint8_t *buffer, size_t n)
+{
+    return read_uint32(&buffer[n]) == crc32c::checksum(buffer, n);
+}
+
 void triedb_root::read(const uint8_t *buffer) {
     const uint8_t *p = buffer;
 
@@ -29,6 +77,9 @@ void triedb_root::read(const uint8_t *buffer) {
 
     assert(((p - buffer) + sizeof(uint64_t)) < MAX_SIZE_IN_BYTES);
     ptr_ = read_uint64(p); p += sizeof(uint64_t);
+
+    assert(((p - buffer) + sizeof(uint64_t)) < MAX_SIZE_IN_BYTES);
+    data_end_ = read_uint64(p); p += sizeof(uint64_t);
 }
 
 void triedb_root::write(uint8_t *buffer) const {
@@ -40,6 +91,7 @@ void triedb_root::write(uint8_t *buffer) const {
     write_uint64(p, checked_cast<uint64_t>(num_entries_)); p += sizeof(uint64_t);
     write_uint64(p, previous_id_.value()); p += sizeof(uint64_t);
     write_uint64(p, ptr_); p += sizeof(uint64_t);
+    write_uint64(p, data_end_); p += sizeof(uint64_t);
 }
 
 struct version_buffer {
@@ -282,24 +334,298 @@ void triedb::leaf_hasher(triedb_leaf *leaf) {
     blake2b_final(&s, &final_hash[0], sizeof(final_hash));
     leaf->set_hash(final_hash, sizeof(final_hash));
 }
-    
-triedb::triedb(const std::string &dir_path) : triedb(triedb_params(), dir_path) {
+
+void triedb::hash_leaves(triedb_leaf *const leaves[], size_t n) const {
+    // Leaves bigger than this are hashed one by one; there's nothing to
+    // gain from running them in lanes, only a copy to make.
+    static const size_t MAX_LANE_DATA_SIZE = 1024;
+    static const size_t BATCH = 32;
+
+    auto *fn = leaf_hasher_fn_.target<void (*)(triedb_leaf *)>();
+    if (fn == nullptr || *fn != &triedb::leaf_hasher) {
+	for (size_t i = 0; i < n; i++) {
+	    leaf_hasher_fn_(leaves[i]);
+	}
+	return;
+    }
+
+    triedb_leaf *batch[BATCH];
+    std::vector<uint8_t> msgs[BATCH];
+    const void *in[BATCH];
+    size_t inlen[BATCH];
+    uint8_t hashes[BATCH][32];
+    void *out[BATCH];
+
+    size_t i = 0;
+    while (i < n) {
+	size_t num = 0;
+	for (; i < n && num < BATCH; i++) {
+	    auto *leaf = leaves[i];
+	    if (leaf->custom_data_size() > MAX_LANE_DATA_SIZE) {
+		leaf_hasher(leaf);
+		continue;
+	    }
+	    auto &msg = msgs[num];
+	    msg.resize(sizeof(uint64_t) + leaf->custom_data_size());
+	    write_uint64(&msg[0], leaf->key());
+	    if (leaf->custom_data_size() > 0) {
+		memcpy(&msg[sizeof(uint64_t)], leaf->custom_data(), leaf->custom_data_size());
+	    }
+	    batch[num] = leaf;
+	    in[num] = msg.data();
+	    inlen[num] = msg.size();
+	    out[num] = hashes[num];
+	    num++;
+	}
+	blake2b_many(num, out, sizeof(hashes[0]), in, inlen);
+	for (size_t j = 0; j < num; j++) {
+	    batch[j]->set_hash(hashes[j], sizeof(hashes[j]));
+	}
+    }
 }
     
-triedb::triedb(const triedb_params &params, const std::string &dir_path)
+//
+// triedb_storage
+//
+
+triedb_storage::triedb_storage(const std::string &dir_path)
+    : triedb_storage(triedb_params(), dir_path) {
+}
+
+triedb_storage::triedb_storage(const triedb_params &params, const std::string &dir_path)
   : triedb_params(params),
     dir_path_(dir_path),
     stream_flusher_(),
     stream_cache_(triedb_params::cache_num_streams(), stream_flusher_),
+    roots_stream_(nullptr),
+    roots_end_(0),
+    last_offset_(0),
+    synced_offset_(0),
+    num_syncs_(0)
+{
+    root_map roots;
+    read_roots(roots);
+    last_offset_ = scan_last_offset();
+    recover(roots);
+    synced_offset_ = last_offset_;
+    for (auto &e : roots) {
+	loaded_roots_[e.second.first].push_back(e.second.second);
+    }
+}
+
+triedb_storage::~triedb_storage()
+{
+    flush();
+    stream_cache_.clear();
+    if (roots_stream_) delete roots_stream_;
+}
+
+void triedb_storage::attach(triedb *db, uint32_t db_index)
+{
+    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    if (db_index == ERASED_DB_INDEX) {
+	throw triedb_exception("Database index " + boost::lexical_cast<std::string>(db_index) + " is reserved");
+    }
+    if (db_index >= members_.size()) {
+	members_.resize(db_index + 1, nullptr);
+    }
+    if (members_[db_index] != nullptr) {
+	throw triedb_exception("Database index " + boost::lexical_cast<std::string>(db_index) + " is already in use for " + dir_path_);
+    }
+    members_[db_index] = db;
+    auto it = loaded_roots_.find(db_index);
+    if (it != loaded_roots_.end()) {
+	for (auto &root : it->second) {
+	    db->roots_.insert(std::make_pair(root.id(), root));
+	    db->roots_at_height_[root.height()].insert(root.id());
+	}
+	loaded_roots_.erase(it);
+    }
+}
+
+void triedb_storage::detach(triedb *db)
+{
+    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    auto db_index = db->db_index_;
+    assert(db_index < members_.size() && members_[db_index] == db);
+    members_[db_index] = nullptr;
+    auto &roots = loaded_roots_[db_index];
+    for (auto &e : db->roots_) {
+	roots.push_back(e.second);
+    }
+}
+
+void triedb_storage::erase_all()
+{
+    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    for (auto *db : members_) {
+	if (db != nullptr) db->clear();
+    }
+    loaded_roots_.clear();
+    stream_cache_.clear();
+    if (roots_stream_) {
+	roots_stream_->close();
+	delete roots_stream_;
+	roots_stream_ = nullptr;
+    }
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(dir_path_, ec);
+    if (ec) {
+      throw triedb_write_exception( "Failed while attempting to erase all; " + ec.message());
+    }
+    last_offset_ = 0;
+    synced_offset_ = 0;
+    roots_end_ = VERSION_SZ + sizeof(uint32_t);
+}
+
+void triedb_storage::erase_db(triedb *db)
+{
+    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+
+    // Rewrite the roots (also the ones not written yet, so there are no
+    // holes in the roots file) as belonging to no database. The data
+    // they refer to stays valid for recovery.
+    std::map<root_id, triedb_root> roots;
+    for (auto &e : db->roots_) {
+	roots[e.first] = e.second;
+	roots[e.first].set_data_end(last_offset_);
+    }
+    db->clear();
+    if (roots.empty()) {
+	return;
+    }
+    stream_cache_.foreach( [](size_t, fstream *f) { f->flush(); } );
+    if (ordered_durability()) {
+	sync_buckets();
+    }
+    synced_offset_ = last_offset_;
+    auto *f = get_roots_stream();
+    for (auto &e : roots) {
+	write_root_record(f, e.first, ERASED_DB_INDEX, e.second);
+    }
+    roots_stream_->flush();
+    if (ordered_durability()) {
+	sync_file(roots_file_path());
+    }
+}
+
+void triedb_storage::write_root_record(fstream *f, const root_id &id, uint32_t db_index,
+				       const triedb_root &root)
+{
+    uint8_t buffer[triedb_root::MAX_SIZE_IN_BYTES];
+    size_t n = root_record_size() - CHECKSUM_SIZE;
+    root.write(buffer);
+    write_uint32(&buffer[triedb_root::serialization_size()], db_index);
+    write_checksum(buffer, n);
+    f->seekg(id.value(), fstream::beg);
+    f->write(reinterpret_cast<char *>(&buffer[0]), n + CHECKSUM_SIZE);
+}
+
+void triedb_storage::flush()
+{
+    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+
+    // Data first...
+    stream_cache_.foreach( [](size_t, fstream *f) { f->flush(); } );
+    if (ordered_durability()) {
+	sync_buckets();
+    }
+    synced_offset_ = last_offset_;
+
+    // ...then the roots that refer to it (of all databases at once.)
+    // Roots are ordered by file offset, so new roots are appended in order.
+    std::map<root_id, std::pair<uint32_t, const triedb_root *> > dirty;
+    for (auto *db : members_) {
+	if (db == nullptr) {
+	    continue;
+	}
+	for (auto &id : db->dirty_roots_) {
+	    auto &root = db->roots_[id];
+	    root.set_data_end(last_offset_);
+	    dirty[id] = std::make_pair(db->db_index_, &root);
+	}
+	db->dirty_roots_.clear();
+    }
+    if (dirty.empty()) {
+	return;
+    }
+
+    auto *f = get_roots_stream();
+    for (auto &e : dirty) {
+	write_root_record(f, e.first, e.second.first, *e.second.second);
+    }
+    roots_stream_->flush();
+    if (ordered_durability()) {
+	sync_file(roots_file_path());
+    }
+}
+
+void triedb_storage::sync_file(const boost::filesystem::path &path, bool is_dir)
+{
+    fsync_path(path, is_dir);
+    num_syncs_++;
+}
+
+void triedb_storage::sync_buckets()
+{
+    if (last_offset_ == synced_offset_) {
+	return;
+    }
+    size_t first_bucket = synced_offset_ / bucket_size();
+    size_t last_bucket = (last_offset_ - 1) / bucket_size();
+    for (size_t i = first_bucket; i <= last_bucket; i++) {
+	auto file_path = bucket_file_path(i);
+	if (!boost::filesystem::exists(file_path)) {
+	    continue;
+	}
+	sync_file(file_path);
+	// A new bucket file also needs its directory entry on disk
+	if (i * bucket_size() >= synced_offset_) {
+	    sync_file(file_path.parent_path(), true);
+	}
+    }
+}
+
+root_id triedb_storage::allocate_root_id()
+{
+    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    root_id rid(roots_end_);
+    roots_end_ += root_record_size();
+    return rid;
+}
+
+//
+// triedb
+//
+
+triedb::triedb(const std::string &dir_path) : triedb(triedb_params(), dir_path) {
+}
+    
+triedb::triedb(const triedb_params &params, const std::string &dir_path)
+  : triedb_params(params),
+    own_storage_(new triedb_storage(params, dir_path)),
+    storage_(own_storage_.get()),
+    db_index_(0),
     leaf_flusher_(),
     leaf_cache_(triedb_params::cache_num_nodes(), leaf_flusher_),
     branch_flusher_(),
     branch_cache_(triedb_params::cache_num_nodes(), branch_flusher_),
-    roots_stream_(nullptr),
     cache_shutdown_(false)
 {
-    read_roots();
-    last_offset_ = scan_last_offset();
+    storage_->attach(this, db_index_);
+}
+
+triedb::triedb(triedb_storage &storage, uint32_t db_index)
+  : triedb_params(storage),
+    storage_(&storage),
+    db_index_(db_index),
+    leaf_flusher_(),
+    leaf_cache_(triedb_params::cache_num_nodes(), leaf_flusher_),
+    branch_flusher_(),
+    branch_cache_(triedb_params::cache_num_nodes(), branch_flusher_),
+    cache_shutdown_(false)
+{
+    storage_->attach(this, db_index_);
 }
 
 triedb::~triedb()
@@ -308,24 +634,26 @@ triedb::~triedb()
     leaf_cache_.clear();
     branch_cache_.clear();
     flush();
-    if (roots_stream_) delete roots_stream_;
+    storage_->detach(this);
 }
 
-void triedb::erase_all()
+void triedb::clear()
 {
+    boost::lock_guard<boost::recursive_mutex> guard(storage_->lock_);
     branch_cache_.clear();
     leaf_cache_.clear();
-    stream_cache_.clear();
-    roots_stream_->close();
-    delete roots_stream_;
-    roots_stream_ = nullptr;
-    boost::system::error_code ec;
-    boost::filesystem::remove_all(dir_path_, ec);
-    if (ec) {
-      throw triedb_write_exception( "Failed while attempting to erase all; " + ec.message());
-    }
-    last_offset_ = 0;
     roots_.clear();
+    roots_at_height_.clear();
+    dirty_roots_.clear();
+}
+
+void triedb::erase_all()
+{
+    if (own_storage_) {
+	storage_->erase_all();
+    } else {
+	storage_->erase_db(this);
+    }
 }
 
 void triedb::erase_all(const std::string &dir_path)
@@ -339,9 +667,7 @@ void triedb::erase_all(const std::string &dir_path)
 
 void triedb::flush()
 {
-    if (roots_stream_) roots_stream_->flush();
-
-    stream_cache_.foreach( [](size_t, fstream *f) { f->flush(); } );
+    storage_->flush();
 }
 
 root_id triedb::new_root() {
@@ -352,18 +678,13 @@ root_id triedb::new_root() {
 
     triedb_root root;
     root.set_height(0);
-    auto s = get_roots_stream();
-    size_t id = s->tellg();
-    root_id rid = root_id(id);
+    boost::lock_guard<boost::recursive_mutex> guard(storage_->lock_);
+    root_id rid = storage_->allocate_root_id();
     root.set_id(rid);
     root.set_ptr(ptr);
-    uint8_t buffer[triedb_root::MAX_SIZE_IN_BYTES];
-    root.write(buffer);
-    size_t n = root.serialization_size();
-    s->seekg(0, fstream::end);
-    s->write(reinterpret_cast<char *>(buffer), n);
     roots_[rid] = root;
     roots_at_height_[0].insert(rid);
+    dirty_roots_.insert(rid);
 
     return rid;
 }
@@ -373,19 +694,15 @@ root_id triedb::new_root(const root_id &parent_id) {
     triedb_root root;
     size_t height = parent.height()+1;
     root.set_height(height);
-    auto s = get_roots_stream();
-    s->seekg(0, fstream::end);
-    auto rid = root_id(s->tellg());
+    boost::lock_guard<boost::recursive_mutex> guard(storage_->lock_);
+    auto rid = storage_->allocate_root_id();
     root.set_id(rid);
     root.set_previous_id(parent.id());
     root.set_ptr(parent.ptr());
     root.set_num_entries(parent.num_entries());
-    uint8_t buffer[triedb_root::MAX_SIZE_IN_BYTES];
-    root.write(buffer);
-    size_t n = root.serialization_size();
-    s->write(reinterpret_cast<char *>(buffer), n);
     roots_[rid] = root;
     roots_at_height_[height].insert(rid);
+    dirty_roots_.insert(rid);
     return rid;
 }
 
@@ -754,12 +1071,12 @@ bool triedb::get(const triedb_branch *br, uint64_t from_key, uint64_t to_key,
     return true;
 }
 
-boost::filesystem::path triedb::roots_file_path() const {
+boost::filesystem::path triedb_storage::roots_file_path() const {
     auto file_path = boost::filesystem::path(dir_path_) / "roots.bin";
     return file_path;
 }
 
-fstream * triedb::get_roots_stream() {
+fstream * triedb_storage::get_roots_stream() {
     if (roots_stream_) {
         return roots_stream_;
     }
@@ -788,7 +1105,7 @@ fstream * triedb::get_roots_stream() {
     return roots_stream_;
 }
 
-void triedb::read_roots() {
+void triedb_storage::read_roots(root_map &roots) {
     fstream *f = get_roots_stream();
     f->seekg(0, fstream::end);
     size_t file_size = f->tellg();
@@ -799,39 +1116,155 @@ void triedb::read_roots() {
     uint8_t buffer[triedb_root::MAX_SIZE_IN_BYTES];
     triedb_root root;
 
-    size_t file_offset = f->tellg();
-
-    while (file_offset < file_size) {
-        f->read(reinterpret_cast<char *>(&buffer[0]), sizeof(uint32_t));
-	size_t n = read_uint32(buffer);
-
-	assert(n == triedb_root::serialization_size());
-	f->read(reinterpret_cast<char *>(&buffer[sizeof(uint32_t)]),
-		n-sizeof(uint32_t));
+    size_t record_size = root_record_size();
+    size_t n = record_size - CHECKSUM_SIZE;
+    size_t file_offset = overhead_size;
+
+    // Stop at the first torn or corrupt record; it and everything
+    // after it is dropped.
+    while (file_offset + record_size <= file_size) {
+        f->read(reinterpret_cast<char *>(&buffer[0]), record_size);
+	if (f->fail() ||
+	    read_uint32(buffer) != triedb_root::serialization_size() ||
+	    !check_checksum(buffer, n)) {
+	    break;
+	}
 	root.read(buffer);
 	root.set_id(root_id(file_offset));
-	roots_.insert(std::make_pair(root.id(), root));
-	roots_at_height_[root.height()].insert(root.id());
+	uint32_t db_index = read_uint32(&buffer[triedb_root::serialization_size()]);
+	roots[root.id()] = std::make_pair(db_index, root);
+
+	file_offset += record_size;
+    }
 
-	file_offset = f->tellg();
+    roots_end_ = file_offset;
+    if (file_offset < file_size) {
+	truncate_roots(roots, file_offset);
     }
 }
 
-void triedb::set_root(const root_id &id, uint64_t offset)
+void triedb_storage::truncate_roots(root_map &roots, uint64_t roots_offset)
 {
-    auto root = get_root(id);
-    root.set_ptr(offset);
-    size_t file_offset = root.id().value();
-    assert(file_offset >= VERSION_SZ);
-    auto *f = get_roots_stream();
-    f->seekg(file_offset, fstream::beg);
-    uint8_t buffer[triedb_root::MAX_SIZE_IN_BYTES];
-    root.write(buffer);
-    f->write(reinterpret_cast<char *>(&buffer[0]), root.serialization_size());
-    roots_[id] = root;
+    roots.erase(roots.lower_bound(root_id(roots_offset)), roots.end());
+    roots_stream_->close();
+    delete roots_stream_;
+    roots_stream_ = nullptr;
+    boost::system::error_code ec;
+    boost::filesystem::resize_file(roots_file_path(), roots_offset, ec);
+    if (ec) {
+	throw triedb_write_exception("Failed to truncate " + roots_file_path().string() + "; " + ec.message());
+    }
+    roots_end_ = roots_offset;
+    get_roots_stream();
+}
+
+void triedb_storage::recover(root_map &roots)
+{
+    // The roots are all good, but the data they refer to may not
+    // (unless written in ordered mode.) Validate the records that were
+    // written since the previous flush point. If there's a bad record,
+    // then drop the roots that depend on it and check the flush
+    // before that, and so on.
+    for (;;) {
+	uint64_t data_end = 0, previous_data_end = 0;
+	for (auto &e : roots) {
+	    data_end = std::max(data_end, e.second.second.data_end());
+	}
+	for (auto &e : roots) {
+	    auto d = e.second.second.data_end();
+	    if (d < data_end && d > previous_data_end) {
+		previous_data_end = d;
+	    }
+	}
+	auto bad_offset = verify_records(previous_data_end, data_end);
+	if (bad_offset == data_end) {
+	    // Anything beyond what the roots refer to is an unflushed tail
+	    if (last_offset_ != data_end) {
+		truncate_data(data_end);
+	    }
+	    return;
+	}
+	uint64_t roots_offset = roots_end_;
+	for (auto &e : roots) {
+	    if (e.second.second.data_end() > bad_offset) {
+		roots_offset = std::min(roots_offset, e.first.value());
+	    }
+	}
+	truncate_roots(roots, roots_offset);
+    }
+}
+
+uint64_t triedb_storage::verify_records(uint64_t from_offset, uint64_t to_offset) const
+{
+    std::vector<uint8_t> buffer;
+    uint64_t offset = from_offset;
+    while (offset < to_offset) {
+	size_t bucket_index = offset / bucket_size();
+	auto file_path = bucket_file_path(bucket_index);
+	if (!boost::filesystem::exists(file_path)) {
+	    return offset;
+	}
+	uint64_t first_offset = bucket_index * bucket_size();
+	uint64_t bucket_end = first_offset + boost::filesystem::file_size(file_path) - VERSION_SZ;
+	if (offset >= bucket_end) {
+	    // Records that do not fit are placed in the next bucket
+	    if (!boost::filesystem::exists(bucket_file_path(bucket_index+1))) {
+		return offset;
+	    }
+	    offset = first_offset + bucket_size();
+	    continue;
+	}
+	uint8_t size_buffer[sizeof(uint32_t)];
+	auto *f = set_file_offset(offset);
+	f->read(reinterpret_cast<char *>(&size_buffer[0]), sizeof(uint32_t));
+	size_t n = read_uint32(size_buffer);
+	if (f->fail() || n < sizeof(uint32_t) ||
+	    n >= triedb_leaf::MAX_SIZE_IN_BYTES ||
+	    offset + n + CHECKSUM_SIZE > bucket_end) {
+	    f->clear();
+	    return offset;
+	}
+	buffer.resize(n + CHECKSUM_SIZE);
+	memcpy(&buffer[0], size_buffer, sizeof(uint32_t));
+	f->read(reinterpret_cast<char *>(&buffer[sizeof(uint32_t)]),
+		n - sizeof(uint32_t) + CHECKSUM_SIZE);
+	if (f->fail() || !check_checksum(&buffer[0], n)) {
+	    f->clear();
+	    return offset;
+	}
+	offset += n + CHECKSUM_SIZE;
+    }
+    return to_offset;
+}
+
+void triedb_storage::truncate_data(uint64_t offset)
+{
+    stream_cache_.clear();
+
+    size_t bucket_index = offset / bucket_size();
+    boost::system::error_code ec;
+    auto file_path = bucket_file_path(bucket_index);
+    if (boost::filesystem::exists(file_path)) {
+	size_t file_size = offset - bucket_index * bucket_size() + VERSION_SZ;
+	boost::filesystem::resize_file(file_path, file_size, ec);
+	if (ec) {
+	    throw triedb_write_exception("Failed to truncate " + file_path.string() + "; " + ec.message());
+	}
+    }
+    for (size_t i = bucket_index + 1;; i++) {
+	file_path = bucket_file_path(i);
+	if (!boost::filesystem::exists(file_path)) {
+	    break;
+	}
+	boost::filesystem::remove(file_path, ec);
+	if (ec) {
+	    throw triedb_write_exception("Failed to remove " + file_path.string() + "; " + ec.message());
+	}
+    }
+    last_offset_ = offset;
 }
 
-boost::filesystem::path triedb::bucket_dir_location(size_t bucket_index) const {
+boost::filesystem::path triedb_storage::bucket_dir_location(size_t bucket_index) const {
     size_t start_bucket = (bucket_index / 64) * 64;
     size_t end_bucket = (bucket_index / 64) * 64 + 63;
     std::stringstream ss;
@@ -841,7 +1274,7 @@ boost::filesystem::path triedb::bucket_dir_location(size_t bucket_index) const {
     return r / name;
 }
 
-size_t triedb::scan_last_bucket() const {
+size_t triedb_storage::scan_last_bucket() const {
     size_t i;
     // First find right bucket directory
     for (i = 0;;i += 64) {
@@ -870,7 +1303,7 @@ size_t triedb::scan_last_bucket() const {
     return i - 1;
 }
 
-uint64_t triedb::scan_last_offset() const {
+uint64_t triedb_storage::scan_last_offset() const {
     size_t bucket_index = scan_last_bucket();
     if (bucket_index == static_cast<size_t>(-1)) {
          return 0;
@@ -883,13 +1316,13 @@ uint64_t triedb::scan_last_offset() const {
     return last_offset;
 }
     
-boost::filesystem::path triedb::bucket_file_path(size_t bucket_index) const {
+boost::filesystem::path triedb_storage::bucket_file_path(size_t bucket_index) const {
     auto dir = bucket_dir_location(bucket_index);
     std::string name = "bucket_" + boost::lexical_cast<std::string>(bucket_index) + ".data.bin";
     return dir / name;
 }
 
-fstream * triedb::get_bucket_stream(size_t bucket_index) const {
+fstream * triedb_storage::get_bucket_stream(size_t bucket_index) const {
     auto *f = stream_cache_.find(bucket_index);
     if (f != nullptr) {
         return *f;
@@ -912,7 +1345,7 @@ fstream * triedb::get_bucket_stream(size_t bucket_index) const {
     return ff;
 }
 
-fstream * triedb::set_file_offset(uint64_t offset) const
+fstream * triedb_storage::set_file_offset(uint64_t offset) const
 {
     size_t bucket_index = offset / bucket_size();
     auto *f = get_bucket_stream(bucket_index);
@@ -922,30 +1355,33 @@ fstream * triedb::set_file_offset(uint64_t offset) const
     return f;
 }
 
-const triedb_root & triedb::get_root(const root_id &id)
-{
-    auto found = roots_.find(id);
-    assert(found != roots_.end());
-    return found->second;
-}
-    
-void triedb::read_leaf_node(uint64_t offset, triedb_leaf &node) const
+size_t triedb_storage::read_record(uint64_t offset, std::vector<uint8_t> &buffer, const char *what) const
 {
-    std::vector<uint8_t> buffer(4);
+    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    uint8_t size_buffer[sizeof(uint32_t)];
     auto *f = set_file_offset(offset);
-    f->read(reinterpret_cast<char *>(&buffer[0]), sizeof(uint32_t));
-    uint32_t size = read_uint32(&buffer[0]);
-    assert(size >= 4 && size < triedb_leaf::MAX_SIZE_IN_BYTES);
-    buffer.resize(4+size);
+    f->read(reinterpret_cast<char *>(&size_buffer[0]), sizeof(uint32_t));
+    uint32_t size = read_uint32(size_buffer);
+    if (size < 4 || size >= triedb_leaf::MAX_SIZE_IN_BYTES) {
+	throw triedb_checksum_exception(std::string("Corrupt ") + what + " at offset " + boost::lexical_cast<std::string>(offset));
+    }
+    if (buffer.size() < size+CHECKSUM_SIZE) {
+	buffer.resize(size+CHECKSUM_SIZE);
+    }
+    memcpy(&buffer[0], size_buffer, sizeof(uint32_t));
     f->read(reinterpret_cast<char *>(&buffer[sizeof(uint32_t)]),
-	    size-sizeof(uint32_t));
-    node.read(&buffer[0]);
+	    size-sizeof(uint32_t)+CHECKSUM_SIZE);
+    if (!check_checksum(&buffer[0], size)) {
+	throw triedb_checksum_exception(std::string("Checksum mismatch for ") + what + " at offset " + boost::lexical_cast<std::string>(offset));
+    }
+    return size;
 }
 
-uint64_t triedb::append_leaf_node(const triedb_leaf &node) const
+uint64_t triedb_storage::append_record(uint8_t *buffer, size_t n)
 {
+    boost::lock_guard<boost::recursive_mutex> guard(lock_);
     auto offset = last_offset_;
-    size_t num_bytes = node.serialization_size();
+    size_t num_bytes = n + CHECKSUM_SIZE;
     size_t bucket_index = offset / bucket_size();
     auto first_offset = bucket_index * bucket_size();
     // Are we crossing the bucket boundary? 
@@ -955,47 +1391,57 @@ uint64_t triedb::append_leaf_node(const triedb_leaf &node) const
         offset = bucket_index*bucket_size();
 	last_offset_ = offset;
     }
+    write_checksum(buffer, n);
+    auto *f = set_file_offset(offset);
+    f->write(reinterpret_cast<char *>(&buffer[0]), num_bytes);
+    last_offset_ += num_bytes;
+    return offset;
+}
+
+void triedb::set_root(const root_id &id, uint64_t offset)
+{
+    assert(roots_.find(id) != roots_.end());
+    boost::lock_guard<boost::recursive_mutex> guard(storage_->lock_);
+    roots_[id].set_ptr(offset);
+    dirty_roots_.insert(id);
+}
+
+const triedb_root & triedb::get_root(const root_id &id)
+{
+    auto found = roots_.find(id);
+    assert(found != roots_.end());
+    return found->second;
+}
+    
+void triedb::read_leaf_node(uint64_t offset, triedb_leaf &node) const
+{
+    storage_->read_record(offset, read_buffer_, "leaf");
+    node.read(&read_buffer_[0]);
+}
+
+uint64_t triedb::append_leaf_node(const triedb_leaf &node) const
+{
     size_t n = node.serialization_size();
     assert(n < triedb_leaf::MAX_SIZE_IN_BYTES);
-    std::vector<uint8_t> buffer(n);
+    std::vector<uint8_t> buffer(n+triedb_storage::CHECKSUM_SIZE);
     node.write(&buffer[0]);
-    auto *f = set_file_offset(offset);
-    f->write(reinterpret_cast<char *>(&buffer[0]), n);
-    last_offset_ += n;
-    return offset;
+    return storage_->append_record(&buffer[0], n);
 }
     
 void triedb::read_branch_node(uint64_t offset, triedb_branch &node) const
 {
-    uint8_t buffer[triedb_branch::MAX_SIZE_IN_BYTES];
-    auto *f = set_file_offset(offset);
-    f->read(reinterpret_cast<char *>(&buffer[0]), sizeof(uint32_t));
-    uint32_t size = read_uint32(buffer);
-    assert(size >= 4 && size < triedb_branch::MAX_SIZE_IN_BYTES);
-    f->read(reinterpret_cast<char *>(&buffer[sizeof(uint32_t)]),
-	    size-sizeof(uint32_t));
-    node.read(buffer);
+    auto size = storage_->read_record(offset, read_buffer_, "branch");
+    assert(size < triedb_branch::MAX_SIZE_IN_BYTES);
+    (void)size;
+    node.read(&read_buffer_[0]);
 }
 
 uint64_t triedb::append_branch_node(triedb_branch *node) const
 {
-    auto offset = last_offset_;
-    size_t num_bytes = node->serialization_size();
-    size_t bucket_index = offset / bucket_size();
-    auto first_offset = bucket_index * bucket_size();
-    // Are we crossing the bucket boundary? 
-    if (offset - first_offset + num_bytes >= bucket_size()) {
-        // Then switch to the next bucket
-        bucket_index++;
-        offset = bucket_index*bucket_size();
-	last_offset_ = offset;	
-    }
-    uint8_t buffer[triedb_branch::MAX_SIZE_IN_BYTES];
+    uint8_t buffer[triedb_branch::MAX_SIZE_IN_BYTES+triedb_storage::CHECKSUM_SIZE];
     size_t n = node->serialization_size();
     node->write(buffer);
-    auto *f = set_file_offset(offset);
-    f->write(reinterpret_cast<char *>(&buffer[0]), n);
-    last_offset_ += n;
+    auto offset = storage_->append_record(buffer, n);
     if (!cache_shutdown_) branch_cache_.insert(offset, node);
     return offset;
 }
@@ -1220,6 +1666,9 @@ bool merkle_branch::validate(const triedb *db, uint64_t key_offset, uint64_t key
     write_uint32(mask_buffer, m);
     blake2b_update(&s, mask_buffer, sizeof(mask_buffer));
 
+    const merkle_leaf *leaves[triedb_params::MAX_BRANCH];
+    size_t num_leaves = 0;
+
     for (size_t i = 0; i < triedb_params::MAX_BRANCH; i++) {
 	auto const &child = get_child(i);
 	bool has_child = (m & (1 << i)) != 0;
@@ -1236,13 +1685,24 @@ bool merkle_branch::validate(const triedb *db, uint64_t key_offset, uint64_t key
 	auto sub_index = i;
 	size_t sub_step = key_step >> triedb_params::MAX_BRANCH_BITS;
 	size_t sub_offset = key_offset + sub_index * sub_step;
-	if (!child->validate(db, sub_offset, sub_step, from_key, to_key)) {
+	if (db != nullptr && child->type() == merkle_node::LEAF) {
+	    // Check the key now, but the hash together with the other
+	    // leaves below.
+	    if (!child->validate(nullptr, sub_offset, sub_step, from_key, to_key)) {
+		return false;
+	    }
+	    leaves[num_leaves++] = reinterpret_cast<const merkle_leaf *>(child.get());
+	} else if (!child->validate(db, sub_offset, sub_step, from_key, to_key)) {
 	    return false;
 	}
 	auto const *childp = child.get();
 	blake2b_update(&s, childp->hash(), childp->hash_size());
     }
 
+    if (num_leaves > 0 && !merkle_leaf::validate_hashes(db, leaves, num_leaves)) {
+	return false;
+    }
+
     blake2b_final(&s, &final_hash[0], sizeof(final_hash));
 
     auto h = hash();
@@ -1313,6 +1773,25 @@ bool merkle_leaf::validate(const triedb *db, uint64_t key_offset, uint64_t key_s
     return equal_hash(leaf);
 }
 
+bool merkle_leaf::validate_hashes(const triedb *db, const merkle_leaf *const leaves[], size_t n) {
+    assert(n <= triedb_params::MAX_BRANCH);
+    std::vector<triedb_leaf> tleaves;
+    tleaves.reserve(n);
+    triedb_leaf *ptrs[triedb_params::MAX_BRANCH];
+    for (size_t i = 0; i < n; i++) {
+	auto const &dat = leaves[i]->data();
+	tleaves.emplace_back(leaves[i]->key(), dat.data(), dat.size());
+	ptrs[i] = &tleaves[i];
+    }
+    db->hash_leaves(ptrs, n);
+    for (size_t i = 0; i < n; i++) {
+	if (!leaves[i]->equal_hash(tleaves[i])) {
+	    return false;
+	}
+    }
+    return true;
+}
+
 bool merkle_leaf::validate_end(const triedb *db, uint64_t key_offset, uint64_t key_step, uint64_t from_key) const {
     (void)key_offset;
     (void)key_step;
@@ -8,15 +8,21 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
 #include <boost/functional/hash.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <iostream>
 #include <bitset>
 #include <algorithm>
 #include <set>
+#include <map>
+#include <memory>
+#include <vector>
 #include "../common/lru_cache.hpp"
 #include "../common/bits.hpp"
 #include "../common/checked_cast.hpp"
+#include "../common/crc32c.hpp"
 #include "util.hpp"
 #include "triedb_params.hpp"
 
@@ -263,6 +269,9 @@ public:
     bool validate_end(const triedb *db, uint64_t key_offset, uint64_t key_step,
 		      uint64_t from_key) const override;
 
+    // Check the hashes of n leaves (at most MAX_BRANCH) in one go.
+    static bool validate_hashes(const triedb *db, const merkle_leaf *const leaves[], size_t n);
+
 private:
     uint64_t key_;
     std::unique_ptr<custom_data_t> data_;
@@ -442,26 +451,29 @@ private:
 //         'ptr' (where it is in the data file)
 //         'custom_data' (for more information - which will be
 //                        different depending on database.)
+//         'data_end' (all data up to this offset was flushed before
+//                     this root was written; used for crash recovery.)
 
 class triedb;
 
 class triedb_root {
 private:
     friend class triedb;
+    friend class triedb_storage;
     static const size_t MAX_SIZE_IN_BYTES = 4096;
 public:
     triedb_root() : id_(0), previous_id_(0), ptr_(0), height_(0),
-		    num_entries_(0) { }
+		    num_entries_(0), data_end_(0) { }
 
     triedb_root(const triedb_root &parent, const root_id &child) :
 	id_(child), previous_id_(parent.id()), 
 	ptr_(0), height_(parent.height() + 1),
-	num_entries_(parent.num_entries()) { }
+	num_entries_(parent.num_entries()), data_end_(0) { }
 
     triedb_root(const root_id &id)
 	: id_(id), previous_id_(),
 	  ptr_(0), height_(0),
-	  num_entries_(0) { }
+	  num_entries_(0), data_end_(0) { }
 
     const root_id & id() const {
 	return id_;
@@ -511,12 +523,21 @@ public:
 	num_entries_--;
     }
 
+    inline uint64_t data_end() const {
+	return data_end_;
+    }
+
+    inline void set_data_end(uint64_t offset) {
+	data_end_ = offset;
+    }
+
     static size_t serialization_size() {
 	return sizeof(uint32_t) + // Total size
 	       sizeof(uint32_t) + // height
 	       sizeof(uint64_t) + // num entries
 	       sizeof(uint64_t) + // previous root id
-	       sizeof(uint64_t);  // ptr
+	       sizeof(uint64_t) + // ptr
+	       sizeof(uint64_t);  // data end
     }
 
     std::string str() const {
@@ -524,7 +545,7 @@ public:
 	ss << "triedb_root{";
 	ss << "id=" << id_.str() << ",prev=" << previous_id_.str()
 	   << ",ptr=" << ptr_ << ",height=" << height_ << ",num_entries="
-	   << num_entries_ << "}";
+	   << num_entries_ << ",data_end=" << data_end_ << "}";
 	return ss.str();
     }
 
@@ -540,6 +561,7 @@ private:
     uint64_t ptr_;
     size_t height_;
     uint64_t num_entries_;
+    uint64_t data_end_;
 };
 
 
@@ -569,6 +591,11 @@ class triedb_key_not_found_exception : public triedb_exception {
 public:
     triedb_key_not_found_exception(const std::string &msg) : triedb_exception(msg) { }
 };    
+
+class triedb_checksum_exception : public triedb_exception {
+public:
+    triedb_checksum_exception(const std::string &msg) : triedb_exception(msg) { }
+};
     
 class triedb_node : public node_hash {
 };
@@ -750,10 +777,123 @@ private:
     uint64_t *ptr_;
 };
     
+//
+// Every record (root, branch or leaf) on disk is followed by a CRC-32C
+// of its bytes. Roots are only written at flush() (data first, then
+// roots) and each root remembers how far the data was flushed when it
+// was written. On open we then only need to validate the records after
+// the previous flush point to find the last consistent root, and
+// anything beyond it (a torn tail) is truncated.
+//
+// triedb_storage owns the files (the data buckets and the roots file.)
+// Several triedbs can share one storage, each identified by its
+// database index, so that a single flush() makes all of them durable
+// with one sync of the data followed by one sync of the roots.
+//
+// The streams, offsets and roots file of a storage are shared by its
+// triedbs and guarded by its lock, as are the (dirty) roots of the
+// triedbs that flush() writes. So triedbs of one storage can be used
+// from different threads; a single triedb is still not thread safe.
+//
+class triedb_storage : public triedb_params, private boost::noncopyable {
+public:
+    static const size_t CHECKSUM_SIZE = sizeof(uint32_t);
+
+    triedb_storage(const std::string &dir_path);
+    triedb_storage(const triedb_params &params, const std::string &dir_path);
+    ~triedb_storage();
+
+    inline const std::string & dir_path() const {
+	return dir_path_;
+    }
+
+    // Erase all databases of this storage (and its files.)
+    void erase_all();
+    void flush();
+
+    // Roots of an erased database are rewritten with this index
+    static const uint32_t ERASED_DB_INDEX = 0xffffffff;
+
+    // Number of fsync() calls made so far (for testing/statistics.)
+    inline size_t num_syncs() const {
+	return num_syncs_;
+    }
+
+    // A root record is the root, the index of the database it
+    // belongs to and the checksum.
+    static inline size_t root_record_size() {
+	return triedb_root::serialization_size() + sizeof(uint32_t) + CHECKSUM_SIZE;
+    }
+
+private:
+    friend class triedb;
+
+    typedef std::map<root_id, std::pair<uint32_t, triedb_root> > root_map;
+
+    void attach(triedb *db, uint32_t db_index);
+    void detach(triedb *db);
+    void erase_db(triedb *db);
+    root_id allocate_root_id();
+    void write_root_record(fstream *f, const root_id &id, uint32_t db_index,
+			   const triedb_root &root);
+
+    size_t read_record(uint64_t offset, std::vector<uint8_t> &buffer,
+		       const char *what) const;
+    uint64_t append_record(uint8_t *buffer, size_t n);
+
+    boost::filesystem::path roots_file_path() const;
+    fstream * get_roots_stream();
+    void read_roots(root_map &roots);
+    void truncate_roots(root_map &roots, uint64_t roots_offset);
+    void recover(root_map &roots);
+    uint64_t verify_records(uint64_t from_offset, uint64_t to_offset) const;
+    void truncate_data(uint64_t offset);
+    void sync_buckets();
+    void sync_file(const boost::filesystem::path &path, bool is_dir = false);
+    boost::filesystem::path bucket_dir_location(size_t bucket_index) const;
+    boost::filesystem::path bucket_file_path(size_t bucket_index) const;
+    fstream * get_bucket_stream(size_t bucket_index) const;
+    size_t scan_last_bucket() const;
+    uint64_t scan_last_offset() const;
+    fstream * set_file_offset(uint64_t offset) const;
+
+    std::string dir_path_;
+
+    mutable boost::recursive_mutex lock_;
+
+    struct stream_flusher {
+        void evicted(size_t, fstream *f) {
+	    f->close();
+	    delete f;
+        }
+    };
+
+    // Bucket index to stream
+    typedef common::lru_cache<size_t, fstream *, stream_flusher> stream_cache;
+    stream_flusher stream_flusher_;
+    mutable stream_cache stream_cache_;
+
+    fstream *roots_stream_;
+    uint64_t roots_end_;
+
+    mutable uint64_t last_offset_;
+    uint64_t synced_offset_;
+    size_t num_syncs_;
+
+    // Attached databases (by database index)
+    std::vector<triedb *> members_;
+
+    // Roots of databases that are not (or no longer) attached
+    std::unordered_map<uint32_t, std::vector<triedb_root> > loaded_roots_;
+};
+
 class triedb : public triedb_params {
 public:
     triedb(const std::string &dir_path);
     triedb(const triedb_params &params, const std::string &dir_path);
+    // Use a (shared) storage; the database index identifies this
+    // database's roots within it.
+    triedb(triedb_storage &storage, uint32_t db_index);
     ~triedb();
 
     inline bool is_empty() const {
@@ -764,11 +904,18 @@ public:
         debug_ = b;
     }
 
+    // Erase this database. With a shared storage only its roots are
+    // dropped; its records stay (unreferenced) in the data buckets, as
+    // those are shared with the other databases.
     void erase_all();
     static void erase_all(const std::string &dir_path);
 
     void flush();
 
+    inline triedb_storage & storage() {
+	return *storage_;
+    }
+
     void set_leaf_hasher(std::function<void (triedb_leaf *leaf)> fn) {
 	leaf_hasher_fn_ = fn;
     }
@@ -777,6 +924,11 @@ public:
 	return leaf_hasher_fn_;
     }
 
+    // Same as calling the leaf hasher on each of them, but with the
+    // default one the (small) leaves are hashed side by side with
+    // blake2b_many.
+    void hash_leaves(triedb_leaf *const leaves[], size_t n) const;
+
     const std::set<root_id> & find_roots(size_t height) const;
 
     // Asserts if there are more than 1. This is useful for testing only.
@@ -852,6 +1004,9 @@ public:
 
 private:
     friend class triedb_iterator;
+    friend class triedb_storage;
+
+    void clear();
   
     void branch_hasher(triedb_branch *branch);
 
@@ -872,9 +1027,6 @@ private:
 						     const triedb_branch *node,
 						     uint64_t key);
   
-    boost::filesystem::path roots_file_path() const;
-    fstream * get_roots_stream();
-    void read_roots();
     inline void increment_num_entries(const root_id &id) {
 	roots_[id].increment_num_entries();
     }
@@ -885,12 +1037,6 @@ private:
 	roots_[id].set_num_entries(n);
     }
     void set_root(const root_id &at_root, uint64_t offset);
-    boost::filesystem::path bucket_dir_location(size_t bucket_index) const;
-    boost::filesystem::path bucket_file_path(size_t bucket_index) const;
-    fstream * get_bucket_stream(size_t bucket_index) const;
-    size_t scan_last_bucket() const;
-    uint64_t scan_last_offset() const;
-    fstream * set_file_offset(uint64_t offset) const;
     const triedb_root & get_root(const root_id &id);
   
     void read_leaf_node(uint64_t offset, triedb_leaf &node) const;
@@ -923,14 +1069,9 @@ private:
 	}
     }
 
-    std::string dir_path_;
-
-    struct stream_flusher {
-        void evicted(size_t, fstream *f) {
-	    f->close();
-	    delete f;
-        }
-    };
+    std::unique_ptr<triedb_storage> own_storage_;
+    triedb_storage *storage_;
+    uint32_t db_index_;
 
     struct leaf_flusher {
         void evicted(size_t, triedb_leaf *leaf) {
@@ -944,11 +1085,6 @@ private:
         }
     };
   
-    // Bucket index to stream
-    typedef common::lru_cache<size_t, fstream *, stream_flusher> stream_cache;
-    stream_flusher stream_flusher_;
-    mutable stream_cache stream_cache_;
-
     // Leaf cache
     typedef common::lru_cache<size_t, triedb_leaf *, leaf_flusher> leaf_cache;
     leaf_flusher leaf_flusher_;
@@ -962,9 +1098,10 @@ private:
     // Root references
     std::unordered_map<root_id, triedb_root> roots_;
     std::unordered_map<size_t, std::set<root_id> > roots_at_height_;
-    fstream *roots_stream_;
-  
-    mutable uint64_t last_offset_;
+    std::set<root_id> dirty_roots_;
+
+    // Scratch buffer for reading nodes
+    mutable std::vector<uint8_t> read_buffer_;
 
     bool cache_shutdown_;
 
@@ -2,6 +2,6 @@
 
 namespace prologcoin { namespace db {
 
-const char triedb_params::VERSION[16] = "triedb_1.0     ";
+const char triedb_params::VERSION[16] = "triedb_1.2     ";
 
 }}
@@ -25,7 +25,8 @@ public:
       : bucket_size_(DEFAULT_BUCKET_SIZE),
         cache_num_streams_(DEFAULT_CACHE_NUM_STREAMS),
         cache_num_nodes_(DEFAULT_CACHE_NUM_NODES),
-        use_hashing_(true) { }
+        use_hashing_(true),
+        ordered_durability_(false) { }
   
     inline size_t bucket_size() const { return bucket_size_; }
     inline void set_bucket_size(size_t sz) { bucket_size_ = sz; }
@@ -38,12 +39,19 @@ public:
 
     inline bool use_hashing() const { return use_hashing_; }
     inline void set_use_hashing(bool h) { use_hashing_ = h; }
+
+    // If set, flush() fsyncs the data buckets before writing the roots
+    // that refer to them (and then fsyncs the roots file.) A crash can
+    // then never leave a root pointing to data that isn't on disk.
+    inline bool ordered_durability() const { return ordered_durability_; }
+    inline void set_ordered_durability(bool b) { ordered_durability_ = b; }
   
 private:
     size_t bucket_size_;
     size_t cache_num_streams_;
     size_t cache_num_nodes_;
     bool use_hashing_;
+    bool ordered_durability_;
 };
     
 }}
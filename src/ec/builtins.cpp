@@ -13,6 +13,8 @@
 #include "../common/sha512.hpp"
 #include "../common/aes256.hpp"
 
+#include <atomic>
+#include <boost/thread.hpp>
 #include "src/util.h"
 #include "src/hash_impl.h"
 
@@ -132,18 +134,9 @@ private:
     std::unordered_map<size_t, musig_session *> session_;
 };    
     
-static secp256k1_ctx & get_ctx(interpreter_base &interp) {
-    static const common::con_cell CONTEXT("$ecctx", 0);
-
-    secp256k1_ctx *c;
-    
-    if ((c = reinterpret_cast<secp256k1_ctx *>(
-		   interp.get_managed_data(CONTEXT))) == nullptr) {
-        c = new secp256k1_ctx(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
-        interp.set_managed_data(CONTEXT, c);
-    }
-
-    return *c;
+// All interpreters share the same context (building one is expensive)
+static secp256k1_ctx & get_ctx(interpreter_base &) {
+    return secp256k1_ctx::shared();
 }
 
 secp256k1_ctx & builtins::get_secp256k1_ctx(interpreter_base &interp)
@@ -207,6 +200,65 @@ musig_env & builtins::get_musig_env(interpreter_base &interp) {
     return *env;
 }
     
+//
+// Extended public keys derived along BIP32 paths, keyed by the
+// (serialized) parent and the path prefix. Deriving M/0/I for many I
+// then derives the common prefix once, and deriving the same key again
+// (e.g. wallet:pubkey/2 for every UTXO) is a lookup. It's bounded; when
+// full it's dropped as a whole.
+//
+// Private derivations are never cached: the keys (and the parent in
+// the map keys) would stay in memory after the wallet has dropped its
+// secret.
+//
+class hd_cache : public prologcoin::interp::managed_data {
+public:
+    static const size_t MAX_ENTRIES = 8192;
+
+    template<typename XKey> static std::string key_of(const XKey &parent) {
+        uint8_t bytes[78];
+	parent.write(bytes);
+	return std::string(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+    }
+
+    static void append_child(std::string &key, uint32_t child_num) {
+        for (size_t i = 0; i < 4; i++) {
+	    key.push_back(static_cast<char>((child_num >> (24 - 8*i)) & 0xff));
+	}
+    }
+
+    inline bool find(const std::string &key, extended_public_key &out) const {
+        auto it = pub_.find(key);
+	if (it == pub_.end()) {
+	    return false;
+	}
+	out = it->second;
+	return true;
+    }
+
+    inline void insert(const std::string &key, const extended_public_key &k) {
+        if (size() >= MAX_ENTRIES) {
+	    pub_.clear();
+	}
+	pub_.insert(std::make_pair(key, k));
+    }
+
+    inline size_t size() const { return pub_.size(); }
+
+private:
+    std::unordered_map<std::string, extended_public_key> pub_;
+};
+
+static hd_cache & get_hd_cache(interpreter_base &interp) {
+    static const common::con_cell HDCACHE("$hdcache", 0);
+    auto *cache = reinterpret_cast<hd_cache *>(interp.get_managed_data(HDCACHE));
+    if (cache == nullptr) {
+        cache = new hd_cache();
+	interp.set_managed_data(HDCACHE, cache);
+    }
+    return *cache;
+}
+
 void builtins::get_checksum(const uint8_t *bytes, size_t n, uint8_t checksum[4])
 {
     // Silence unused warnings
@@ -508,6 +560,33 @@ bool builtins::get_hashed_2_data(uint8_t *data, size_t data_len,
     return true;
 }
 
+// Hash the serialized term as it is produced
+class sha256_sink : public term_serializer::sink {
+public:
+    sha256_sink() { secp256k1_sha256_initialize(&ctx_); }
+
+    virtual void write(const uint8_t *data, size_t n) override
+    { secp256k1_sha256_write(&ctx_, data, n); }
+
+    void finalize(uint8_t hash[32]) { secp256k1_sha256_finalize(&ctx_, hash); }
+
+private:
+    secp256k1_sha256 ctx_;
+};
+
+class blake2b_sink : public term_serializer::sink {
+public:
+    blake2b_sink(size_t out_len) { blake2b_init(&s_, out_len); }
+
+    virtual void write(const uint8_t *data, size_t n) override
+    { blake2b_update(&s_, data, n); }
+
+    void finalize(uint8_t *hash, size_t out_len) { blake2b_final(&s_, hash, out_len); }
+
+private:
+    blake2b_state s_;
+};
+
 bool builtins::get_hashed_term(interpreter_base &interp, const term data,
 			       uint8_t hash[32], size_t count)
 {
@@ -558,17 +637,21 @@ bool builtins::get_hashed_term(interpreter_base &interp, const term data,
 	return true;
     }
 
-    // The data is anything but a bignum. We'll serialize the data and
-    // then compute the SHA256 hash of it.
+    // The data is anything but a bignum. We'll compute the SHA256 hash
+    // of its serialization, while serializing it.
     term_serializer ser(interp);
-    term_serializer::buffer_t buf;
-    ser.write(buf, data);
+    sha256_sink out;
+    ser.write(out, data);
+    out.finalize(hash);
 
-    if (count == 1) {
-        return get_hashed_1_data(&buf[0], buf.size(), hash);
-    } else {
-        return get_hashed_2_data(&buf[0], buf.size(), hash);      
+    if (count == 2) {
+	secp256k1_sha256 ctx;
+	secp256k1_sha256_initialize(&ctx);
+	secp256k1_sha256_write(&ctx, hash, 32);
+	secp256k1_sha256_finalize(&ctx, hash);
     }
+
+    return true;
 }
 
 bool builtins::get_hashed_1_term(interpreter_base &interp, const term data,
@@ -764,23 +847,20 @@ bool builtins::hash_3(interpreter_base &interp, size_t arity, term args[])
 	   interp.to_string(args[1]));
     }
 
-    term_serializer::buffer_t buf;
+    uint8_t hash[32];
+
+    blake2b_sink out(sizeof(hash));
     if (args[0].tag() == tag_t::BIG) {
 	auto &big = reinterpret_cast<big_cell &>(args[0]);
 	auto n = interp.num_bytes(big);
-	buf.resize(n);
+	term_serializer::buffer_t buf(n);
 	interp.get_big(big, &buf[0], n);
+	out.write(&buf[0], n);
     } else {
 	term_serializer ser(interp);
-	ser.write(buf, args[0]);
+	ser.write(out, args[0]);
     }
-
-    uint8_t hash[32];
-    
-    blake2b_state s;
-    blake2b_init(&s, sizeof(hash));
-    blake2b_update(&s, &buf[0], buf.size());
-    blake2b_final(&s, hash, sizeof(hash));
+    out.finalize(hash, sizeof(hash));
 
     auto result = interp.new_big(hash, sizeof(hash));
 
@@ -937,12 +1017,23 @@ bool builtins::pproof_3(interpreter_base &interp,
     return interp.unify(args[2], pproof);
 }
 
-bool builtins::pverify_1(interpreter_base &interp, size_t arity, term args[])
+//
+// The raw data of a pproof/6 term. Extracting it needs the interpreter,
+// verifying it doesn't, so verification can be spread over threads.
+//
+struct pproof_data {
+    uint8_t commit[33];
+    uint8_t commit1[33];
+    uint8_t commit2[33];
+    uint8_t pubkey[33];
+    uint64_t utime;
+    uint8_t signature[64];
+};
+
+bool builtins::get_pproof(interpreter_base &interp, term pproof, pproof_data &data)
 {
     using namespace prologcoin::common;
 
-    term pproof = args[0];
-
     // Check that the functor is pproof/6
     if (pproof.tag() != tag_t::STR ||
 	interp.functor(pproof) != con_cell("pproof",6)) {
@@ -956,19 +1047,13 @@ bool builtins::pverify_1(interpreter_base &interp, size_t arity, term args[])
     term term_utime = interp.arg(pproof, 4);
     term term_signature = interp.arg(pproof, 5);
 
-    uint8_t commit_raw[33];
-    uint8_t commit1_raw[33];
-    uint8_t commit2_raw[33];
-    public_key pubkey_raw;
-    uint8_t signature_raw[64];
-
     size_t n1 = 33, n2 = 33, n3 = 33, n4 = 33, n5 = 64;
 
-    if (!get_bignum(interp, term_commit, commit_raw, n1) ||
-	!get_bignum(interp, term_commit1, commit1_raw, n2) ||
-	!get_bignum(interp, term_commit2, commit2_raw, n3) ||
-	!get_bignum(interp, term_pubkey, &pubkey_raw[0], n4) ||
-	!get_bignum(interp, term_signature, signature_raw, n5)) {
+    if (!get_bignum(interp, term_commit, data.commit, n1) ||
+	!get_bignum(interp, term_commit1, data.commit1, n2) ||
+	!get_bignum(interp, term_commit2, data.commit2, n3) ||
+	!get_bignum(interp, term_pubkey, data.pubkey, n4) ||
+	!get_bignum(interp, term_signature, data.signature, n5)) {
 	return false;
     }
     if (n1 != 33 || n2 != 33 || n3 != 33 || n4 != 33 || n5 != 64) {
@@ -978,27 +1063,27 @@ bool builtins::pverify_1(interpreter_base &interp, size_t arity, term args[])
     if (term_utime.tag() != tag_t::INT) {
 	return false;
     }
-    uint64_t ut_val = static_cast<uint64_t>(reinterpret_cast<const int_cell &>(term_utime).value());
-
-    auto &ctx = get_ctx(interp);
+    data.utime = static_cast<uint64_t>(reinterpret_cast<const int_cell &>(term_utime).value());
+    return true;
+}
 
+bool builtins::verify_pproof(secp256k1_ctx &ctx, pproof_data &data)
+{
     secp256k1_pedersen_commitment commit, commit1, commit2, commit3;
 
-    if (secp256k1_pedersen_commitment_parse(ctx, &commit, commit_raw) != 1) {
+    if (secp256k1_pedersen_commitment_parse(ctx, &commit, data.commit) != 1) {
 	return false;
     }
-    if (secp256k1_pedersen_commitment_parse(ctx, &commit1, commit1_raw) != 1) {
+    if (secp256k1_pedersen_commitment_parse(ctx, &commit1, data.commit1) != 1) {
 	return false;
     }
-    if (secp256k1_pedersen_commitment_parse(ctx, &commit2, commit2_raw) != 1) {
+    if (secp256k1_pedersen_commitment_parse(ctx, &commit2, data.commit2) != 1) {
 	return false;
     }
 
-    if (secp256k1_pedersen_commitment_load_pubkey(ctx, &commit3, &pubkey_raw[0]) != 1) {
+    if (secp256k1_pedersen_commitment_load_pubkey(ctx, &commit3, data.pubkey) != 1) {
     	return false;
     }
-    uint8_t commit3_raw[33];
-    secp256k1_pedersen_commitment_serialize(ctx, commit3_raw, &commit3);
 
     //
     // Positive commit
@@ -1023,18 +1108,82 @@ bool builtins::pverify_1(interpreter_base &interp, size_t arity, term args[])
     //
 
     // First hash message which is utime
-    utime ut(ut_val);
+    utime ut(data.utime);
     uint8_t msg[8];
     ut.to_bytes(msg);
     uint8_t hash[32];
     get_hashed_2_data(msg, sizeof(msg), hash);
-    if (!verify_signature(interp, hash, pubkey_raw, signature_raw)) {
+
+    secp256k1_pubkey pubkey;
+    if (secp256k1_ec_pubkey_parse(ctx, &pubkey, data.pubkey, 33) != 1) {
+	return false;
+    }
+    secp256k1_ecdsa_signature sig;
+    if (secp256k1_ecdsa_signature_parse_compact(ctx, &sig, data.signature) != 1) {
+	return false;
+    }
+    if (secp256k1_ecdsa_verify(ctx, &sig, hash, &pubkey) != 1) {
 	return false;
     }
 
     return true;
 }
 
+bool builtins::pverify_1(interpreter_base &interp, size_t arity, term args[])
+{
+    pproof_data data;
+    if (!get_pproof(interp, args[0], data)) {
+	return false;
+    }
+    return verify_pproof(get_ctx(interp), data);
+}
+
+bool builtins::pverify_all_1(interpreter_base &interp, size_t arity, term args[])
+{
+    static const size_t MIN_PER_THREAD = 16;
+
+    if (!interp.is_list(args[0])) {
+	throw interpreter_exception_wrong_arg_type("pverify_all/1: Argument must be a list of proofs; was " + interp.to_string(args[0]));
+    }
+
+    std::vector<pproof_data> proofs;
+    for (term lst = args[0]; interp.is_dotted_pair(lst); lst = interp.arg(lst, 1)) {
+	proofs.push_back(pproof_data());
+	if (!get_pproof(interp, interp.arg(lst, 0), proofs.back())) {
+	    return false;
+	}
+    }
+
+    // The proofs are independent, so large batches are split among
+    // threads (the shared context is only read.) A thread stops as soon
+    // as any proof fails.
+    auto &ctx = get_ctx(interp);
+    std::atomic<bool> ok(true);
+    auto verify = [&](size_t lo, size_t hi) {
+	for (size_t i = lo; i < hi && ok; i++) {
+	    if (!verify_pproof(ctx, proofs[i])) {
+		ok = false;
+	    }
+	}
+    };
+    size_t num_threads = std::max(static_cast<size_t>(1),
+		  std::min(static_cast<size_t>(boost::thread::hardware_concurrency()),
+			   proofs.size() / MIN_PER_THREAD));
+    size_t chunk = (proofs.size() + num_threads - 1) / num_threads;
+    std::vector<boost::thread> workers;
+    for (size_t t = 1; t < num_threads; t++) {
+	size_t lo = std::min(t * chunk, proofs.size());
+	size_t hi = std::min(lo + chunk, proofs.size());
+	workers.push_back(boost::thread([&verify, lo, hi]() { verify(lo, hi); }));
+    }
+    verify(0, std::min(chunk, proofs.size()));
+    for (auto &w : workers) {
+	w.join();
+    }
+
+    return ok;
+}
+
 void builtins::pedersen_test()
 {
     auto *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
@@ -1897,6 +2046,7 @@ void builtins::load(interpreter_base &interp, con_cell *module0)
     // interp.load_builtin(EC, con_cell("pcommit",3), &builtins::pcommit_3);
     interp.load_builtin(M, con_cell("pproof", 3), &builtins::pproof_3);
     interp.load_builtin(M, con_cell("pverify", 1), &builtins::pverify_1);
+    interp.load_builtin(M, interp.functor("pverify_all", 1), &builtins::pverify_all_1);
 
     // MuSig
     interp.load_builtin(M, interp.functor("musig_combine", 3), &builtins::musig_combine_3);
@@ -1924,6 +2074,7 @@ void builtins::load(interpreter_base &interp, con_cell *module0)
     interp.load_builtin(M, interp.functor("words", 2), &builtins::words_2);
     interp.load_builtin(M, interp.functor("child_pubkey", 3), &builtins::child_pubkey_3);
     interp.load_builtin(M, interp.functor("child_privkey", 3), &builtins::child_privkey_3);
+    interp.load_builtin(M, interp.functor("child_addresses", 4), &builtins::child_addresses_4);
     interp.load_builtin(M, interp.functor("normal_key", 2), &builtins::normal_key_2);
     interp.load_builtin(M, interp.functor("bc1", 2), &builtins::bc1_2);    
 
@@ -1945,6 +2096,7 @@ void builtins::load_consensus(interpreter_base &interp) {
     interp.load_builtin(M, interp.functor("privkey_tweak_add", 3), &builtins::privkey_tweak_add_3);    
     
     interp.load_builtin(M, con_cell("pverify", 1), &builtins::pverify_1);
+    interp.load_builtin(M, interp.functor("pverify_all", 1), &builtins::pverify_all_1);
 
     // MuSig
     interp.load_builtin(M, interp.functor("musig_combine", 3), &builtins::musig_combine_3);
@@ -1952,14 +2104,49 @@ void builtins::load_consensus(interpreter_base &interp) {
     interp.load_builtin(M, interp.functor("musig_secret", 7), &builtins::musig_secret_7);
 }
 
+static void derive_path(interpreter_base &interp, extended_private_key &key, const std::vector<uint32_t> &child_nums)
+{
+    // Not cached (see hd_cache)
+    hd_keys hd(get_ctx(interp));
+    for (auto child_num : child_nums) {
+        hd.generate_child(key, child_num, key);
+    }
+}
+
+static void derive_path(interpreter_base &interp, extended_public_key &key, const std::vector<uint32_t> &child_nums)
+{
+    if (child_nums.empty()) {
+        return;
+    }
+
+    auto &cache = get_hd_cache(interp);
+    std::vector<std::string> prefixes(child_nums.size());
+    std::string prefix = hd_cache::key_of(key);
+    for (size_t i = 0; i < child_nums.size(); i++) {
+        hd_cache::append_child(prefix, child_nums[i]);
+	prefixes[i] = prefix;
+    }
+
+    // Start from the longest prefix we already have
+    size_t start = child_nums.size();
+    while (start > 0 && !cache.find(prefixes[start-1], key)) {
+        start--;
+    }
+
+    hd_keys hd(get_ctx(interp));
+    for (size_t i = start; i < child_nums.size(); i++) {
+        hd.generate_child(key, child_nums[i], key);
+	cache.insert(prefixes[i], key);
+    }
+}
+
 template<typename XKey> static void execute_path(const std::string &pname, interpreter_base &interp, XKey &key, term path)
 {
     static const con_cell H("h",1);
     static const con_cell M("m",0);
     static const con_cell SLASH("/",2);
 
-    hd_keys hd(get_ctx(interp));
-
+    std::vector<uint32_t> child_nums;
     std::vector<term> ops;
     while (path.tag() == tag_t::STR && interp.functor(path) == SLASH) {
         ops.push_back(interp.arg(path, 1));
@@ -1997,7 +2184,7 @@ template<typename XKey> static void execute_path(const std::string &pname, inter
 	        throw interpreter_exception_wrong_arg_type(msg.str());	        
 	    }
 	    uint32_t child_num = static_cast<uint32_t>(val);
-	    hd.generate_child(key, hd_keys::H(child_num), key);
+	    child_nums.push_back(hd_keys::H(child_num));
 	} else if (op.tag() == tag_t::CON) {
 	    if (!first || op != M) {
   	        std::stringstream msg;
@@ -2012,7 +2199,7 @@ template<typename XKey> static void execute_path(const std::string &pname, inter
 	        throw interpreter_exception_wrong_arg_type(msg.str());	        
 	    }
 	    uint32_t child_num = static_cast<uint32_t>(val);
-	    hd.generate_child(key, child_num, key);
+	    child_nums.push_back(child_num);
 	} else {
 	    std::stringstream msg;
 	    msg << pname << ": Unexpected path component: " << interp.to_string(op);
@@ -2020,6 +2207,8 @@ template<typename XKey> static void execute_path(const std::string &pname, inter
 	}
 	first = false;
     }
+
+    derive_path(interp, key, child_nums);
 }
 
 bool builtins::is_int_list(interpreter_base &interp, term lst)
@@ -2144,17 +2333,15 @@ bool builtins::words_2(interpreter_base &interp, size_t arity, term args[]) {
     return interp.unify(out, mem.to_sentence());
 }
 
-bool builtins::derive_child(const std::string &pname, interpreter_base &interp, term parent, term path, term result) {
+void builtins::get_extended_key(const std::string &pname, interpreter_base &interp, term parent, uint8_t xkey_bytes[XKEY_LEN]) {
     if (parent.tag() != tag_t::BIG) {
         std::stringstream msg;
         msg << pname << ": First argument must be a valid extended parent key; was " << interp.to_string(parent);
         throw interpreter_exception_wrong_arg_type(msg.str());
     }
   
-    static const size_t XKEY_LEN = 82;
-    uint8_t xkey_bytes[XKEY_LEN];
     size_t xkey_bytes_num = XKEY_LEN;
-    if (!get_bignum(interp, parent, xkey_bytes, xkey_bytes_num) || xkey_bytes_num != 82) {
+    if (!get_bignum(interp, parent, xkey_bytes, xkey_bytes_num) || xkey_bytes_num != XKEY_LEN) {
         std::stringstream msg;
         msg << pname << ": First argument must be a valid extended parent key; was " << interp.to_string(parent);
         throw interpreter_exception_wrong_arg_type(msg.str());      
@@ -2168,6 +2355,11 @@ bool builtins::derive_child(const std::string &pname, interpreter_base &interp,
         msg << pname << ": Provided extended key checksum failed; " << interp.to_string(parent);
         throw interpreter_exception_wrong_arg_type(msg.str());      
     }
+}
+
+bool builtins::derive_child(const std::string &pname, interpreter_base &interp, term parent, term path, term result) {
+    uint8_t xkey_bytes[XKEY_LEN];
+    get_extended_key(pname, interp, parent, xkey_bytes);
 
     // Check if key is public or private
 
@@ -2230,6 +2422,103 @@ bool builtins::child_privkey_3(interpreter_base &interp, size_t arity, term args
     return derive_child("child_privkey/3", interp, args[0], args[1], args[2]);
 }
 
+bool builtins::child_addresses_4(interpreter_base &interp, size_t arity, term args[]) {
+    static const std::string pname = "child_addresses/4";
+    static const size_t ADDRESS_LEN = 25;
+
+    uint8_t xkey_bytes[XKEY_LEN];
+    get_extended_key(pname, interp, args[0], xkey_bytes);
+
+    extended_public_key xpub;
+    if (xkey_bytes[0] == 0x04 && xkey_bytes[1] == 0x88 &&
+	xkey_bytes[2] == 0xB2 && xkey_bytes[3] == 0x1E) {
+	if (!xpub.read(xkey_bytes)) {
+	    throw interpreter_exception_wrong_arg_type(pname + ": Couldn't parse parent public key; " + interp.to_string(args[0]));
+	}
+    } else if (xkey_bytes[0] == 0x04 && xkey_bytes[1] == 0x88 &&
+	       xkey_bytes[2] == 0xAD && xkey_bytes[3] == 0xE4) {
+        extended_private_key xpriv;
+	if (!xpriv.read(xkey_bytes)) {
+	    throw interpreter_exception_wrong_arg_type(pname + ": Couldn't parse parent private key; " + interp.to_string(args[0]));
+	}
+	xpriv.compute_extended_public_key(get_ctx(interp), xpub);
+    } else {
+	throw interpreter_exception_wrong_arg_type(pname + ": Unrecognized parent key; " + interp.to_string(args[0]));
+    }
+
+    if (args[1].tag() != tag_t::INT || reinterpret_cast<int_cell &>(args[1]).value() < 0) {
+	throw interpreter_exception_wrong_arg_type(pname + ": Second argument, From, must be a non-negative integer; was " + interp.to_string(args[1]));
+    }
+    if (args[2].tag() != tag_t::INT || reinterpret_cast<int_cell &>(args[2]).value() < 0) {
+	throw interpreter_exception_wrong_arg_type(pname + ": Third argument, Count, must be a non-negative integer; was " + interp.to_string(args[2]));
+    }
+    auto from = static_cast<uint64_t>(reinterpret_cast<int_cell &>(args[1]).value());
+    auto count = static_cast<size_t>(reinterpret_cast<int_cell &>(args[2]).value());
+    if (from + count > extended_key::HARDENED_KEY) {
+	throw interpreter_exception_wrong_arg_type(pname + ": Child numbers must be below 2^31; was " + interp.to_string(args[1]) + " + " + interp.to_string(args[2]));
+    }
+
+    // Children that were derived before come from the cache; the rest
+    // are split among threads. Each child is independent (and secp256k1
+    // contexts can be shared for these read-only operations.)
+    auto &cache = get_hd_cache(interp);
+    std::string parent_key = hd_cache::key_of(xpub);
+    std::vector<extended_public_key> children(count);
+    std::vector<size_t> todo;
+    for (size_t i = 0; i < count; i++) {
+	auto key = parent_key;
+	hd_cache::append_child(key, static_cast<uint32_t>(from + i));
+	if (!cache.find(key, children[i])) {
+	    todo.push_back(i);
+	}
+    }
+
+    std::vector<uint8_t> addresses(count * ADDRESS_LEN);
+    std::vector<uint8_t> ok(count, 1);
+    auto &ctx = get_ctx(interp);
+    auto derive = [&](size_t lo, size_t hi) {
+	hd_keys hd(ctx);
+	for (size_t j = lo; j < hi; j++) {
+	    size_t i = todo[j];
+	    ok[i] = hd.generate_child(xpub, static_cast<uint32_t>(from + i), children[i]);
+	}
+    };
+    static const size_t MIN_PER_THREAD = 32;
+    size_t num_threads = std::max(static_cast<size_t>(1),
+		  std::min(static_cast<size_t>(boost::thread::hardware_concurrency()),
+			   todo.size() / MIN_PER_THREAD));
+    size_t chunk = (todo.size() + num_threads - 1) / num_threads;
+    std::vector<boost::thread> workers;
+    for (size_t t = 1; t < num_threads; t++) {
+	size_t lo = std::min(t * chunk, todo.size());
+	size_t hi = std::min(lo + chunk, todo.size());
+	workers.push_back(boost::thread([&derive, lo, hi]() { derive(lo, hi); }));
+    }
+    derive(0, std::min(chunk, todo.size()));
+    for (auto &w : workers) {
+	w.join();
+    }
+
+    term lst = interp.EMPTY_LIST;
+    for (size_t i = count; i-- > 0;) {
+	if (!ok[i]) {
+	    // Invalid child (probability < 2^-127); BIP32 says skip it
+	    return false;
+	}
+	get_address(children[i], &addresses[i * ADDRESS_LEN]);
+	term big = interp.new_big(ADDRESS_LEN*8);
+	interp.set_big(big, &addresses[i * ADDRESS_LEN], ADDRESS_LEN);
+	lst = interp.new_dotted_pair(big, lst);
+    }
+    for (auto i : todo) {
+	auto key = parent_key;
+	hd_cache::append_child(key, static_cast<uint32_t>(from + i));
+	cache.insert(key, children[i]);
+    }
+
+    return interp.unify(args[3], lst);
+}
+
 bool builtins::normal_key_2(interpreter_base &interp, size_t arity, term args[]) {
     const std::string pname = "normal_key/2";
 
@@ -33,6 +33,7 @@ public:
 
 class musig_env;
 class musig_session;
+struct pproof_data;
     
 class builtins {
 public:
@@ -155,6 +156,11 @@ public:
     // Verifies the given proof.
     static bool pverify_1(interpreter_base &interp, size_t arity, term args[]);
 
+    // pverify_all(+Proofs)
+    // True iff all proofs in the list verify. Large lists are verified
+    // in parallel.
+    static bool pverify_all_1(interpreter_base &interp, size_t arity, term args[]);
+
     // BIP32 & BIP39
 
     // master_key(+Seed, -MasterPrivate, -MasterPublic)
@@ -173,6 +179,11 @@ public:
     //               'm/' can be skipped; h(2)/3 means the same thing
     static bool child_pubkey_3(interpreter_base &interp, size_t arity, term args[]);
     static bool child_privkey_3(interpreter_base &interp, size_t arity, term args[]);
+    // child_addresses(+ParentKey, +From, +Count, -Addresses)
+    // Addresses of the (public) children From, ..., From+Count-1 of
+    // ParentKey. Same as child_pubkey/3, normal_key/2 and address/2 for
+    // each, but derived in parallel.
+    static bool child_addresses_4(interpreter_base &interp, size_t arity, term args[]);
     // normal_key/2(+ExtendedKey, Key)
     // True iff Key is the normal key from the extended key.
     static bool normal_key_2(interpreter_base &interp, size_t arity, term args[]);
@@ -195,7 +206,11 @@ public:
     static term encrypt(interpreter_base &interp, term input, const std::string &passwd, int64_t iter);
 
 private:
+    static bool get_pproof(interpreter_base &interp, term pproof, pproof_data &data);
+    static bool verify_pproof(secp256k1_ctx &ctx, pproof_data &data);
     static bool decrypt(interpreter_base &interp, term input, const uint8_t *key, term result);
+    static const size_t XKEY_LEN = 82;
+    static void get_extended_key(const std::string &pname, interpreter_base &interp, term parent, uint8_t xkey_bytes[XKEY_LEN]);
     static bool derive_child(const std::string &pname, interpreter_base &interp, term parent, term path, term result);
 
 public:
@@ -17,14 +17,40 @@ secp256k1_ctx::secp256k1_ctx() : secp256k1_ctx(SECP256K1_CONTEXT_SIGN | SECP256K
     
 secp256k1_ctx::secp256k1_ctx(unsigned int flags) {
     ctx_ = secp256k1_context_create(flags);
-    scratch_ = secp256k1_scratch_space_create(ctx_, 1024*1024);
 }
 
 secp256k1_ctx::~secp256k1_ctx() {
-    secp256k1_scratch_space_destroy(ctx_, scratch_);
     secp256k1_context_destroy(ctx_);
 }
 
+secp256k1_ctx & secp256k1_ctx::shared() {
+    struct shared_ctx {
+	shared_ctx() : ctx(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY) {
+	    // Blinding against side channels when signing
+	    uint8_t seed[32];
+	    random::next_bytes(seed, sizeof(seed));
+	    int r = secp256k1_context_randomize(ctx, seed);
+	    assert(r == 1);
+	    (void)r;
+	}
+	secp256k1_ctx ctx;
+    };
+    static shared_ctx shared_;
+    return shared_.ctx;
+}
+
+secp256k1_scratch_space * secp256k1_ctx::scratch() {
+    // The scratch space only uses the context for its error callback,
+    // so it's created with the shared one (which outlives it.)
+    struct thread_scratch {
+	thread_scratch() : scratch(secp256k1_scratch_space_create(shared(), SCRATCH_SIZE)) { }
+	~thread_scratch() { secp256k1_scratch_space_destroy(shared(), scratch); }
+	secp256k1_scratch_space *scratch;
+    };
+    static thread_local thread_scratch thread_scratch_;
+    return thread_scratch_.scratch;
+}
+
 void checksum(const uint8_t *in, size_t len, uint8_t out[4])
 {
     sha256 hash;
@@ -14,19 +14,26 @@ namespace prologcoin { namespace ec {
 
 class secp256k1_ctx : public prologcoin::interp::managed_data {
 public:
+    static const size_t SCRATCH_SIZE = 1024*1024;
+
     secp256k1_ctx();
     secp256k1_ctx(unsigned int flags);
     virtual ~secp256k1_ctx() override;
 
+    // The context used by all interpreters (for signing and verifying.)
+    // It's created (with its precomputed tables) the first time it's
+    // needed and then only read, so it's shared by all threads.
+    static secp256k1_ctx & shared();
+
     inline operator secp256k1_context * () {
         return ctx_;
     }
-    inline secp256k1_scratch_space * scratch() {
-        return scratch_;
-    }
+
+    // Scratch space is written to, so there's one per thread.
+    secp256k1_scratch_space * scratch();
+
 private:
     secp256k1_context *ctx_;
-    secp256k1_scratch_space *scratch_;
 };
 
 void checksum(const uint8_t *in, size_t len, uint8_t out[4]);
@@ -3,3 +3,11 @@
 %
 ?- B = 58'L326Y3N3XHcGWSnhiTPZTb544aGZt6x8sTfLpnWKwoeLr3NWghct, V = 1234, ec:pproof(B,V,P), ec:pverify(P).
 % Expect: true/*
+
+%
+% ec:pverify_all
+%
+?- B = 58'L326Y3N3XHcGWSnhiTPZTb544aGZt6x8sTfLpnWKwoeLr3NWghct, ec:pproof(B,1,P1), ec:pproof(B,2,P2), ec:pverify_all([P1,P2]), ec:pverify_all([]).
+% Expect: true/*
+?- B = 58'L326Y3N3XHcGWSnhiTPZTb544aGZt6x8sTfLpnWKwoeLr3NWghct, ec:pproof(B,1,P1), P1 = pproof(C,C1,C2,K,T,S), T1 is T + 1, \+ ec:pverify_all([P1,pproof(C,C1,C2,K,T1,S)]).
+% Expect: true/*
@@ -156,3 +156,34 @@ derive_pub3(xprv, Path,C) :-
 % Expect: C = 58'xpub68NZiKmJWnxxS6aaHmn81bvJeTESw724CRDs6HbuccFQN9Ku14VQrADWgqbhhTHBaohPX4CjNLf9fq9MYo6oDaPPLPxSb7gwQN3ih19Zm4Y.
 ?- derive_prv3(xprv, m/h(0), C).
 % Expect: C = 58'xprv9uPDJpEQgRQfDcW7BkF7eTya6RPxXeJCqCJGHuCJ4GiRVLzkTXBAJMu2qaMWPrS7AANYqdq6vcBcBUdJCVVFceUvJFjaPdGZ2y9WACViL4L.
+
+%
+% Batch derivation of addresses (same as one by one)
+%
+
+child_addresses_seq(_, _, 0, []) :- !.
+child_addresses_seq(P, I, N, [A|As]) :-
+    ec:child_pubkey(P, I, X), ec:normal_key(X, K), ec:address(K, A),
+    I1 is I + 1, N1 is N - 1,
+    child_addresses_seq(P, I1, N1, As).
+
+check_addresses(From, N) :-
+    mpub1(P),
+    ec:child_addresses(P, From, N, As),
+    child_addresses_seq(P, From, N, As2),
+    As == As2.
+
+check_private_parent(From, N) :-
+    mprv1(P), mpub1(Q),
+    ec:child_addresses(P, From, N, As),
+    ec:child_addresses(Q, From, N, As2),
+    As == As2.
+
+?- check_addresses(0, 200).
+% Expect: true
+?- check_addresses(150, 100).
+% Expect: true
+?- check_private_parent(5, 3).
+% Expect: true
+?- mpub1(P), ec:child_addresses(P, 0, 0, As).
+% Expect: P = 58'xpub661MyMwAqRbcFtXgS5sYJABqqG9YLmC4Q1Rdap9gSE8NqtwybGhePY2gZ29ESFjqJoCu1Rupje8YtGqsefD265TMg7usUDFdp6W1EGMcet8, As = [].
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <iomanip>
+#include "../../common/term.hpp"
+#include "../../common/utime.hpp"
+#include "../../interp/interpreter.hpp"
+#include "../builtins.hpp"
+
+using namespace prologcoin::common;
+using namespace prologcoin::ec;
+
+static void header( const std::string &str )
+{
+    std::cout << "\n";
+    std::cout << "--- [" + str + "] " + std::string(60 - str.length(), '-') << "\n";
+    std::cout << "\n";
+}
+
+static void test_pverify_batch()
+{
+    header("test_pverify_batch");
+
+    static const size_t N = 1000;
+
+    prologcoin::interp::interpreter interp("test");
+    builtins::load(interp);
+    term_env &env = interp;
+
+    term blinding = interp.parse("58'L326Y3N3XHcGWSnhiTPZTb544aGZt6x8sTfLpnWKwoeLr3NWghct");
+
+    std::cout << "Generate " << N << " proofs..." << std::endl;
+    std::vector<term> proofs;
+    for (size_t i = 0; i < N; i++) {
+	term args[3] = { blinding, int_cell(static_cast<int64_t>(1000 + i)), interp.new_ref() };
+	assert(builtins::pproof_3(interp, 3, args));
+	proofs.push_back(env.deref(args[2]));
+    }
+    term lst = interp.EMPTY_LIST;
+    for (auto it = proofs.rbegin(); it != proofs.rend(); ++it) {
+	lst = interp.new_dotted_pair(*it, lst);
+    }
+
+    utime t0 = utime::now();
+    for (auto p : proofs) {
+	term args[1] = { p };
+	assert(builtins::pverify_1(interp, 1, args));
+    }
+    utime t1 = utime::now();
+    term args[1] = { lst };
+    assert(builtins::pverify_all_1(interp, 1, args));
+    utime t2 = utime::now();
+
+    auto one_by_one = (t1 - t0).in_us();
+    auto batch = (t2 - t1).in_us();
+    std::cout << "pverify/1 (one by one): " << one_by_one / 1000 << " ms" << std::endl;
+    std::cout << "pverify_all/1:          " << batch / 1000 << " ms" << std::endl;
+    std::cout << "Speedup:                " << std::setprecision(3)
+	      << static_cast<double>(one_by_one) / std::max(batch, static_cast<uint64_t>(1))
+	      << "x" << std::endl;
+
+    // One bad proof makes the batch fail
+    term bad = proofs[N/2];
+    term bad_args[6];
+    for (size_t i = 0; i < 6; i++) {
+	bad_args[i] = interp.arg(bad, i);
+    }
+    auto ut = reinterpret_cast<int_cell &>(bad_args[4]).value();
+    bad_args[4] = int_cell(ut + 1);
+    proofs[N/2] = interp.new_term(con_cell("pproof",6), { bad_args[0], bad_args[1], bad_args[2], bad_args[3], bad_args[4], bad_args[5] });
+    lst = interp.EMPTY_LIST;
+    for (auto it = proofs.rbegin(); it != proofs.rend(); ++it) {
+	lst = interp.new_dotted_pair(*it, lst);
+    }
+    term args2[1] = { lst };
+    assert(!builtins::pverify_all_1(interp, 1, args2));
+}
+
+int main(int argc, char *argv[])
+{
+    test_pverify_batch();
+    return 0;
+}
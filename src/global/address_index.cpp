@@ -0,0 +1,130 @@
+#include "address_index.hpp"
+#include "global_interpreter.hpp"
+#include "global.hpp"
+
+using namespace prologcoin::common;
+
+namespace prologcoin { namespace global {
+
+address_index::address_index()
+    : built_(false),
+      num_builds_(0)
+{
+}
+
+bool address_index::address_of(interp::interpreter_base &interp,
+			       term closure, term &address)
+{
+    static const con_cell COLON(":", 2);
+    static const con_cell FREEZE("$freeze", 0);
+    static const con_cell TX1("tx1", 0);
+    static const con_cell ARGS("args", 3);
+
+    closure = interp.deref(closure);
+    if (closure.tag() != tag_t::STR || interp.functor(closure) != COLON) {
+	return false;
+    }
+    if (interp.arg(closure, 0) != FREEZE) {
+	return false;
+    }
+    term f = interp.arg(closure, 1);
+    if (f.tag() != tag_t::STR || interp.functor(f).arity() < 3) {
+	return false;
+    }
+    if (interp.arg(f, 1) != TX1) {
+	return false;
+    }
+    term args = interp.arg(f, 2);
+    if (args.tag() != tag_t::STR || interp.functor(args) != ARGS) {
+	return false;
+    }
+    address = interp.arg(args, 2);
+    return !address.tag().is_ref();
+}
+
+address_index::key_t address_index::key_of(interp::interpreter_base &interp,
+					   term address)
+{
+    return interp.to_string(address);
+}
+
+void address_index::build(global_interpreter &interp)
+{
+    by_address_.clear();
+    by_heap_addr_.clear();
+
+    auto &chain = interp.get_global().get_blockchain();
+    auto &closure_db = chain.closure_db();
+    auto root = chain.closure_root();
+    if (!closure_db.is_empty() && !root.is_zero()) {
+	for (auto it = closure_db.begin(root, 0); !it.at_end(); ++it) {
+	    auto &leaf = *it;
+	    assert(leaf.custom_data_size() == sizeof(uint64_t));
+	    cell cl(db::read_uint64(leaf.custom_data()));
+	    term address;
+	    if (address_of(interp, cl, address)) {
+		add(leaf.key(), key_of(interp, address));
+	    }
+	}
+    }
+    built_ = true;
+    num_builds_++;
+}
+
+void address_index::invalidate()
+{
+    built_ = false;
+    by_address_.clear();
+    by_heap_addr_.clear();
+}
+
+void address_index::add(size_t heap_addr, const key_t &key)
+{
+    remove(heap_addr);
+    by_address_[key].insert(heap_addr);
+    by_heap_addr_[heap_addr] = key;
+}
+
+void address_index::add(global_interpreter &interp, size_t heap_addr,
+			term closure)
+{
+    term address;
+    if (address_of(interp, closure, address)) {
+	add(heap_addr, key_of(interp, address));
+    } else {
+	remove(heap_addr);
+    }
+}
+
+void address_index::remove(size_t heap_addr)
+{
+    auto found = by_heap_addr_.find(heap_addr);
+    if (found == by_heap_addr_.end()) {
+	return;
+    }
+    auto at = by_address_.find(found->second);
+    if (at != by_address_.end()) {
+	at->second.erase(heap_addr);
+	if (at->second.empty()) {
+	    by_address_.erase(at);
+	}
+    }
+    by_heap_addr_.erase(found);
+}
+
+void address_index::find(const std::vector<key_t> &keys, size_t since,
+			 std::vector<size_t> &heap_addrs) const
+{
+    for (auto &key : keys) {
+	auto at = by_address_.find(key);
+	if (at == by_address_.end()) {
+	    continue;
+	}
+	auto &addrs = at->second;
+	for (auto it = addrs.lower_bound(since); it != addrs.end(); ++it) {
+	    heap_addrs.push_back(*it);
+	}
+    }
+}
+
+}}
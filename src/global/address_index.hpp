@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef _global_address_index_hpp
+#define _global_address_index_hpp
+
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+#include "../common/term.hpp"
+#include "../interp/interpreter.hpp"
+
+namespace prologcoin { namespace global {
+
+class global_interpreter;
+
+//
+// address_index. A secondary index from address (the PubKeyAddr of
+// tx1 closures, i.e. '$freeze':F with arg 2 of F being tx1 and arg 3
+// args(_,_,Address)) to the heap addresses of the frozen closures
+// paying to it. A wallet can then ask for its own UTXOs instead of
+// paging through every closure.
+//
+// The index lives in memory. It is built by scanning the closure
+// database of the tip when closures are first committed (or by the
+// first lookup, if no closures have been committed to the tip), and
+// then kept up to date as closures are committed. Switching tip drops
+// it, so it's built again for the new chain when needed. The build is
+// never charged to a lookup, as the cost of a query must not depend on
+// the history of this node.
+//
+// Lookups are only hints; global_interpreter checks that the closure
+// at each heap address is (still) a tx1 closure paying to the address
+// and adds the closures not committed yet, so the result only depends
+// on the state, never on the history of this node.
+//
+class address_index : private boost::noncopyable {
+public:
+    using term = common::term;
+    using key_t = std::string;
+
+    address_index();
+
+    inline bool is_built() const { return built_; }
+    void build(global_interpreter &interp);
+    void invalidate();
+
+    // Called when a closure is committed (or removed.)
+    void add(global_interpreter &interp, size_t heap_addr, term closure);
+    void remove(size_t heap_addr);
+
+    // Heap addresses >= since of the (committed) closures paying to
+    // any of the given addresses. Unordered and not checked.
+    void find(const std::vector<key_t> &keys, size_t since,
+	      std::vector<size_t> &heap_addrs) const;
+
+    // True (and address bound) if closure is a tx1 closure.
+    static bool address_of(interp::interpreter_base &interp, term closure,
+			   term &address);
+    static key_t key_of(interp::interpreter_base &interp, term address);
+
+    inline size_t size() const { return by_heap_addr_.size(); }
+    inline size_t num_builds() const { return num_builds_; }
+
+private:
+    void add(size_t heap_addr, const key_t &key);
+
+    bool built_;
+    std::unordered_map<key_t, std::set<size_t> > by_address_;
+    std::unordered_map<size_t, key_t> by_heap_addr_;
+    size_t num_builds_;
+};
+
+}}
+
+#endif
@@ -0,0 +1,265 @@
+#include "../common/term_env.hpp"
+#include "block_pipeline.hpp"
+#include "global.hpp"
+
+using namespace prologcoin::common;
+
+namespace prologcoin { namespace global {
+
+block_pipeline::block_pipeline(global &g, size_t num_workers, size_t max_pending)
+    : global_(g),
+      max_pending_(max_pending),
+      max_age_(DEFAULT_MAX_AGE),
+      stop_(false)
+{
+    for (size_t i = 0; i < num_workers; i++) {
+	workers_.push_back(boost::thread([this]() { run_worker(); }));
+    }
+}
+
+block_pipeline::~block_pipeline()
+{
+    {
+	boost::unique_lock<boost::mutex> lockit(lock_);
+	stop_ = true;
+	work_cv_.notify_all();
+    }
+    while (!workers_.empty()) {
+	workers_.back().join();
+	workers_.pop_back();
+    }
+    for (auto &e : items_) {
+	delete e.second;
+    }
+}
+
+bool block_pipeline::submit(const meta_entry &entry, const buffer_t &meta,
+			    const buffer_t &goals)
+{
+    boost::unique_lock<boost::mutex> lockit(lock_);
+    if (items_.find(entry.get_id()) != items_.end()) {
+	return false;
+    }
+    if (items_.size() >= max_pending_) {
+	drop_expired(lockit);
+	if (items_.size() >= max_pending_) {
+	    return false;
+	}
+    }
+    auto *it = new item();
+    it->entry = entry;
+    it->meta = meta;
+    it->goals = goals;
+    it->submitted = utime::now();
+    it->state = PENDING;
+    items_[entry.get_id()] = it;
+    queue_.push_back(it);
+    work_cv_.notify_one();
+    return true;
+}
+
+bool block_pipeline::has_block(const meta_id &id) const
+{
+    boost::unique_lock<boost::mutex> lockit(lock_);
+    return items_.find(id) != items_.end();
+}
+
+size_t block_pipeline::num_pending() const
+{
+    boost::unique_lock<boost::mutex> lockit(lock_);
+    return items_.size();
+}
+
+void block_pipeline::erase(boost::unique_lock<boost::mutex> &lockit, const meta_id &id)
+{
+    for (;;) {
+	auto found = items_.find(id);
+	if (found == items_.end()) {
+	    return;
+	}
+	auto *it = found->second;
+	if (it->state == CHECKING) {
+	    // Wait for the worker (which releases the lock, so look it
+	    // up again.)
+	    done_cv_.wait(lockit);
+	    continue;
+	}
+	queue_.erase(std::remove(queue_.begin(), queue_.end(), it), queue_.end());
+	items_.erase(found);
+	delete it;
+	return;
+    }
+}
+
+void block_pipeline::drop(const meta_id &id)
+{
+    boost::unique_lock<boost::mutex> lockit(lock_);
+    erase(lockit, id);
+}
+
+void block_pipeline::drop_expired(boost::unique_lock<boost::mutex> &lockit)
+{
+    auto now = utime::now();
+    std::vector<meta_id> expired;
+    for (auto &e : items_) {
+	if ((now - e.second->submitted).in_us() >= max_age_) {
+	    expired.push_back(e.first);
+	}
+    }
+    for (auto &id : expired) {
+	erase(lockit, id);
+    }
+}
+
+void block_pipeline::drop_unreachable(const meta_id &tip)
+{
+    auto &chain = global_.get_blockchain();
+    auto *tip_entry = chain.get_meta_entry(tip);
+    uint32_t tip_height = tip_entry ? tip_entry->get_height() : 0;
+
+    boost::unique_lock<boost::mutex> lockit(lock_);
+    std::vector<meta_id> unreachable;
+    for (auto &e : items_) {
+	auto *it = e.second;
+	bool reachable = false;
+	if (tip_entry != nullptr && it->entry.get_height() > tip_height) {
+	    // Follow the previous ids back to the height of the tip
+	    meta_id id = it->entry.get_previous_id();
+	    uint32_t height = it->entry.get_height() - 1;
+	    while (height > tip_height) {
+		auto *prev = chain.get_meta_entry(id);
+		if (prev == nullptr) {
+		    break;
+		}
+		id = prev->get_previous_id();
+		height--;
+	    }
+	    reachable = height == tip_height && id == tip;
+	}
+	if (!reachable) {
+	    unreachable.push_back(e.first);
+	}
+    }
+    for (auto &id : unreachable) {
+	erase(lockit, id);
+    }
+}
+
+void block_pipeline::clear()
+{
+    boost::unique_lock<boost::mutex> lockit(lock_);
+    queue_.clear();
+    for (;;) {
+	bool busy = false;
+	for (auto &e : items_) {
+	    if (e.second->state == CHECKING) busy = true;
+	}
+	if (!busy) break;
+	done_cv_.wait(lockit);
+    }
+    for (auto &e : items_) {
+	delete e.second;
+    }
+    items_.clear();
+}
+
+bool block_pipeline::commit(const meta_id &id)
+{
+    item *it = nullptr;
+    {
+	boost::unique_lock<boost::mutex> lockit(lock_);
+	for (;;) {
+	    auto found = items_.find(id);
+	    if (found == items_.end()) {
+		last_error_ = "Block was not submitted";
+		return false;
+	    }
+	    it = found->second;
+	    if (it->state == PENDING) {
+		// Nobody has picked it up yet, so check it right here
+		queue_.erase(std::remove(queue_.begin(), queue_.end(), it), queue_.end());
+		it->state = CHECKING;
+		lockit.unlock();
+		check(*it);
+		lockit.lock();
+		continue;
+	    }
+	    if (it->state == CHECKING) {
+		done_cv_.wait(lockit);
+		continue;
+	    }
+	    items_.erase(found);
+	    break;
+	}
+    }
+
+    std::unique_ptr<item> owned(it);
+
+    if (it->state == INVALID) {
+	last_error_ = it->error;
+	return false;
+    }
+
+    // Executing on the global interpreter is strictly sequential
+    try {
+	global_.setup_commit(it->meta);
+	if (!global_.execute_commit(it->goals, *it->env, it->goals_term)) {
+	    last_error_ = "Block goals failed";
+	    return false;
+	}
+    } catch (std::runtime_error &ex) {
+	global_.discard();
+	last_error_ = ex.what();
+	return false;
+    }
+    return true;
+}
+
+void block_pipeline::run_worker()
+{
+    boost::unique_lock<boost::mutex> lockit(lock_);
+    for (;;) {
+	while (!stop_ && queue_.empty()) {
+	    work_cv_.wait(lockit);
+	}
+	if (stop_) {
+	    return;
+	}
+	auto *it = queue_.front();
+	queue_.pop_front();
+	it->state = CHECKING;
+	lockit.unlock();
+	check(*it);
+	lockit.lock();
+    }
+}
+
+//
+// Runs without the lock, only touches the item itself.
+//
+void block_pipeline::check(item &it)
+{
+    state_t state = CHECKED;
+    std::string error;
+
+    std::unique_ptr<term_env> env(new term_env());
+    term goals_term;
+    try {
+	term_serializer ser(*env);
+	ser.read(it.meta);
+	goals_term = ser.read(it.goals);
+    } catch (std::exception &ex) {
+	state = INVALID;
+	error = std::string("Malformed block: ") + ex.what();
+	env = nullptr;
+    }
+
+    boost::unique_lock<boost::mutex> lockit(lock_);
+    it.env = std::move(env);
+    it.goals_term = goals_term;
+    it.error = error;
+    it.state = state;
+    done_cv_.notify_all();
+}
+
+}}
@@ -0,0 +1,115 @@
+#pragma once
+
+#ifndef _global_block_pipeline_hpp
+#define _global_block_pipeline_hpp
+
+#include <boost/thread.hpp>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "../common/term_env.hpp"
+#include "../common/term_serializer.hpp"
+#include "../common/utime.hpp"
+#include "meta_entry.hpp"
+
+namespace prologcoin { namespace global {
+
+class global;
+
+//
+// block_pipeline. When syncing, blocks arrive (often out of order)
+// long before they can be executed on the global interpreter. Once
+// submitted, a block is deserialized on a worker thread (into a term
+// environment of its own) while the global interpreter keeps executing
+// earlier blocks. Executing a block then only needs to wait for the
+// worker and copy its goals over, not read the block again. (The PoW
+// of the meta entry was validated when it was added to the chain.)
+//
+// The number of blocks in flight is bounded; submit() refuses new
+// blocks when the pipeline is full (back-pressure) and the caller falls
+// back to commit them directly. Blocks that no longer follow the tip
+// (after a switch) are dropped, and so are blocks that have waited
+// longer than max_age() when room is needed.
+//
+class block_pipeline : private boost::noncopyable {
+public:
+    using buffer_t = common::term_serializer::buffer_t;
+
+    static const size_t DEFAULT_NUM_WORKERS = 2;
+    static const size_t DEFAULT_MAX_PENDING = 64;
+    static const uint64_t DEFAULT_MAX_AGE = 600000000; // 10 minutes (in us)
+
+    block_pipeline(global &g, size_t num_workers = DEFAULT_NUM_WORKERS,
+		   size_t max_pending = DEFAULT_MAX_PENDING);
+    ~block_pipeline();
+
+    // Queue a block for checking. Returns false if the pipeline is
+    // full or the block is already there.
+    bool submit(const meta_entry &entry, const buffer_t &meta,
+		const buffer_t &goals);
+
+    bool has_block(const meta_id &id) const;
+
+    // Wait for the checks of the given block, then execute it on the
+    // global interpreter. On failure the global state is rolled back
+    // to before the block (and the block is dropped from the pipeline.)
+    // Returns false if the block was never submitted or if it failed.
+    bool commit(const meta_id &id);
+
+    // Drop a block (e.g. if it turned out to be on a different branch.)
+    void drop(const meta_id &id);
+
+    // Drop all blocks that don't descend from 'tip'.
+    void drop_unreachable(const meta_id &tip);
+
+    void clear();
+
+    size_t num_pending() const;
+
+    inline uint64_t max_age() const { return max_age_; }
+    inline void set_max_age(uint64_t us) { max_age_ = us; }
+
+    inline const std::string & last_error() const {
+	return last_error_;
+    }
+
+private:
+    enum state_t { PENDING, CHECKING, CHECKED, INVALID };
+
+    struct item {
+	meta_entry entry;
+	buffer_t meta;
+	buffer_t goals;
+	common::utime submitted;
+	state_t state;
+	std::string error;
+
+	// Set by check()
+	std::unique_ptr<common::term_env> env;
+	common::term goals_term;
+    };
+
+    void run_worker();
+    void check(item &it);
+    void drop_expired(boost::unique_lock<boost::mutex> &lockit);
+    void erase(boost::unique_lock<boost::mutex> &lockit, const meta_id &id);
+
+    global &global_;
+    size_t max_pending_;
+    uint64_t max_age_;
+
+    mutable boost::mutex lock_;
+    boost::condition_variable work_cv_;
+    boost::condition_variable done_cv_;
+    std::map<meta_id, item *> items_;
+    std::deque<item *> queue_;
+    bool stop_;
+    std::vector<boost::thread> workers_;
+
+    std::string last_error_;
+};
+
+}}
+
+#endif
@@ -10,15 +10,32 @@ namespace prologcoin { namespace global {
 
 blockchain::blockchain(const std::string &data_dir) :
     data_dir_(data_dir),
-    db_meta_dir_((boost::filesystem::path(data_dir_) / "db" / "meta").string()),
-    db_blocks_dir_((boost::filesystem::path(data_dir_) / "db" / "blocks").string()),
-    db_heap_dir_((boost::filesystem::path(data_dir_) / "db" / "heap").string()),
-    db_closure_dir_((boost::filesystem::path(data_dir_) / "db" / "closure").string()),
-    db_symbols_dir_((boost::filesystem::path(data_dir_) / "db" / "symbols").string()),
-    db_program_dir_((boost::filesystem::path(data_dir_) / "db" / "program").string()) {
+    db_storage_dir_((boost::filesystem::path(data_dir_) / "db" / "store").string()) {
+   check_db_layout();
    init();
 }
 
+void blockchain::check_db_layout() const
+{
+    // Before triedb_1.2 every database had its own directory. Those
+    // can't be read by the shared storage, so rather than silently
+    // starting a new chain next to them, refuse to start.
+    static const char *OLD_DIRS[] = { "meta", "blocks", "heap", "closure",
+				      "symbols", "program" };
+    auto db_dir = boost::filesystem::path(data_dir_) / "db";
+    for (auto *name : OLD_DIRS) {
+	auto old_dir = db_dir / name;
+	boost::system::error_code ec;
+	if (boost::filesystem::is_directory(old_dir, ec)) {
+	    throw db::triedb_version_exception(
+		  "Found databases in the old format (one directory per "
+		  "database) at " + old_dir.string() + "; this version keeps "
+		  "all databases in " + db_storage_dir_ + " and cannot read "
+		  "them. Remove " + db_dir.string() + " to resync the chain.");
+	}
+    }
+}
+
 void blockchain::update_meta_id()
 {
     blake2b_state s;
@@ -101,6 +118,7 @@ void blockchain::init()
     db_closure_ = nullptr;
     db_symbols_ = nullptr;
     db_program_ = nullptr;
+    db_storage_ = nullptr;
     
     tip_ = meta_entry();
     at_height_.clear();
@@ -219,12 +237,8 @@ std::set<meta_id> blockchain::find_entries(size_t height, const uint8_t *prefix,
 }
 
 void blockchain::flush_db() {
-    blocks_db().flush();
-    heap_db().flush();
-    closure_db().flush();
-    symbols_db().flush();
-    program_db().flush();
-    meta_db().flush();
+    // Flushes all databases (data first, then the roots)
+    get_db_storage().flush();
 }
 
 void blockchain::advance() {
@@ -40,38 +40,50 @@ public:
     void add_meta_entry(meta_entry &e);
     void update_meta_entry(const meta_entry &e);
 
+    // All databases share one storage, so that a single flush makes
+    // them all durable (one sync for the data, one for the roots.)
+    inline db::triedb_storage & get_db_storage() const {
+        if (db_storage_.get() == nullptr) {
+	    // Never let a root reach the disk before the data it refers to
+	    db::triedb_params params;
+	    params.set_ordered_durability(true);
+	    db_storage_ = std::unique_ptr<db::triedb_storage>(new db::triedb_storage(params, db_storage_dir_));
+	}
+	return *db_storage_.get();
+    }
+
     inline db::triedb & get_db_instance(std::unique_ptr<db::triedb> &var,
-					const std::string &dir) const {
+					uint32_t db_index) const {
         if (var.get() == nullptr) {
-	    var = std::unique_ptr<db::triedb>(new db::triedb(dir));
+	    var = std::unique_ptr<db::triedb>(new db::triedb(get_db_storage(), db_index));
         }
 	return *var.get();
     }
 
     inline db::triedb & meta_db() {
-        return get_db_instance(db_meta_, db_meta_dir_);
+        return get_db_instance(db_meta_, DB_INDEX_META);
     }
     inline db::triedb & blocks_db() {
-	return get_db_instance(db_blocks_, db_blocks_dir_);
+	return get_db_instance(db_blocks_, DB_INDEX_BLOCKS);
     }
     inline db::triedb & heap_db() {
-	return get_db_instance(db_heap_, db_heap_dir_);
+	return get_db_instance(db_heap_, DB_INDEX_HEAP);
     }
     inline db::triedb & closure_db() {
-        return get_db_instance(db_closure_, db_closure_dir_);
+        return get_db_instance(db_closure_, DB_INDEX_CLOSURE);
     }
     inline const db::triedb & closure_db() const {
-        return get_db_instance(db_closure_, db_closure_dir_);
+        return get_db_instance(db_closure_, DB_INDEX_CLOSURE);
     }    
     inline db::triedb & symbols_db() {
-        return get_db_instance(db_symbols_, db_symbols_dir_);      
+        return get_db_instance(db_symbols_, DB_INDEX_SYMBOLS);
     }
 
     inline db::triedb & program_db() {
-        return get_db_instance(db_program_, db_program_dir_);
+        return get_db_instance(db_program_, DB_INDEX_PROGRAM);
     }
     inline const db::triedb & program_db() const {
-        return get_db_instance(db_program_, db_program_dir_);
+        return get_db_instance(db_program_, DB_INDEX_PROGRAM);
     }    
 
     inline db_root_id heap_root() const {
@@ -180,17 +192,23 @@ public:
     }
 
 private:
+    void check_db_layout() const;
     void update_meta_id();
 
     std::string data_dir_;
 
-    std::string db_meta_dir_;
-    std::string db_blocks_dir_;
-    std::string db_heap_dir_;
-    std::string db_closure_dir_;
-    std::string db_symbols_dir_;  
-    std::string db_program_dir_;
+    // Database indices within the shared storage (these are persisted.)
+    static const uint32_t DB_INDEX_META = 0;
+    static const uint32_t DB_INDEX_BLOCKS = 1;
+    static const uint32_t DB_INDEX_HEAP = 2;
+    static const uint32_t DB_INDEX_CLOSURE = 3;
+    static const uint32_t DB_INDEX_SYMBOLS = 4;
+    static const uint32_t DB_INDEX_PROGRAM = 5;
+
+    std::string db_storage_dir_;
 
+    // Must be declared before (i.e. destroyed after) the databases
+    mutable std::unique_ptr<db::triedb_storage> db_storage_;
     mutable std::unique_ptr<db::triedb> db_meta_;
     mutable std::unique_ptr<db::triedb> db_blocks_;
     mutable std::unique_ptr<db::triedb> db_heap_;
@@ -24,6 +24,9 @@ void builtins::load(interpreter_base &interp, con_cell *module0)
 
     interp.load_builtin(M, interp.functor("increment_height", 0), &builtins::increment_height_0);
 
+    interp.load_builtin(M, interp.functor("frozen_by_address", 4), &builtins::frozen_by_address_4);
+    interp.load_builtin(M, interp.functor("closure_filters", 3), &builtins::closure_filters_3);
+
     interp.load_builtin(con_cell("ref",2), builtin(&builtins::ref_2));
 }
 
@@ -92,4 +95,82 @@ bool builtins::increment_height_0(interpreter_base &interp, size_t arity, term a
     return true;
 }
 
+bool builtins::frozen_by_address_4(interpreter_base &interp, size_t arity, term args[] ) {
+    static const con_cell HEIGHT("height", 1);
+
+    if (!interp.is_list(args[0])) {
+        throw interpreter_exception_wrong_arg_type(
+	   "frozen_by_address/4: First argument, Addresses, must be a list; was " + interp.to_string(args[0]));
+    }
+    std::vector<term> addresses;
+    for (term lst = args[0]; interp.is_dotted_pair(lst); lst = interp.arg(lst, 1)) {
+	addresses.push_back(interp.arg(lst, 0));
+    }
+
+    auto &g = get_global(interp);
+    term since_term = args[1];
+    if (since_term.tag() == tag_t::STR && interp.functor(since_term) == HEIGHT) {
+	since_term = interp.arg(since_term, 0);
+	if (since_term.tag() != tag_t::INT || reinterpret_cast<int_cell &>(since_term).value() < 0) {
+	    throw interpreter_exception_wrong_arg_type(
+	       "frozen_by_address/4: Height must be a non-negative integer; was " + interp.to_string(since_term));
+	}
+	since_term = int_cell(static_cast<int64_t>(g.heap_size_at(static_cast<size_t>(reinterpret_cast<int_cell &>(since_term).value()))));
+    }
+    if (since_term.tag() != tag_t::INT || reinterpret_cast<int_cell &>(since_term).value() < 0) {
+        throw interpreter_exception_wrong_arg_type(
+	   "frozen_by_address/4: Second argument, Since, must be a heap address or height(H); was " + interp.to_string(args[1]));
+    }
+    size_t since = static_cast<size_t>(reinterpret_cast<int_cell &>(since_term).value());
+
+    std::vector<std::pair<size_t, term> > closures;
+    uint64_t cost = 0;
+    g.interp().get_frozen_closures_by_address(addresses, since, closures, cost);
+    interp.add_cost(cost);
+
+    term addrs = interpreter_base::EMPTY_LIST;
+    term cls = interpreter_base::EMPTY_LIST;
+    for (auto it = closures.rbegin(); it != closures.rend(); ++it) {
+	addrs = interp.new_dotted_pair(int_cell(static_cast<int64_t>(it->first)), addrs);
+	cls = interp.new_dotted_pair(it->second, cls);
+    }
+    return interp.unify(args[2], addrs) && interp.unify(args[3], cls);
+}
+
+bool builtins::closure_filters_3(interpreter_base &interp, size_t arity, term args[] ) {
+    static const size_t MAX_FILTERS = 1000;
+    static const con_cell FILTER("filter", 4);
+    static const con_cell NONE("none", 0);
+
+    for (size_t i = 0; i < 2; i++) {
+	if (args[i].tag() != tag_t::INT || reinterpret_cast<int_cell &>(args[i]).value() < 0) {
+	    throw interpreter_exception_wrong_arg_type(
+	       "closure_filters/3: Heights must be non-negative integers; was " + interp.to_string(args[i]));
+	}
+    }
+    size_t from = static_cast<size_t>(reinterpret_cast<int_cell &>(args[0]).value());
+    size_t to = static_cast<size_t>(reinterpret_cast<int_cell &>(args[1]).value());
+    if (to >= from + MAX_FILTERS) {
+	to = from + MAX_FILTERS - 1;
+    }
+
+    std::vector<global::closure_filter> filters;
+    get_global(interp).db_get_closure_filters(from, to, filters);
+
+    term lst = interpreter_base::EMPTY_LIST;
+    for (auto it = filters.rbegin(); it != filters.rend(); ++it) {
+	term data = NONE;
+	if (it->has_filter) {
+	    data = interp.new_big(&it->data[0], it->data.size());
+	}
+	term f = interp.new_term(FILTER,
+				 { int_cell(static_cast<int64_t>(it->height)),
+				   int_cell(static_cast<int64_t>(it->heap_start)),
+				   int_cell(static_cast<int64_t>(it->heap_end)),
+				   data });
+	lst = interp.new_dotted_pair(f, lst);
+    }
+    return interp.unify(args[2], lst);
+}
+
 }}
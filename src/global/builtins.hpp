@@ -26,6 +26,17 @@ public:
 
     static bool increment_height_0(interpreter_base &interp, size_t arity, term args[] );
 
+    // frozen_by_address(+Addresses, +Since, -HeapAddrs, -Closures)
+    // The tx1 closures paying to any of Addresses with heap address
+    // Since or above. Since can also be height(H) for the closures
+    // created after the block at height H.
+    static bool frozen_by_address_4(interpreter_base &interp, size_t arity, term args[] );
+
+    // closure_filters(+FromHeight, +ToHeight, -Filters)
+    // Filters is a list of filter(Height, HeapStart, HeapEnd, Data), where
+    // Data is the closure filter (a bignum) of the block, or none.
+    static bool closure_filters_3(interpreter_base &interp, size_t arity, term args[] );
+
     // ref(?X, ?HeapAddr)
     // We'll add a new predicate "test(on)", "test(off)" to toggle
     // global interpreter in testing mode. ref_2 will not be available
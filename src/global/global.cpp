@@ -33,6 +33,14 @@ bool global::set_tip(const meta_id &id)
     }
     blockchain_.set_tip(*entry);
 
+    if (goal_pool_) {
+	goal_pool_->invalidate_all();
+    }
+    if (pipeline_) {
+	pipeline_->drop_unreachable(id);
+    }
+    address_index_.invalidate();
+
     interp_ = nullptr;
     if (!blockchain_.tip().is_partial()) {
 	interp_ = std::unique_ptr<global_interpreter>(new global_interpreter(*this));
@@ -41,6 +49,19 @@ bool global::set_tip(const meta_id &id)
     return true;
 }
 	
+void global::set_block_cache_size(size_t bytes)
+{
+    block_cache_size_ = bytes;
+    if (interp_) {
+	interp_->set_block_cache_size(bytes);
+    }
+}
+
+void global::set_block_prefetch(size_t num_blocks)
+{
+    block_prefetch_ = num_blocks;
+}
+
 void global::erase_db(const std::string &data_dir)
 {
     auto dir_path = boost::filesystem::path(data_dir) / "db";
@@ -53,6 +74,7 @@ void global::erase_db(const std::string &data_dir)
 
 void global::total_reset() {
     interp_ = nullptr;
+    address_index_.invalidate();
     erase_db(data_dir_);
     blockchain_.init();
     interp_ = std::unique_ptr<global_interpreter>(new global_interpreter(*this));
@@ -185,6 +207,56 @@ void global::db_set_block(size_t height, const term_serializer::buffer_t &buf)
 				   &buf[0], buf.size());
 }
 
+void global::db_set_closure_filter(size_t height, const std::vector<uint8_t> &filter)
+{
+    blockchain_.blocks_db().update(blockchain_.blocks_root(),
+				   CLOSURE_FILTER_KEY + height,
+				   &filter[0], filter.size());
+}
+
+void global::db_get_closure_filters(size_t from_height, size_t to_height,
+				    std::vector<closure_filter> &filters)
+{
+    size_t top = current_height();
+    if (to_height > top) {
+	to_height = top;
+    }
+    if (from_height > to_height) {
+	return;
+    }
+
+    // Walk back once for the heap sizes (the block before from_height
+    // gives us where the first block started.)
+    size_t lowest = from_height == 0 ? 0 : from_height - 1;
+    std::vector<size_t> heap_sizes(to_height - lowest + 1, 0);
+    const meta_entry *entry = &blockchain_.tip();
+    while (entry != nullptr && entry->get_height() >= lowest) {
+	if (entry->get_height() <= to_height) {
+	    heap_sizes[entry->get_height() - lowest] = heap_size_of(*entry);
+	}
+	if (entry->get_height() == 0) {
+	    break;
+	}
+	entry = blockchain_.get_meta_entry(entry->get_previous_id());
+    }
+
+    auto &blocks_db = blockchain_.blocks_db();
+    auto root = blockchain_.blocks_root();
+    for (size_t height = from_height; height <= to_height; height++) {
+	closure_filter f;
+	f.height = height;
+	f.heap_start = height == 0 ? 0 : heap_sizes[height - 1 - lowest];
+	f.heap_end = heap_sizes[height - lowest];
+	auto leaf = blocks_db.find(root, CLOSURE_FILTER_KEY + height);
+	f.has_filter = leaf != nullptr;
+	if (leaf != nullptr) {
+	    f.data.assign(leaf->custom_data(),
+			  leaf->custom_data() + leaf->custom_data_size());
+	}
+	filters.push_back(f);
+    }
+}
+
 static term to_number(term_env &dst, uint64_t v)
 {
     static uint64_t limit = int_cell::max().value();
@@ -544,6 +616,36 @@ size_t global::current_height() const {
     return blockchain_.tip().get_height();
 }
 
+size_t global::heap_size_of(const meta_entry &e)
+{
+    auto &hdb = blockchain_.heap_db();
+    auto root = e.get_root_id_heap();
+    if (hdb.is_empty() || root.is_zero() || hdb.num_entries(root) == 0) {
+	return 0;
+    }
+    auto it = hdb.end(root);
+    --it;
+    if (it.at_end()) {
+	return 0;
+    }
+    auto &leaf = *it;
+    return leaf.key() * heap_block::MAX_SIZE
+	 + leaf.custom_data_size() / sizeof(cell);
+}
+
+size_t global::heap_size_at(size_t height)
+{
+    // The heap root of a block is the state after it
+    const meta_entry *entry = &blockchain_.tip();
+    while (entry->get_height() > height) {
+	entry = blockchain_.get_meta_entry(entry->get_previous_id());
+	if (entry == nullptr) {
+	    return 0;
+	}
+    }
+    return heap_size_of(*entry);
+}
+
 size_t global::max_height() const {
     return blockchain_.max_height();
 }
@@ -556,10 +658,15 @@ void global::increment_height()
     get_blockchain().set_time(commit_time_);
     get_blockchain().advance();
     interp().commit_heap();
+    std::vector<std::string> addresses;
+    interp().new_closure_addresses(addresses);
     interp().commit_closures();
     interp().commit_symbols();
     interp().commit_program();
     db_set_block(current_height(), commit_goals_);
+    std::vector<uint8_t> filter;
+    gcs_filter::build(current_height(), addresses, filter);
+    db_set_closure_filter(current_height(), filter);
     init_empty_goals();
     get_blockchain().update_tip();
 }
@@ -624,7 +731,38 @@ void global::setup_commit(const term_serializer::buffer_t &buf) {
 }
 
 bool global::execute_commit(const term_serializer::buffer_t &buf) {
-    if (!execute_goal_silent(buf)) {
+    return execute_commit(buf, nullptr, term());
+}
+
+bool global::execute_commit(const term_serializer::buffer_t &buf,
+			    term_env &src, term goals) {
+    return execute_commit(buf, &src, goals);
+}
+
+bool global::execute_commit(const term_serializer::buffer_t &buf,
+			    term_env *src, term goals) {
+    // Track what the block changes so that pending goals depending
+    // on it get checked again.
+    access_set access;
+    goal_pool::allocation alloc;
+    if (goal_pool_) {
+	alloc = goal_pool::snapshot_allocation(*interp_);
+	interp_->set_access_tracking(&access);
+    }
+    bool ok;
+    try {
+	if (src == nullptr) {
+	    ok = execute_goal_silent(buf);
+	} else {
+	    check_interp();
+	    ok = interp_->execute_goal(interp_->copy(goals, *src));
+	}
+    } catch (std::runtime_error &) {
+	interp_->set_access_tracking(nullptr);
+	throw;
+    }
+    interp_->set_access_tracking(nullptr);
+    if (!ok) {
 	discard();
 	return false;
     }
@@ -632,6 +770,10 @@ bool global::execute_commit(const term_serializer::buffer_t &buf) {
     assert(is_clean());
     commit_goals_ = buf;
     advance();
+
+    if (goal_pool_) {
+	goal_pool_->committed(buf, access, alloc);
+    }
     
     return true;
 }
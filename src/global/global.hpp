@@ -7,10 +7,14 @@
 #include "../common/term_serializer.hpp"
 #include "../common/fast_hash.hpp"
 #include "../common/checked_cast.hpp"
+#include "../common/gcs_filter.hpp"
 #include "../db/triedb.hpp"
 #include "../db/util.hpp"
 #include "global_interpreter.hpp"
 #include "blockchain.hpp"
+#include "block_pipeline.hpp"
+#include "goal_pool.hpp"
+#include "address_index.hpp"
 #include <unordered_map>
 
 namespace prologcoin { namespace global {
@@ -45,15 +49,32 @@ private:
     static const size_t GB = 1024*MB;
 
     bool pow_check_{true};
+    size_t block_cache_size_{BLOCK_CACHE_SIZE};
+    size_t block_prefetch_{BLOCK_PREFETCH};
 
 public:
+    // Default budget for cached (unmodified) heap blocks
     static const size_t BLOCK_CACHE_SIZE = 4*GB;
+    // Default number of heap blocks loaded ahead on sequential misses
+    static const size_t BLOCK_PREFETCH = 8;
 
     inline const std::string & data_dir() { return data_dir_; }
 
     inline bool check_pow() const {
 	return pow_check_;
     }
+
+    // Memory budget (in bytes) for the heap block cache of the global
+    // interpreter. Takes effect immediately.
+    inline size_t block_cache_size() const {
+	return block_cache_size_;
+    }
+    void set_block_cache_size(size_t bytes);
+
+    inline size_t block_prefetch() const {
+	return block_prefetch_;
+    }
+    void set_block_prefetch(size_t num_blocks);
     
     inline void set_check_pow(bool b) {
 	pow_check_ = b;
@@ -114,6 +135,35 @@ public:
 
     void setup_commit(const buffer_t &buf);
     bool execute_commit(const buffer_t &buf);
+    // Same, but the goals of 'buf' have already been deserialized
+    // into 'src' (e.g. by the block pipeline.)
+    bool execute_commit(const buffer_t &buf, common::term_env &src,
+			common::term goals);
+
+    // Blocks that are checked ahead of execution (when syncing)
+    inline block_pipeline & pipeline() {
+	if (!pipeline_) {
+	    pipeline_ = std::unique_ptr<block_pipeline>(new block_pipeline(*this));
+	}
+	return *pipeline_;
+    }
+
+    // Pending goals checked ahead of commit
+    inline goal_pool & pending_goals() {
+	if (!goal_pool_) {
+	    goal_pool_ = std::unique_ptr<goal_pool>(new goal_pool(*this));
+	}
+	return *goal_pool_;
+    }
+
+    // Address to frozen closures (for wallets)
+    inline address_index & addresses() {
+	return address_index_;
+    }
+
+    // Heap size after the block at the given height (of the current
+    // chain.)
+    size_t heap_size_at(size_t height);
 
     inline void execute_cut() {
 	check_interp();
@@ -169,6 +219,26 @@ public:
 	return block;
     }
 
+    // Load up to n consecutive heap blocks starting at block_index
+    // (stops at the first one missing.) One trie walk for all of them.
+    void db_get_heap_blocks(size_t block_index, size_t n,
+			    std::vector<common::heap_block *> &blocks) {
+	auto &heap_db = blockchain_.heap_db();
+	auto root = blockchain_.heap_root();
+	auto it = heap_db.begin(root, block_index);
+	auto it_end = heap_db.end(root);
+	for (size_t i = 0; i < n && it != it_end; ++it, i++) {
+	    auto &leaf = *it;
+	    if (leaf.key() != block_index + i) {
+		break;
+	    }
+	    auto *block = new common::heap_block(env(), block_index + i);
+	    custom_data_to_heap_block(leaf.custom_data(),
+				      leaf.custom_data_size(), *block);
+	    blocks.push_back(block);
+	}
+    }
+
     void db_set_heap_block(size_t block_index, common::heap_block *block) {
 	uint8_t custom_data[common::heap_block::MAX_SIZE*sizeof(common::cell)];
 	size_t custom_data_size = 0;
@@ -379,6 +449,27 @@ public:
     term db_get_block(common::term_env &dst, const meta_entry &e, bool raw);
     void db_set_block(size_t height, const buffer_t &buf);
 
+    //
+    // Closure filters. A Golomb-coded set (keyed by height) of the
+    // addresses paid to by the closures a block froze. Light wallets
+    // test their own addresses against these and fetch the closures
+    // of the matching blocks only. Kept in the blocks database (at
+    // CLOSURE_FILTER_KEY + height), next to the block.
+    //
+    static const uint64_t CLOSURE_FILTER_KEY = static_cast<uint64_t>(1) << 32;
+
+    struct closure_filter {
+	size_t height;
+	size_t heap_start; // Heap size before the block
+	size_t heap_end;   // Heap size after the block
+	bool has_filter;   // Blocks from before filters have none
+	std::vector<uint8_t> data;
+    };
+
+    void db_set_closure_filter(size_t height, const std::vector<uint8_t> &filter);
+    void db_get_closure_filters(size_t from_height, size_t to_height,
+				std::vector<closure_filter> &filters);
+
     term db_get_meta(common::term_env &dst, const meta_id &id, bool more);
     size_t db_get_meta_length(const meta_id &root_id, size_t lookahead_n);
     term db_get_meta_roots(common::term_env &dst, const meta_id &id, size_t spacing, size_t n);
@@ -389,6 +480,9 @@ public:
     bool db_parse_meta(common::term_env &src, common::term meta_term, meta_entry &out);
 
 private:
+    bool execute_commit(const buffer_t &buf, common::term_env *src,
+			common::term goals);
+
     void custom_data_to_heap_block(const uint8_t *custom_data,
 				   size_t custom_data_size,
 				   common::heap_block &blk) {
@@ -415,6 +509,8 @@ private:
 
     void init();
 
+    size_t heap_size_of(const meta_entry &e);
+
     std::string data_dir_;
     blockchain blockchain_;
     std::unique_ptr<global_interpreter> interp_;
@@ -423,6 +519,9 @@ private:
     uint64_t commit_nonce_;
     common::utime commit_time_;
     buffer_t commit_goals_;
+    std::unique_ptr<block_pipeline> pipeline_;
+    std::unique_ptr<goal_pool> goal_pool_;
+    address_index address_index_;
 };
 
 }}
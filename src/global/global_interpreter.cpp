@@ -10,20 +10,29 @@ using namespace prologcoin::interp;
 
 namespace prologcoin { namespace global {
 
+static size_t block_cache_capacity(size_t bytes)
+{
+    // Always room for at least a few blocks
+    return std::max(static_cast<size_t>(4), bytes / heap_block::MAX_SIZE / sizeof(cell));
+}
+
 global_interpreter::global_interpreter(global &g)
     : interp::interpreter("global"),
       global_(g),
       current_block_index_(static_cast<size_t>(-2)),
       current_block_(nullptr),
       block_flusher_(),
-      block_cache_(global::BLOCK_CACHE_SIZE / heap_block::MAX_SIZE / sizeof(cell), block_flusher_),
+      block_cache_(block_cache_capacity(g.block_cache_size()), block_flusher_),
+      last_miss_index_(static_cast<size_t>(-2)),
+      num_prefetched_(0),
       new_predicates_(0),
       new_frozen_closures_(0),
       old_heap_size_(0),
       next_atom_id_(0),
       start_next_atom_id_(0),
       next_predicate_id_(0),
-      start_next_predicate_id_(0)
+      start_next_predicate_id_(0),
+      access_(nullptr)
 {
     set_auto_wam(true);
 }
@@ -380,15 +389,90 @@ void global_interpreter::load_atom_index(const std::string &name)
     }
 }
 
+static bool intersects(const std::unordered_set<size_t> &a,
+		       const std::unordered_set<size_t> &b)
+{
+    auto &small = a.size() < b.size() ? a : b;
+    auto &large = a.size() < b.size() ? b : a;
+    for (auto x : small) {
+	if (large.count(x)) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+bool access_set::conflicts_with(const access_set &other) const
+{
+    return intersects(written_blocks, other.read_blocks) ||
+	   intersects(written_blocks, other.written_blocks) ||
+	   intersects(read_blocks, other.written_blocks) ||
+	   intersects(written_closures, other.read_closures) ||
+	   intersects(written_closures, other.written_closures) ||
+	   intersects(read_closures, other.written_closures);
+}
+
 heap_block * global_interpreter::db_get_heap_block(size_t block_index) {
+    // Two misses in a row on adjacent blocks: assume a sequential
+    // traversal (e.g. a long list) and load the blocks ahead of it.
+    // Do it before inserting the requested block so it can't be
+    // evicted by the prefetched ones.
+    if (block_index == last_miss_index_ + 1) {
+	prefetch_heap_blocks(block_index + 1);
+    }
+    last_miss_index_ = block_index;
+
     common::heap_block *block = get_global().db_get_heap_block(block_index);
     block_cache_.insert(block_index, block);
     current_block_ = block;
     return block;
 }
 
+void global_interpreter::prefetch_heap_blocks(size_t block_index) {
+    size_t n = std::min(get_global().block_prefetch(), block_cache_.capacity() / 4);
+    if (heap_size() == 0 || block_index > last_block_index()) {
+	return;
+    }
+    n = std::min(n, last_block_index() - block_index + 1);
+    if (n == 0) {
+	return;
+    }
+    std::vector<heap_block *> blocks;
+    get_global().db_get_heap_blocks(block_index, n, blocks);
+    for (auto *block : blocks) {
+	auto index = block->index();
+	if (modified_blocks_.count(index) || block_cache_.contains(index)) {
+	    delete block;
+	    continue;
+	}
+	block_cache_.insert(index, block);
+	num_prefetched_++;
+    }
+}
+
+void global_interpreter::set_block_cache_size(size_t bytes) {
+    block_cache_.set_capacity(block_cache_capacity(bytes));
+}
+
+global_interpreter::block_cache_stats global_interpreter::get_block_cache_stats() const {
+    block_cache_stats stats;
+    stats.hits = block_cache_.hits();
+    stats.misses = block_cache_.misses();
+    stats.evictions = block_cache_.evictions();
+    stats.prefetched = num_prefetched_;
+    stats.size = block_cache_.size();
+    stats.capacity = block_cache_.capacity();
+    return stats;
+}
+
+void global_interpreter::reset_block_cache_stats() {
+    block_cache_.reset_stats();
+    num_prefetched_ = 0;
+}
+
 term global_interpreter::get_frozen_closure(size_t addr)
 {
+    if (access_) access_->read_closures.insert(addr);
     auto it = modified_closures_.find(addr);
     if (it != modified_closures_.end()) {
 	return it->second;
@@ -403,6 +487,7 @@ void global_interpreter::clear_frozen_closure(size_t addr)
 	return;
     }
     internal_clear_frozen_closure(addr);
+    if (access_) access_->written_closures.insert(addr);
 
     // Check if frozen closure is in modified list, then remove it
     auto it = modified_closures_.find(addr);
@@ -419,6 +504,7 @@ void global_interpreter::clear_frozen_closure(size_t addr)
 void global_interpreter::set_frozen_closure(size_t addr, term closure)
 {
     internal_set_frozen_closure(addr, closure);
+    if (access_) access_->written_closures.insert(addr);
     modified_closures_[addr] = closure;
     new_frozen_closures_++;
 }
@@ -543,14 +629,82 @@ void global_interpreter::commit_symbols()
     new_atoms_.clear();
 }
 
+void global_interpreter::get_frozen_closures_by_address(
+			     const std::vector<term> &addresses,
+			     size_t since,
+			     std::vector<std::pair<size_t,term> > &closures,
+			     uint64_t &cost)
+{
+    // Normally built at commit; only a tip not committed to by this
+    // node needs a build here.
+    auto &index = get_global().addresses();
+    if (!index.is_built()) {
+	index.build(*this);
+    }
+
+    std::unordered_set<address_index::key_t> keys;
+    for (auto address : addresses) {
+	keys.insert(address_index::key_of(*this, address));
+    }
+    std::vector<address_index::key_t> key_list(keys.begin(), keys.end());
+
+    std::vector<size_t> heap_addrs;
+    index.find(key_list, since, heap_addrs);
+
+    // Not yet committed closures aren't in the index
+    const auto none = term();
+    for (auto it = modified_closures_.lower_bound(since);
+	 it != modified_closures_.end(); ++it) {
+	if (it->second != none) {
+	    heap_addrs.push_back(it->first);
+	}
+    }
+
+    std::sort(heap_addrs.begin(), heap_addrs.end());
+    heap_addrs.erase(std::unique(heap_addrs.begin(), heap_addrs.end()),
+		     heap_addrs.end());
+
+    cost += addresses.size() + heap_addrs.size();
+    for (auto addr : heap_addrs) {
+	term closure = get_frozen_closure(addr);
+	term address;
+	if (closure != EMPTY_LIST &&
+	    address_index::address_of(*this, closure, address) &&
+	    keys.count(address_index::key_of(*this, address))) {
+	    closures.push_back(std::make_pair(addr, closure));
+	    cost += interpreter_base::cost(closure);
+	}
+    }
+}
+
+void global_interpreter::new_closure_addresses(std::vector<std::string> &keys)
+{
+    const auto none = term();
+    for (auto &cl : modified_closures_) {
+	term address;
+	if (cl.second != none &&
+	    address_index::address_of(*this, cl.second, address)) {
+	    keys.push_back(address_index::key_of(*this, address));
+	}
+    }
+}
+
 void global_interpreter::commit_closures()
 {
     const auto none = term();
+    auto &index = get_global().addresses();
+    if (!index.is_built() && !modified_closures_.empty()) {
+	// Build it here (before the new closures are in the database)
+	// so that lookups don't have to.
+	index.build(*this);
+    }
     for (auto &cl : modified_closures_) {
 	if (cl.second == none) {
 	    get_global().db_remove_closure(cl.first);
+	    if (index.is_built()) index.remove(cl.first);
 	} else {
 	    get_global().db_set_closure(cl.first, cl.second);
+	    if (index.is_built()) index.add(*this, cl.first, cl.second);
 	}
     }
     modified_closures_.clear();
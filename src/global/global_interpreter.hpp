@@ -8,6 +8,7 @@
 #include "../interp/interpreter.hpp"
 #include "../db/util.hpp"
 #include "../db/triedb.hpp"
+#include <unordered_set>
 
 namespace prologcoin { namespace global {
 
@@ -35,6 +36,29 @@ public:
 
 class global;
 
+//
+// The heap blocks and frozen closures a goal (transaction) read and
+// wrote. Two transactions whose access sets do not conflict touch
+// disjoint state, i.e. their relative order does not matter for
+// anything but the heap addresses they allocate.
+//
+struct access_set {
+    std::unordered_set<size_t> read_blocks;
+    std::unordered_set<size_t> written_blocks;
+    std::unordered_set<size_t> read_closures;
+    std::unordered_set<size_t> written_closures;
+
+    inline void clear() {
+	read_blocks.clear();
+	written_blocks.clear();
+	read_closures.clear();
+	written_closures.clear();
+    }
+
+    // True if one writes something the other reads or writes.
+    bool conflicts_with(const access_set &other) const;
+};
+
 class global_interpreter : public interp::interpreter {
 public:
     friend class global;
@@ -62,6 +86,10 @@ public:
     void commit_program();
     void commit_closures();
 
+    // Keys (see address_index) of the addresses paid to by the closures
+    // frozen since the last commit.
+    void new_closure_addresses(std::vector<std::string> &keys);
+
     virtual size_t num_predicates() const override;
     size_t num_symbols();
     virtual size_t num_frozen_closures() const override;
@@ -72,6 +100,16 @@ public:
 				     size_t max_clousres,
 	     std::vector<std::pair<size_t, term> > &closures) override;
 
+    // Closures (at heap address since and above) paying to any of
+    // the given addresses, in heap address order. Uses the address
+    // index of global. cost is the work done for the lookup (the
+    // candidates scanned and the closures returned), which only
+    // depends on the state, not on whether the index had to be built.
+    void get_frozen_closures_by_address(const std::vector<term> &addresses,
+					size_t since,
+	     std::vector<std::pair<size_t, term> > &closures,
+	     uint64_t &cost);
+
     virtual void updated_predicate_pre(const interp::qname &qn) override {
 	auto p = internal_get_predicate(qn);
 	if (p) {
@@ -110,6 +148,28 @@ public:
         return current_block_index_;
     }
   
+    void set_block_cache_size(size_t bytes);
+
+    struct block_cache_stats {
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+	size_t prefetched;
+	size_t size;
+	size_t capacity;
+    };
+    block_cache_stats get_block_cache_stats() const;
+    void reset_block_cache_stats();
+
+    // Record accessed heap blocks and closures into 'access' (or stop
+    // recording if nullptr.)
+    inline void set_access_tracking(access_set *access) {
+	access_ = access;
+	if (access_ && current_block_ != nullptr) {
+	    access_->read_blocks.insert(current_block_index_);
+	}
+    }
+
     static void setup_consensus_lib(interpreter &interp);
   
     inline void set_naming(bool b) { naming_ = b; }
@@ -197,6 +257,8 @@ private:
 
     inline void modified_heap_block(common::heap_block &block)
     {
+	if (access_) access_->written_blocks.insert(block.index());
+
         // Won't delete block because of "changed" flag
         block_cache_.erase(block.index());
 
@@ -207,6 +269,7 @@ private:
     void discard_changes();
 
     common::heap_block * db_get_heap_block(size_t block_index);
+    void prefetch_heap_blocks(size_t block_index);
 
     inline common::heap_block & get_heap_block(size_t block_index)
     {
@@ -221,6 +284,7 @@ private:
 	        new_block_index = num_blocks();
 	    }
   	    auto *new_block = new common::heap_block(*this, new_block_index);
+	    if (access_) access_->written_blocks.insert(new_block_index);
 	    modified_blocks_.insert(std::make_pair(new_block_index, new_block));
 	    set_head_block(new_block);
 	    current_block_ = new_block;
@@ -228,6 +292,7 @@ private:
 	    return *new_block;
         }
 	current_block_index_ = block_index;
+	if (access_) access_->read_blocks.insert(block_index);
 	auto hsz = heap_size();
 	bool is_head = hsz == 0 ? 0 : find_block_index(hsz - 1) == block_index;
         auto it = modified_blocks_.find(block_index);
@@ -265,6 +330,8 @@ private:
     };
     block_flusher block_flusher_;
     common::lru_cache<size_t, common::heap_block *, block_flusher> block_cache_;
+    size_t last_miss_index_;
+    size_t num_prefetched_;
 
     std::unordered_map<size_t, common::heap_block *> modified_blocks_;
  
@@ -284,6 +351,8 @@ private:
 
     size_t next_predicate_id_;
     size_t start_next_predicate_id_;
+
+    access_set *access_;
 };
 
 }}
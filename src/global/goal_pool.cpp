@@ -0,0 +1,270 @@
+#include "../common/term_env.hpp"
+#include "../common/sha256.hpp"
+#include "goal_pool.hpp"
+#include "global.hpp"
+
+using namespace prologcoin::common;
+
+namespace prologcoin { namespace global {
+
+goal_pool::goal_pool(global &g, size_t max_size)
+    : global_(g),
+      max_size_(max_size),
+      dry_run_cost_(DEFAULT_DRY_RUN_COST),
+      next_seq_(0),
+      num_dry_runs_(0),
+      num_reused_(0),
+      num_invalidated_(0)
+{
+}
+
+goal_pool::key_t goal_pool::key_of(const buffer_t &goal)
+{
+    sha256 h;
+    h.update(goal.data(), goal.size());
+    return h.finalize();
+}
+
+goal_pool::allocation goal_pool::snapshot_allocation(global_interpreter &interp)
+{
+    allocation alloc;
+    alloc.heap_size = interp.heap_size();
+    alloc.block = alloc.heap_size == 0 ? 0 : (alloc.heap_size - 1) / heap_block::MAX_SIZE;
+    size_t from = alloc.block * heap_block::MAX_SIZE;
+    alloc.cells.reserve(alloc.heap_size - from);
+    for (size_t addr = from; addr < alloc.heap_size; addr++) {
+	alloc.cells.push_back(interp.heap_get(addr).raw_value());
+    }
+    return alloc;
+}
+
+void goal_pool::strip_allocation(access_set &access, const allocation &alloc,
+				 global_interpreter &interp)
+{
+    for (auto it = access.read_blocks.begin(); it != access.read_blocks.end();) {
+	if (*it > alloc.block) it = access.read_blocks.erase(it); else ++it;
+    }
+    for (auto it = access.written_blocks.begin(); it != access.written_blocks.end();) {
+	if (*it > alloc.block) it = access.written_blocks.erase(it); else ++it;
+    }
+    if (!access.written_blocks.count(alloc.block)) {
+	return;
+    }
+    // Only appended to?
+    size_t from = alloc.block * heap_block::MAX_SIZE;
+    for (size_t i = 0; i < alloc.cells.size(); i++) {
+	if (interp.heap_get(from + i).raw_value() != alloc.cells[i]) {
+	    return;
+	}
+    }
+    access.written_blocks.erase(alloc.block);
+}
+
+void goal_pool::dry_run(entry &e)
+{
+    auto &interp = global_.interp();
+    auto alloc = snapshot_allocation(interp);
+    auto max_cost = interp.maximum_cost();
+
+    num_dry_runs_++;
+    e.access.clear();
+    e.error.clear();
+    bool ok = false;
+    try {
+	interp.set_maximum_cost(dry_run_cost_);
+	term_serializer ser(interp);
+	term goal = ser.read(e.goal);
+	interp.set_access_tracking(&e.access);
+	ok = interp.execute_goal(goal);
+	if (ok) {
+	    interp.execute_cut();
+	}
+    } catch (std::exception &ex) {
+	// Interpreter, serializer, term and wam exceptions; anything
+	// the goal does wrong makes it invalid.
+	e.error = ex.what();
+	ok = false;
+    } catch (...) {
+	e.error = "unknown error";
+	ok = false;
+    }
+    interp.set_access_tracking(nullptr);
+    interp.set_maximum_cost(max_cost);
+    if (ok) {
+	strip_allocation(e.access, alloc, interp);
+    }
+    global_.discard();
+
+    e.status = ok ? VALID : INVALID;
+}
+
+goal_pool::status_t goal_pool::add(const buffer_t &goal, key_t *key)
+{
+    // Serialize it again so that the same goal always gets the same
+    // key (and so that garbage is rejected early.)
+    entry e;
+    try {
+	term_env env;
+	term_serializer ser(env);
+	term t = ser.read(goal);
+	ser.write(e.goal, t);
+    } catch (serializer_exception &) {
+	return INVALID;
+    }
+
+    auto k = key_of(e.goal);
+    if (key != nullptr) *key = k;
+
+    auto found = entries_.find(k);
+    if (found != entries_.end()) {
+	if (found->second.status == STALE) {
+	    dry_run(found->second);
+	}
+	return found->second.status;
+    }
+
+    while (!entries_.empty() && entries_.size() >= max_size_) {
+	erase(entries_.find(order_.begin()->second));
+    }
+
+    dry_run(e);
+    if (e.status == INVALID) {
+	return INVALID;
+    }
+    e.seq = next_seq_++;
+    order_[e.seq] = k;
+    entries_[k] = e;
+    return VALID;
+}
+
+bool goal_pool::contains(const key_t &key) const
+{
+    return entries_.find(key) != entries_.end();
+}
+
+goal_pool::status_t goal_pool::status(const key_t &key) const
+{
+    auto found = entries_.find(key);
+    if (found == entries_.end()) {
+	return INVALID;
+    }
+    return found->second.status;
+}
+
+void goal_pool::erase(std::unordered_map<key_t, entry>::iterator it)
+{
+    order_.erase(it->second.seq);
+    entries_.erase(it);
+}
+
+void goal_pool::remove(const key_t &key)
+{
+    auto found = entries_.find(key);
+    if (found != entries_.end()) {
+	erase(found);
+    }
+}
+
+void goal_pool::clear()
+{
+    entries_.clear();
+    order_.clear();
+}
+
+size_t goal_pool::assemble(size_t max_goals, buffer_t &block)
+{
+    term_env env;
+    term_serializer ser(env);
+    std::vector<term> goals;
+    access_set combined;
+    std::vector<key_t> invalid;
+
+    for (auto &o : order_) {
+	if (goals.size() >= max_goals) {
+	    break;
+	}
+	auto &e = entries_[o.second];
+	if (e.status == STALE) {
+	    dry_run(e);
+	} else if (e.status == VALID) {
+	    num_reused_++;
+	}
+	if (e.status == INVALID) {
+	    invalid.push_back(o.second);
+	    continue;
+	}
+	if (e.access.conflicts_with(combined)) {
+	    // Leave it for the next block
+	    continue;
+	}
+	combined.read_blocks.insert(e.access.read_blocks.begin(), e.access.read_blocks.end());
+	combined.written_blocks.insert(e.access.written_blocks.begin(), e.access.written_blocks.end());
+	combined.read_closures.insert(e.access.read_closures.begin(), e.access.read_closures.end());
+	combined.written_closures.insert(e.access.written_closures.begin(), e.access.written_closures.end());
+	goals.push_back(ser.read(e.goal));
+    }
+
+    for (auto &k : invalid) {
+	remove(k);
+    }
+
+    block.clear();
+    if (goals.empty()) {
+	return 0;
+    }
+    term conj = goals.back();
+    for (size_t i = goals.size() - 1; i-- > 0;) {
+	conj = env.new_term(con_cell(",",2), {goals[i], conj});
+    }
+    ser.write(block, conj);
+    return goals.size();
+}
+
+void goal_pool::committed(const buffer_t &block, const access_set &written,
+			  const allocation &alloc)
+{
+    if (entries_.empty()) {
+	return;
+    }
+
+    // Goals of the block are done
+    term_env env;
+    term_serializer ser(env);
+    term t = ser.read(block);
+    std::vector<term> goals;
+    while (t.tag() == tag_t::STR && env.functor(t) == con_cell(",",2)) {
+	goals.push_back(env.arg(t, 0));
+	t = env.arg(t, 1);
+    }
+    goals.push_back(t);
+    for (auto goal : goals) {
+	buffer_t buf;
+	ser.write(buf, goal);
+	remove(key_of(buf));
+    }
+
+    // Goals that depend on what the block changed must be checked again
+    access_set changed;
+    changed.written_blocks = written.written_blocks;
+    changed.written_closures = written.written_closures;
+    strip_allocation(changed, alloc, global_.interp());
+    for (auto &p : entries_) {
+	auto &e = p.second;
+	if (e.status == VALID && e.access.conflicts_with(changed)) {
+	    e.status = STALE;
+	    num_invalidated_++;
+	}
+    }
+}
+
+void goal_pool::invalidate_all()
+{
+    for (auto &p : entries_) {
+	if (p.second.status != STALE) {
+	    p.second.status = STALE;
+	    num_invalidated_++;
+	}
+    }
+}
+
+}}
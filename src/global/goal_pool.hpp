@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef _global_goal_pool_hpp
+#define _global_goal_pool_hpp
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "../common/term_serializer.hpp"
+#include "global_interpreter.hpp"
+
+namespace prologcoin { namespace global {
+
+class global;
+
+//
+// goal_pool. Pending goals (transactions) that have not made it into
+// a block yet. A goal is checked when it arrives: deserialized and
+// dry run against the current state (which runs its signature checks)
+// recording the heap blocks and closures it accessed, then all changes
+// are discarded. The verdict is kept, keyed by the hash of the
+// (canonically serialized) goal.
+//
+// When a block is committed its goals leave the pool, and goals that
+// accessed something the block wrote are marked stale; only those are
+// dry run again. Assembling a block picks valid goals, in arrival
+// order, whose access sets don't conflict, so the block can be
+// committed without trying goals one by one.
+//
+// Every goal that creates terms appends them to the heap block being
+// allocated into, so that is not counted as a write unless a cell that
+// was already there changed (e.g. a variable got bound.) Blocks beyond
+// it are new and not counted at all.
+//
+// A dry run may cost at most dry_run_cost() so that a goal that never
+// terminates can't hold up the node.
+//
+// Like the rest of global, the pool must be used under the node lock.
+//
+class goal_pool : private boost::noncopyable {
+public:
+    using buffer_t = common::term_serializer::buffer_t;
+    using key_t = std::string;
+
+    static const size_t DEFAULT_MAX_SIZE = 4096;
+    static const uint64_t DEFAULT_DRY_RUN_COST = 1000000;
+
+    enum status_t { VALID, INVALID, STALE };
+
+    goal_pool(global &g, size_t max_size = DEFAULT_MAX_SIZE);
+
+    // Add (and check) a goal. If it's already in the pool the cached
+    // verdict is returned. The oldest goal is dropped if the pool is
+    // full. On return key (if non-null) is the key of the goal.
+    status_t add(const buffer_t &goal, key_t *key = nullptr);
+
+    bool contains(const key_t &key) const;
+    status_t status(const key_t &key) const;
+    void remove(const key_t &key);
+    void clear();
+
+    inline size_t size() const { return entries_.size(); }
+    inline size_t max_size() const { return max_size_; }
+    inline void set_max_size(size_t n) { max_size_ = n; }
+    inline uint64_t dry_run_cost() const { return dry_run_cost_; }
+    inline void set_dry_run_cost(uint64_t c) { dry_run_cost_ = c; }
+
+    // The heap block allocation starts in and what its cells held
+    // before, to tell new terms from bindings of existing ones.
+    struct allocation {
+	size_t block;
+	size_t heap_size;
+	std::vector<common::untagged_cell::value_t> cells;
+    };
+    static allocation snapshot_allocation(global_interpreter &interp);
+
+    // Put up to max_goals mutually independent valid goals into a block
+    // (a conjunction.) Stale goals are checked again first. Returns the
+    // number of goals in the block.
+    size_t assemble(size_t max_goals, buffer_t &block);
+
+    // Called when a block has been committed. 'written' is what it
+    // wrote and 'alloc' the allocation snapshot taken before it.
+    void committed(const buffer_t &block, const access_set &written,
+		   const allocation &alloc);
+
+    // The state changed in a way we can't track (e.g. a new tip.)
+    void invalidate_all();
+
+    static key_t key_of(const buffer_t &goal);
+
+    // Statistics
+    inline uint64_t num_dry_runs() const { return num_dry_runs_; }
+    inline uint64_t num_reused() const { return num_reused_; }
+    inline uint64_t num_invalidated() const { return num_invalidated_; }
+
+private:
+    struct entry {
+	buffer_t goal;
+	status_t status;
+	access_set access;
+	uint64_t seq;
+	std::string error;
+    };
+
+    static void strip_allocation(access_set &access, const allocation &alloc,
+				 global_interpreter &interp);
+    void dry_run(entry &e);
+    void erase(std::unordered_map<key_t, entry>::iterator it);
+
+    global &global_;
+    size_t max_size_;
+    uint64_t dry_run_cost_;
+    std::unordered_map<key_t, entry> entries_;
+    std::map<uint64_t, key_t> order_;
+    uint64_t next_seq_;
+
+    uint64_t num_dry_runs_;
+    uint64_t num_reused_;
+    uint64_t num_invalidated_;
+};
+
+}}
+
+#endif
@@ -109,12 +109,65 @@ static size_t setup_global_basic(const std::string &test_dir)
     return ref_heap_pos;
 }
 
-static void test_global_basic()
+static size_t test_global_basic()
 {
     header("test_global_basic");
 
     size_t heap_ref_pos = setup_global_basic(test_dir);
     recheck_global_basic(test_dir, heap_ref_pos);
+    return heap_ref_pos;
+}
+
+static void test_global_block_cache(size_t heap_ref_pos)
+{
+    header("test_global_block_cache");
+
+    // Reopen what test_global_basic stored (a list spanning more than
+    // 16 heap blocks) with room for only 8 blocks in the cache.
+    global g(test_dir);
+    g.set_block_cache_size(8 * heap_block::MAX_SIZE * sizeof(cell));
+    g.set_block_prefetch(2);
+
+    auto &interp = g.interp();
+    interp.reset_block_cache_stats();
+    auto stats = interp.get_block_cache_stats();
+    assert(stats.capacity == 8);
+    assert(stats.hits == 0 && stats.misses == 0);
+
+    term lst = interp.heap_get(heap_ref_pos);
+    size_t n = 0;
+    while (interp.is_dotted_pair(lst)) {
+	n++;
+	lst = interp.arg(lst, 1);
+    }
+
+    stats = interp.get_block_cache_stats();
+    std::cout << "List of " << n << " elements: hits=" << stats.hits
+	      << " misses=" << stats.misses << " evictions=" << stats.evictions
+	      << " prefetched=" << stats.prefetched << " size=" << stats.size
+	      << std::endl;
+    assert(n == 65536);
+    // Sequential misses load the next blocks ahead, so those are hits
+    assert(stats.prefetched > 0);
+    assert(stats.hits > 0);
+    assert(stats.hits >= stats.prefetched / 2);
+    // The list doesn't fit
+    assert(stats.evictions > 0);
+    assert(stats.size <= stats.capacity);
+
+    // Without prefetching every new block is a miss
+    g.set_block_cache_size(8 * heap_block::MAX_SIZE * sizeof(cell));
+    g.set_block_prefetch(0);
+    interp.reset_block_cache_stats();
+    lst = interp.heap_get(heap_ref_pos);
+    while (interp.is_dotted_pair(lst)) {
+	lst = interp.arg(lst, 1);
+    }
+    auto stats0 = interp.get_block_cache_stats();
+    std::cout << "Without prefetch: hits=" << stats0.hits
+	      << " misses=" << stats0.misses << std::endl;
+    assert(stats0.prefetched == 0);
+    assert(stats0.misses > stats.misses);
 }
 
 static void recheck_frozen_closures(std::vector<size_t> &all_frozen_closures0)
@@ -218,6 +271,254 @@ static void test_global_frozen_closures()
     recheck_frozen_closures(all_frozen_closures);
 }
 
+static void test_global_goal_pool()
+{
+    header("test_global_goal_pool");
+
+    global::erase_db(test_dir);
+
+    global g(test_dir);
+    auto &pool = g.pending_goals();
+
+    auto to_buffer = [&](const std::string &str) {
+	term_serializer::buffer_t buf;
+	term_serializer ser(g.interp());
+	term t = g.interp().parse(str);
+	ser.write(buf, t);
+	g.discard();
+	return buf;
+    };
+
+    auto ok_goal = to_buffer("X = foo(42).");
+    auto bad_goal = to_buffer("1 = 2.");
+
+    assert(pool.add(ok_goal) == goal_pool::VALID);
+    assert(pool.add(bad_goal) == goal_pool::INVALID);
+    assert(pool.size() == 1);
+    assert(pool.num_dry_runs() == 2);
+
+    // Known goal; no need to run it again
+    assert(pool.add(ok_goal) == goal_pool::VALID);
+    assert(pool.num_dry_runs() == 2);
+
+    // Dry runs leave no trace
+    assert(g.is_clean());
+
+    term_serializer::buffer_t block;
+    assert(pool.assemble(10, block) == 1);
+    assert(g.execute_commit(block));
+
+    // Committed goals leave the pool
+    assert(pool.size() == 0);
+    assert(pool.assemble(10, block) == 0);
+
+    // Two variables in the block being allocated into
+    term v1 = g.interp().new_ref(), v2 = g.interp().new_ref();
+    auto r1 = reinterpret_cast<ref_cell &>(v1).index();
+    auto r2 = reinterpret_cast<ref_cell &>(v2).index();
+    g.advance();
+
+    auto bind_goal = [&](size_t addr, int val) {
+	return to_buffer("ref(X, " + boost::lexical_cast<std::string>(addr)
+			 + "), X = " + boost::lexical_cast<std::string>(val) + ".");
+    };
+
+    goal_pool::key_t key1, key2, key3;
+    assert(pool.add(bind_goal(r1, 1), &key1) == goal_pool::VALID);
+    assert(pool.add(bind_goal(r1, 2), &key2) == goal_pool::VALID);
+    assert(pool.add(bind_goal(r2, 3), &key3) == goal_pool::VALID);
+    assert(g.is_clean());
+
+    // Binding an existing variable is a write, even in the allocation
+    // block, so only the first goal goes into the block.
+    assert(pool.assemble(10, block) == 1);
+    assert(g.execute_commit(block));
+    assert(!pool.contains(key1));
+
+    // ...and the others must be checked again
+    assert(pool.status(key2) == goal_pool::STALE);
+    assert(pool.status(key3) == goal_pool::STALE);
+    assert(pool.num_invalidated() == 2);
+
+    auto dry_runs = pool.num_dry_runs();
+    assert(pool.add(bind_goal(r1, 2)) == goal_pool::INVALID);
+    assert(pool.add(bind_goal(r2, 3)) == goal_pool::VALID);
+    assert(pool.num_dry_runs() == dry_runs + 2);
+    assert(pool.assemble(10, block) == 1);
+    assert(g.execute_commit(block));
+    assert(pool.size() == 0);
+
+    // A goal that doesn't terminate runs out of its budget
+    pool.set_dry_run_cost(10000);
+    assert(pool.add(to_buffer("append(X, Y, Z), fail.")) == goal_pool::INVALID);
+    assert(g.is_clean());
+
+    std::cout << "Dry runs: " << pool.num_dry_runs() << ", reused: " << pool.num_reused() << std::endl;
+}
+
+static void test_global_block_pipeline()
+{
+    header("test_global_block_pipeline");
+
+    global::erase_db(test_dir);
+
+    global g(test_dir);
+
+    auto to_buffer = [&](const std::string &str) {
+	term_serializer::buffer_t buf;
+	term_env env;
+	term_serializer ser(env);
+	ser.write(buf, env.parse(str));
+	return buf;
+    };
+
+    uint8_t hash[meta_id::HASH_SIZE];
+    auto new_entry = [&](uint8_t n, const meta_id &prev, uint32_t height) {
+	meta_entry e;
+	memset(hash, 0, sizeof(hash));
+	hash[0] = n;
+	e.set_id(meta_id(hash));
+	e.set_previous_id(prev);
+	e.set_height(height);
+	return e;
+    };
+
+    auto &p = g.pipeline();
+    auto tip = g.tip_id();
+    auto e1 = new_entry(1, tip, 1);
+    auto e2 = new_entry(2, e1.get_id(), 2);
+
+    // Submitted out of order, committed in order
+    assert(p.submit(e2, to_buffer("meta([height(2)])."), to_buffer("Y = b.")));
+    assert(p.submit(e1, to_buffer("meta([height(1)])."), to_buffer("X = a.")));
+    assert(!p.submit(e1, to_buffer("meta([height(1)])."), to_buffer("X = a.")));
+    assert(p.num_pending() == 2);
+    assert(p.commit(e1.get_id()));
+    assert(p.commit(e2.get_id()));
+    assert(p.num_pending() == 0);
+    assert(g.current_height() == 2);
+
+    // Not submitted / malformed
+    assert(!p.commit(e1.get_id()));
+    auto tip2 = g.tip_id();
+    auto e3 = new_entry(3, tip2, 3);
+    term_serializer::buffer_t garbage(7, 0xff);
+    assert(p.submit(e3, to_buffer("meta([height(3)])."), garbage));
+    assert(!p.commit(e3.get_id()));
+    assert(p.last_error().find("Malformed") == 0);
+    assert(g.current_height() == 2);
+
+    // Dropped explicitly
+    assert(p.submit(e3, to_buffer("meta([height(3)])."), to_buffer("Z = c.")));
+    p.drop(e3.get_id());
+    assert(!p.has_block(e3.get_id()));
+
+    // Dropped when they no longer follow the tip
+    auto e4 = new_entry(4, new_entry(5, tip, 3).get_id(), 4);
+    assert(p.submit(e3, to_buffer("meta([height(3)])."), to_buffer("Z = c.")));
+    assert(p.submit(e4, to_buffer("meta([height(4)])."), to_buffer("W = d.")));
+    p.drop_unreachable(tip2);
+    assert(p.has_block(e3.get_id()));
+    assert(!p.has_block(e4.get_id()));
+    p.clear();
+
+    // Old blocks make room when the pipeline is full
+    block_pipeline q(g, 1, 2);
+    auto e6 = new_entry(6, tip2, 3);
+    auto e7 = new_entry(7, tip2, 3);
+    assert(q.submit(e3, to_buffer("meta([height(3)])."), to_buffer("Z = c.")));
+    assert(q.submit(e6, to_buffer("meta([height(3)])."), to_buffer("Z = c.")));
+    assert(!q.submit(e7, to_buffer("meta([height(3)])."), to_buffer("Z = c.")));
+    q.set_max_age(0);
+    assert(q.submit(e7, to_buffer("meta([height(3)])."), to_buffer("Z = c.")));
+    assert(q.has_block(e7.get_id()));
+    assert(q.num_pending() == 1);
+}
+
+static void test_global_address_index()
+{
+    header("test_global_address_index");
+
+    global::erase_db(test_dir);
+
+    global g(test_dir);
+    prologcoin::ec::builtins::load(g.interp());
+
+    auto count = [&](const std::string &query) {
+	auto cmd = g.interp().parse(query);
+	bool r = g.interp().execute(cmd);
+	assert(r);
+	size_t n = 0;
+	for (term lst = g.interp().get_result_term("X");
+	     g.interp().is_dotted_pair(lst); lst = g.interp().arg(lst, 1)) {
+	    n++;
+	}
+	return n;
+    };
+
+    auto reward_cmd = g.interp().parse("ec:privkey(P), ec:pubkey(P,Q), ec:address(Q,A), reward(A).");
+    g.interp().execute(reward_cmd);
+    auto addr1 = g.interp().to_string(g.interp().get_result_term("A"));
+    g.advance();
+    g.interp().execute(reward_cmd);
+    auto addr2 = g.interp().to_string(g.interp().get_result_term("A"));
+    g.advance();
+
+    // Built at the first commit of closures, not by a lookup
+    assert(g.addresses().is_built());
+    assert(g.addresses().num_builds() == 1);
+    assert(count("frozen_by_address([" + addr1 + "], 0, X, _).") == 1);
+    auto cost1 = g.interp().accumulated_cost();
+    assert(count("frozen_by_address([" + addr1 + "," + addr2 + "], 0, X, _).") == 2);
+    auto cost2 = g.interp().accumulated_cost();
+    // Lookups are charged for what they scan and return
+    assert(cost2 > cost1);
+    g.discard();
+
+    // ...and then kept up to date by commits
+    g.interp().execute(reward_cmd);
+    auto addr3 = g.interp().to_string(g.interp().get_result_term("A"));
+    assert(count("frozen_by_address([" + addr3 + "], 0, X, _).") == 1);
+    g.advance();
+    assert(count("frozen_by_address([" + addr3 + "], 0, X, _).") == 1);
+    assert(count("frozen_by_address([" + addr1 + "," + addr2 + "," + addr3 + "], height(2), X, _).") == 1);
+    assert(g.addresses().num_builds() == 1);
+    g.discard();
+}
+
+static void test_global_closure_filters()
+{
+    header("test_global_closure_filters");
+
+    global::erase_db(test_dir);
+
+    global g(test_dir);
+    prologcoin::ec::builtins::load(g.interp());
+
+    auto reward_cmd = g.interp().parse("ec:privkey(P), ec:pubkey(P,Q), ec:address(Q,A), reward(A).");
+    std::vector<std::string> addrs;
+    for (size_t i = 0; i < 3; i++) {
+	g.interp().execute(reward_cmd);
+	addrs.push_back(g.interp().to_string(g.interp().get_result_term("A")));
+	g.advance();
+    }
+
+    std::vector<global::closure_filter> filters;
+    g.db_get_closure_filters(1, g.current_height(), filters);
+    assert(filters.size() == 3);
+    for (size_t i = 0; i < filters.size(); i++) {
+	auto &f = filters[i];
+	assert(f.height == i + 1);
+	assert(f.has_filter);
+	assert(f.heap_start < f.heap_end);
+	assert(i == 0 || f.heap_start == filters[i-1].heap_end);
+	gcs_filter gcs(f.height, &f.data[0], f.data.size());
+	assert(gcs.size() == 1);
+	assert(gcs.match(addrs[i]));
+	assert(!gcs.match_any({addrs[(i+1)%3], addrs[(i+2)%3]}));
+    }
+}
+
 int main(int argc, char *argv[])
 {
     home_dir = find_home_dir(argv[0]);
@@ -226,7 +527,12 @@ int main(int argc, char *argv[])
 
     random::set_for_testing(true);
   
-    test_global_basic();
+    size_t heap_ref_pos = test_global_basic();
+    test_global_block_cache(heap_ref_pos);
     test_global_frozen_closures();
+    test_global_goal_pool();
+    test_global_block_pipeline();
+    test_global_address_index();
+    test_global_closure_filters();
     return 0;
 }
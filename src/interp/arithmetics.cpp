@@ -1,3 +1,4 @@
+#include <limits>
 #include "builtins.hpp"
 #include "interpreter_base.hpp"
 #include "arithmetics.hpp"
@@ -13,23 +14,151 @@ namespace prologcoin { namespace interp {
 	return ic;
     }
 
+    // r = a*b, returns true if it overflows int64_t
+    static inline bool mul_overflow(int64_t a, int64_t b, int64_t &r)
+    {
+#if defined(__GNUC__)
+	return __builtin_mul_overflow(a, b, &r);
+#else
+	static const int64_t MAX = std::numeric_limits<int64_t>::max();
+	static const int64_t MIN = std::numeric_limits<int64_t>::min();
+	if (a > 0) {
+	    if (b > 0 ? a > MAX / b : b < MIN / a) {
+		return true;
+	    }
+	} else if (b > 0) {
+	    if (a < MIN / b) {
+		return true;
+	    }
+	} else if (a != 0 && b < MAX / a) {
+	    return true;
+	}
+	r = a * b;
+	return false;
+#endif
+    }
+
+    static inline bool is_small(int64_t v)
+    {
+	return v >= int_cell::min().value() && v <= int_cell::max().value();
+    }
+
+    term arithmetics_fn::big_2(interpreter_base &interp, big_op op,
+			       term *args, const char *context)
+    {
+	static const size_t SMALL_BYTES = 64;
+
+	// Integers are a sign and an 8 byte magnitude; BIG cells are
+	// never negative.
+	size_t num_bytes[2];
+	for (size_t i = 0; i < 2; i++) {
+	    num_bytes[i] = 8;
+	    if (args[i].tag() == tag_t::BIG) {
+		num_bytes[i] = (interp.num_bits(
+			reinterpret_cast<const big_cell &>(args[i])) + 7) / 8;
+	    }
+	}
+	size_t result_bytes = big_result_bytes(op, num_bytes[0], num_bytes[1]);
+
+	// Up to 512 bits everything stays on the stack
+	uint8_t small[4*SMALL_BYTES];
+	std::vector<uint8_t> large;
+	uint8_t *bytes = small;
+	if (num_bytes[0] + num_bytes[1] + result_bytes > sizeof(small)) {
+	    large.resize(num_bytes[0] + num_bytes[1] + result_bytes);
+	    bytes = &large[0];
+	}
+
+	big_operand operand[2];
+	for (size_t i = 0; i < 2; i++) {
+	    size_t n = num_bytes[i];
+	    operand[i].negative = false;
+	    operand[i].bytes = bytes;
+	    operand[i].num_bytes = n;
+	    if (args[i].tag() == tag_t::BIG) {
+		interp.get_big(args[i], bytes, n);
+	    } else {
+		int64_t v = get_int(args[i]).value();
+		uint64_t m = static_cast<uint64_t>(v < 0 ? -v : v);
+		for (size_t j = 0; j < n; j++) {
+		    bytes[n-1-j] = static_cast<uint8_t>(m >> (8*j));
+		}
+		operand[i].negative = v < 0;
+	    }
+	    bytes += n;
+	}
+	uint8_t *result = bytes;
+
+	size_t num_limbs = (std::max(num_bytes[0], num_bytes[1]) + 7) / 8;
+	bool quadratic = op != BIG_ADD && op != BIG_SUB &&
+	                 op != BIG_MAX && op != BIG_MIN;
+	interp.add_accumulated_cost(quadratic ? num_limbs*num_limbs : num_limbs);
+
+	bool negative = false;
+	if (!big_apply(op, operand[0], operand[1], result, negative)) {
+	    throw interpreter_exception_division_by_zero(
+		   std::string(context) + ": attempt to divide by zero");
+	}
+
+	// Results that fit are integers, the others are BIG cells as
+	// wide as their significant bytes.
+	size_t skip = 0;
+	while (skip < result_bytes && result[skip] == 0) {
+	    skip++;
+	}
+	size_t n = result_bytes - skip;
+	if (n <= 8) {
+	    uint64_t m = 0;
+	    for (size_t j = skip; j < result_bytes; j++) {
+		m = (m << 8) | result[j];
+	    }
+	    if (m <= static_cast<uint64_t>(int_cell::max().value())) {
+		return int_cell(negative ? -static_cast<int64_t>(m)
+				         : static_cast<int64_t>(m));
+	    }
+	    if (negative && m == static_cast<uint64_t>(-int_cell::min().value())) {
+		return int_cell::min();
+	    }
+	}
+	if (negative) {
+	    throw interpreter_exception_unsupported(
+		   std::string(context) + ": negative big integers are unsupported");
+	}
+	term big = interp.new_big(8*n);
+	interp.set_big(big, result + skip, n);
+	return big;
+    }
+
     term arithmetics_fn::plus_2(interpreter_base &interp, term *args)
     {
-	return get_int(args[0]) + get_int(args[1]);
+	if (is_big(args)) return big_2(interp, BIG_ADD, args, "+/2");
+	int64_t r = get_int(args[0]).value() + get_int(args[1]).value();
+	if (!is_small(r)) return big_2(interp, BIG_ADD, args, "+/2");
+	return int_cell(r);
     }
 
     term arithmetics_fn::minus_2(interpreter_base &interp, term *args)
     {
-	return get_int(args[0]) - get_int(args[1]);
+	if (is_big(args)) return big_2(interp, BIG_SUB, args, "-/2");
+	int64_t r = get_int(args[0]).value() - get_int(args[1]).value();
+	if (!is_small(r)) return big_2(interp, BIG_SUB, args, "-/2");
+	return int_cell(r);
     }
 
     term arithmetics_fn::times_2(interpreter_base &interp, term *args)
     {
-	return get_int(args[0]) * get_int(args[1]);
+	if (is_big(args)) return big_2(interp, BIG_MUL, args, "*/2");
+	int64_t r;
+	if (mul_overflow(get_int(args[0]).value(), get_int(args[1]).value(), r)
+	    || !is_small(r)) {
+	    return big_2(interp, BIG_MUL, args, "*/2");
+	}
+	return int_cell(r);
     }
 
     term arithmetics_fn::div0_2(interpreter_base &interp, term *args)
     {
+	if (is_big(args)) return big_2(interp, BIG_DIV0, args, "// /2");
 	auto a = get_int(args[0]);
 	auto b = get_int(args[1]);
 	if (b.is_zero()) {
@@ -42,6 +171,7 @@ namespace prologcoin { namespace interp {
     }
 
     term arithmetics_fn::div_2(interpreter_base &interp, term *args) {
+	if (is_big(args)) return big_2(interp, BIG_DIV, args, "div/2");
 	auto b = get_int(args[1]);
 	if (b.is_zero()) {
 	    throw interpreter_exception_division_by_zero(
@@ -57,6 +187,7 @@ namespace prologcoin { namespace interp {
 
     term arithmetics_fn::rem_2(interpreter_base &interp, term *args)
     {
+	if (is_big(args)) return big_2(interp, BIG_REM, args, "rem/2");
 	auto a = get_int(args[0]);
 	auto b = get_int(args[1]);
 	if (b.is_zero()) {
@@ -69,6 +200,7 @@ namespace prologcoin { namespace interp {
 	
     term arithmetics_fn::mod_2(interpreter_base &interp, term *args)
     {
+	if (is_big(args)) return big_2(interp, BIG_MOD, args, "mod/2");
 	auto a = get_int(args[0]);
 	auto b = get_int(args[1]);
 	if (b.is_zero()) {
@@ -96,6 +228,7 @@ namespace prologcoin { namespace interp {
 
     term arithmetics_fn::max_2(interpreter_base &interp, term *args)
     {
+	if (is_big(args)) return big_2(interp, BIG_MAX, args, "max/2");
 	auto a = get_int(args[0]).value();
 	auto b = get_int(args[1]).value();
 	return int_cell(std::max(a, b));
@@ -103,6 +236,7 @@ namespace prologcoin { namespace interp {
 
     term arithmetics_fn::min_2(interpreter_base &interp, term *args)
     {
+	if (is_big(args)) return big_2(interp, BIG_MIN, args, "min/2");
 	auto a = get_int(args[0]).value();
 	auto b = get_int(args[1]).value();
 	return int_cell(std::min(a, b));
@@ -209,11 +343,7 @@ namespace prologcoin { namespace interp {
 		interp_.abort(interpreter_exception_not_sufficiently_instantiated(context + ": Arguments are not sufficiently instantiated"));
 		break;
 	    }
-	    case tag_t::BIG: {
-		interp_.abort(interpreter_exception_unsupported(context + ": Big integers are unsupported."));
-		break;
-	    }
-	    case tag_t::INT: {
+	    case tag_t::INT: case tag_t::BIG: {
 		assert(false); // Should not occur
 		break;
 	    }
@@ -223,6 +353,75 @@ namespace prologcoin { namespace interp {
 	return result;
     }
 
+    bool arithmetics::eval_small(term expr, int64_t &value, size_t depth)
+    {
+	static const con_cell plus_2("+", 2);
+	static const con_cell minus_2("-", 2);
+	static const con_cell times_2("*", 2);
+	static const con_cell div0_2("//", 2);
+	static const con_cell mod_2("mod", 2);
+	static const con_cell rem_2("rem", 2);
+	static const con_cell div_2("div", 2);
+	static const con_cell max_2("max", 2);
+	static const con_cell min_2("min", 2);
+	static const size_t MAX_DEPTH = 32;
+
+	expr = interp_.deref(expr);
+	if (expr.tag() == tag_t::INT) {
+	    value = static_cast<const int_cell &>(static_cast<const cell &>(expr)).value();
+	    return true;
+	}
+	if (expr.tag() != tag_t::STR || depth == MAX_DEPTH) {
+	    return false;
+	}
+	auto f = interp_.functor(expr);
+	if (f.arity() != 2) {
+	    return false;
+	}
+	int64_t a, b, r;
+	if (!eval_small(interp_.arg(expr, 0), a, depth + 1) ||
+	    !eval_small(interp_.arg(expr, 1), b, depth + 1)) {
+	    return false;
+	}
+	if (f == plus_2) {
+	    r = a + b;
+	} else if (f == minus_2) {
+	    r = a - b;
+	} else if (f == times_2) {
+	    if (mul_overflow(a, b, r)) {
+		return false;
+	    }
+	} else if (f == max_2) {
+	    r = std::max(a, b);
+	} else if (f == min_2) {
+	    r = std::min(a, b);
+	} else if (f == div0_2 || f == mod_2 || f == rem_2 || f == div_2) {
+	    // Division by zero and the saturating abs() of the minimum
+	    // value are left to the general evaluator.
+	    if (b == 0 || a == int_cell::min().value() ||
+		b == int_cell::min().value()) {
+		return false;
+	    }
+	    auto q = a / b, m = a % b;
+	    if (f == div0_2) {
+		r = q;
+	    } else if (f == rem_2) {
+		r = m;
+	    } else if (f == mod_2) {
+		r = (m != 0 && ((m < 0) != (b < 0))) ? m + b : m;
+	    } else {
+		r = (m < 0) ? q - 1 : q;
+	    }
+	} else {
+	    return false;
+	}
+	if (r < int_cell::min().value() || r > int_cell::max().value()) {
+	    return false;
+	}
+	value = r;
+	return true;
+    }
+
     //
     // Simple
     //
@@ -4,6 +4,7 @@
 #define _interp_arithmetics_hpp
 
 #include "../common/term.hpp"
+#include "../common/big_limbs.hpp"
 #include "interpreter_exception.hpp"
 
 namespace prologcoin { namespace interp {
@@ -37,6 +38,17 @@ public:
 	static common::term min_2(interpreter_base &interp, common::term *args);	
     private:
 	static common::int_cell get_int(const common::term &t);
+
+	// Exact arithmetic where some argument is a BIG cell or the
+	// result doesn't fit in an integer. Results that fit are
+	// integers, larger ones BIG cells; BIG cells have no sign, so
+	// a large negative result is an error.
+	static inline bool is_big(common::term *args) {
+	    return args[0].tag() == common::tag_t::BIG ||
+		   args[1].tag() == common::tag_t::BIG;
+	}
+	static common::term big_2(interpreter_base &interp, common::big_op op,
+				  common::term *args, const char *context);
     };
 
 
@@ -56,6 +68,13 @@ public:
 
 	common::term eval(common::term &expr, const std::string &context);
 
+	// Fast path for expressions over small integers using only
+	// +, -, *, //, mod, rem, div, max and min. Returns false if the
+	// expression needs eval() instead (big integers, other functions,
+	// unbound variables, overflow or deep nesting); eval() then
+	// gives the result or the error.
+	bool eval_small(common::term expr, int64_t &value, size_t depth = 0);
+
     private:
 	void load_fn(const std::string &name, size_t arity, fn f);
 	void load_fns();
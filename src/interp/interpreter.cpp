@@ -403,7 +403,7 @@ void interpreter::fail()
 			std::string redo_str = to_string(qr());
 			std::cout << "interpreter::fail(): redo " << redo_str << " (first_arg=" << to_string(first_arg) << ")" << std::endl;
 		    }
-		    auto &clauses = pred.get_clauses(*this, first_arg);
+		    auto &clauses = pred.select_clauses(*this, qr());
 		    size_t from_clause = bpval & 0xffffffff;
 		    ok = select_clause(code_point(qr()), pred_id, clauses, from_clause);
 		}
@@ -713,7 +713,6 @@ void interpreter::dispatch()
 	}
     }
 
-    auto first_arg = get_first_arg();
     const predicate &pred = get_predicate(module, f);
 
     if (pred.empty()) {
@@ -731,7 +730,7 @@ void interpreter::dispatch()
     set_pr(f);
 
     // Otherwise a vector of clauses
-    auto &clauses = pred.get_clauses(*this, first_arg);
+    auto &clauses = pred.select_clauses(*this, p().term_code());
 
     set_b0(b());
 
@@ -85,7 +85,7 @@ class predicate {
 public:
   inline predicate() = default;
   inline predicate(const predicate &other) = default;
-  inline predicate(const qname &qn) : qname_(qn), id_(0), with_vars_(false), num_clauses_(0),was_compiled_(false),ok_to_compile_(true), performance_count_(0) { }
+  inline predicate(const qname &qn) : qname_(qn), id_(0), columns_built_(false), with_vars_(false), num_clauses_(0),was_compiled_(false),ok_to_compile_(true), performance_count_(0) { }
   inline const qname & qualified_name() const { return qname_; }
 
   inline const std::vector<managed_clause> & clauses() const { return clauses_; }
@@ -100,6 +100,20 @@ public:
   const std::vector<managed_clause> & get_clauses(interpreter_base &interp, size_t term_id) const;
   const std::vector<managed_clause> & get_clauses(interpreter_base &interp, common::term first_arg) const;
 
+  // Candidate clauses for a call. Like get_clauses(interp, first_arg)
+  // when the first argument is indexable, otherwise fact tables are
+  // looked up on the most selective bound argument. The selection
+  // only depends on the arguments of the goal, so a redo of the same
+  // goal gets the same clause list.
+  const std::vector<managed_clause> & select_clauses(interpreter_base &interp, common::term goal) const;
+
+  // Predicates with at least this many facts (and no rules) get an
+  // index on every argument position that has no variables (here for
+  // the naive interpreter, and as switch instructions when compiled.)
+  static const size_t FACT_TABLE_MIN_CLAUSES = 32;
+
+  bool is_fact_table(interpreter_base &interp) const;
+
   inline std::vector<managed_clause> & get_clauses() const
       { return clauses_; }
 
@@ -118,6 +132,8 @@ public:
   {
       filtered_.clear();
       term_id_.clear();
+      columns_.clear();
+      columns_built_ = false;
   }
 
   inline bool was_compiled() const {
@@ -146,6 +162,10 @@ public:
   void check_index(interpreter_base &interp);
 
 private:
+    typedef std::unordered_map<common::term, std::vector<managed_clause> > column_index;
+
+    void build_columns(interpreter_base &interp) const;
+
     bool matched_indexed_clause(interpreter_base &interp, common::term head);
     managed_clause remove_indexed_clause(interpreter_base &interp, common::term head);
     friend class interpreter_base;
@@ -158,6 +178,10 @@ private:
     mutable std::unordered_map<common::term, std::vector<managed_clause> > indexed_;
     mutable std::vector<std::vector<managed_clause> > filtered_;
     mutable std::unordered_map<common::term, size_t> term_id_;
+    // Fact table index per argument position (empty if the position
+    // has variables in some fact.) Built lazily, cleared with the cache.
+    mutable std::vector<column_index> columns_;
+    mutable bool columns_built_;
     bool with_vars_;
     size_t num_clauses_;
     bool was_compiled_;
@@ -474,6 +498,7 @@ class interpreter_base : public common::term_env {
     friend class builtins_opt;
     friend class builtins_fileio;
     friend class arithmetics;
+    friend class arithmetics_fn;
     friend struct meta_context;
     friend class interpreter;
     friend struct new_instance_context;
@@ -896,6 +921,11 @@ public:
     {
         return module_meta_db_[name];
     }
+
+    inline void clear_module_changed(con_cell name)
+    {
+        module_meta_db_[name].clear_changed();
+    }
   
     inline const std::vector<qname> & get_module(const con_cell name)
         { auto it = module_db_.find(name);
@@ -1015,9 +1045,30 @@ public:
     inline bool is_builtin(const qname &qn) const
     { return builtins_.find(qn) != builtins_.end(); }
 
+    inline const std::unordered_map<qname, builtin> & get_builtins() const
+    { return builtins_; }
+
+    // Reverse lookup (compiled code only keeps the name and function)
+    inline bool find_builtin(common::con_cell name, builtin_fn fn, qname &qn) const
+    {
+	for (auto &e : builtins_) {
+	    if (e.first.second == name && e.second.fn() == fn) {
+		qn = e.first;
+		return true;
+	    }
+	}
+	return false;
+    }
+
     inline uint64_t accumulated_cost() const
         { return accumulated_cost_; }
 
+    // For builtins (outside of interp) doing work that isn't paid by
+    // unify, copy, etc.
+    inline void add_cost(uint64_t cost)
+        { add_accumulated_cost(cost); }
+
+    inline uint64_t maximum_cost() const { return maximum_cost_; }
     inline void set_maximum_cost(uint64_t cost) { maximum_cost_ = cost; }
 
     inline bool unify(term a, term b)
@@ -1088,6 +1139,9 @@ public:
     inline void set_managed_data(common::con_cell key, managed_data *data)
        { managed_data_[key] = data; }
 
+    inline size_t num_managed_data() const
+       { return managed_data_.size(); }
+
     inline meta_context * get_current_meta_context()
         { return register_m_; }
 
@@ -1706,6 +1760,30 @@ protected:
 	return arg(goal, 0);
     }
 
+    // Same as get_first_arg(goal), but for any argument position.
+    term get_arg(term goal, size_t index)
+    {
+	if (goal.tag() == common::tag_t::CON) {
+	    if (index >= num_of_args_) {
+		return EMPTY_LIST;
+	    }
+	    return deref(a(index));
+	}
+        if (!is_functor(goal)) {
+	    return EMPTY_LIST;
+        }
+	if (functor(goal) == COLON) {
+	    goal = arg(goal, 1);
+	    if (!is_functor(goal)) {
+	        return EMPTY_LIST;
+	    }
+	}
+	if (index >= functor(goal).arity()) {
+	    return EMPTY_LIST;
+	}
+	return arg(goal, index);
+    }
+
     void abort(const interpreter_exception &ex);
     bool definitely_inequal(const term a, const term b);
 
@@ -1900,10 +1978,10 @@ private:
     // If password is in persistent mode
     bool persistent_password_;
 
+protected:
     bool is_persistent_password() const { return persistent_password_; }
     void set_persistent_password(bool p) { persistent_password_ = p; }
 
-protected:
     void clear_secret();
 
 private:
@@ -2369,6 +2447,86 @@ inline const std::vector<managed_clause> & predicate::get_clauses(interpreter_ba
     return filtered_[term_id];
 }
 
+inline bool predicate::is_fact_table(interpreter_base &interp) const {
+    if (num_clauses_ < FACT_TABLE_MIN_CLAUSES) {
+        return false;
+    }
+    for (auto &mclause : clauses_) {
+        if (mclause.is_erased()) {
+	    continue;
+	}
+	if (interp.functor(mclause.clause()) == interpreter_base::IMPLIED_BY) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+inline void predicate::build_columns(interpreter_base &interp) const {
+    columns_built_ = true;
+    columns_.clear();
+    if (!is_fact_table(interp)) {
+        return;
+    }
+    size_t arity = qname_.second.arity();
+    columns_.resize(arity);
+    std::vector<bool> indexable(arity, true);
+    for (auto &mclause : clauses_) {
+        performance_count_++;
+        if (mclause.is_erased()) {
+	    continue;
+	}
+	auto head = interp.clause_head(mclause.clause());
+	for (size_t i = 0; i < arity; i++) {
+	    if (!indexable[i]) {
+	        continue;
+	    }
+	    auto key = interp.arg_index(interp.arg(head, i));
+	    if (key.tag().is_ref()) {
+	        indexable[i] = false;
+		columns_[i].clear();
+	    } else {
+	        columns_[i][key].push_back(mclause);
+	    }
+	}
+    }
+}
+
+inline const std::vector<managed_clause> & predicate::select_clauses(interpreter_base &interp, common::term goal) const {
+    static const std::vector<managed_clause> NOT_FOUND;
+    auto first_arg = interp.get_arg(goal, 0);
+    if ((!with_vars_ && !interp.arg_index(first_arg).tag().is_ref()) ||
+	num_clauses_ < FACT_TABLE_MIN_CLAUSES) {
+        return get_clauses(interp, first_arg);
+    }
+    if (!columns_built_) {
+        build_columns(interp);
+    }
+    const std::vector<managed_clause> *best = nullptr;
+    for (size_t i = 0; i < columns_.size(); i++) {
+        auto &column = columns_[i];
+	if (column.empty()) {
+	    continue;
+	}
+	auto key = interp.arg_index(interp.get_arg(goal, i));
+	if (key.tag().is_ref()) {
+	    continue;
+	}
+	performance_count_++;
+	auto it = column.find(key);
+	if (it == column.end()) {
+	    return NOT_FOUND;
+	}
+	if (best == nullptr || it->second.size() < best->size()) {
+	    best = &it->second;
+	}
+    }
+    if (best == nullptr) {
+        return get_clauses(interp, first_arg);
+    }
+    return *best;
+}
+
 template<> inline environment_naive_t * interpreter_base::allocate_environment<ENV_NAIVE>()
 {
     auto new_ee = reinterpret_cast<environment_naive_t *>(allocate_stack(true));
@@ -19,3 +19,76 @@ length([X|Xs], N) :-
 ?- length([1,2,3,4,5],Q2).
 % Expect: Q2 = 5
 % Expect: end
+
+%
+% Integer division and rounding (compiled inline in WAM code)
+%
+
+arith2(A, B, C, D, E, F) :-
+    X = 7, Y = 2, Z is 0 - X,
+    A is Z // Y, B is Z mod Y, C is X mod (0 - Y),
+    D is Z rem Y, E is Z div Y, F is max(3, min(9, 4)).
+?- arith2(Q3, Q4, Q5, Q6, Q7, Q8).
+% Expect: Q3 = -3, Q4 = 1, Q5 = -1, Q6 = -1, Q7 = -4, Q8 = 4
+% Expect: end
+
+%
+% Comparisons
+%
+
+cmp(X, Y, R) :- X < Y, !, R = lt.
+cmp(X, Y, R) :- X > Y, !, R = gt.
+cmp(_, _, eq).
+?- cmp(2*3, 7, Q9), cmp(10 - 3, 7, Q10), cmp(3*3, 7, Q11).
+% Expect: Q9 = lt, Q10 = eq, Q11 = gt
+% Expect: end
+
+inrange(L, H, X) :- X >= L, X =< H.
+?- inrange(1, 10, 5*2).
+% Expect: true
+% Expect: end
+
+?- inrange(1, 10, 5*3).
+% Expect: fail
+
+%
+% Bignums (exact; results that fit are integers again)
+%
+
+big1 :-
+    A = 16'ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff,
+    X is A + 1, X > A, Y is X - 1, Y == A, Z is A - A, Z == 0.
+?- big1.
+% Expect: true
+% Expect: end
+
+big2 :-
+    A = 16'ffffffffffffffffffffffffffffffff,
+    X is A * A, Y is (A + 1) * (A - 1) + 1, X == Y, X > A,
+    Q is X // A, Q == A, R is X mod A, R == 0.
+?- big2.
+% Expect: true
+% Expect: end
+
+big3 :-
+    A = 100000000000000000000000000000000,
+    Q is A // 7, R is A mod 7, Y is Q * 7 + R, Y == A, Y > Q.
+?- big3.
+% Expect: true
+% Expect: end
+
+big4(Q, R, D, M, X, Y) :-
+    A = 100000000000000000000000000000000, B is 0 - 7,
+    Q is B // A, R is B rem A, D is B div A, M0 is B mod A, M is M0 - A,
+    X is min(B, A), Y is max(B, A) - A.
+?- big4(Q12, Q13, Q14, Q15, Q16, Q17).
+% Expect: Q12 = 0, Q13 = -7, Q14 = -1, Q15 = -7, Q16 = -7, Q17 = 0
+% Expect: end
+
+big5 :-
+    X is 1152921504606846975 + 1, X > 1152921504606846975,
+    Y is X - 1, Y == 1152921504606846975,
+    Z is 0 - 1152921504606846975 - 1, Z < 0.
+?- big5.
+% Expect: true
+% Expect: end
@@ -1,7 +1,11 @@
+#include <fstream>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
 #include "../../common/term_tools.hpp"
 #include "../../common/term_serializer.hpp"
 #include "../interpreter.hpp"
+#include "../wam_code_cache.hpp"
 
 using namespace prologcoin::common;
 using namespace prologcoin::interp;
@@ -335,6 +339,268 @@ static void test_interpreter_freeze_preprocess()
     */
 }
 
+static void test_fact_table()
+{
+    header("test_fact_table()");
+
+    const size_t N = 100000;
+    const size_t M = 1000;
+
+    interpreter interp("test");
+    interp.setup_standard_lib();
+
+    std::stringstream prog;
+    for (size_t i = 0; i < N; i++) {
+	prog << "fact(" << i << ", v" << i << ", " << (i % 7) << ").\n";
+    }
+
+    auto start = boost::posix_time::microsec_clock::local_time();
+    interp.load_program(prog.str());
+    auto stop = boost::posix_time::microsec_clock::local_time();
+    std::cout << "Loaded " << N << " facts in "
+	      << (stop - start).total_milliseconds() << " ms" << std::endl;
+
+    std::vector<term> by_first, by_second;
+    for (size_t k = 0; k < M; k++) {
+	size_t i = (k * 7919) % N;
+	by_first.push_back(interp.parse("fact(" + boost::lexical_cast<std::string>(i) + ", X, Y)."));
+	by_second.push_back(interp.parse("fact(X, v" + boost::lexical_cast<std::string>(i) + ", Y)."));
+    }
+
+    auto lookup = [&](const std::string &name, std::vector<term> &queries) {
+	auto start = boost::posix_time::microsec_clock::local_time();
+	for (auto q : queries) {
+	    bool ok = interp.execute(q);
+	    assert(ok);
+	    assert(!interp.has_more());
+	    interp.reset();
+	}
+	auto stop = boost::posix_time::microsec_clock::local_time();
+	auto dt = (stop - start).total_microseconds();
+	std::cout << M << " lookups on " << name << " argument: "
+		  << dt << " us (" << (dt / M) << " us/lookup)" << std::endl;
+    };
+
+    lookup("first", by_first);
+
+    // First lookup on another argument builds the fact table index
+    start = boost::posix_time::microsec_clock::local_time();
+    assert(interp.execute(by_second[0]));
+    interp.reset();
+    stop = boost::posix_time::microsec_clock::local_time();
+    std::cout << "Built fact table index in "
+	      << (stop - start).total_milliseconds() << " ms" << std::endl;
+
+    lookup("second", by_second);
+
+    // Bound on two arguments picks the smaller bucket
+    term q = interp.parse("fact(X, v42, Y).");
+    assert(interp.execute(q));
+    assert(interp.get_result(false) == "X = 42, Y = 0");
+    interp.reset();
+
+    q = interp.parse("fact(X, v42, 1).");
+    assert(!interp.execute(q));
+    interp.reset();
+
+    q = interp.parse("fact(X, nothere, Y).");
+    assert(!interp.execute(q));
+    interp.reset();
+
+    // Backtrack over a non-first argument bucket (in clause order)
+    q = interp.parse("fact(X, Y, 3).");
+    assert(interp.execute(q));
+    assert(interp.get_result(false) == "X = 3, Y = v3");
+    assert(interp.next());
+    assert(interp.get_result(false) == "X = 10, Y = v10");
+    interp.reset();
+
+    // Compiled code switches on every argument of a fact table too
+    start = boost::posix_time::microsec_clock::local_time();
+    bool compiled = interp.compile(con_cell("fact", 3));
+    assert(compiled);
+    stop = boost::posix_time::microsec_clock::local_time();
+    std::cout << "Compiled " << N << " facts in "
+	      << (stop - start).total_milliseconds() << " ms" << std::endl;
+
+    lookup("first (compiled)", by_first);
+    lookup("second (compiled)", by_second);
+
+    q = interp.parse("fact(X, v42, Y).");
+    assert(interp.execute(q));
+    assert(interp.get_result(false) == "X = 42, Y = 0");
+    assert(!interp.has_more());
+    interp.reset();
+
+    q = interp.parse("fact(X, v42, 1).");
+    assert(!interp.execute(q));
+    interp.reset();
+
+    q = interp.parse("fact(X, Y, 3).");
+    assert(interp.execute(q));
+    assert(interp.get_result(false) == "X = 3, Y = v3");
+    assert(interp.next());
+    assert(interp.get_result(false) == "X = 10, Y = v10");
+    interp.reset();
+
+    // The index follows updates of the database
+    q = interp.parse("(asserta(fact(extra, v42, 9)), fact(X, v42, Y)).");
+    assert(interp.execute(q));
+    assert(interp.get_result(false) == "X = extra, Y = 9");
+    assert(interp.next());
+    assert(interp.get_result(false) == "X = 42, Y = 0");
+    interp.reset();
+}
+
+static void test_auto_compile()
+{
+    header("test_auto_compile()");
+
+    interpreter interp("test");
+    interp.setup_standard_lib();
+
+    // Auto compiling runs on the first call, so measure the first call
+    // latency of the largest predicate that is auto compiled. Larger
+    // predicates and fact tables stay with the naive interpreter.
+    const size_t R = interpreter::AUTO_COMPILE_MAX_CLAUSES;
+    std::stringstream rules;
+    for (size_t i = 0; i <= R; i++) {
+	if (i < R) {
+	    rules << "rule(" << i << ", X) :- X is " << i << " * 2.\n";
+	}
+	rules << "big_rule(" << i << ", X) :- X is " << i << " * 2.\n";
+    }
+    for (size_t i = 0; i < 10*R; i++) {
+	rules << "table(" << i << ", v" << i << ").\n";
+    }
+    interp.load_program(rules.str());
+    interp.set_auto_wam(true);
+    auto first_call = [&](const std::string &query, const std::string &expect) {
+	term q = interp.parse(query);
+	auto start = boost::posix_time::microsec_clock::local_time();
+	bool ok = interp.execute(q);
+	auto stop = boost::posix_time::microsec_clock::local_time();
+	assert(ok);
+	assert(interp.get_result(false) == expect);
+	interp.reset();
+	std::cout << "First call of " << query << " "
+		  << (stop - start).total_microseconds() << " us" << std::endl;
+    };
+    first_call("rule(100, X).", "X = 200");
+    first_call("rule(101, X).", "X = 202");
+    first_call("big_rule(100, X).", "X = 200");
+    first_call("table(X, v500).", "X = 500");
+    interp.set_auto_wam(false);
+    assert(interp.is_compiled(qname(interp.current_module(), con_cell("rule", 2))));
+    assert(!interp.is_compiled(qname(interp.current_module(), interp.functor("big_rule", 2))));
+    assert(!interp.is_compiled(qname(interp.current_module(), con_cell("table", 2))));
+}
+
+static void test_code_cache()
+{
+    header("test_code_cache()");
+
+    const std::string prog = R"PROG(
+color(red, 1).
+color(green, 2).
+color(blue, 3).
+
+area(circle(R), A) :- A is 3*R*R.
+area(square(S), A) :- A is S*S.
+area(rect(W,H), A) :- A is W*H.
+
+classify(X, small) :- X < 10, !.
+classify(X, medium) :- X < 100, !.
+classify(_, large).
+
+total([], 0).
+total([X|Xs], S) :- total(Xs, S0), S is S0 + X.
+
+pick(X, Y) :- ( color(X, Y) -> true ; Y = none ).
+
+len(Xs, N) :- system:length(Xs, N).
+
+go(r(L,N,T,A,K,P,Q)) :-
+    findall(C-V, color(C,V), L), len(L, N), total([1,2,3,40], T),
+    area(rect(2,3), A), classify(T, K), pick(green, P), pick(pink, Q).
+)PROG";
+
+    auto path = boost::filesystem::temp_directory_path() /
+	boost::filesystem::unique_path("wam_code_%%%%%%%%.cache");
+
+    std::string code[2], result[2];
+    size_t num_compiled = 0;
+    for (size_t i = 0; i < 2; i++) {
+	interpreter interp("test");
+	interp.set_code_cache(path.string());
+	auto start = boost::posix_time::microsec_clock::local_time();
+	interp.setup_standard_lib();
+	interp.load_program(prog);
+	interp.compile();
+	auto stop = boost::posix_time::microsec_clock::local_time();
+
+	auto *cache = interp.code_cache();
+	std::cout << (i == 0 ? "Without" : "With") << " cache: compiled in "
+		  << (stop - start).total_microseconds() << " us (hits="
+		  << cache->num_hits() << ", misses=" << cache->num_misses()
+		  << ")" << std::endl;
+	if (i == 0) {
+	    assert(cache->num_hits() == 0);
+	    num_compiled = cache->num_misses();
+	    assert(num_compiled > 0 && cache->size() == num_compiled);
+	    bool saved = interp.save_code_cache();
+	    assert(saved);
+	} else {
+	    assert(cache->num_misses() == 0);
+	    assert(cache->num_hits() == num_compiled);
+	}
+
+	// The order of switch_on_constant/structure tables is that of
+	// their hash maps, so compare them sorted.
+	std::stringstream ss;
+	interp.print_code(ss);
+	std::string line;
+	while (std::getline(ss, line)) {
+	    auto at = line.find("switch_on_");
+	    if (at != std::string::npos) {
+		at = line.find(' ', at);
+		std::vector<std::string> entries;
+		boost::split(entries, line.substr(at+1), boost::is_any_of(","));
+		for (auto &e : entries) boost::trim(e);
+		std::sort(entries.begin(), entries.end());
+		line = line.substr(0, at+1) + boost::join(entries, ", ");
+	    }
+	    code[i] += line + "\n";
+	}
+
+	term q = interp.parse("go(R).");
+	bool ok = interp.execute(q);
+	assert(ok);
+	result[i] = interp.get_result(false);
+	std::cout << result[i] << std::endl;
+	interp.reset();
+    }
+
+    assert(code[0] == code[1]);
+    assert(result[0] == result[1]);
+
+    // A cache file from another build (different fingerprint) is ignored
+    {
+	std::fstream f(path.string(), std::ios::in | std::ios::out | std::ios::binary);
+	// Magic, version, number of instructions and fingerprint size
+	f.seekp(16);
+	char c = ~wam_code_cache::build_fingerprint()[0];
+	f.write(&c, 1);
+    }
+    {
+	interpreter interp("test");
+	interp.set_code_cache(path.string());
+	assert(interp.code_cache()->size() == 0);
+    }
+
+    boost::filesystem::remove(path);
+}
+
 int main( int argc, char *argv[] )
 {
     test_up_and_down();
@@ -343,6 +609,9 @@ int main( int argc, char *argv[] )
     test_interpreter_serialize();
     test_interpreter_multi_instance();
     test_interpreter_freeze_preprocess();
+    test_fact_table();
+    test_auto_compile();
+    test_code_cache();
 
     return 0;
 }
@@ -0,0 +1,689 @@
+#include <fstream>
+#include <algorithm>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include "../common/sha256.hpp"
+#include "wam_code_cache.hpp"
+#include "wam_compiler.hpp"
+
+using namespace prologcoin::common;
+
+namespace prologcoin { namespace interp {
+
+typedef wam_code_cache::buffer_t buffer_t;
+
+class wam_code_cache_exception : public std::runtime_error
+{
+public:
+    wam_code_cache_exception(const std::string &msg)
+	: std::runtime_error(msg) { }
+};
+
+static const char MAGIC[4] = { 'W', 'A', 'M', 'C' };
+
+static inline void write_u32(buffer_t &bytes, uint32_t v)
+{
+    for (size_t i = 0; i < 4; i++) {
+	bytes.push_back(static_cast<uint8_t>(v >> (8*i)));
+    }
+}
+
+static inline void write_bytes(buffer_t &bytes, const void *p, size_t n)
+{
+    auto *b = static_cast<const uint8_t *>(p);
+    bytes.insert(bytes.end(), b, b + n);
+}
+
+struct cache_reader {
+    cache_reader(const buffer_t &bytes) : bytes_(bytes), offset_(0) { }
+
+    inline uint8_t u8() {
+	uint8_t v;
+	bytes(&v, 1);
+	return v;
+    }
+
+    inline uint32_t u32() {
+	uint8_t b[4];
+	bytes(b, 4);
+	return static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8) |
+	       (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    }
+
+    inline void bytes(void *p, size_t n) {
+	if (offset_ + n > bytes_.size()) {
+	    throw wam_code_cache_exception("Unexpected end of cache data");
+	}
+	memcpy(p, &bytes_[offset_], n);
+	offset_ += n;
+    }
+
+    inline bool at_end() const { return offset_ == bytes_.size(); }
+
+    const buffer_t &bytes_;
+    size_t offset_;
+};
+
+//
+// What an instruction refers to beyond its raw bytes; these fields
+// are written separately and patched in when the entry is loaded.
+//
+enum instruction_layout_t {
+    LAYOUT_RAW,
+    LAYOUT_CON_REG,
+    LAYOUT_TERM,
+    LAYOUT_CODE_POINT,
+    LAYOUT_SWITCH_ON_TERM,
+    LAYOUT_HASH_MAP
+};
+
+static instruction_layout_t layout_of(uint32_t type)
+{
+    switch (type) {
+    case PUT_STRUCTURE_A: case PUT_STRUCTURE_X: case PUT_STRUCTURE_Y:
+    case GET_STRUCTURE_A: case GET_STRUCTURE_X: case GET_STRUCTURE_Y:
+	return LAYOUT_CON_REG;
+    case PUT_CONSTANT: case GET_CONSTANT: case SET_CONSTANT:
+    case UNIFY_CONSTANT: case COST: case ARITH:
+	return LAYOUT_TERM;
+    case CALL: case EXECUTE: case BUILTIN: case BUILTIN_R:
+    case TRY_ME_ELSE: case RETRY_ME_ELSE: case TRY: case RETRY: case TRUST:
+    case GOTO: case RESET_LEVEL:
+	return LAYOUT_CODE_POINT;
+    case SWITCH_ON_TERM:
+	return LAYOUT_SWITCH_ON_TERM;
+    case SWITCH_ON_CONSTANT: case SWITCH_ON_STRUCTURE:
+	return LAYOUT_HASH_MAP;
+    default:
+	return LAYOUT_RAW;
+    }
+}
+
+//
+// Table from instruction type to its set_type<I>(). Filling it in also
+// runs init() of every instruction so that printers and updaters
+// (needed to relocate code) are registered even if no instruction of
+// that type has been constructed by the compiler.
+//
+typedef void (wam_instruction_base::*set_type_fn)();
+
+template<int I> struct instruction_types {
+    static void fill(set_type_fn *fns) {
+	static const wam_instruction_type T = static_cast<wam_instruction_type>(I);
+	wam_instruction<T>::init();
+	fns[I] = &wam_instruction_base::set_type<T>;
+	instruction_types<I+1>::fill(fns);
+    }
+};
+
+template<> struct instruction_types<LAST> {
+    static void fill(set_type_fn *) { }
+};
+
+static const set_type_fn * set_type_fns()
+{
+    static set_type_fn fns[LAST];
+    static bool init = [] { instruction_types<0>::fill(fns); return true; } ();
+    static_cast<void>(init);
+    return fns;
+}
+
+enum code_point_kind_t { CP_FAIL = 0, CP_TERM = 1, CP_BUILTIN = 2 };
+
+//
+// Serializes interim code. Returns false (from write) for code that
+// can't be cached, which only means the predicate is compiled every
+// time.
+//
+class entry_writer {
+public:
+    entry_writer(wam_interpreter &interp) : interp_(interp) { }
+
+    bool write(wam_instruction_base *instr)
+    {
+	uint32_t type = static_cast<uint32_t>(instr->type());
+	if (type == INTERIM_MERGE) {
+	    return false;
+	}
+	write_u32(code_, type);
+
+	auto layout = layout_of(type);
+	if (layout == LAYOUT_HASH_MAP) {
+	    auto *hm = static_cast<wam_instruction_hash_map *>(instr);
+	    write_u32(code_, hm->ai());
+	    write_u32(code_, static_cast<uint32_t>(hm->map().size()));
+	    for (auto &e : hm->map()) {
+		write_u32(code_, term_index(e.first));
+		if (!write_cp(e.second)) {
+		    return false;
+		}
+	    }
+	    return true;
+	}
+
+	std::vector<code_t> raw(instr->size());
+	memcpy(&raw[0], instr, instr->size_in_bytes());
+	reinterpret_cast<wam_instruction_base *>(&raw[0])->set_type(nullptr, instr->type());
+	write_u32(code_, static_cast<uint32_t>(raw.size()));
+	write_bytes(code_, &raw[0], instr->size_in_bytes());
+
+	switch (layout) {
+	case LAYOUT_CON_REG:
+	    write_u32(code_, term_index(static_cast<wam_instruction_con_reg *>(instr)->con()));
+	    break;
+	case LAYOUT_TERM:
+	    write_u32(code_, term_index(static_cast<wam_instruction_term *>(instr)->get_term()));
+	    break;
+	case LAYOUT_CODE_POINT:
+	    return write_cp(static_cast<wam_instruction_code_point *>(instr)->cp());
+	case LAYOUT_SWITCH_ON_TERM: {
+	    auto *sw = static_cast<wam_instruction<SWITCH_ON_TERM> *>(instr);
+	    return write_cp(sw->pv()) && write_cp(sw->pc()) &&
+		   write_cp(sw->pl()) && write_cp(sw->ps());
+	    }
+	default:
+	    break;
+	}
+	return true;
+    }
+
+    // All referenced terms as one list, so term_serializer keeps
+    // shared subterms shared. A functor on its own isn't a term, so
+    // these are written as atoms and their arities on the side.
+    void write_terms(buffer_t &bytes, std::vector<uint32_t> &arities)
+    {
+	term lst = con_cell("[]",0);
+	arities.resize(terms_.size());
+	for (size_t i = terms_.size(); i-- > 0;) {
+	    term t = terms_[i];
+	    arities[i] = 0;
+	    if (t.tag() == tag_t::CON) {
+		auto &f = reinterpret_cast<con_cell &>(t);
+		if (f.arity() > 0) {
+		    arities[i] = static_cast<uint32_t>(f.arity());
+		    t = interp_.to_atom(f);
+		}
+	    }
+	    lst = interp_.new_dotted_pair(t, lst);
+	}
+	term_serializer ser(interp_);
+	ser.write(bytes, lst);
+    }
+
+    inline const buffer_t & code() const { return code_; }
+
+private:
+    uint32_t term_index(term t)
+    {
+	auto it = index_.find(t);
+	if (it != index_.end()) {
+	    return it->second;
+	}
+	uint32_t i = static_cast<uint32_t>(terms_.size());
+	terms_.push_back(t);
+	index_[t] = i;
+	return i;
+    }
+
+    bool write_cp(const code_point &cp)
+    {
+	if (cp.has_wam_code()) {
+	    // Already bound to code at a fixed address
+	    return false;
+	}
+	if (cp.is_builtin()) {
+	    qname qn;
+	    if (!interp_.find_builtin(cp.name(), cp.bn(), qn)) {
+		return false;
+	    }
+	    code_.push_back(CP_BUILTIN);
+	    write_u32(code_, term_index(qn.first));
+	    write_u32(code_, term_index(qn.second));
+	} else if (cp.is_fail()) {
+	    code_.push_back(CP_FAIL);
+	} else {
+	    code_.push_back(CP_TERM);
+	    write_u32(code_, term_index(cp.module()));
+	    write_u32(code_, term_index(cp.term_code()));
+	}
+	return true;
+    }
+
+    wam_interpreter &interp_;
+    buffer_t code_;
+    std::vector<term> terms_;
+    std::unordered_map<term, uint32_t> index_;
+};
+
+class entry_reader {
+public:
+    entry_reader(wam_interpreter &interp, cache_reader &in, const std::vector<term> &terms)
+	: interp_(interp), in_(in), terms_(terms) { }
+
+    void read(wam_interim_code &instrs)
+    {
+	uint32_t type = in_.u32();
+	auto layout = layout_of(type);
+
+	if (layout == LAYOUT_HASH_MAP) {
+	    auto *map = interp_.new_hash_map();
+	    uint32_t ai = in_.u32();
+	    size_t n = in_.u32();
+	    for (size_t i = 0; i < n; i++) {
+		term key = get_term();
+		map->insert(std::make_pair(key, read_cp()));
+	    }
+	    if (type == SWITCH_ON_CONSTANT) {
+		instrs.push_back(wam_instruction<SWITCH_ON_CONSTANT>(map, ai));
+	    } else {
+		instrs.push_back(wam_instruction<SWITCH_ON_STRUCTURE>(map, ai));
+	    }
+	    return;
+	}
+
+	size_t sz = in_.u32();
+	std::vector<code_t> raw(sz);
+	if (sz < sizeof(wam_instruction_base)/sizeof(code_t)) {
+	    throw wam_code_cache_exception("Truncated instruction");
+	}
+	in_.bytes(&raw[0], sz*sizeof(code_t));
+	auto *instr = reinterpret_cast<wam_instruction_base *>(&raw[0]);
+	if (instr->size() != sz || static_cast<uint32_t>(instr->type()) != type) {
+	    throw wam_code_cache_exception("Inconsistent instruction");
+	}
+	if (type < LAST) {
+	    (instr->*set_type_fns()[type])();
+	} else if (type == INTERIM_LABEL) {
+	    instr->set_type(&wam_interim_instruction<INTERIM_LABEL>::invoke,
+			    static_cast<wam_instruction_type>(type));
+	} else {
+	    throw wam_code_cache_exception("Unknown instruction type");
+	}
+
+	switch (layout) {
+	case LAYOUT_CON_REG: {
+	    term t = get_term();
+	    if (t.tag() != tag_t::CON) {
+		throw wam_code_cache_exception("Expected functor");
+	    }
+	    static_cast<wam_instruction_con_reg *>(instr)->set_con(reinterpret_cast<con_cell &>(t));
+	    break;
+	    }
+	case LAYOUT_TERM:
+	    static_cast<wam_instruction_term *>(instr)->set_term(get_term());
+	    break;
+	case LAYOUT_CODE_POINT: {
+	    auto *cp_instr = static_cast<wam_instruction_code_point *>(instr);
+	    cp_instr->set_cp(read_cp());
+	    bool is_bn = type == BUILTIN || type == BUILTIN_R;
+	    if (cp_instr->cp().is_builtin() != is_bn ||
+		(is_bn && cp_instr->cp().is_builtin_recursive() != (type == BUILTIN_R))) {
+		throw wam_code_cache_exception("Builtin has changed");
+	    }
+	    break;
+	    }
+	case LAYOUT_SWITCH_ON_TERM: {
+	    auto *sw = static_cast<wam_instruction<SWITCH_ON_TERM> *>(instr);
+	    sw->pv() = read_cp();
+	    sw->pc() = read_cp();
+	    sw->pl() = read_cp();
+	    sw->ps() = read_cp();
+	    break;
+	    }
+	default:
+	    break;
+	}
+
+	instrs.push_back(*instr);
+    }
+
+private:
+    term get_term()
+    {
+	size_t i = in_.u32();
+	if (i >= terms_.size()) {
+	    throw wam_code_cache_exception("Term index out of range");
+	}
+	return terms_[i];
+    }
+
+    con_cell get_con()
+    {
+	term t = get_term();
+	if (t.tag() != tag_t::CON) {
+	    throw wam_code_cache_exception("Expected atom");
+	}
+	return reinterpret_cast<con_cell &>(t);
+    }
+
+    code_point read_cp()
+    {
+	switch (in_.u8()) {
+	case CP_FAIL:
+	    return code_point::fail();
+	case CP_TERM: {
+	    auto module = get_con();
+	    term t = get_term();
+	    code_point cp(qname(module, con_cell("[]",0)));
+	    cp.set_term_code(t);
+	    return cp;
+	    }
+	case CP_BUILTIN: {
+	    auto module = get_con();
+	    auto name = get_con();
+	    auto &bn = interp_.get_builtin(qname(module, name));
+	    if (bn.is_empty()) {
+		throw wam_code_cache_exception("Builtin is missing");
+	    }
+	    return code_point(name, bn.fn(), bn.is_recursive());
+	    }
+	default:
+	    throw wam_code_cache_exception("Unknown code point");
+	}
+    }
+
+    wam_interpreter &interp_;
+    cache_reader &in_;
+    const std::vector<term> &terms_;
+};
+
+wam_code_cache::wam_code_cache()
+    : builtins_signature_count_(0), dirty_(false), num_hits_(0), num_misses_(0)
+{
+}
+
+const std::string & wam_code_cache::build_fingerprint()
+{
+    static const std::string fingerprint = [] {
+	uint32_t one = 1;
+	std::stringstream ss;
+	ss << VERSION << " " << LAST
+	   << " " << (*reinterpret_cast<uint8_t *>(&one) == 1 ? "le" : "be")
+	   << " " << sizeof(void *) << " " << sizeof(code_t)
+	   << " " << sizeof(term) << " " << sizeof(code_point)
+	   << " " << sizeof(wam_instruction_base)
+#if defined(_MSC_VER)
+	   << " msvc " << _MSC_FULL_VER;
+#elif defined(__VERSION__)
+	   << " " << __VERSION__;
+#else
+	   ;
+#endif
+	std::string str = ss.str();
+	sha256 h;
+	h.update(str.c_str(), str.size());
+	uint8_t digest[sha256::HASH_SIZE];
+	h.finalize(digest);
+	return std::string(reinterpret_cast<const char *>(digest), sizeof(digest));
+    } ();
+    return fingerprint;
+}
+
+// Only recomputed when builtins are added, which is mostly while the
+// interpreter is set up.
+const std::string & wam_code_cache::builtins_signature(wam_interpreter &interp)
+{
+    auto &builtins = interp.get_builtins();
+    if (builtins_signature_count_ == builtins.size() && !builtins_signature_.empty()) {
+	return builtins_signature_;
+    }
+    std::vector<std::string> names;
+    names.reserve(builtins.size());
+    for (auto &e : builtins) {
+	names.push_back(interp.to_string(e.first) + "/" +
+			boost::lexical_cast<std::string>(e.first.second.arity()) +
+			(e.second.is_recursive() ? "r" : ""));
+    }
+    std::sort(names.begin(), names.end());
+    sha256 h;
+    for (auto &name : names) {
+	h.update(name.c_str(), name.size() + 1);
+    }
+    uint8_t digest[sha256::HASH_SIZE];
+    h.finalize(digest);
+    builtins_signature_ = std::string(reinterpret_cast<const char *>(digest), sizeof(digest));
+    builtins_signature_count_ = builtins.size();
+    return builtins_signature_;
+}
+
+wam_code_cache::key_t wam_code_cache::key_of(wam_interpreter &interp, const qname &qn)
+{
+    sha256 h;
+    auto &fingerprint = build_fingerprint();
+    h.update(fingerprint.data(), fingerprint.size());
+    auto &signature = builtins_signature(interp);
+    h.update(signature.data(), signature.size());
+
+    // Unqualified goals are compiled relative to the current module
+    std::string names = interp.to_string(interp.current_module()) + " " +
+	interp.to_string(qn) + "/" + boost::lexical_cast<std::string>(qn.second.arity());
+    h.update(names.c_str(), names.size() + 1);
+
+    try {
+	term_serializer ser(interp);
+	for (auto &m_clause : interp.get_predicate(qn).get_clauses()) {
+	    if (m_clause.is_erased()) {
+		continue;
+	    }
+	    buffer_t bytes;
+	    ser.write(bytes, m_clause.clause());
+	    h.update(&bytes[0], bytes.size());
+	}
+    } catch (serializer_exception &ex) {
+	return key_t();
+    }
+
+    uint8_t digest[sha256::HASH_SIZE];
+    h.finalize(digest);
+    return key_t(reinterpret_cast<const char *>(digest), sizeof(digest));
+}
+
+bool wam_code_cache::lookup(wam_interpreter &interp, const key_t &key,
+			    wam_interim_code &instrs, size_t &num_x, size_t &num_y)
+{
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+	num_misses_++;
+	return false;
+    }
+
+    size_t heap_sz = interp.heap_size();
+    bool on_heap = false;
+    wam_interim_code loaded(interp);
+
+    try {
+	cache_reader in(it->second);
+	num_x = in.u32();
+	num_y = in.u32();
+
+	buffer_t term_bytes(in.u32());
+	in.bytes(&term_bytes[0], term_bytes.size());
+	term_serializer ser(interp);
+	term lst = ser.read(term_bytes);
+	std::vector<term> terms;
+	while (interp.is_dotted_pair(lst)) {
+	    term t = interp.arg(lst, 0);
+	    if (t.tag() != tag_t::CON && t.tag() != tag_t::INT) {
+		on_heap = true;
+	    }
+	    terms.push_back(t);
+	    lst = interp.arg(lst, 1);
+	}
+	if (in.u32() != terms.size()) {
+	    throw wam_code_cache_exception("Inconsistent term table");
+	}
+	for (auto &t : terms) {
+	    size_t arity = in.u32();
+	    if (arity > 0) {
+		if (t.tag() != tag_t::CON) {
+		    throw wam_code_cache_exception("Expected functor");
+		}
+		t = interp.to_functor(reinterpret_cast<con_cell &>(t), arity);
+	    }
+	}
+
+	entry_reader reader(interp, in, terms);
+	size_t n = in.u32();
+	for (size_t i = 0; i < n; i++) {
+	    reader.read(loaded);
+	}
+	if (!in.at_end()) {
+	    throw wam_code_cache_exception("Trailing data");
+	}
+    } catch (std::runtime_error &ex) {
+	interp.trim_heap_safe(heap_sz);
+	discarded_.insert(key);
+	entries_.erase(it);
+	dirty_ = true;
+	num_misses_++;
+	return false;
+    }
+
+    // Structures (e.g. m:f in calls) must survive the heap trim after
+    // compilation, like the clauses compiled code otherwise refers to.
+    if (on_heap) {
+	interp.heap_limit();
+    } else {
+	interp.trim_heap_safe(heap_sz);
+    }
+
+    instrs.append(loaded);
+    num_hits_++;
+    return true;
+}
+
+void wam_code_cache::store(wam_interpreter &interp, const key_t &key,
+			   wam_interim_code &instrs, size_t num_x, size_t num_y)
+{
+    entry_writer writer(interp);
+    size_t n = 0;
+    for (auto *instr : instrs) {
+	if (!writer.write(instr)) {
+	    return;
+	}
+	n++;
+    }
+
+    buffer_t term_bytes;
+    std::vector<uint32_t> arities;
+    try {
+	writer.write_terms(term_bytes, arities);
+    } catch (serializer_exception &ex) {
+	return;
+    }
+
+    buffer_t entry;
+    write_u32(entry, static_cast<uint32_t>(num_x));
+    write_u32(entry, static_cast<uint32_t>(num_y));
+    write_u32(entry, static_cast<uint32_t>(term_bytes.size()));
+    write_bytes(entry, &term_bytes[0], term_bytes.size());
+    write_u32(entry, static_cast<uint32_t>(arities.size()));
+    for (auto arity : arities) {
+	write_u32(entry, arity);
+    }
+    write_u32(entry, static_cast<uint32_t>(n));
+    write_bytes(entry, &writer.code()[0], writer.code().size());
+
+    entries_[key] = entry;
+    discarded_.erase(key);
+    dirty_ = true;
+}
+
+bool wam_code_cache::read_file(const std::string &path,
+			       std::map<key_t, buffer_t> &entries)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.good()) {
+	return false;
+    }
+    buffer_t bytes((std::istreambuf_iterator<char>(in)),
+		   std::istreambuf_iterator<char>());
+
+    std::map<key_t, buffer_t> read_entries;
+    try {
+	cache_reader r(bytes);
+	char magic[sizeof(MAGIC)];
+	r.bytes(magic, sizeof(magic));
+	if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+	    r.u32() != VERSION || r.u32() != LAST) {
+	    return false;
+	}
+	auto &expected = build_fingerprint();
+	if (r.u32() != expected.size()) {
+	    return false;
+	}
+	std::string fingerprint(expected.size(), '\0');
+	r.bytes(&fingerprint[0], fingerprint.size());
+	if (fingerprint != expected) {
+	    return false;
+	}
+	size_t n = r.u32();
+	for (size_t i = 0; i < n; i++) {
+	    key_t key(r.u32(), '\0');
+	    r.bytes(&key[0], key.size());
+	    buffer_t entry(r.u32());
+	    r.bytes(&entry[0], entry.size());
+	    read_entries[key] = entry;
+	}
+    } catch (wam_code_cache_exception &ex) {
+	return false;
+    }
+    for (auto &e : read_entries) {
+	entries.insert(e);
+    }
+    return true;
+}
+
+bool wam_code_cache::load(const std::string &path)
+{
+    return read_file(path, entries_);
+}
+
+bool wam_code_cache::save(const std::string &path)
+{
+    // Keep what others have written to the same file, but not what
+    // was found to be invalid here.
+    read_file(path, entries_);
+    for (auto &key : discarded_) {
+	entries_.erase(key);
+    }
+
+    buffer_t bytes;
+    write_bytes(bytes, MAGIC, sizeof(MAGIC));
+    write_u32(bytes, VERSION);
+    write_u32(bytes, LAST);
+    auto &fingerprint = build_fingerprint();
+    write_u32(bytes, static_cast<uint32_t>(fingerprint.size()));
+    write_bytes(bytes, fingerprint.data(), fingerprint.size());
+    write_u32(bytes, static_cast<uint32_t>(entries_.size()));
+    for (auto &e : entries_) {
+	write_u32(bytes, static_cast<uint32_t>(e.first.size()));
+	write_bytes(bytes, e.first.data(), e.first.size());
+	write_u32(bytes, static_cast<uint32_t>(e.second.size()));
+	write_bytes(bytes, &e.second[0], e.second.size());
+    }
+
+    // Write to a temporary file first, so a reader never sees a
+    // partially written cache.
+    std::string tmp_path = path + ".tmp";
+    {
+	std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+	if (!out.good()) {
+	    return false;
+	}
+	out.write(reinterpret_cast<const char *>(&bytes[0]), bytes.size());
+	if (!out.good()) {
+	    return false;
+	}
+    }
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+	boost::filesystem::remove(tmp_path, ec);
+	return false;
+    }
+    dirty_ = false;
+    return true;
+}
+
+}}
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef _interp_wam_code_cache_hpp
+#define _interp_wam_code_cache_hpp
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "../common/term_serializer.hpp"
+#include "interpreter_base.hpp"
+
+namespace prologcoin { namespace interp {
+
+class wam_interpreter;
+class wam_interim_code;
+
+//
+// wam_code_cache. A persistent cache of compiled predicates so that
+// loading the same program again (e.g. the standard library or the
+// wallet implementation at startup) skips the WAM compiler.
+//
+// Entries are keyed by a hash of everything compilation depends on:
+// the module being compiled in, the predicate name and its clauses.
+// An entry holds the interim code (before labels and calls are bound)
+// so it is relocatable; loading it goes through the same load_code
+// path as freshly compiled code. Terms referenced by instructions are
+// kept in a term_serializer buffer (atoms by name, so the atom table
+// of the interpreter doesn't matter) and builtins by their name.
+//
+// The file header holds a fingerprint of the build (instruction
+// layouts, type sizes, byte order and compiler), so a cache written by
+// another build is ignored as a whole. Keys also include the builtin
+// table of the interpreter (names and arities), so interpreters with
+// different builtins never share entries.
+//
+// Any entry that doesn't fit the interpreter (e.g. a builtin that is
+// no longer there) is simply a miss and the predicate gets compiled.
+//
+class wam_code_cache {
+public:
+    typedef common::term_serializer::buffer_t buffer_t;
+    typedef std::string key_t;
+
+    // Bump when instruction layouts change.
+    static const uint32_t VERSION = 2;
+
+    wam_code_cache();
+
+    // Load entries from file. Returns false if there was no (valid)
+    // cache file.
+    bool load(const std::string &path);
+
+    // Write all entries to file (together with the entries another
+    // interpreter may have added to it since it was loaded, except
+    // those that were found to be invalid here.)
+    bool save(const std::string &path);
+
+    // Hash of the build this cache file format depends on
+    static const std::string & build_fingerprint();
+
+    key_t key_of(wam_interpreter &interp, const qname &qn);
+
+    bool lookup(wam_interpreter &interp, const key_t &key,
+		wam_interim_code &instrs, size_t &num_x, size_t &num_y);
+    void store(wam_interpreter &interp, const key_t &key,
+	       wam_interim_code &instrs, size_t num_x, size_t num_y);
+
+    inline size_t size() const { return entries_.size(); }
+    inline bool is_dirty() const { return dirty_; }
+
+    inline size_t num_hits() const { return num_hits_; }
+    inline size_t num_misses() const { return num_misses_; }
+
+private:
+    bool read_file(const std::string &path, std::map<key_t, buffer_t> &entries);
+    const std::string & builtins_signature(wam_interpreter &interp);
+
+    std::map<key_t, buffer_t> entries_;
+    std::set<key_t> discarded_;
+    std::string builtins_signature_;
+    size_t builtins_signature_count_;
+    bool dirty_;
+    size_t num_hits_;
+    size_t num_misses_;
+};
+
+}}
+
+#endif
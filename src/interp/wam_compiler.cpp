@@ -1307,6 +1307,8 @@ void wam_compiler::compile_builtin(common::con_cell module,
 		} else {
 		    seq.push_back(wam_instruction<CUT>(0));
 		}
+	    } else if (is_arith_builtin(bn.fn())) {
+		seq.push_back(wam_instruction<ARITH>(f));
 	    } else {
 		seq.push_back(wam_instruction<BUILTIN>(module, f, bn.fn()));
 	    }
@@ -1314,6 +1316,15 @@ void wam_compiler::compile_builtin(common::con_cell module,
     }
 }
 
+bool wam_compiler::is_arith_builtin(builtin_fn fn)
+{
+    return fn == builtins::is_2 ||
+	   fn == builtins::less_than_2 ||
+	   fn == builtins::less_than_equals_2 ||
+	   fn == builtins::greater_than_2 ||
+	   fn == builtins::greater_than_equals_2;
+}
+
 bool wam_compiler::is_if_then_else(const term goal)
 {
     static const common::con_cell bn_impl = common::con_cell("->",2);
@@ -1851,12 +1862,13 @@ std::vector<common::int_cell> wam_compiler::new_labels_dup(size_t n)
 }
 
 std::vector<size_t> wam_compiler::find_clauses_on_cat(
-      const managed_clauses &m_clauses, wam_compiler::first_arg_cat_t cat)
+      const managed_clauses &m_clauses, wam_compiler::first_arg_cat_t cat,
+      size_t ai)
 {
     std::vector<size_t> found;
     size_t index = 0;
     for (auto &m_clause : m_clauses) {
-        if (first_arg_cat(m_clause.clause()) == cat) {
+        if (nth_arg_cat(m_clause.clause(), ai) == cat) {
 	    found.push_back(index);
         }
 	index++;
@@ -1864,32 +1876,82 @@ std::vector<size_t> wam_compiler::find_clauses_on_cat(
     return found;
 }
 
+//
+// Fact tables (as for predicate::is_fact_table) are indexed on every
+// argument, not just the first one: the arguments (after the first)
+// that no fact has a variable in. These are switched on in order when
+// the preceding ones are unbound, so that the first bound argument
+// picks the clauses to try.
+//
+std::vector<size_t> wam_compiler::fact_table_args(const managed_clauses &subsection)
+{
+    std::vector<size_t> args;
+    if (subsection.size() < predicate::FACT_TABLE_MIN_CLAUSES) {
+	return args;
+    }
+    common::con_cell implication(":-", 2);
+    for (auto &m_clause : subsection) {
+	if (env_.functor(m_clause.clause()) == implication) {
+	    return args;
+	}
+    }
+    size_t arity = env_.functor(clause_head(subsection[0].clause())).arity();
+    for (size_t ai = 1; ai < arity; ai++) {
+	bool indexable = true;
+	for (auto &m_clause : subsection) {
+	    if (nth_arg_cat(m_clause.clause(), ai) == FIRST_VAR) {
+		indexable = false;
+		break;
+	    }
+	}
+	if (indexable) {
+	    args.push_back(ai);
+	}
+    }
+    return args;
+}
+
+void wam_compiler::emit_indexing(const managed_clauses &subsection,
+				 const std::vector<common::int_cell> &labels,
+				 wam_interim_code &instrs)
+{
+    auto more_args = fact_table_args(subsection);
+    size_t ai = 0;
+    for (auto next_ai : more_args) {
+	auto next_lbl = new_label();
+	emit_switch_on_term(subsection, labels, ai, code_point(next_lbl), instrs);
+	instrs.push_back(wam_interim_instruction<INTERIM_LABEL>(next_lbl));
+	ai = next_ai;
+    }
+    emit_switch_on_term(subsection, labels, ai, code_point(labels[0]), instrs);
+}
+
 void wam_compiler::emit_switch_on_term(const managed_clauses &subsection,
 	       const std::vector<common::int_cell> &labels,
+	       size_t ai,
+	       code_point on_var_cp,
 	       wam_interim_code &instrs)
 {
-    auto on_var_cp = code_point(labels[0]);
-
-    auto on_con = find_clauses_on_cat(subsection, FIRST_CON);
+    auto on_con = find_clauses_on_cat(subsection, FIRST_CON, ai);
     auto on_con_cp = on_con.empty() ? code_point::fail() 
 	           : (on_con.size() == 1) ? code_point(labels[2*on_con[0]+1])
 	           : code_point(new_label());
 
-    auto on_lst = find_clauses_on_cat(subsection, FIRST_LST);
+    auto on_lst = find_clauses_on_cat(subsection, FIRST_LST, ai);
     auto on_lst_cp = on_lst.empty() ? code_point::fail() 
 	           : (on_lst.size() == 1) ? code_point(labels[2*on_lst[0]+1])
 	           : code_point(new_label());
 
-    auto on_str = find_clauses_on_cat(subsection, FIRST_STR);
+    auto on_str = find_clauses_on_cat(subsection, FIRST_STR, ai);
     auto on_str_cp = on_str.empty() ? code_point::fail() 
 	           : (on_str.size() == 1) ? code_point(labels[2*on_str[0]+1])
 	           : code_point(new_label());
 
-    instrs.push_back(wam_instruction<SWITCH_ON_TERM>(on_var_cp, on_con_cp, on_lst_cp, on_str_cp));
+    instrs.push_back(wam_instruction<SWITCH_ON_TERM>(on_var_cp, on_con_cp, on_lst_cp, on_str_cp, static_cast<uint32_t>(ai)));
 
-    emit_second_level_indexing(FIRST_CON,subsection,labels,on_con,on_con_cp,instrs);
-    emit_second_level_indexing(FIRST_LST,subsection,labels,on_lst,on_lst_cp,instrs);
-    emit_second_level_indexing(FIRST_STR,subsection,labels,on_str,on_str_cp,instrs);
+    emit_second_level_indexing(FIRST_CON,subsection,labels,on_con,on_con_cp,ai,instrs);
+    emit_second_level_indexing(FIRST_LST,subsection,labels,on_lst,on_lst_cp,ai,instrs);
+    emit_second_level_indexing(FIRST_STR,subsection,labels,on_str,on_str_cp,ai,instrs);
 }
 
 void wam_compiler::emit_third_level_indexing(
@@ -1912,6 +1974,7 @@ void wam_compiler::emit_second_level_indexing(
 	      const std::vector<common::int_cell> &labels,
 	      const std::vector<size_t> &clause_indices,
 	      code_point cp,
+	      size_t ai,
 	      wam_interim_code &instrs)
 {
     if (clause_indices.size() < 2) {
@@ -1921,29 +1984,29 @@ void wam_compiler::emit_second_level_indexing(
     auto &ic = reinterpret_cast<const common::int_cell &>(cp.term_code());
     instrs.push_back(wam_interim_instruction<INTERIM_LABEL>(ic));
 
+    // Group the clauses by argument (in order of appearance) in one
+    // pass, so that large predicates compile in linear time.
+    std::vector<term> args;
+    std::vector<std::vector<size_t> > groups;
+    std::unordered_map<term, size_t> group_of;
+    for (auto clause_index : clause_indices) {
+	auto arg0 = nth_arg(subsection[clause_index].clause(), ai);
+	auto it = group_of.find(arg0);
+	if (it == group_of.end()) {
+	    it = group_of.insert(std::make_pair(arg0, groups.size())).first;
+	    args.push_back(arg0);
+	    groups.push_back(std::vector<size_t>());
+	}
+	groups[it->second].push_back(clause_index);
+    }
+
     auto *map = interp_.new_hash_map();
     std::vector<term> for_third_arg;
     std::vector<std::vector<size_t> > for_third_indices;
-    for (auto clause_index : clause_indices) {
+    for (size_t g = 0; g < groups.size(); g++) {
 	common::int_cell new_lbl(0);
-	auto &m_clause = subsection[clause_index];
-
-	auto arg0 = first_arg(m_clause.clause());
-
-	// Already managed?
-	if (map->count(arg0)) {
-	    continue;
-	}
-
-	// Get all clauses with the same arg
-	std::vector<size_t> same_arg0;
-	for (auto ci : clause_indices) {
-	    auto &other_m_clause = subsection[ci];
-	    auto other_arg0 = first_arg(other_m_clause.clause());
-	    if (arg0 == other_arg0) {
-		same_arg0.push_back(ci);
-	    }
-	}
+	auto arg0 = args[g];
+	auto &same_arg0 = groups[g];
 	if (same_arg0.size() == 1) {
 	    // Unique? Then direct jump
 	    map->insert(std::make_pair(arg0, code_point(labels[2*same_arg0[0]+1])));
@@ -1956,8 +2019,8 @@ void wam_compiler::emit_second_level_indexing(
 	}
     }
     switch (cat) {
-    case FIRST_CON: instrs.push_back(wam_instruction<SWITCH_ON_CONSTANT>(map)); break;
-    case FIRST_STR: instrs.push_back(wam_instruction<SWITCH_ON_STRUCTURE>(map)); break;
+    case FIRST_CON: instrs.push_back(wam_instruction<SWITCH_ON_CONSTANT>(map, static_cast<uint32_t>(ai))); break;
+    case FIRST_STR: instrs.push_back(wam_instruction<SWITCH_ON_STRUCTURE>(map, static_cast<uint32_t>(ai))); break;
     default: break;
     }
     size_t n = for_third_arg.size();
@@ -1980,7 +2043,7 @@ void wam_compiler::compile_subsection(const managed_clauses &subsection,
     
     if (n > 1) {
         std::vector<common::int_cell> labels = new_labels(2*n);
-	if (!arity_0) emit_switch_on_term(subsection, labels, instrs);
+	if (!arity_0) emit_indexing(subsection, labels, instrs);
 	for (size_t i = 0; i < n; i++) {
 	    emit_cp(labels, i, n, instrs);
 	    auto &m_clause = subsection[i];
@@ -2088,14 +2151,14 @@ std::vector<managed_clauses> wam_compiler::partition_clauses(
     return partitioned;
 }
 
-term wam_compiler::first_arg(const term clause)
+term wam_compiler::nth_arg(const term clause, size_t ai)
 {
     auto head = clause_head(clause);
     auto f = env_.functor(head);
-    if (f.arity() == 0) {
+    if (f.arity() <= ai) {
 	return env_.EMPTY_LIST;
     }
-    auto arg = env_.arg(head, 0);
+    auto arg = env_.arg(head, ai);
     switch (arg.tag()) {
     case common::tag_t::REF: case common::tag_t::RFW: return arg;
     case common::tag_t::CON: return arg;
@@ -2106,9 +2169,9 @@ term wam_compiler::first_arg(const term clause)
     }
 }
 
-wam_compiler::first_arg_cat_t wam_compiler::first_arg_cat(const term cl)
+wam_compiler::first_arg_cat_t wam_compiler::nth_arg_cat(const term cl, size_t ai)
 {
-    term arg = first_arg(cl);
+    term arg = nth_arg(cl, ai);
 
     if (interp_.is_dotted_pair(arg)) {
 	return FIRST_LST;
@@ -485,6 +485,7 @@ private:
     bool clause_needs_environment(const term clause);
     bool is_conjunction(const term goal);
     bool is_disjunction(const term goal);
+    bool is_arith_builtin(builtin_fn fn);
     bool is_if_then_else(const term goal);
     void insert_phi_nodes(const term goal_a, const term goal_b,
 			  wam_interim_code &code);
@@ -546,9 +547,13 @@ private:
     enum first_arg_cat_t {
         FIRST_VAR, FIRST_CON, FIRST_LST, FIRST_STR
     };
-    first_arg_cat_t first_arg_cat(const term clause);
+    inline first_arg_cat_t first_arg_cat(const term clause)
+    { return nth_arg_cat(clause, 0); }
+    first_arg_cat_t nth_arg_cat(const term clause, size_t ai);
 
-    term first_arg(const term clause);
+    inline term first_arg(const term clause)
+    { return nth_arg(clause, 0); }
+    term nth_arg(const term clause, size_t ai);
     common::con_cell first_arg_functor(const term clause);
     bool first_arg_is_var(const term clause);
     bool first_arg_is_con(const term clause);
@@ -558,9 +563,16 @@ private:
     std::vector<managed_clauses> partition_clauses_nonvar(const managed_clauses &clauses);
     std::vector<managed_clauses> partition_clauses_first_arg(const managed_clauses &clauses);
     std::vector<size_t> find_clauses_on_cat(const managed_clauses &clauses,
-					    first_arg_cat_t cat);
+					    first_arg_cat_t cat,
+					    size_t ai);
+    std::vector<size_t> fact_table_args(const managed_clauses &subsection);
+    void emit_indexing(const managed_clauses &subsection,
+		       const std::vector<common::int_cell> &labels,
+		       wam_interim_code &instrs);
     void emit_switch_on_term(const managed_clauses &subsection,
 			     const std::vector<common::int_cell> &labels,
+			     size_t ai,
+			     code_point on_var_cp,
 			     wam_interim_code &instrs);
     void emit_second_level_indexing(
 	      wam_compiler::first_arg_cat_t cat,
@@ -568,6 +580,7 @@ private:
 	      const std::vector<common::int_cell> &labels,
 	      const std::vector<size_t> &clause_indices,
 	      code_point cp,
+	      size_t ai,
 	      wam_interim_code &instrs);
     void emit_third_level_indexing(
 	     const std::vector<size_t> &clause_indices,
@@ -1,5 +1,7 @@
+#include <boost/filesystem.hpp>
 #include "wam_interpreter.hpp"
 #include "wam_compiler.hpp"
+#include "wam_code_cache.hpp"
 
 namespace prologcoin { namespace interp {
 
@@ -97,7 +99,7 @@ void wam_code::print_code(std::ostream &out, size_t from, size_t to)
     }
 }
 
-wam_interpreter::wam_interpreter(const std::string &name) : interpreter_base(name), wam_code(*this), auto_wam_(false), compiler_(nullptr)
+wam_interpreter::wam_interpreter(const std::string &name) : interpreter_base(name), wam_code(*this), auto_wam_(false), compiler_(nullptr), code_cache_(nullptr)
 {
     total_reset();
 }
@@ -105,6 +107,7 @@ wam_interpreter::wam_interpreter(const std::string &name) : interpreter_base(nam
 wam_interpreter::~wam_interpreter()
 {
     delete compiler_;
+    delete code_cache_;
     for (auto m : hash_maps_) {
 	delete m;
     }
@@ -242,13 +245,23 @@ bool wam_interpreter::compile(const qname &qn)
     size_t heap_sz = heap_size();
 
     wam_interim_code instrs(*this);
-    compiler_->clear();
-    if (!compiler_->compile_predicate(qn, instrs)) {
-	trim_heap_safe(heap_sz);
-	return false;
+    size_t xn_size = 0, yn_size = 0;
+    wam_code_cache::key_t key;
+    if (code_cache_) {
+	key = code_cache_->key_of(*this, qn);
+    }
+    if (key.empty() || !code_cache_->lookup(*this, key, instrs, xn_size, yn_size)) {
+	compiler_->clear();
+	if (!compiler_->compile_predicate(qn, instrs)) {
+	    trim_heap_safe(heap_sz);
+	    return false;
+	}
+	xn_size = compiler_->get_num_x_registers(instrs);
+	yn_size = compiler_->get_environment_size_of(instrs);
+	if (!key.empty()) {
+	    code_cache_->store(*this, key, instrs, xn_size, yn_size);
+	}
     }
-    size_t xn_size = compiler_->get_num_x_registers(instrs);
-    size_t yn_size = compiler_->get_environment_size_of(instrs);    
     size_t first_offset = next_offset();
     
     load_code(instrs);
@@ -263,6 +276,10 @@ bool wam_interpreter::compile(const qname &qn)
 
     get_predicate(qn).set_was_compiled(true);
 
+    // The code is up to date with the clauses; don't recompile it on
+    // the first call.
+    clear_updated_predicate(qn);
+
     return true;
 }
 
@@ -289,19 +306,38 @@ void wam_interpreter::compile()
     clear_updated_predicates();
 }
 
+void wam_interpreter::set_code_cache(const std::string &path)
+{
+    // Saved later, possibly after the current directory has changed
+    auto abs_path = boost::filesystem::absolute(path).string();
+    if (code_cache_ && code_cache_path_ == abs_path) {
+	return;
+    }
+    delete code_cache_;
+    code_cache_ = new wam_code_cache();
+    code_cache_path_ = abs_path;
+    code_cache_->load(abs_path);
+}
+
+bool wam_interpreter::save_code_cache()
+{
+    if (code_cache_ == nullptr || !code_cache_->is_dirty()) {
+	return false;
+    }
+    return code_cache_->save(code_cache_path_);
+}
+
 void wam_interpreter::recompile()
 {
-    std::vector<qname> recompiled;
-    for (auto &qn : get_updated_predicates()) {
+    // compile() clears the updated flag, so iterate over a copy
+    std::vector<qname> updated(get_updated_predicates().begin(),
+			       get_updated_predicates().end());
+    for (auto &qn : updated) {
         if (was_compiled(qn)) {
 	    remove_compiled(qn);
 	    compile(qn);
-	    recompiled.push_back(qn);
 	}
     }
-    for (auto &qn : recompiled) {
-        clear_updated_predicate(qn);
-    }
 }
 
 void wam_interpreter::recompile_if_needed(const qname &qn)
@@ -322,7 +358,8 @@ void wam_interpreter::auto_compile(const qname &qn)
     bool failed = false;
     if (pred.ok_to_compile()) {
 	auto num_clauses = pred.num_clauses();
-	if (num_clauses > 0 && num_clauses <= 10) {
+	if (num_clauses > 0 && num_clauses <= AUTO_COMPILE_MAX_CLAUSES &&
+	    !pred.is_fact_table(*this)) {
 	    if (!compile(qn)) {
 		failed = true;
 	    }
@@ -96,6 +96,7 @@ enum wam_instruction_type {
   RESET_LEVEL, // --- "" ---
 
   COST, // Non-standard WAM; for accumulated cost
+  ARITH, // Non-standard WAM; is/2 and arithmetic comparisons inline
 
   LAST
 };
@@ -103,6 +104,7 @@ enum wam_instruction_type {
 class wam_interpreter;
 class wam_compiler;
 class wam_interim_code;
+class wam_code_cache;
 
 typedef uint64_t code_t;
 
@@ -368,11 +370,14 @@ private:
 class wam_instruction_hash_map : public wam_instruction_base
 {
 public:
-    inline wam_instruction_hash_map(fn_type fn, uint64_t sz_bytes, wam_instruction_type t, wam_hash_map *map)
-	: wam_instruction_base(fn, sz_bytes, t), map_(map) { }
+    inline wam_instruction_hash_map(fn_type fn, uint64_t sz_bytes, wam_instruction_type t, wam_hash_map *map, uint32_t ai)
+	: wam_instruction_base(fn, sz_bytes, t), map_(map), ai_(ai) { }
 
     inline wam_hash_map & map() const { return *map_; }
 
+    // The argument register switched on
+    inline uint32_t ai() const { return ai_; }
+
     inline void update(code_t *old_base, code_t *new_base)
     {
 	for (auto &v : map()) {
@@ -389,6 +394,7 @@ protected:
 
 private:
     wam_hash_map *map_;
+    uint32_t ai_;
 };
 
 class wam_code
@@ -730,6 +736,13 @@ public:
     void recompile();
     void recompile_if_needed(const qname &qn);
     void auto_compile(const qname &qn);
+
+    // Predicates up to this many clauses are auto compiled. The
+    // compile runs on the first call (and isn't charged), so this is
+    // kept to what compiles in a few milliseconds (see
+    // test_fact_table.) Fact tables are not auto compiled; the naive
+    // interpreter indexes them on every argument without compiling.
+    static const size_t AUTO_COMPILE_MAX_CLAUSES = 256;
     void print_code(std::ostream &out);
     void print_code(std::ostream &out, size_t from, size_t to);    
     void print_code(std::ostream &out, const qname &qn);
@@ -741,6 +754,15 @@ public:
     inline void set_auto_wam(bool enabled)
     { auto_wam_ = enabled; }
 
+    // Compile through a persistent cache (see wam_code_cache.hpp.)
+    // Loads the cache file at path if there is one; compiled predicates
+    // not yet in it are added and written back by save_code_cache().
+    void set_code_cache(const std::string &path);
+    bool save_code_cache();
+
+    inline wam_code_cache * code_cache()
+    { return code_cache_; }
+
 protected:
     void load_code(wam_interim_code &code);
 
@@ -766,11 +788,14 @@ private:
     bool auto_wam_;
     bool fail_;
     wam_compiler *compiler_;
+    wam_code_cache *code_cache_;
+    std::string code_cache_path_;
 
     // Set with all offsets
     std::set <size_t> label_offsets;
 
     template<wam_instruction_type I> friend class wam_instruction;
+    friend class wam_code_cache;
 
     static inline size_t num_y(interpreter_base *interp, bool use_previous)
     {
@@ -1779,9 +1804,10 @@ private:
     inline void switch_on_term(const code_point &pv,
 			       const code_point &pc,
 			       const code_point &pl,
-			       const code_point &ps)
+			       const code_point &ps,
+			       size_t ai)
     {
-	term t = deref(a(0));
+	term t = deref(a(ai));
 
 	switch (t.tag()) {
 	case common::tag_t::CON: case common::tag_t::INT:
@@ -1820,9 +1846,9 @@ private:
 	}
     }
 
-    inline void switch_on_constant(wam_hash_map &map)
+    inline void switch_on_constant(wam_hash_map &map, size_t ai)
     {
-	term t = deref(a(0));
+	term t = deref(a(ai));
 	auto it = map.find(t);
 	if (it == map.end()) {
 	    backtrack();
@@ -1831,9 +1857,9 @@ private:
 	}
     }
 
-    inline void switch_on_structure(wam_hash_map &map)
+    inline void switch_on_structure(wam_hash_map &map, size_t ai)
     {
-	term t = functor(deref(a(0)));
+	term t = functor(deref(a(ai)));
 
 	auto it = map.find(t);
 	if (it == map.end()) {
@@ -1892,6 +1918,55 @@ private:
 	goto_next_instruction();
     }
 
+    inline common::term eval_arith(common::term expr, common::con_cell f)
+    {
+	int64_t value;
+	if (arith().eval_small(expr, value)) {
+	    return common::int_cell(value);
+	}
+	return arith().eval(expr, atom_name(f) + "/2");
+    }
+
+    // Same semantics (and cost) as the is/2, </2, =</2, >/2 and >=/2
+    // builtins, but without the builtin call and with small integer
+    // expressions evaluated directly.
+    inline bool inline_arith(common::con_cell f)
+    {
+	static const common::con_cell is_2("is", 2);
+	static const common::con_cell less_than_2("<", 2);
+	static const common::con_cell less_than_equals_2("=<", 2);
+	static const common::con_cell greater_than_2(">", 2);
+
+	set_num_of_args(2);
+	goto_next_instruction();
+
+	term lhs = deref(a(0));
+	term rhs = deref(a(1));
+	bool r;
+	if (f == is_2) {
+	    r = unify(lhs, eval_arith(rhs, f));
+	} else {
+	    term result_lhs = eval_arith(lhs, f);
+	    term result_rhs = eval_arith(rhs, f);
+	    int cmp = standard_order(result_lhs, result_rhs);
+	    if (f == less_than_2) {
+		r = cmp < 0;
+	    } else if (f == less_than_equals_2) {
+		r = cmp <= 0;
+	    } else if (f == greater_than_2) {
+		r = cmp > 0;
+	    } else {
+		r = cmp >= 0;
+	    }
+	}
+	if (!r) {
+	    backtrack();
+	} else {
+	    check_frozen();
+	}
+	return r;
+    }
+
     friend class wam_code;
 
     friend class test_wam_interpreter;
@@ -3609,9 +3684,10 @@ public:
       inline wam_instruction(code_point pv,
 			     code_point pc,
 			     code_point pl,
-			     code_point ps) :
+			     code_point ps,
+			     uint32_t ai = 0) :
       wam_instruction_base(&invoke, sizeof(*this), SWITCH_ON_TERM),
-      pv_(pv), pc_(pc), pl_(pl), ps_(ps) {
+      pv_(pv), pc_(pc), pl_(pl), ps_(ps), ai_(ai) {
       init();
     }
 
@@ -3627,6 +3703,7 @@ public:
     inline code_point & pc() { return pc_; }
     inline code_point & pl() { return pl_; }
     inline code_point & ps() { return ps_; }
+    inline uint32_t ai() const { return ai_; }
 
     inline void update(code_t *old_base, code_t *new_base)
     {
@@ -3639,13 +3716,16 @@ public:
     static void invoke(wam_interpreter &interp, wam_instruction_base *self)
     {
 	auto self1 = reinterpret_cast<wam_instruction<SWITCH_ON_TERM> *>(self);
-	interp.switch_on_term(self1->pv(), self1->pc(), self1->pl(), self1->ps());
+	interp.switch_on_term(self1->pv(), self1->pc(), self1->pl(), self1->ps(), self1->ai());
     }
 
     static void print(std::ostream &out, wam_interpreter &interp, wam_instruction_base *self)
     {
 	auto self1 = reinterpret_cast<wam_instruction<SWITCH_ON_TERM> *>(self);
 	out << "switch_on_term ";
+	if (self1->ai() != 0) {
+	    out << "a" << self1->ai() << ", ";
+	}
         if (self1->pv().is_fail()) {
 	    out << "V->fail";
 	} else {
@@ -3681,12 +3761,13 @@ public:
     code_point pc_;
     code_point pl_;
     code_point ps_;
+    uint32_t ai_;
 };
 
 template<> class wam_instruction<SWITCH_ON_CONSTANT> : public wam_instruction_hash_map {
 public:
-    inline wam_instruction(wam_hash_map *map) :
-      wam_instruction_hash_map(&invoke, sizeof(*this), SWITCH_ON_CONSTANT,map){
+    inline wam_instruction(wam_hash_map *map, uint32_t ai = 0) :
+      wam_instruction_hash_map(&invoke, sizeof(*this), SWITCH_ON_CONSTANT,map,ai){
         init();
     }
 
@@ -3701,13 +3782,16 @@ public:
     static void invoke(wam_interpreter &interp, wam_instruction_base *self)
     {
 	auto self1 = reinterpret_cast<wam_instruction<SWITCH_ON_CONSTANT> *>(self);
-	interp.switch_on_constant(self1->map());
+	interp.switch_on_constant(self1->map(), self1->ai());
     }
 
     static void print(std::ostream &out, wam_interpreter &interp, wam_instruction_base *self)
     {
 	auto self1 = reinterpret_cast<wam_instruction<SWITCH_ON_CONSTANT> *>(self);
 	out << "switch_on_constant ";
+	if (self1->ai() != 0) {
+	    out << "a" << self1->ai() << ", ";
+	}
 	bool first = true;
 	for (auto &v : self1->map()) {
 	    if (!first) out << ", ";
@@ -3721,9 +3805,9 @@ public:
 
 template<> class wam_instruction<SWITCH_ON_STRUCTURE> : public wam_instruction_hash_map {
 public:
-    inline wam_instruction(wam_hash_map *map) :
+    inline wam_instruction(wam_hash_map *map, uint32_t ai = 0) :
         wam_instruction_hash_map(&invoke, sizeof(*this), SWITCH_ON_STRUCTURE,
-				 map) {
+				 map, ai) {
         init();
     }
 
@@ -3738,13 +3822,16 @@ public:
     static void invoke(wam_interpreter &interp, wam_instruction_base *self)
     {
 	auto self1 = reinterpret_cast<wam_instruction<SWITCH_ON_STRUCTURE> *>(self);
-	interp.switch_on_structure(self1->map());
+	interp.switch_on_structure(self1->map(), self1->ai());
     }
 
     static void print(std::ostream &out, wam_interpreter &interp, wam_instruction_base *self)
     {
 	auto self1 = reinterpret_cast<wam_instruction<SWITCH_ON_STRUCTURE> *>(self);
 	out << "switch_on_structure ";
+	if (self1->ai() != 0) {
+	    out << "a" << self1->ai() << ", ";
+	}
 	bool first = true;
 	for (auto &v : self1->map()) {
 	    if (!first) out << ", ";
@@ -3957,6 +4044,38 @@ public:
     }
 };
 
+template<> class wam_instruction<ARITH> : public wam_instruction_term {
+public:
+    inline wam_instruction(common::con_cell f) :
+	wam_instruction_term(&invoke, sizeof(*this), ARITH, f) {
+      init();
+    }
+
+    static inline void init() {
+	static bool init = [] {
+ 	    register_printer(&invoke, &print);
+	    return true; } ();
+	static_cast<void>(init);
+    }
+
+    inline common::con_cell f() const
+    {
+	const common::term t = get_term();
+	return reinterpret_cast<const common::con_cell &>(t);
+    }
+
+    static void invoke(wam_interpreter &interp, wam_instruction_base *self)
+    {
+	auto self1 = reinterpret_cast<wam_instruction<ARITH> *>(self);
+        interp.inline_arith(self1->f());
+    }
+
+    static void print(std::ostream &out, wam_interpreter &interp, wam_instruction_base *self)
+    {
+	auto self1 = reinterpret_cast<wam_instruction<ARITH> *>(self);
+        out << "arith " << interp.to_string(self1->f()) << "/2";
+    }
+};
 
 template<wam_instruction_type I> inline void wam_instruction_base::set_type()
 {
@@ -19,6 +19,9 @@ static std::string dir;
 static bool is_wallet = false;
 static bool is_meta = false;
 static bool check_pow = true;
+static size_t num_interpreters = interpreter_pool::DEFAULT_MAX_SIZE;
+static size_t block_cache_mb = prologcoin::global::global::BLOCK_CACHE_SIZE / (1024*1024);
+static size_t block_prefetch = prologcoin::global::global::BLOCK_PREFETCH;
 
 static void help()
 {
@@ -30,6 +33,9 @@ static void help()
     std::cout << "  --port <number> (start service on this port, default is " << self_node::DEFAULT_PORT << ")" << std::endl;
     std::cout << "  --name <string> (set friendly name on node, default is noname)" << std::endl;
     std::cout << "  --dir <dir> (location of data directory)" << std::endl;
+    std::cout << "  --interpreters <number> (idle session interpreters kept for reuse, default is " << interpreter_pool::DEFAULT_MAX_SIZE << ")" << std::endl;
+    std::cout << "  --block_cache <number> (MB of cached global heap blocks, default is " << prologcoin::global::global::BLOCK_CACHE_SIZE / (1024*1024) << ")" << std::endl;
+    std::cout << "  --block_prefetch <number> (heap blocks loaded ahead on sequential reads, default is " << prologcoin::global::global::BLOCK_PREFETCH << ")" << std::endl;
 
     std::cout << std::endl;
     std::cout << "Example: " << program_name << " --interactive --port 8700" << std::endl;
@@ -70,6 +76,14 @@ static void start()
 	node.set_check_pow(false);
     }
 
+    size_t warm = interpreter_pool::DEFAULT_WARM_SIZE;
+    if (num_interpreters < warm) warm = num_interpreters;
+    node.interpreter_pool().set_max_size(num_interpreters);
+    node.interpreter_pool().set_warm_size(warm);
+
+    node.global().set_block_cache_size(block_cache_mb*1024*1024);
+    node.global().set_block_prefetch(block_prefetch);
+
     node.start();
     // node.start_sync();
 
@@ -192,6 +206,33 @@ int main(int argc, char *argv[])
         dir = dir_opt;
     }
 
+    std::string interpreters_opt = get_option(args, "--interpreters");
+    if (!interpreters_opt.empty()) {
+	try {
+	    num_interpreters = boost::lexical_cast<size_t>(interpreters_opt);
+	} catch (boost::exception &ex) {
+	    std::cout << std::endl << program_name << ": erroneous number of interpreters: " << interpreters_opt << std::endl << std::endl;
+	}
+    }
+
+    std::string block_cache_opt = get_option(args, "--block_cache");
+    if (!block_cache_opt.empty()) {
+	try {
+	    block_cache_mb = boost::lexical_cast<size_t>(block_cache_opt);
+	} catch (boost::exception &ex) {
+	    std::cout << std::endl << program_name << ": erroneous block cache size: " << block_cache_opt << std::endl << std::endl;
+	}
+    }
+
+    std::string block_prefetch_opt = get_option(args, "--block_prefetch");
+    if (!block_prefetch_opt.empty()) {
+	try {
+	    block_prefetch = boost::lexical_cast<size_t>(block_prefetch_opt);
+	} catch (boost::exception &ex) {
+	    std::cout << std::endl << program_name << ": erroneous number of prefetched blocks: " << block_prefetch_opt << std::endl << std::endl;
+	}
+    }
+
     std::string ignore_pow = get_option(args, "--ignore_pow");
     if (ignore_pow == "1" || ignore_pow == "true") {
 	check_pow = false;
@@ -32,6 +32,8 @@ meta_interpreter::~meta_interpreter() {
 	auto *w = it.second;
 	delete w;
     }
+    // Also keep what got auto compiled during the session
+    save_code_cache();
 }
 
 void meta_interpreter::init()
@@ -40,10 +42,14 @@ void meta_interpreter::init()
     load_builtins_file_io();
     ec::builtins::load(*this);
     coin::builtins::load(*this);
+    if (!home_dir_.empty()) {
+	set_code_cache((boost::filesystem::path(home_dir_) / "wam_code.cache").string());
+    }
     setup_standard_lib();
     set_current_module(con_cell("meta",0));
     setup_local_builtins();
     set_auto_wam(true);
+    save_code_cache();
 }
 
 void meta_interpreter::total_reset()
@@ -272,7 +272,7 @@ void connection::run()
 	break;
     case STATE_IDLE:
 	timer_.expires_from_now(boost::posix_time::microseconds(
-			self().get_fast_timer_interval_microseconds()));
+			idle_microseconds()));
 	timer_.async_wait(
 		  strand_.wrap(
 		     [this](const error_code &ec) {
@@ -302,9 +302,15 @@ void connection::trigger_now()
 			    self().get_fast_timer_interval_microseconds()));
 }
 
+uint64_t connection::idle_microseconds()
+{
+    return self().get_fast_timer_interval_microseconds();
+}
+
 in_connection::in_connection(self_node &self)
     : connection(self, CONNECTION_IN, env_),
-      session_(nullptr)
+      session_(nullptr),
+      request_id_()
 {
     setup_commands();
     prepare_receive();
@@ -342,12 +348,24 @@ void in_connection::on_state()
 
 void in_connection::reply_ok(const term t)
 {
-    send_ok(t);
+    if (request_id_ == term()) {
+	send_ok(t);
+    } else {
+	auto &e = env_;
+	send(e.new_term(con_cell("rep",2),
+			{request_id_, e.new_term(e.functor("ok",1),{t})}));
+    }
 }
 
 void in_connection::reply_error(const term t)
 {
-    send_error(t);
+    if (request_id_ == term()) {
+	send_error(t);
+    } else {
+	auto &e = env_;
+	send(e.new_term(con_cell("rep",2),
+			{request_id_, e.new_term(e.functor("error",1),{t})}));
+    }
 }
 
 void in_connection::reply_exception(const std::string &msg)
@@ -524,6 +542,7 @@ void in_connection::process_command(const term cmd)
 void in_connection::process_query()
 {
     auto &e = env_;
+    request_id_ = term();
     auto t = received();
     if (t == term()) {
 	return;
@@ -533,6 +552,17 @@ void in_connection::process_query()
 	return;
     }
     auto f = e.functor(t);
+    if (f == con_cell("req",2)) {
+	// Pipelined request: req(Id, Msg). Requests are processed in
+	// the order they arrive, but the client matches replies by id.
+	request_id_ = e.arg(t,0);
+	t = e.arg(t,1);
+	if (t.tag() != tag_t::STR) {
+	    reply_error(e.new_term(e.functor("unrecognized_command",1),{t}));
+	    return;
+	}
+	f = e.functor(t);
+    }
     if (f == con_cell("command",1)) {
 	process_command(e.arg(t,0));
     } else if (f == con_cell("query",2)) {
@@ -648,7 +678,7 @@ void in_connection::process_execution(const term cmd, bool in_query, bool silent
 //
 
 out_connection::out_connection(self_node &self, out_connection::out_type_t t, const ip_service &ip)
-    :  connection(self, CONNECTION_OUT, env_), out_type_(t), ip_(ip), init_in_progress_(false), use_heartbeat_(true), connected_(false), sent_my_name_(false), work_( &out_task::comparator ), busy_count_(0), pending_queries_(0)
+    :  connection(self, CONNECTION_OUT, env_), out_type_(t), ip_(ip), init_in_progress_(false), use_heartbeat_(true), connected_(false), sent_my_name_(false), next_request_id_(0), busy_count_(0), pending_queries_(0)
 {
     using namespace boost::system;
 
@@ -683,11 +713,16 @@ void out_connection::delete_tasks()
 {
     boost::lock_guard<boost::recursive_mutex> guard(work_lock_);
 
-    while (!work_.empty()) {
-	out_task *t = work_.top();
-        delete t;
-	work_.pop();
+    std::vector<out_task *> all;
+    work_.for_each([&](out_task *t) { all.push_back(t); });
+    work_.clear();
+    for (auto *t : all) {
+	delete t;
     }
+    for (auto &p : in_flight_) {
+	delete p.second;
+    }
+    in_flight_.clear();
 }
 
 out_task * out_connection::create_heartbeat_task()
@@ -736,7 +771,7 @@ void out_connection::reschedule(out_task *task, utime t)
     // as it doesn't pop the work queue, then we'll pop the work queue
     // to remove it first.
     if (task->get_state() == out_task::SEND) {
-	work_.pop();
+	work_.remove(task);
     }
 
     // Never touch the item currently processing. This causes problems          
@@ -744,7 +779,7 @@ void out_connection::reschedule(out_task *task, utime t)
     // garbled by a new task.)
     if (!work_.empty()) {
         out_task *t_next = work_.top();
-        if (t_next != task && t_next->get_state() != out_task::IDLE) {
+        if (t_next != nullptr && t_next != task && t_next->get_state() != out_task::IDLE) {
 	   if (t <= t_next->get_when()) {
 	      t = t_next->get_when();
 	      t++;
@@ -839,13 +874,18 @@ void out_connection::send_next_task()
 	return;
     }
     auto next_task = work_.top();
-    if (!next_task->expiring()) {
+    if (next_task == nullptr || !next_task->expiring()) {
 	idle_state();
 	return;
     }
     if (next_task->get_state() == out_task::KILLED) {
-	delete next_task;
 	work_.pop();
+	delete next_task;
+	return;
+    }
+    work_.started(next_task);
+    if (next_task->is_pipelined() && is_connected()) {
+	send_pipelined_task(next_task);
 	return;
     }
     next_task->set_state(out_task::SEND);
@@ -861,6 +901,63 @@ void out_connection::send_next_task()
     }
 }
 
+//
+// Send a pipelined task as req(Id, Msg) without waiting for the
+// replies to the ones already sent. It leaves the work queue and is
+// looked up by id once rep(Id, Reply) arrives.
+//
+void out_connection::send_pipelined_task(out_task *task)
+{
+    work_.pop();
+    task->set_state(out_task::SEND);
+    task->set_term(term());
+    task->process();
+    if (task->get_term() == term()) {
+	// Nothing to send (yet.) Put it back.
+	task->set_state(out_task::IDLE);
+	reschedule_last(task);
+	if (in_flight_.empty()) {
+	    idle_state();
+	} else {
+	    prepare_receive();
+	}
+	return;
+    }
+    auto id = next_request_id_++;
+    in_flight_[id] = task;
+    send(env_.new_term(con_cell("req",2), {int_cell(id), task->get_term()}));
+}
+
+bool out_connection::can_pipeline_next()
+{
+    if (in_flight_.size() >= MAX_IN_FLIGHT || work_.empty() || !is_connected()) {
+	return false;
+    }
+    auto *next_task = work_.top();
+    return next_task != nullptr && next_task->is_pipelined() && next_task->expiring() &&
+	   next_task->get_state() == out_task::IDLE;
+}
+
+out_task * out_connection::take_in_flight(term reply)
+{
+    auto &e = env_;
+    if (reply.tag() != tag_t::STR || e.functor(reply) != con_cell("rep",2)) {
+	return nullptr;
+    }
+    auto id_term = e.arg(reply, 0);
+    if (id_term.tag() != tag_t::INT) {
+	return nullptr;
+    }
+    auto it = in_flight_.find(reinterpret_cast<int_cell &>(id_term).value());
+    if (it == in_flight_.end()) {
+	return nullptr;
+    }
+    auto *task = it->second;
+    in_flight_.erase(it);
+    task->set_term(e.arg(reply, 1));
+    return task;
+}
+
 void out_connection::on_state()
 {
     boost::lock_guard<boost::recursive_mutex> guard(work_lock_);
@@ -868,11 +965,19 @@ void out_connection::on_state()
     switch (get_state()) {
     case STATE_IDLE: if (!is_stopped()) send_next_task(); break;
     case STATE_RECEIVED: {
-	auto task = work_.top();
-	work_.pop();
-	auto r = received(task->env());
+	out_task *task = nullptr;
+	if (!in_flight_.empty()) {
+	    task = take_in_flight(received(env_));
+	    if (task == nullptr) {
+		error(reason_t::ERROR_UNRECOGNIZED, "Unexpected pipelined reply");
+		break;
+	    }
+	} else {
+	    task = work_.top();
+	    work_.pop();
+	    task->set_term(received(task->env()));
+	}
 	task->set_state(out_task::RECEIVED);
-	task->set_term(r);
 	task->process();
 	if (task->get_state() == out_task::WAIT) {
 	    self().add_waiting(task);
@@ -880,12 +985,20 @@ void out_connection::on_state()
 	    delete task;
 	}
 	if (!is_stopped()) {
-	    send_next_task();
+	    if (!in_flight_.empty() && !can_pipeline_next()) {
+		prepare_receive();
+	    } else {
+		send_next_task();
+	    }
 	}
 	break;
         }
     case STATE_SENT:
-	prepare_receive();
+	if (!in_flight_.empty() && can_pipeline_next()) {
+	    send_next_task();
+	} else {
+	    prepare_receive();
+	}
 	break;
     case STATE_ERROR:
 	error(reason_t::ERROR_UNRECOGNIZED, "Probable node shutdown.");
@@ -901,12 +1014,33 @@ void out_connection::on_state()
 
 void out_connection::print_task_queue() const
 {
-    auto temp = work_;
-    while (!temp.empty()) {
-	auto task = temp.top();
+    for (auto &p : in_flight_) {
+	std::cout << "in flight #" << p.first << ": " << p.second->get_state_name() << " " << p.second->description() << std::endl;
+    }
+    work_.for_each([](out_task *task) {
 	std::cout << task->get_when().str() << ": " << task->get_state_name() << " " << task->description() << std::endl;
-	temp.pop();
+	});
+    std::cout << "queued=" << work_.size() << " (high=" << work_.size(out_task::PRIORITY_HIGH) << " normal=" << work_.size(out_task::PRIORITY_NORMAL) << " low=" << work_.size(out_task::PRIORITY_LOW) << ") max=" << work_.max_size() << " started=" << work_.num_started() << " late=" << work_.num_late() << " max_lateness=" << work_.max_lateness_us() << "us" << std::endl;
+}
+
+//
+// Instead of polling at the fast timer interval, wake up when the
+// next task is due.
+//
+uint64_t out_connection::idle_microseconds()
+{
+    uint64_t fast = self().get_fast_timer_interval_microseconds();
+    boost::lock_guard<boost::recursive_mutex> guard(work_lock_);
+    if (work_.empty()) {
+	return fast;
+    }
+    auto next = work_.next_when();
+    auto now = utime::now();
+    if (next <= now) {
+	// Due but couldn't be sent (e.g. not connected yet)
+	return fast;
     }
+    return std::min(fast, (next - now).in_us());
 }
 
 void out_connection::increment_pending_queries() {
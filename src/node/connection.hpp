@@ -5,6 +5,7 @@
 
 #include "asio_win32_check.hpp"
 
+#include <map>
 #include <queue>
 #include <boost/thread.hpp>
 #include <boost/asio/io_service.hpp>
@@ -20,6 +21,7 @@
 #include "ip_address.hpp"
 #include "ip_service.hpp"
 #include "task.hpp"
+#include "task_queue.hpp"
 
 namespace prologcoin { namespace node {
 
@@ -138,6 +140,9 @@ protected:
 
     void trigger_now();
 
+    // How long to wait in the idle state before looking for work.
+    virtual uint64_t idle_microseconds();
+
     const std::string & last_error() const { return last_error_; }
 
 private:
@@ -209,6 +214,9 @@ private:
 		       std::function<void(common::term cmd)> > commands_;
     in_session_state *session_;
     term_env env_;
+    // Id of the request being processed if it came as req(Id, Msg),
+    // in which case the reply is sent as rep(Id, Reply).
+    term request_id_;
     std::string name_;
     bool silent_;
 };
@@ -225,6 +233,11 @@ public:
     using utime = prologcoin::common::utime;
     enum out_type_t { STANDARD, VERIFIER };
 
+    // Maximum number of pipelined requests waiting for a reply. Keeps
+    // the requests we write while the remote end is busy writing
+    // replies well within the socket buffers.
+    static const size_t MAX_IN_FLIGHT = 16;
+
     out_connection(self_node &self, out_type_t t, const ip_service &ip);
     virtual ~out_connection();
     
@@ -279,6 +292,8 @@ public:
       }
     }
 
+    inline const task_queue & work() const { return work_; }
+
     inline bool is_connected() const { return connected_; }
     inline void set_connected(bool b) { connected_ = b; }
 
@@ -314,7 +329,12 @@ private:
     void handle_init_connection_task(out_task &task);
     static void handle_init_connection_task_fn(out_task &task);
 
+    virtual uint64_t idle_microseconds() override;
+
     void send_next_task();
+    void send_pipelined_task(out_task *task);
+    bool can_pipeline_next();
+    out_task * take_in_flight(term reply);
     void on_state();
 
     void reply_error(const common::term t);
@@ -334,8 +354,11 @@ private:
     term_env env_;
     boost::recursive_mutex work_lock_;
     // boost::condition_variable work_cv_;
-    std::priority_queue<out_task *, std::vector<out_task *>, std::function<bool (const out_task *t1, const out_task *t2)> > work_;
+    task_queue work_;
     utime last_in_work_;
+    // Pipelined tasks sent as req(Id, Msg) waiting for rep(Id, Reply)
+    std::map<int64_t, out_task *> in_flight_;
+    int64_t next_request_id_;
     size_t busy_count_;
     common::spinlock busy_count_lock_;
     size_t pending_queries_;
@@ -0,0 +1,230 @@
+#include "fanout.hpp"
+#include "self_node.hpp"
+#include "task_execute_query.hpp"
+
+using namespace prologcoin::common;
+
+namespace prologcoin { namespace node {
+
+latency_histogram::latency_histogram()
+{
+    clear();
+}
+
+void latency_histogram::clear()
+{
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+	buckets_[i] = 0;
+    }
+    total_ = 0;
+}
+
+size_t latency_histogram::bucket_of(uint64_t us)
+{
+    size_t bucket = 0;
+    while (us != 0 && bucket < NUM_BUCKETS - 1) {
+	us >>= 1;
+	bucket++;
+    }
+    return bucket;
+}
+
+void latency_histogram::add(uint64_t us)
+{
+    buckets_[bucket_of(us)]++;
+    total_++;
+}
+
+uint64_t latency_histogram::percentile(double p) const
+{
+    uint64_t n = total_;
+    if (n == 0) {
+	return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(p * n / 100.0 + 0.5);
+    if (target == 0) target = 1;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+	sum += buckets_[i];
+	if (sum >= target) {
+	    return bucket_limit(i);
+	}
+    }
+    return bucket_limit(NUM_BUCKETS - 1);
+}
+
+fanout::fanout(self_node &self, term_env &query_src)
+    : self_(self),
+      query_src_(query_src),
+      state_(std::make_shared<state>()),
+      num_succeeded_(0),
+      num_pending_(0)
+{
+}
+
+fanout::~fanout()
+{
+    boost::unique_lock<boost::mutex> lockit(state_->lock);
+    for (auto &s : state_->slots) {
+	abandon(s);
+    }
+}
+
+size_t fanout::start(term query, const std::vector<std::string> &peers,
+		     uint64_t timeout_millis)
+{
+    size_t num_started = 0;
+
+    // Hold the connection lock so no task goes away before we have
+    // registered our callback.
+    boost::lock_guard<boost::recursive_mutex> guard(self_.connections_lock_);
+
+    for (auto &where : peers) {
+	auto now = utime::now();
+	size_t index;
+	{
+	    boost::unique_lock<boost::mutex> lockit(state_->lock);
+	    index = state_->slots.size();
+	    state_->slots.push_back(slot{where, nullptr, now,
+			now + utime::ms(timeout_millis), false, false});
+	}
+	auto *task = self_.schedule_execute_query(query, nullptr, query_src_,
+					  where, interp::MODE_NORMAL);
+	if (task == nullptr) {
+	    boost::unique_lock<boost::mutex> lockit(state_->lock);
+	    state_->slots[index].done = true;
+	    results_.push_back(peer_result{where, FAILED, term(),
+					   "No such connection", 0});
+	    continue;
+	}
+	{
+	    boost::unique_lock<boost::mutex> lockit(state_->lock);
+	    state_->slots[index].task = task;
+	}
+	num_pending_++;
+	num_started++;
+
+	// Capture the shared state, not this, as the callback may come
+	// after we're done waiting.
+	auto st = state_;
+	task->on_ready([st, index](bool alive) {
+		boost::unique_lock<boost::mutex> lockit(st->lock);
+		auto &s = st->slots[index];
+		if (!alive) {
+		    s.task = nullptr;
+		} else if (!s.ready) {
+		    s.ready = true;
+		    st->ready_order.push_back(index);
+		}
+		st->changed.notify_one();
+	    });
+    }
+
+    return num_started;
+}
+
+void fanout::collect(slot &s)
+{
+    if (s.done) {
+	return;
+    }
+    s.done = true;
+    num_pending_--;
+
+    uint64_t latency = (utime::now() - s.started).in_us();
+    self_.fanout_latency().add(latency);
+
+    peer_result r{s.where, FAILED, term(), "", latency};
+    auto *task = s.task;
+    if (task == nullptr) {
+	r.exception = "Connection closed";
+    } else if (task->failed()) {
+	if (task->is_exception()) {
+	    r.exception = task->get_exception();
+	}
+    } else {
+	uint64_t cost_tmp = 0;
+	r.result = query_src_.copy(task->get_result(), task->env(), cost_tmp);
+	r.outcome = SUCCEEDED;
+	num_succeeded_++;
+    }
+    if (task != nullptr) {
+	task->consume_result();
+    }
+    results_.push_back(r);
+}
+
+void fanout::time_out(slot &s, const utime &now)
+{
+    s.done = true;
+    num_pending_--;
+    if (s.task != nullptr) {
+	s.task->consume_result();
+    }
+    results_.push_back(peer_result{s.where, TIMED_OUT, term(), "",
+				   (now - s.started).in_us()});
+}
+
+void fanout::abandon(slot &s)
+{
+    if (s.done) {
+	return;
+    }
+    s.done = true;
+    num_pending_--;
+    if (s.task != nullptr) {
+	s.task->consume_result();
+    }
+}
+
+bool fanout::wait(size_t quorum)
+{
+    boost::unique_lock<boost::mutex> lockit(state_->lock);
+
+    auto &slots = state_->slots;
+    if (quorum == 0 || quorum > slots.size()) {
+	quorum = slots.size();
+    }
+
+    size_t next_ready = 0;
+    for (;;) {
+	auto &ready_order = state_->ready_order;
+	while (next_ready < ready_order.size()) {
+	    collect(slots[ready_order[next_ready++]]);
+	}
+	// Tasks that died without a reply
+	for (auto &s : slots) {
+	    if (!s.done && s.task == nullptr) collect(s);
+	}
+
+	if (num_succeeded_ >= quorum || num_pending_ == 0) {
+	    break;
+	}
+
+	auto now = utime::now();
+	utime next_deadline;
+	for (auto &s : slots) {
+	    if (s.done) continue;
+	    if (now >= s.deadline) {
+		time_out(s, now);
+	    } else if (next_deadline.is_zero() || s.deadline < next_deadline) {
+		next_deadline = s.deadline;
+	    }
+	}
+	if (num_pending_ == 0) {
+	    break;
+	}
+
+	boost::chrono::microseconds dt((next_deadline - now).in_us());
+	state_->changed.wait_for(lockit, dt);
+    }
+
+    // Quorum reached; we're not interested in the rest.
+    for (auto &s : slots) {
+	abandon(s);
+    }
+
+    return num_succeeded_ >= quorum;
+}
+
+}}
@@ -0,0 +1,131 @@
+#pragma once
+
+#ifndef _node_fanout_hpp
+#define _node_fanout_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "../common/term.hpp"
+#include "../common/term_env.hpp"
+#include "../common/utime.hpp"
+
+namespace prologcoin { namespace node {
+
+class self_node;
+class task_execute_query;
+
+//
+// latency_histogram. Counts latencies (in microseconds) in log2 sized
+// buckets; bucket i holds latencies below 2^i (and at least 2^(i-1).)
+// Updated from several sessions at once, so the counters are atomic.
+//
+class latency_histogram {
+public:
+    static const size_t NUM_BUCKETS = 40;
+
+    latency_histogram();
+
+    void add(uint64_t us);
+    void clear();
+
+    inline uint64_t count(size_t bucket) const { return buckets_[bucket]; }
+    inline uint64_t total() const { return total_; }
+
+    static inline uint64_t bucket_limit(size_t bucket)
+    { return static_cast<uint64_t>(1) << bucket; }
+
+    static size_t bucket_of(uint64_t us);
+
+    // Upper bound (bucket limit) of the p-th percentile (0 < p <= 100.)
+    // Returns 0 if nothing has been recorded.
+    uint64_t percentile(double p) const;
+
+private:
+    std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+    std::atomic<uint64_t> total_;
+};
+
+//
+// fanout. Issue the same query to several peers at once and collect
+// the results as they arrive. Each peer has its own deadline; a peer
+// that hasn't answered by then is reported as timed out. With a
+// quorum of K the wait ends as soon as K peers have answered
+// successfully (first-K-of-N); the remaining peers are abandoned and
+// their results thrown away when they arrive.
+//
+// Every outstanding query is a future: its task calls back into the
+// shared state below when the reply arrives (or the task dies with
+// its connection), so waiting doesn't depend on the node wide
+// parallel_changed_ condition.
+//
+class fanout {
+public:
+    using term = common::term;
+    using term_env = common::term_env;
+    using utime = common::utime;
+
+    enum outcome_t { PENDING, SUCCEEDED, FAILED, TIMED_OUT };
+
+    struct peer_result {
+	std::string where;
+	outcome_t outcome;
+	term result;            // Instantiated query (in query_src)
+	std::string exception;  // Set if the peer threw an exception
+	uint64_t latency_us;
+    };
+
+    fanout(self_node &self, term_env &query_src);
+    ~fanout();
+
+    // Schedule the query at all peers. Returns the number of peers
+    // it could be scheduled at (unknown peers are reported as failed.)
+    size_t start(term query, const std::vector<std::string> &peers,
+		 uint64_t timeout_millis);
+
+    // Wait until quorum peers have succeeded (0 means all of them) or
+    // no peer is pending any more. Returns true if the quorum was met.
+    bool wait(size_t quorum = 0);
+
+    // Results in the order they completed.
+    inline const std::vector<peer_result> & results() const
+    { return results_; }
+
+    inline size_t num_succeeded() const { return num_succeeded_; }
+
+private:
+    struct slot {
+	std::string where;
+	task_execute_query *task;
+	utime started;
+	utime deadline;
+	bool ready;
+	bool done;
+    };
+
+    struct state {
+	boost::mutex lock;
+	boost::condition_variable changed;
+	std::vector<slot> slots;
+	std::vector<size_t> ready_order;
+    };
+
+    void collect(slot &s);
+    void time_out(slot &s, const utime &now);
+    void abandon(slot &s);
+
+    self_node &self_;
+    term_env &query_src_;
+    std::shared_ptr<state> state_;
+    std::vector<peer_result> results_;
+    size_t num_succeeded_;
+    size_t num_pending_;
+};
+
+}}
+
+#endif
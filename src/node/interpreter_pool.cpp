@@ -0,0 +1,136 @@
+#include "interpreter_pool.hpp"
+#include "local_interpreter.hpp"
+
+namespace prologcoin { namespace node {
+
+interpreter_pool::interpreter_pool(self_node &self)
+    : self_(self),
+      max_size_(DEFAULT_MAX_SIZE),
+      warm_size_(DEFAULT_WARM_SIZE),
+      num_hits_(0),
+      num_misses_(0),
+      num_discarded_(0),
+      num_setups_(0),
+      total_setup_us_(0)
+{
+}
+
+interpreter_pool::~interpreter_pool()
+{
+    for (auto *interp : idle_) {
+	delete interp;
+    }
+    idle_.clear();
+}
+
+local_interpreter * interpreter_pool::acquire(in_session_state &session)
+{
+    local_interpreter *interp = nullptr;
+    {
+	boost::lock_guard<boost::mutex> guard(lock_);
+	if (!idle_.empty()) {
+	    interp = idle_.back();
+	    idle_.pop_back();
+	    num_hits_++;
+	} else {
+	    num_misses_++;
+	}
+    }
+    if (interp == nullptr) {
+	interp = new local_interpreter(self_);
+    }
+    interp->attach(session);
+    return interp;
+}
+
+void interpreter_pool::release(local_interpreter *interp)
+{
+    if (interp->recycle()) {
+	boost::lock_guard<boost::mutex> guard(lock_);
+	if (idle_.size() < max_size_) {
+	    idle_.push_back(interp);
+	    return;
+	}
+    } else {
+	boost::lock_guard<boost::mutex> guard(lock_);
+	num_discarded_++;
+    }
+    delete interp;
+}
+
+void interpreter_pool::warm_up(size_t n)
+{
+    for (size_t i = 0; i < n && size() < max_size(); i++) {
+	auto *interp = new local_interpreter(self_);
+	interp->ensure_initialized();
+	boost::lock_guard<boost::mutex> guard(lock_);
+	idle_.push_back(interp);
+    }
+}
+
+size_t interpreter_pool::max_size() const
+{
+    boost::lock_guard<boost::mutex> guard(lock_);
+    return max_size_;
+}
+
+void interpreter_pool::set_max_size(size_t n)
+{
+    std::vector<local_interpreter *> excess;
+    {
+	boost::lock_guard<boost::mutex> guard(lock_);
+	max_size_ = n;
+	while (idle_.size() > max_size_) {
+	    excess.push_back(idle_.back());
+	    idle_.pop_back();
+	}
+    }
+    for (auto *interp : excess) {
+	delete interp;
+    }
+}
+
+size_t interpreter_pool::size() const
+{
+    boost::lock_guard<boost::mutex> guard(lock_);
+    return idle_.size();
+}
+
+uint64_t interpreter_pool::num_hits() const
+{
+    boost::lock_guard<boost::mutex> guard(lock_);
+    return num_hits_;
+}
+
+uint64_t interpreter_pool::num_misses() const
+{
+    boost::lock_guard<boost::mutex> guard(lock_);
+    return num_misses_;
+}
+
+uint64_t interpreter_pool::num_discarded() const
+{
+    boost::lock_guard<boost::mutex> guard(lock_);
+    return num_discarded_;
+}
+
+uint64_t interpreter_pool::num_setups() const
+{
+    boost::lock_guard<boost::mutex> guard(lock_);
+    return num_setups_;
+}
+
+uint64_t interpreter_pool::total_setup_us() const
+{
+    boost::lock_guard<boost::mutex> guard(lock_);
+    return total_setup_us_;
+}
+
+void interpreter_pool::add_setup(uint64_t us)
+{
+    boost::lock_guard<boost::mutex> guard(lock_);
+    num_setups_++;
+    total_setup_us_ += us;
+}
+
+}}
@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef _node_interpreter_pool_hpp
+#define _node_interpreter_pool_hpp
+
+#include <stdint.h>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+namespace prologcoin { namespace node {
+
+class self_node;
+class local_interpreter;
+class in_session_state;
+
+//
+// interpreter_pool. Setting up a local_interpreter (builtins, standard
+// library, ec and coin modules) is much more expensive than what most
+// sessions do with it (heartbeats, peer info, wallet pulses.) When a
+// session is killed its interpreter is recycled, i.e. reset back to
+// the state it had right after setup, and handed to the next session.
+//
+// Interpreters whose program database was modified (consult, assert,
+// startup file, ...) cannot be restored cheaply and are discarded.
+//
+class interpreter_pool {
+public:
+    static const size_t DEFAULT_MAX_SIZE = 16;
+    static const size_t DEFAULT_WARM_SIZE = 2;
+
+    interpreter_pool(self_node &self);
+    ~interpreter_pool();
+
+    // Get an interpreter for a new session. It's already set up if it
+    // came from the pool, otherwise it gets set up lazily (on first
+    // query.)
+    local_interpreter * acquire(in_session_state &session);
+
+    // Return the interpreter of a session that is gone.
+    void release(local_interpreter *interp);
+
+    // Set up n interpreters ahead of time (up to the maximum size.)
+    void warm_up(size_t n);
+
+    size_t max_size() const;
+    void set_max_size(size_t n);
+
+    // How many interpreters the node sets up when it starts.
+    inline size_t warm_size() const { return warm_size_; }
+    inline void set_warm_size(size_t n) { warm_size_ = n; }
+
+    size_t size() const;
+
+    // Statistics
+    uint64_t num_hits() const;
+    uint64_t num_misses() const;
+    uint64_t num_discarded() const;
+    uint64_t num_setups() const;
+    uint64_t total_setup_us() const;
+
+    void add_setup(uint64_t us);
+
+private:
+    self_node &self_;
+    mutable boost::mutex lock_;
+    std::vector<local_interpreter *> idle_;
+    size_t max_size_;
+    size_t warm_size_;
+    uint64_t num_hits_;
+    uint64_t num_misses_;
+    uint64_t num_discarded_;
+    uint64_t num_setups_;
+    uint64_t total_setup_us_;
+};
+
+}}
+
+#endif
@@ -4,6 +4,7 @@
 #include "session.hpp"
 #include "task_reset.hpp"
 #include "task_execute_query.hpp"
+#include "fanout.hpp"
 #include "../ec/builtins.hpp"
 #include "../coin/builtins.hpp"
 #include "../global/global_interpreter.hpp"
@@ -126,6 +127,101 @@ bool me_builtins::operator_at_parallel_2(interpreter_base &interp0, size_t arity
 {
     return  operator_at_impl(interp0, arity, args, "@=", MODE_PARALLEL);
 }
+
+//
+// fanout(Goal, Peers, Quorum, Timeout, Results)
+//
+// Run Goal at all Peers (a list of connection names) at once and wait
+// until Quorum of them have succeeded (0 means all) or each peer has
+// answered or been waiting for Timeout milliseconds. Results is a list
+// of Peer-Outcome in the order the peers completed, where Outcome is
+// the instantiated Goal, fail, timeout or error(Message). Peers still
+// pending when the quorum is met are left out.
+//
+bool me_builtins::fanout_5(interpreter_base &interp0, size_t arity, term args[])
+{
+    static const std::string name = "fanout/5";
+    auto &interp = to_local(interp0);
+
+    interp.root_check("fanout", arity);
+
+    std::vector<std::string> peers;
+    term lst = args[1];
+    while (interp.is_dotted_pair(lst)) {
+	term peer = interp.arg(lst, 0);
+	if (!interp.is_atom(peer)) {
+	    interp.abort(interpreter_exception_wrong_arg_type(name + ": Second argument must be a list of atoms; found " + interp.to_string(peer)));
+	}
+	peers.push_back(interp.atom_name(peer));
+	lst = interp.arg(lst, 1);
+    }
+    if (lst != interp.EMPTY_LIST) {
+	interp.abort(interpreter_exception_wrong_arg_type(name + ": Second argument must be a list of atoms; was " + interp.to_string(args[1])));
+    }
+
+    term quorum_term = args[2];
+    if (quorum_term.tag() != tag_t::INT || reinterpret_cast<int_cell &>(quorum_term).value() < 0) {
+	interp.abort(interpreter_exception_wrong_arg_type(name + ": Third argument must be a non-negative integer; was " + interp.to_string(quorum_term)));
+    }
+    size_t quorum = static_cast<size_t>(reinterpret_cast<int_cell &>(quorum_term).value());
+
+    term timeout_term = args[3];
+    if (timeout_term.tag() != tag_t::INT || reinterpret_cast<int_cell &>(timeout_term).value() < 0) {
+	interp.abort(interpreter_exception_wrong_arg_type(name + ": Fourth argument must be a non-negative integer; was " + interp.to_string(timeout_term)));
+    }
+    uint64_t timeout = static_cast<uint64_t>(reinterpret_cast<int_cell &>(timeout_term).value());
+
+    fanout f(interp.self(), interp);
+    f.start(args[0], peers, timeout);
+    f.wait(quorum);
+
+    auto &results = f.results();
+    term result = interp.EMPTY_LIST;
+    for (auto it = results.rbegin(); it != results.rend(); ++it) {
+	term outcome;
+	switch (it->outcome) {
+	case fanout::SUCCEEDED: outcome = it->result; break;
+	case fanout::TIMED_OUT: outcome = con_cell("timeout",0); break;
+	default:
+	    if (it->exception.empty()) {
+		outcome = con_cell("fail",0);
+	    } else {
+		outcome = interp.new_term(con_cell("error",1), {interp.string_to_list(it->exception)});
+	    }
+	    break;
+	}
+	term peer = interp.functor(it->where, 0);
+	term pair = interp.new_term(con_cell("-",2), {peer, outcome});
+	result = interp.new_dotted_pair(pair, result);
+    }
+
+    return interp.unify(args[4], result);
+}
+
+//
+// fanout_latency(Histogram)
+//
+// Histogram is a list of Limit-Count pairs (non-empty buckets only),
+// where Count is the number of peer replies to fanout/5 that took
+// less than Limit microseconds (but at least half of it.)
+//
+bool me_builtins::fanout_latency_1(interpreter_base &interp0, size_t arity, term args[])
+{
+    auto &interp = to_local(interp0);
+
+    auto &hist = interp.self().fanout_latency();
+    term result = interp.EMPTY_LIST;
+    for (size_t i = latency_histogram::NUM_BUCKETS; i-- > 0;) {
+	uint64_t cnt = hist.count(i);
+	if (cnt == 0) {
+	    continue;
+	}
+	term limit = int_cell(static_cast<int64_t>(latency_histogram::bucket_limit(i)));
+	term pair = interp.new_term(con_cell("-",2), {limit, int_cell(static_cast<int64_t>(cnt))});
+	result = interp.new_dotted_pair(pair, result);
+    }
+    return interp.unify(args[0], result);
+}
 	
 bool me_builtins::id_1(interpreter_base &interp0, size_t arity, term args[] )
 {
@@ -523,9 +619,21 @@ bool me_builtins::gstat_1(interpreter_base &interp0, size_t arity, term args[])
 	std::cout << "num_predicates=" << g.num_predicates() << std::endl;
 	std::cout << "num_symbols=" << g.num_symbols() << std::endl;
 	std::cout << "num_frozen_closures=" << g.num_frozen_closures() << std::endl;
+	auto stats = g.interp().get_block_cache_stats();
+	std::cout << "block_cache=" << stats.size << "/" << stats.capacity
+		  << " hits=" << stats.hits << " misses=" << stats.misses
+		  << " evictions=" << stats.evictions
+		  << " prefetched=" << stats.prefetched << std::endl;
 	return true;
     } else {
 	term result = interp.EMPTY_LIST;
+	auto stats = g.interp().get_block_cache_stats();
+	result = interp.new_dotted_pair(
+		interp.new_term(interp.functor("block_cache",6),
+				{int_cell(stats.hits), int_cell(stats.misses),
+				 int_cell(stats.evictions), int_cell(stats.prefetched),
+				 int_cell(stats.size), int_cell(stats.capacity)}),
+		result);
 	result = interp.new_dotted_pair(
 		interp.new_term(interp.functor("new_frozen_closures",1),
 				{int_cell(g.num_frozen_closures())}),
@@ -1498,6 +1606,17 @@ bool me_builtins::commit(local_interpreter &interp, term_serializer::buffer_t &b
     
     g.set_naming(naming);
 
+    block_to_buffer(interp, t, buf);
+
+    if (!g.execute_commit(buf)) {
+	return false;
+    }
+
+    return true;
+}
+
+void me_builtins::block_to_buffer(local_interpreter &interp, term t, buffer_t &buf)
+{
     if (t.tag() == tag_t::BIG) {
 	// Assume this is an encoded leaf
 	auto &big = reinterpret_cast<big_cell &>(t);
@@ -1516,14 +1635,148 @@ bool me_builtins::commit(local_interpreter &interp, term_serializer::buffer_t &b
 	buf.clear();
 	ser.write(buf, t);
     }
+}
 
-    if (!g.execute_commit(buf)) {
+bool me_builtins::submit_block_3(interpreter_base &interp0, size_t arity, term args[])
+{
+    // submit_block(Id, Meta, Block)
+    // Hand over a downloaded block (not yet executable) to the block
+    // pipeline, which checks it on a worker thread in the meantime.
+    // Fails if the pipeline is full or the meta entry is unknown.
+    static const std::string name = "submit_block/3";
+    auto &interp = to_local(interp0);
+
+    interp.root_check("submit_block", arity);
+
+    auto id = get_meta_id(interp0, name, args[0]);
+
+    buffer_t meta_buf;
+    term_serializer ser(interp);
+    ser.write(meta_buf, args[1]);
+    buffer_t goals_buf;
+    block_to_buffer(interp, args[2], goals_buf);
+
+    auto locked = interp.lock_node();
+    global::global &g = interp.self().global();
+    auto *entry = g.get_blockchain().get_meta_entry(id);
+    if (entry == nullptr) {
+	return false;
+    }
+    return g.pipeline().submit(*entry, meta_buf, goals_buf);
+}
+
+bool me_builtins::commit_block_3(interpreter_base &interp0, size_t arity, term args[])
+{
+    // commit_block(Id, Meta, Block)
+    // Same as setup_commit(Meta), commit(Block), but if the block was
+    // submitted (and thus already checked) we use the pipeline.
+    static const std::string name = "commit_block/3";
+    auto &interp = to_local(interp0);
+
+    interp.root_check("commit_block", arity);
+
+    auto id = get_meta_id(interp0, name, args[0]);
+
+    auto locked = interp.lock_node();
+    global::global &g = interp.self().global();
+
+    if (!g.has_interp()) {
 	return false;
     }
+    g.set_naming(false);
+
+    if (g.pipeline().has_block(id)) {
+	return g.pipeline().commit(id);
+    }
+
+    buffer_t buf;
+    term_serializer ser(interp);
+    ser.write(buf, args[1]);
+    g.setup_commit(buf);
+    return commit(interp, buf, args[2], false);
+}
+
+bool me_builtins::drop_block_1(interpreter_base &interp0, size_t arity, term args[])
+{
+    // drop_block(Id)
+    // Remove a submitted block from the block pipeline (e.g. because
+    // its download failed or it is on a branch we won't follow.)
+    static const std::string name = "drop_block/1";
+    auto &interp = to_local(interp0);
+
+    interp.root_check("drop_block", arity);
+
+    auto id = get_meta_id(interp0, name, args[0]);
 
+    auto locked = interp.lock_node();
+    interp.self().global().pipeline().drop(id);
     return true;
 }
 
+bool me_builtins::pending_goal_1(interpreter_base &interp0, size_t arity, term args[])
+{
+    // pending_goal(Goal)
+    // Add Goal to the pool of pending goals. It is dry run against the
+    // current state (and then undone.) Fails if it doesn't succeed.
+    auto &interp = to_local(interp0);
+    interp.root_check("pending_goal", arity);
+
+    buffer_t buf;
+    term_serializer ser(interp);
+    ser.write(buf, args[0]);
+
+    auto locked = interp.lock_node();
+    global::global &g = interp.self().global();
+    if (!g.has_interp()) {
+	return false;
+    }
+    return g.pending_goals().add(buf) == global::goal_pool::VALID;
+}
+
+bool me_builtins::pending_block_2(interpreter_base &interp0, size_t arity, term args[])
+{
+    // pending_block(Max, Block)
+    // Block is a conjunction of (at most Max) pending goals that don't
+    // depend on each other, ready to be committed. Fails if there are
+    // none.
+    static const std::string name = "pending_block/2";
+    auto &interp = to_local(interp0);
+
+    interp.root_check("pending_block", arity);
+
+    term max_term = args[0];
+    if (max_term.tag() != tag_t::INT || reinterpret_cast<int_cell &>(max_term).value() < 1) {
+	interp.abort(interpreter_exception_wrong_arg_type(name + ": First argument must be a positive integer; was " + interp.to_string(max_term)));
+    }
+    size_t max_goals = static_cast<size_t>(reinterpret_cast<int_cell &>(max_term).value());
+
+    buffer_t buf;
+    {
+	auto locked = interp.lock_node();
+	global::global &g = interp.self().global();
+	if (!g.has_interp()) {
+	    return false;
+	}
+	if (g.pending_goals().assemble(max_goals, buf) == 0) {
+	    return false;
+	}
+    }
+    term_serializer ser(interp);
+    term block = ser.read(buf);
+    return interp.unify(args[1], block);
+}
+
+bool me_builtins::pending_goals_1(interpreter_base &interp0, size_t arity, term args[])
+{
+    // pending_goals(N)
+    // N is the number of goals in the pool.
+    auto &interp = to_local(interp0);
+    auto locked = interp.lock_node();
+    global::global &g = interp.self().global();
+    int_cell n(static_cast<int64_t>(g.pending_goals().size()));
+    return interp.unify(args[0], n);
+}
+
 bool me_builtins::commit_2(interpreter_base &interp0, size_t arity, term args[])
 {
     // commit(X)
@@ -2550,8 +2803,8 @@ bool me_builtins::ptask_0(interpreter_base &interp0, size_t arity, term args[])
 }
 
 
-local_interpreter::local_interpreter(in_session_state &session)
-    : interp::interpreter("node"), session_(session), initialized_(false), ignore_text_(false)
+local_interpreter::local_interpreter(self_node &self)
+    : interp::interpreter("node"), self_(self), session_(nullptr), initialized_(false), ignore_text_(false)
 {
     // Redirect standard output (standard std::cout) to an internal
     // stringstream.
@@ -2567,12 +2820,12 @@ node_locker local_interpreter::lock_node()
 
 self_node & local_interpreter::self()
 {
-    return session_.self();
+    return self_;
 }
 
 bool local_interpreter::is_root() 
 {
-    return session_.is_root();
+    return session_ != nullptr && session_->is_root();
 }
 
 void local_interpreter::root_check(const std::string &name, size_t arity)
@@ -2588,6 +2841,7 @@ void local_interpreter::ensure_initialized()
 {
     if (!initialized_) {
 	initialized_ = true;
+	auto start = utime::now();
 	// TODO: Only do this for authorized clients.
 	enable_file_io();
 
@@ -2607,9 +2861,70 @@ void local_interpreter::ensure_initialized()
 	// "background" processes between queries)
 	set_retain_state_between_queries(true);
 
-	// Load startup file
-	if (load_startup_file_) startup_file();
+	program_modified_ = false;
+	init_heap_size_ = heap_size();
+	init_module_ = current_module();
+	init_debug_ = is_debug();
+	init_track_cost_ = is_track_cost();
+	init_directory_ = get_current_directory();
+	init_ops_ = get_ops();
+	init_num_managed_data_ = num_managed_data();
+
+	self().interpreter_pool().add_setup((utime::now() - start).in_us());
     }
+
+    // Load startup file (once per session)
+    if (session_ != nullptr && load_startup_file_ && !startup_loaded_) {
+	startup_loaded_ = true;
+	startup_file();
+    }
+}
+
+void local_interpreter::attach(in_session_state &session)
+{
+    session_ = &session;
+    load_startup_file_ = true;
+    startup_loaded_ = false;
+}
+
+bool local_interpreter::recycle()
+{
+    session_ = nullptr;
+
+    // Data that builtins attached to the interpreter (e.g. MuSig
+    // sessions) belongs to the session, and we can't tell how to
+    // reset it.
+    if (!initialized_ || program_modified_ ||
+	current_module() != init_module_ ||
+	num_managed_data() != init_num_managed_data_) {
+	return false;
+    }
+
+    while (num_instances() > 0) {
+	delete_instance();
+    }
+    interpreter::reset();
+    reset_files();
+    set_qr(EMPTY_LIST);
+    set_persistent_password(false);
+    clear_secret();
+
+    // Flags and operators
+    set_debug(init_debug_);
+    set_track_cost(init_track_cost_);
+    set_retain_state_between_queries(true);
+    set_current_directory(init_directory_);
+    get_ops() = init_ops_;
+
+    // Everything the session put on the heap (including frozen
+    // closures) goes away.
+    trim_heap_safe(init_heap_size_);
+
+    text_out_.clear();
+    standard_output_.str("");
+    ignore_text_ = false;
+
+    return true;
 }
 
 void local_interpreter::setup_local_builtins()
@@ -2645,6 +2960,8 @@ void local_interpreter::setup_local_builtins()
     load_builtin(ME, functor("add_address",2), &me_builtins::add_address_2);
     load_builtin(ME, con_cell("ready", 1), &me_builtins::ready_2);
     load_builtin(ME, con_cell("ready", 2), &me_builtins::ready_2);
+    load_builtin(ME, functor("fanout", 5), &me_builtins::fanout_5);
+    load_builtin(ME, functor("fanout_latency", 1), &me_builtins::fanout_latency_1);
 
     // Mailbox
     load_builtin(ME, con_cell("mailbox",1), &me_builtins::mailbox_1);
@@ -2710,6 +3027,13 @@ void local_interpreter::setup_local_builtins()
     load_builtin(ME, functor("setup_commit", 1), &me_builtins::setup_commit_1);
     load_builtin(ME, con_cell("commit", 1), &me_builtins::commit_2);
     load_builtin(ME, con_cell("commit", 2), &me_builtins::commit_2);
+    // Commit through the block pipeline (checks blocks ahead of time)
+    load_builtin(ME, functor("submit_block", 3), &me_builtins::submit_block_3);
+    load_builtin(ME, functor("commit_block", 3), &me_builtins::commit_block_3);
+    load_builtin(ME, functor("drop_block", 1), &me_builtins::drop_block_1);
+    load_builtin(ME, functor("pending_goal", 1), &me_builtins::pending_goal_1);
+    load_builtin(ME, functor("pending_block", 2), &me_builtins::pending_block_2);
+    load_builtin(ME, functor("pending_goals", 1), &me_builtins::pending_goals_1);
 
     // Execute on global interpreter
     load_builtin(ME, con_cell("global", 1), &me_builtins::global_1);
@@ -37,6 +37,10 @@ public:
     static bool operator_at_parallel_2(interpreter_base &interp, size_t arity, term args[]);    
     static bool operator_at_2_meta(interpreter_base &interp, const meta_reason_t &reason);
 
+    // Issue a goal to several peers at once
+    static bool fanout_5(interpreter_base &interp, size_t arity, term args[]);
+    static bool fanout_latency_1(interpreter_base &interp, size_t arity, term args[]);
+
     // Version & name...
     static bool id_1(interpreter_base &interp, size_t arity, term args[]);
     static bool name_1(interpreter_base &interp, size_t arity, term args[]);
@@ -99,6 +103,13 @@ public:
     static bool setup_commit_1(interpreter_base &interp, size_t arity, term args[]);
     static bool commit(local_interpreter &interp, buffer_t &buf, term t, bool naming);
     static bool commit_2(interpreter_base &interp, size_t arity, term args[]);
+    static void block_to_buffer(local_interpreter &interp, term t, buffer_t &buf);
+    static bool submit_block_3(interpreter_base &interp, size_t arity, term args[]);
+    static bool commit_block_3(interpreter_base &interp, size_t arity, term args[]);
+    static bool drop_block_1(interpreter_base &interp, size_t arity, term args[]);
+    static bool pending_goal_1(interpreter_base &interp, size_t arity, term args[]);
+    static bool pending_block_2(interpreter_base &interp, size_t arity, term args[]);
+    static bool pending_goals_1(interpreter_base &interp, size_t arity, term args[]);
     static bool global_impl(interpreter_base &interp, size_t arity, term args[], bool silent);
     static bool global_1(interpreter_base &interp, size_t arity, term args[]);
     static bool global_silent_1(interpreter_base &interp, size_t arity, term args[]);
@@ -186,10 +197,17 @@ public:
     using interperter_base = interp::interpreter_base;
     using term = common::term;
 
-    local_interpreter(in_session_state &session);
+    local_interpreter(self_node &self);
 
     void ensure_initialized();
 
+    // Bind to the session that will use this interpreter
+    void attach(in_session_state &session);
+
+    // Detach from the session and restore the state right after setup
+    // (see interpreter_pool.) Returns false if that isn't possible.
+    bool recycle();
+
     node_locker lock_node();
 
     bool reset();
@@ -201,7 +219,7 @@ public:
 	load_startup_file_ = false;
     }
     
-    inline in_session_state & session() { return session_; }
+    inline in_session_state & session() { return *session_; }
 
     inline const std::string & get_text_out() { return text_out_; }
     inline void reset_text_out() { text_out_.clear(); }
@@ -226,6 +244,11 @@ public:
     static const common::con_cell COLON;
     static const common::con_cell COMMA;
 
+    virtual void updated_predicate_pre(const interp::qname &qn) override {
+	interpreter::updated_predicate_pre(qn);
+	program_modified_ = true;
+    }
+
 private:
     self_node & self();
     bool is_root();
@@ -235,12 +258,24 @@ private:
 
     void setup_local_builtins();
 
-    in_session_state &session_;
+    self_node &self_;
+    in_session_state *session_;
     bool initialized_;
     std::string text_out_;
     bool ignore_text_;
     std::stringstream standard_output_;
     bool load_startup_file_{true};
+    bool startup_loaded_{false};
+
+    // State right after setup (for recycle)
+    bool program_modified_{false};
+    size_t init_heap_size_{0};
+    common::con_cell init_module_;
+    bool init_debug_{false};
+    bool init_track_cost_{false};
+    std::string init_directory_;
+    common::term_ops init_ops_;
+    size_t init_num_managed_data_{0};
 };
 
 }}
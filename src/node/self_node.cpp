@@ -25,6 +25,8 @@ node_delayed_t::~node_delayed_t() {
 self_node::self_node(const std::string &data_dir, unsigned short port)
     : name_("noname"),
       ioservice_(),
+      num_workers_(std::max(static_cast<size_t>(MIN_NUM_WORKERS),
+			    static_cast<size_t>(boost::thread::hardware_concurrency()))),
       endpoint_(self_node::tcp::v4(), port),
       acceptor_(ioservice_, endpoint_),
       socket_(ioservice_),
@@ -32,6 +34,7 @@ self_node::self_node(const std::string &data_dir, unsigned short port)
       timer_(ioservice_),
       comment_(env_.EMPTY_LIST),
       recent_in_connection_(nullptr),
+      interpreter_pool_(*this),
       preferred_num_standard_out_connections_(DEFAULT_NUM_STANDARD_OUT_CONNECTIONS),
       preferred_num_verifier_connections_(DEFAULT_NUM_VERIFIER_CONNECTIONS),
       num_standard_out_connections_(0),
@@ -69,6 +72,8 @@ void self_node::start()
     acceptor_.set_option(socket_base::enable_connection_aborted(true));
     acceptor_.listen();
 
+    interpreter_pool_.warm_up(interpreter_pool_.warm_size());
+
     thread_ = boost::thread([&](){ run(); });
 
     sync_ = new sync(this);
@@ -85,8 +90,8 @@ void self_node::run()
     start_accept();
     start_tick();
 
-    for (int i = 0; i < 2; i++) {
-    	workers_.push_back(boost::thread([this]() { ioservice_.run(); } ));
+    for (size_t i = 0; i < num_workers_; i++) {
+	workers_.push_back(boost::thread([this]() { ioservice_.run(); } ));
     }
 }
 
@@ -102,13 +107,13 @@ void self_node::stop_sync()
 
 void self_node::close(connection *conn)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);    
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     closed_.push_back(conn);
 }
 
 void self_node::stop_all_connections()
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     if (stopped_) {
 	return;
@@ -131,7 +136,7 @@ void self_node::stop_all_connections()
 
 bool self_node::all_connections_closed()
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     for (auto *conn : in_connections_) {
 	if (!conn->is_closed()) {
 	    return false;
@@ -152,7 +157,7 @@ void self_node::set_comment(const std::string &str)
 
 void self_node::for_each_in_session(const std::function<void (in_session_state *session)> &fn)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(sessions_lock_);
 
     for (auto p : in_states_) {
 	auto *session = p.second;
@@ -162,7 +167,7 @@ void self_node::for_each_in_session(const std::function<void (in_session_state *
 
 void self_node::for_each_out_connection(const std::function<void (out_connection *out)> &fn)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     for (auto *conn : out_connections_) {
 	auto *out_conn = reinterpret_cast<out_connection *>(conn);
@@ -172,7 +177,7 @@ void self_node::for_each_out_connection(const std::function<void (out_connection
 
 void self_node::for_each_standard_out_connection(const std::function<void (out_connection *out)> &fn)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     for (auto *conn : out_connections_) {
 	auto *out_conn = reinterpret_cast<out_connection *>(conn);
@@ -184,7 +189,7 @@ void self_node::for_each_standard_out_connection(const std::function<void (out_c
 
 void self_node::for_each_in_connection(const std::function<void (in_connection *out)> &fn)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     for (auto *conn : in_connections_) {
 	auto *in_conn = reinterpret_cast<in_connection *>(conn);
@@ -194,7 +199,7 @@ void self_node::for_each_in_connection(const std::function<void (in_connection *
 
 out_connection * self_node::find_out_connection(const std::string &where)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     for (auto *conn : out_connections_) {
 	auto *out = reinterpret_cast<out_connection *>(conn);
@@ -209,7 +214,7 @@ out_connection * self_node::find_out_connection(const std::string &where)
 
 task_execute_query * self_node::schedule_execute_new_instance(const std::string &where)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     auto *out = find_out_connection(where);
     if (out == nullptr) {
 	return nullptr;
@@ -221,7 +226,7 @@ task_execute_query * self_node::schedule_execute_new_instance(const std::string
 
 task_execute_query * self_node::schedule_execute_delete_instance(const std::string &where)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     auto *out = find_out_connection(where);
     if (out == nullptr) {
 	return nullptr;
@@ -233,7 +238,7 @@ task_execute_query * self_node::schedule_execute_delete_instance(const std::stri
 
 task_execute_query * self_node::schedule_execute_query(term query, node_delayed_t *delayed, term_env &query_src, const std::string &where, interp::remote_execute_mode mode)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     auto *out = find_out_connection(where);
     if (out == nullptr) {
 	return nullptr;
@@ -247,7 +252,7 @@ task_execute_query * self_node::schedule_execute_next(const std::string &where,
 						      term_env &query_src,
 						      interp::remote_execute_mode mode)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     auto *out = find_out_connection(where);
     if (out == nullptr) {
 	return nullptr;
@@ -344,14 +349,14 @@ in_session_state * self_node::new_in_session(in_connection *conn, bool is_root)
 {
     auto *ss = new in_session_state(this, conn, is_root);
     ss->set_available_funds( get_initial_funds() );
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(sessions_lock_);
     in_states_[ss->id()] = ss;
     return ss;
 }
 
 in_session_state * self_node::find_in_session(const std::string &id)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(sessions_lock_);
     
     auto it = in_states_.find(id);
     if (it == in_states_.end()) {
@@ -363,7 +368,7 @@ in_session_state * self_node::find_in_session(const std::string &id)
 
 void self_node::in_session_connect(in_session_state *sess, in_connection *conn)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     auto *old_conn = sess->get_connection();
 
@@ -377,7 +382,7 @@ void self_node::in_session_connect(in_session_state *sess, in_connection *conn)
 
 out_connection * self_node::new_standard_out_connection(const ip_service &ip)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     auto *out = new out_connection(*this, out_connection::STANDARD, ip);
     out_connections_.insert(out);
@@ -390,13 +395,14 @@ out_connection * self_node::new_standard_out_connection(const ip_service &ip)
 
 bool self_node::has_standard_out_connection(const ip_service &ip)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     return out_standard_ips_.find(ip) != out_standard_ips_.end();
 }
 
 bool self_node::recently_failed(const ip_service &ip)
 {
+    boost::lock_guard<boost::mutex> guard(recently_failed_lock_);
     auto it = recently_failed_.find(ip);
     if (it == recently_failed_.end()) {
 	return false;
@@ -418,7 +424,7 @@ bool self_node::recently_failed(const ip_service &ip)
 
 out_connection * self_node::new_verifier_connection(const ip_service &ip)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     auto *out = new out_connection(*this, out_connection::VERIFIER, ip);
     task_address_verifier *task = new task_address_verifier(out);
@@ -430,9 +436,11 @@ out_connection * self_node::new_verifier_connection(const ip_service &ip)
 
 void self_node::kill_in_session(in_session_state *sess)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
-
-    in_states_.erase(sess->id());
+    {
+	boost::lock_guard<boost::recursive_mutex> guard(sessions_lock_);
+	in_states_.erase(sess->id());
+    }
+    // Recycles its interpreter, no need to hold the lock for that
     delete sess;
 }
 
@@ -441,6 +449,7 @@ void self_node::start_accept()
     using namespace boost::asio;
     using namespace boost::system;
 
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     in_connection *conn = new in_connection(*this);
     in_connections_.insert(conn);
     recent_in_connection_ = conn;
@@ -464,6 +473,7 @@ void self_node::start_tick()
 			   [this](const error_code &) {
 			       process_waiting_tasks();
 			       prune_dead_connections();
+			       prune_dead_sessions();
 			       check_out_connections();
 			       master_hook();
 			       timer_.expires_from_now(
@@ -497,13 +507,15 @@ void self_node::process_waiting_tasks()
 
 void self_node::prune_dead_connections()
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     auto it = closed_.begin();
     while (it != closed_.end()) {
 	auto *c = *it;
 	if (c->type() == connection::CONNECTION_IN) {
+	    // Only detach the session if it hasn't been resumed on
+	    // another connection meanwhile.
 	    auto *s = reinterpret_cast<in_connection *>(c)->get_session();
-	    if (s != nullptr) {
+	    if (s != nullptr && s->get_connection() == c) {
 		s->reset_connection();
 	    }
 	} else {
@@ -526,8 +538,35 @@ void self_node::prune_dead_connections()
     }
 }
 
+//
+// Sessions that lost their connection and weren't reconnected within
+// the time to live are killed (which recycles their interpreters.)
+//
+void self_node::prune_dead_sessions()
+{
+    std::vector<in_session_state *> dead;
+    {
+	boost::lock_guard<boost::recursive_mutex> guard1(connections_lock_);
+	boost::lock_guard<boost::recursive_mutex> guard2(sessions_lock_);
+	auto now = utime::now();
+	for (auto it = in_states_.begin(); it != in_states_.end();) {
+	    auto *sess = it->second;
+	    if (sess->is_detached() && sess->get_connection() == nullptr &&
+		(now - sess->detached_since()).in_us() >= time_to_live_microseconds_) {
+		dead.push_back(sess);
+		it = in_states_.erase(it);
+	    } else {
+		++it;
+	    }
+	}
+    }
+    for (auto *sess : dead) {
+	delete sess;
+    }
+}
+
 void self_node::change_connection_name(const std::string &old, const std::string &name) {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
     if (!old.empty()) {
 	auto it = named_out_connections_.find(old);
 	if (it != named_out_connections_.end()) {
@@ -558,8 +597,12 @@ void self_node::check_standard_out_connections()
     size_t remaining = preferred_num_standard_out_connections_ - num_standard_out_connections_;
     size_t num_top10 = (remaining + 1) / 2;
     size_t num_bot90 = remaining - num_top10;
-    auto top10 = address_book_.get_randomly_from_top_10_pt(num_top10);
-    auto bot90 = address_book_.get_randomly_from_bottom_90_pt(num_bot90);
+    std::vector<address_entry> top10, bot90;
+    {
+	auto b = book();
+	top10 = b().get_randomly_from_top_10_pt(num_top10);
+	bot90 = b().get_randomly_from_bottom_90_pt(num_bot90);
+    }
     // std::cout << "Top10%: n=" << top10.size() << " bot90%%: n=" << bot90.size() << std::endl;
     connect_to(top10);
     connect_to(bot90);
@@ -573,7 +616,7 @@ void self_node::check_verifier_connections()
     }
 
     size_t remaining = preferred_num_verifier_connections_ - num_verifier_connections_;
-    auto unverified = address_book_.get_randomly_from_unverified(remaining);
+    auto unverified = book()().get_randomly_from_unverified(remaining);
     for (auto &addr : unverified) {
 	auto *out = new_verifier_connection(addr);
 	out->set_use_heartbeat(false);
@@ -587,7 +630,7 @@ void self_node::check_verifier_connections()
 //
 void self_node::check_out_connections()
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 
     if (stopped_) {
 	return;
@@ -599,6 +642,7 @@ void self_node::check_out_connections()
 
 void self_node::failed_connection(const ip_service &ip)
 {
+    boost::lock_guard<boost::mutex> guard(recently_failed_lock_);
     auto &p = recently_failed_[ip];
     recently_failed_sorted_.erase(std::make_pair(p.first, ip));
     p.first = utime::now();
@@ -621,6 +665,7 @@ void self_node::failed_connection(const ip_service &ip)
 
 void self_node::successful_connection(const ip_service &ip)
 {
+    boost::lock_guard<boost::mutex> guard(recently_failed_lock_);
     auto it = recently_failed_.find(ip);
     if (it == recently_failed_.end()) {
 	return;
@@ -697,7 +742,7 @@ void self_node::master_hook()
 
 void self_node::create_mailbox(const std::string &mailbox_name)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::mutex> guard(mailbox_lock_);
 
     mailbox_[mailbox_name] = std::queue<std::string>();
 }
@@ -706,7 +751,7 @@ void self_node::send_message(const std::string &mailbox_name,
 			     const std::string &from,
 			     const std::string &message)
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::mutex> guard(mailbox_lock_);
 
     auto it = mailbox_.find(mailbox_name);
     if (it == mailbox_.end()) {
@@ -722,7 +767,7 @@ void self_node::send_message(const std::string &mailbox_name,
 // Flush messages, move them to text_out (with mailbox_name as prefix)
 std::string self_node::check_mail()
 {
-    boost::lock_guard<boost::recursive_mutex> guard(lock_);
+    boost::lock_guard<boost::mutex> guard(mailbox_lock_);
 
     std::string s;
 
@@ -12,6 +12,7 @@
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/deadline_timer.hpp>
+#include <algorithm>
 #include <string>
 #include <ctime>
 
@@ -21,6 +22,8 @@
 #include "../global/global.hpp"
 #include "../terminal/terminal.hpp"
 #include "node_locker.hpp"
+#include "interpreter_pool.hpp"
+#include "fanout.hpp"
 
 namespace prologcoin { namespace node {
 
@@ -72,6 +75,7 @@ private:
 
     friend class connection;
     friend class address_book_wrapper;
+    friend class fanout;
 
 public:
     static const int VERSION_MAJOR = 0;
@@ -86,6 +90,7 @@ public:
     static const uint64_t DEFAULT_INITIAL_FUNDS = 10000;
     static const uint64_t DEFAULT_MAXIMUM_FUNDS = 10000;
     static const uint64_t DEFAULT_NEW_FUNDS_PER_SECOND = 100;
+    static const size_t MIN_NUM_WORKERS = 2;
 
     self_node(const std::string &data_dir, unsigned short port = DEFAULT_PORT);
     ~self_node();
@@ -123,6 +128,21 @@ public:
     inline void set_new_funds_per_second(uint64_t funds)
     { new_funds_per_second_ = funds; }
 
+    // Number of threads running the io_service, i.e. how many
+    // connections (each serialized by its own strand) can be served
+    // at the same time. Defaults to the number of hardware threads
+    // (but at least MIN_NUM_WORKERS.) Must be set before start().
+    inline size_t num_workers() const { return num_workers_; }
+    inline void set_num_workers(size_t n)
+    { num_workers_ = std::max(n, static_cast<size_t>(1)); }
+
+    // Interpreters of killed sessions are reused; start() sets up
+    // interpreter_pool().warm_size() of them ahead of time.
+    inline node::interpreter_pool & interpreter_pool() { return interpreter_pool_; }
+
+    // Reply latencies of peers queried through fanout.
+    inline latency_histogram & fanout_latency() { return fanout_latency_; }
+
     address_book_wrapper book() {
 	return address_book_wrapper(*this, address_book_);
     }
@@ -264,6 +284,7 @@ public:
 
     void change_connection_name(const std::string &old, const std::string &name);
     bool is_unique_connection_name(const std::string &name) {
+	boost::lock_guard<boost::recursive_mutex> guard(connections_lock_);
 	auto it =  named_out_connections_.find(name);
 	if (it == named_out_connections_.end()) {
 	    return false;
@@ -286,6 +307,7 @@ private:
     void stop_sync();
     void process_waiting_tasks();
     void prune_dead_connections();
+    void prune_dead_sessions();
     void connect_to(const std::vector<address_entry> &entries);
     void check_out_connections();
     void check_standard_out_connections();
@@ -315,6 +337,7 @@ private:
     
     io_service ioservice_;
 
+    size_t num_workers_;
     std::vector<boost::thread> workers_;
 
     endpoint endpoint_;
@@ -326,20 +349,41 @@ private:
 
     std::unordered_set<ip_service> self_ips_;
 
+    //
+    // Locks. Acquire in this order (never the other way around):
+    //
+    //   lock_ (node_locker) -> connections_lock_ -> sessions_lock_
+    //
+    // book_lock_, mailbox_lock_ and recently_failed_lock_ are leaves;
+    // nothing else is acquired while holding them. Each connection
+    // serializes its own handlers with its strand, so it is only
+    // these shared structures that are contended between workers.
+    //
+
+    // Global state (consensus) accessed through lock_node()
+    boost::recursive_mutex lock_;
+
+    boost::recursive_mutex connections_lock_;
     in_connection *recent_in_connection_;
     std::unordered_set<connection *> in_connections_;
     std::unordered_set<connection *> out_connections_;
     std::unordered_map<std::string, size_t> named_out_connections_;
     std::unordered_set<ip_service> out_standard_ips_;
+    std::vector<connection *> closed_;
+
+    boost::mutex recently_failed_lock_;
     std::unordered_map<ip_service, std::pair<utime, size_t> > recently_failed_;
     std::set<std::pair<utime, ip_service> > recently_failed_sorted_;
+
     boost::recursive_mutex waiting_tasks_lock_;
     std::vector<out_task *> waiting_tasks_;
 
-    boost::recursive_mutex lock_;
+    boost::recursive_mutex sessions_lock_;
     std::unordered_map<std::string, in_session_state *> in_states_;
-    std::vector<connection *> closed_;
+    node::interpreter_pool interpreter_pool_;
+    latency_histogram fanout_latency_;
 
+    boost::recursive_mutex book_lock_;
     address_book address_book_;
 
     std::function<void (self_node &self)> master_hook_;
@@ -354,6 +398,7 @@ private:
     uint64_t time_to_live_microseconds_;
     size_t num_download_addresses_;
 
+    boost::mutex mailbox_lock_;
     std::map<std::string, std::queue<std::string> > mailbox_;
 
     bool testing_mode_;
@@ -379,12 +424,12 @@ private:
 
 inline address_book_wrapper::address_book_wrapper(self_node &self, address_book &book) : self_(self), book_(book)
 {
-    self_.lock_.lock();
+    self_.book_lock_.lock();
 }
 
 inline address_book_wrapper::~address_book_wrapper()
 {
-    self_.lock_.unlock();
+    self_.book_lock_.unlock();
 }
 
 }}
@@ -10,38 +10,44 @@ using namespace prologcoin::common;
 in_session_state::in_session_state(self_node *self, in_connection *conn, bool is_root)
   : self_(self),
     connection_(conn),
-    interp_(*this),
+    interp_(self->interpreter_pool().acquire(*this)),
     heartbeat_count_(0),
     available_funds_(0),
-    is_root_(is_root)
+    is_root_(is_root),
+    detached_(false)
 {
     id_ = "s" + random::next();
 }
 
+in_session_state::~in_session_state()
+{
+    self().interpreter_pool().release(interp_);
+}
+
 term in_session_state::query_closure()
 {
-    return interp_.new_dotted_pair(interp_.query(), interp_.query_var_list());
+    return interp_->new_dotted_pair(interp_->query(), interp_->query_var_list());
 }
 
 bool in_session_state::execute(const term query)
 {
     using namespace prologcoin::interp;
 
-    interp_.ensure_initialized();
-    interp_.reset_text_out();
-    interp_.set_maximum_cost(available_funds_);
+    interp_->ensure_initialized();
+    interp_->reset_text_out();
+    interp_->set_maximum_cost(available_funds_);
     bool r = false;
     try {
-	r = interp_.execute(query);
-	interp_.flush_standard_output();
-	auto cost = interp_.accumulated_cost();
+	r = interp_->execute(query);
+	interp_->flush_standard_output();
+	auto cost = interp_->accumulated_cost();
 	if (cost > available_funds_) {
 	    available_funds_ = 0;
 	} else {
 	    available_funds_ -= cost;
 	}
     } catch (const interpreter_exception_out_of_funds &ex) {
-	interp_.flush_standard_output();
+	interp_->flush_standard_output();
 	available_funds_ = 0;
 	throw ex;
     }
@@ -52,20 +58,20 @@ bool in_session_state::next()
 {
     using namespace prologcoin::interp;
 
-    interp_.reset_text_out();
-    interp_.set_maximum_cost(available_funds_);
+    interp_->reset_text_out();
+    interp_->set_maximum_cost(available_funds_);
     bool r = false;
     try {
-	r = interp_.next();
-	interp_.flush_standard_output();
-	auto cost = interp_.accumulated_cost();
+	r = interp_->next();
+	interp_->flush_standard_output();
+	auto cost = interp_->accumulated_cost();
 	if (cost > available_funds_) {
 	    available_funds_ = 0;
 	} else {
 	    available_funds_ -= cost;
 	}
     } catch (const interpreter_exception_out_of_funds &ex) {
-	interp_.flush_standard_output();
+	interp_->flush_standard_output();
 	available_funds_ = 0;
 	throw ex;
     }
@@ -74,22 +80,22 @@ bool in_session_state::next()
 
 bool in_session_state::at_end()
 {
-    return !interp_.has_more() && interp_.is_instance();
+    return !interp_->has_more() && interp_->is_instance();
 }
 
 void in_session_state::delete_instance()
 {
-    interp_.delete_instance();
+    interp_->delete_instance();
 }
 
 bool in_session_state::reset()
 {
-    return interp_.reset();
+    return interp_->reset();
 }
 
 void in_session_state::local_reset()
 {
-    interp_.local_reset();
+    interp_->local_reset();
 }
 
 void in_session_state::add_funds(uint64_t dfunds)
@@ -198,12 +198,26 @@ void sync::setup_sync_impl()
     std::string template_source_1 = R"PROG(
 
 sync :- 
+    sync_height,
     critical_section((sync:mode(Mode), sync_run(Mode))).
 
+%
+% The height is asked for outside the critical section, as fanout/5
+% waits for the answers (for at most sync:fanout_timeout ms) and that
+% would block everything waiting for the critical section.
+%
+sync_height :-
+    current_predicate(sync:mode/1), sync:mode(meta),
+    \+ current_predicate(tmp:height/1),
+    !,
+    (meta_broadcast_get_height(10, []) ; true).
+sync_height.
+
 sync_setup :-
     (\+ current_predicate(sync:mode/1) -> assert(sync:mode(meta)) ; true),
     (\+ current_predicate(sync:step/1) -> assert(sync:step(1000)) ; true),
     (\+ current_predicate(sync:'timeout'/1) -> assert(sync:'timeout'(100000)) ; true),
+    (\+ current_predicate(sync:fanout_timeout/1) -> assert(sync:fanout_timeout(2000)) ; true),
     (\+ current_predicate(sync:lookahead/1) -> assert(sync:lookahead(10)) ; true),
     (\+ current_predicate(sync:low/1) -> assert(sync:low(0)) ; true),
     (current_predicate(sync:low_db/2), sync:low_db(symbols,_) -> true ; assert(sync:low_db(symbols,0))),
@@ -235,7 +249,6 @@ sync_run(meta) :-
      assert(sync:mode(wait))).
 
 meta_update_progress :-
-    (current_predicate(tmp:height/1) -> true ; (meta_broadcast_get_height(10,[]) ; true)), !,
     (current_predicate(sync:progress/1) -> retract(sync:progress(_)) ; true),
     (current_predicate(tmp:height/1), current_predicate(sync:low/1) ->
         tmp:height(TotalHeight),
@@ -244,34 +257,39 @@ meta_update_progress :-
 	assert(sync:progress(Progress))
      ;  assert(sync:progress(0))).
 
+%
+% meta_broadcast_get_height(N, UsedConn)
+%
+% Ask (up to) N ready connections for their height at once and use
+% the median of the answers. We're done when a majority has answered.
+% Not called in the critical section (see sync_height.)
+%
+
 meta_broadcast_get_height(N, UsedConn) :-
-    N > 0, !,
-    ready(Conn, UsedConn),
-    NewUsed = [Conn|UsedConn],
-    (current_predicate(tmp:broadcast/1), tmp:broadcast(Conn) -> true
-    ;  assert(tmp:broadcast(Conn)),
-       sync:'timeout'(Timeout),
-       (max_height(H) @= (Conn else (H = fail) timeout Timeout)),
-       freeze(H, critical_section((
-         debug((write('Height='), write(H), write(' from '), write(Conn), nl)),
-         (number(H) -> assert(tmp:received_height(H,Conn)) 
-         ; retract(tmp:broadcast(Conn))))))),
-    !, N1 is N - 1, meta_broadcast_get_height(N1, NewUsed).
-
-meta_broadcast_get_height(_, _) :-
-    (current_predicate(tmp:received_height/2) -> 
-     findall(H-Conn, tmp:received_height(H,Conn), L) ; L = []),
+    meta_ready_connections(N, UsedConn, Conns),
+    Conns \= [],
+    length(Conns, NumConns),
+    Quorum is NumConns // 2 + 1,
+    sync:fanout_timeout(Timeout),
+    fanout(max_height(_), Conns, Quorum, Timeout, Results),
+    findall(H-Conn, (member(Conn-max_height(H), Results), number(H)), L),
+    debug((write('Heights='), write(L), nl)),
     sort(L, Sorted),
-    length(Sorted, N),
-    (N > 0 ->
-       N2 is N // 2,
-       nth0(N2, Sorted, M-_), % Median
-       (current_predicate(tmp:height/1) -> retract(tmp:height(OldHeight)) ; OldHeight = []),
-       (M \= OldHeight ->
-           debug((write('Summarized Height is '), write(M), nl)) ; true),
-       assert(tmp:height(M))
-    ; true).
-    
+    length(Sorted, M),
+    M > 0,
+    M2 is M // 2,
+    nth0(M2, Sorted, Median-_),
+    debug((write('Summarized Height is '), write(Median), nl)),
+    critical_section((current_predicate(tmp:height/1) -> true
+                      ; assert(tmp:height(Median)))).
+
+meta_ready_connections(0, _, []) :- !.
+meta_ready_connections(N, UsedConn, [Conn|Conns]) :-
+    ready(Conn, UsedConn),
+    !,
+    N1 is N - 1,
+    meta_ready_connections(N1, [Conn|UsedConn], Conns).
+meta_ready_connections(_, _, []).
 
 sync_run(wait) :-
     !,
@@ -922,7 +940,9 @@ sync_block_download(N, UsedConn) :-
 	          (Hash == ExpectedHash -> 
                       (Root == PrevId ->
 		          sync_add_block(Id, Height, Block, Connection)
-	    	        ; sync_delay_block(Id, Height, Block, Connection))
+	    	        ; % Check it in the background while we wait
+                          (submit_block(Id, meta(OurParams), Block) -> true ; true),
+                          sync_delay_block(Id, Height, Block, Connection))
                   ; sync_fail_download(Id, Height, Connection)))))),
       	 N1 is N - 1,
          !,
@@ -941,8 +961,7 @@ sync_add_block(Id, Height, Block, _) :-
     Meta = meta(Params),
     member(previd(PrevId), Params), !,
     switch(PrevId),
-    setup_commit(Meta),
-    commit(Block),
+    commit_block(Id, Meta, Block),
     tip(TipId),
     retract(tmp:getblock(Id, _)),
     retract(sync:rootid(_)),
@@ -963,6 +982,7 @@ sync_add_block(Id, Height, _, Connection) :-
 %
 
 sync_fail_download(Id, Height, Connection) :-
+    drop_block(Id),
     (current_predicate(tmp:fail/2), tmp:fail(Connection, N) ->
       retract(tmp:fail(Connection,_)),
       N1 is N + 1,
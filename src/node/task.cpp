@@ -6,8 +6,12 @@ namespace prologcoin { namespace node {
 using namespace prologcoin::common;
 
 out_task::out_task(const char *description, type_t type, out_connection *out)
-    : type_(type), description_(description), out_(out), env_(&out->env()),
-      state_(IDLE), when_(utime::now())
+    : type_(type), priority_(default_priority(type)),
+      description_(description), out_(out),
+      env_(out != nullptr ? &out->env() : nullptr),
+      state_(IDLE), when_(utime::now()),
+      queue_prev_(nullptr), queue_next_(nullptr), queue_level_(-2),
+      queue_slot_(0), queue_index_(0), queue_seq_(0)
 {
 }
 
@@ -28,9 +32,18 @@ std::string out_task::get_state_name() const
    }
 }
    
-bool out_task::comparator(const out_task *t1, const out_task *t2)
+out_task::priority_t out_task::default_priority(type_t type)
 {
-    return t1->get_when() > t2->get_when();
+    switch (type) {
+    case TYPE_INIT_CONNECTION:
+    case TYPE_RESET:
+    case TYPE_EXECUTE_QUERY:
+	return PRIORITY_HIGH;
+    case TYPE_HEARTBEAT:
+	return PRIORITY_LOW;
+    default:
+	return PRIORITY_NORMAL;
+    }
 }
 
 void out_task::reschedule(utime t)
@@ -39,17 +39,34 @@ public:
 	TYPE_EXECUTE_QUERY = 8
     };
 
+    // Among the tasks that are due, higher priority ones go first
+    // (e.g. queries from sync before heartbeats.)
+    enum priority_t {
+	PRIORITY_HIGH = 0,
+	PRIORITY_NORMAL = 1,
+	PRIORITY_LOW = 2
+    };
+    static const size_t NUM_PRIORITIES = 3;
+
+    static priority_t default_priority(type_t type);
+
     out_task(const char *description, type_t type, out_connection *out);
     virtual ~out_task();
 
-    static bool comparator(const out_task *t1, const out_task *t2);
-
     inline const char * description() const { return description_; }
 
     inline type_t get_type() const { return type_; }
 
+    // Must not be changed while the task is scheduled.
+    inline priority_t priority() const { return priority_; }
+    inline void set_priority(priority_t p) { priority_ = p; }
+
     virtual void process() = 0;
 
+    // Pipelined tasks can be sent while replies to earlier (pipelined)
+    // tasks are still outstanding on the connection.
+    virtual bool is_pipelined() const { return false; }
+
     void stop();
 
     inline void set_query(const term t, bool silent)
@@ -122,13 +139,24 @@ protected:
     void error(const reason_t &reason, const std::string &msg);
 
 private:
+    friend class task_queue;
+
     type_t type_;
+    priority_t priority_;
     const char *description_;
     out_connection *out_;
     term_env *env_;
     state_t state_;
     utime when_;
     term term_;
+
+    // Bookkeeping of the task_queue it is scheduled in
+    out_task *queue_prev_;
+    out_task *queue_next_;
+    int16_t queue_level_;
+    uint16_t queue_slot_;
+    size_t queue_index_;
+    uint64_t queue_seq_;
 };
 
 }}
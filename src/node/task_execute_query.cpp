@@ -87,6 +87,18 @@ task_execute_query::task_execute_query(out_connection *out,
 task_execute_query::~task_execute_query()
 {
     if (delayed_) delayed_->interp->delayed_ready(delayed_);
+    if (ready_fn_) ready_fn_(false);
+}
+
+void task_execute_query::on_ready(const std::function<void (bool)> &fn)
+{
+    bool ready;
+    {
+	boost::unique_lock<boost::mutex> lockit(result_cv_lock_);
+	ready_fn_ = fn;
+	ready = result_ready_;
+    }
+    if (ready) fn(true);
 }
 
 void task_execute_query::wait_for_result()
@@ -153,6 +165,7 @@ void task_execute_query::process()
 	    delayed_->standard_out = get_standard_out();
 	    delayed_->interp->delayed_ready(delayed_);
 	}
+	if (ready_fn_) ready_fn_(true);
 	connection().decrement_pending_queries();
 	result_cv_.notify_one();
 	set_state(WAIT);
@@ -35,6 +35,16 @@ public:
     inline bool failed() const { return result_ == term(); }
     inline void consume_result() { result_consumed_ = true; }
 
+    // fn(true) is called when the reply has arrived (right away if it
+    // already has) and fn(false) when the task is deleted.
+    void on_ready(const std::function<void (bool)> &fn);
+
+    // Only plain queries are pipelined. Getting the next solution and
+    // creating/deleting instances depend on the replies to what was
+    // sent before them, so they wait until nothing is in flight (which
+    // keeps them in order with the queries of the instance.)
+    virtual bool is_pipelined() const override { return type_ == QUERY; }
+
 private:
     virtual void process() override;
 
@@ -54,6 +64,7 @@ private:
     boost::condition_variable result_cv_;
     interp::remote_execute_mode mode_;
     node_delayed_t *delayed_;
+    std::function<void (bool)> ready_fn_;
 };
 
 }}
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <vector>
+#include "task_queue.hpp"
+
+namespace prologcoin { namespace node {
+
+using namespace prologcoin::common;
+
+task_queue::task_queue()
+    : tick_(utime::now().in_us() / TICK_US),
+      seq_(0),
+      head_(nullptr),
+      size_(0),
+      max_size_(0),
+      num_started_(0),
+      num_late_(0),
+      total_lateness_us_(0),
+      max_lateness_us_(0)
+{
+    for (size_t level = 0; level < NUM_LEVELS; level++) {
+	for (size_t slot = 0; slot < NUM_SLOTS; slot++) {
+	    wheel_[level][slot].first = nullptr;
+	    wheel_[level][slot].last = nullptr;
+	}
+	in_level_[level] = 0;
+    }
+    for (size_t p = 0; p < out_task::NUM_PRIORITIES; p++) {
+	size_by_priority_[p] = 0;
+    }
+}
+
+void task_queue::link_last(list &l, out_task *task)
+{
+    task->queue_prev_ = l.last;
+    task->queue_next_ = nullptr;
+    if (l.last == nullptr) {
+	l.first = task;
+    } else {
+	l.last->queue_next_ = task;
+    }
+    l.last = task;
+}
+
+void task_queue::link_before(list &l, out_task *before, out_task *task)
+{
+    task->queue_next_ = before;
+    task->queue_prev_ = before->queue_prev_;
+    if (before->queue_prev_ == nullptr) {
+	l.first = task;
+    } else {
+	before->queue_prev_->queue_next_ = task;
+    }
+    before->queue_prev_ = task;
+}
+
+void task_queue::unlink(list &l, out_task *task)
+{
+    if (task->queue_prev_ == nullptr) {
+	l.first = task->queue_next_;
+    } else {
+	task->queue_prev_->queue_next_ = task->queue_next_;
+    }
+    if (task->queue_next_ == nullptr) {
+	l.last = task->queue_prev_;
+    } else {
+	task->queue_next_->queue_prev_ = task->queue_prev_;
+    }
+    task->queue_prev_ = nullptr;
+    task->queue_next_ = nullptr;
+}
+
+task_queue::list & task_queue::list_of(out_task *task)
+{
+    return wheel_[task->queue_level_][task->queue_slot_];
+}
+
+void task_queue::heap_up(std::vector<out_task *> &heap, size_t i)
+{
+    out_task *task = heap[i];
+    while (i > 0) {
+	size_t parent = (i - 1) / 2;
+	if (!earlier(task, heap[parent])) {
+	    break;
+	}
+	heap_set(heap, i, heap[parent]);
+	i = parent;
+    }
+    heap_set(heap, i, task);
+}
+
+void task_queue::heap_down(std::vector<out_task *> &heap, size_t i)
+{
+    out_task *task = heap[i];
+    size_t n = heap.size();
+    for (;;) {
+	size_t child = 2 * i + 1;
+	if (child >= n) {
+	    break;
+	}
+	if (child + 1 < n && earlier(heap[child + 1], heap[child])) {
+	    child++;
+	}
+	if (!earlier(heap[child], task)) {
+	    break;
+	}
+	heap_set(heap, i, heap[child]);
+	i = child;
+    }
+    heap_set(heap, i, task);
+}
+
+void task_queue::push(out_task *task)
+{
+    if (task->queue_level_ != NOT_QUEUED) {
+	remove(task);
+    }
+    advance(utime::now().in_us() / TICK_US);
+    task->queue_seq_ = seq_++;
+    size_++;
+    size_by_priority_[task->priority()]++;
+    if (size_ > max_size_) {
+	max_size_ = size_;
+    }
+    insert(task);
+}
+
+void task_queue::remove(out_task *task)
+{
+    if (task->queue_level_ == NOT_QUEUED) {
+	return;
+    }
+    if (task->queue_level_ == READY) {
+	auto &heap = ready_[task->queue_slot_];
+	size_t i = task->queue_index_;
+	out_task *last = heap.back();
+	heap.pop_back();
+	if (i < heap.size()) {
+	    heap_set(heap, i, last);
+	    heap_up(heap, i);
+	    heap_down(heap, last->queue_index_);
+	}
+    } else {
+	unlink(list_of(task), task);
+	in_level_[task->queue_level_]--;
+    }
+    task->queue_level_ = NOT_QUEUED;
+    size_--;
+    size_by_priority_[task->priority()]--;
+    if (task == head_) {
+	head_ = nullptr;
+    }
+}
+
+//
+// Put the task in the wheel, at the lowest level whose range covers
+// it, or in the ready list if it's due.
+//
+void task_queue::insert(out_task *task)
+{
+    uint64_t when_tick = task->get_when().in_us() / TICK_US;
+    if (when_tick <= tick_) {
+	insert_ready(task);
+	return;
+    }
+    uint64_t delta = when_tick - tick_;
+    size_t level = 0;
+    while (level < NUM_LEVELS - 1 && delta >= level_span(level + 1)) {
+	level++;
+    }
+    if (delta >= level_span(NUM_LEVELS)) {
+	// Beyond the range of the wheel; park it in the furthest slot
+	// and it'll be put back in when that slot is cascaded.
+	when_tick = tick_ + level_span(NUM_LEVELS) - 1;
+    }
+    size_t slot = slot_of(when_tick, level);
+    task->queue_level_ = static_cast<int16_t>(level);
+    task->queue_slot_ = static_cast<uint16_t>(slot);
+    link_last(wheel_[level][slot], task);
+    in_level_[level]++;
+}
+
+void task_queue::insert_ready(out_task *task)
+{
+    auto p = task->priority();
+    auto &heap = ready_[p];
+    task->queue_level_ = READY;
+    task->queue_slot_ = static_cast<uint16_t>(p);
+    heap.push_back(task);
+    heap_up(heap, heap.size() - 1);
+}
+
+void task_queue::cascade(size_t level, size_t slot)
+{
+    auto &l = wheel_[level][slot];
+    out_task *task = l.first;
+    l.first = nullptr;
+    l.last = nullptr;
+    while (task != nullptr) {
+	out_task *next = task->queue_next_;
+	in_level_[level]--;
+	task->queue_prev_ = nullptr;
+	task->queue_next_ = nullptr;
+	insert(task);
+	task = next;
+    }
+}
+
+void task_queue::expire(size_t slot)
+{
+    auto &l = wheel_[0][slot];
+    out_task *task = l.first;
+    l.first = nullptr;
+    l.last = nullptr;
+    while (task != nullptr) {
+	out_task *next = task->queue_next_;
+	in_level_[0]--;
+	task->queue_prev_ = nullptr;
+	task->queue_next_ = nullptr;
+	insert_ready(task);
+	task = next;
+    }
+}
+
+void task_queue::advance(uint64_t now_tick)
+{
+    while (tick_ < now_tick) {
+	size_t in_wheel = 0;
+	for (size_t level = 0; level < NUM_LEVELS; level++) {
+	    in_wheel += in_level_[level];
+	}
+	if (in_wheel == 0) {
+	    tick_ = now_tick;
+	    break;
+	}
+	uint64_t next_tick = tick_ + 1;
+	if (in_level_[0] == 0) {
+	    // Nothing at the lowest level; skip to where the next
+	    // slot above gets cascaded.
+	    next_tick = std::min((tick_ | (NUM_SLOTS - 1)) + 1, now_tick);
+	}
+	tick_ = next_tick;
+	for (size_t level = NUM_LEVELS - 1; level > 0; level--) {
+	    if ((tick_ & (level_span(level) - 1)) == 0) {
+		cascade(level, slot_of(tick_, level));
+	    }
+	}
+	expire(slot_of(tick_, 0));
+    }
+}
+
+out_task * task_queue::top()
+{
+    if (head_ != nullptr && head_->get_state() != out_task::IDLE) {
+	return head_;
+    }
+    advance(utime::now().in_us() / TICK_US);
+    head_ = nullptr;
+    for (size_t p = 0; p < out_task::NUM_PRIORITIES; p++) {
+	if (!ready_[p].empty()) {
+	    head_ = ready_[p].front();
+	    break;
+	}
+    }
+    return head_;
+}
+
+void task_queue::pop()
+{
+    if (head_ == nullptr) {
+	top();
+    }
+    if (head_ != nullptr) {
+	remove(head_);
+    }
+}
+
+utime task_queue::next_when()
+{
+    utime earliest;
+    bool found = false;
+    auto consider = [&](const out_task *task) {
+	if (!found || task->get_when() < earliest) {
+	    earliest = task->get_when();
+	    found = true;
+	}
+    };
+    for (size_t p = 0; p < out_task::NUM_PRIORITIES; p++) {
+	if (!ready_[p].empty()) {
+	    // Ordered by when
+	    consider(ready_[p].front());
+	}
+    }
+    // The first non-empty slot (after the current one) at each level
+    for (size_t level = 0; level < NUM_LEVELS; level++) {
+	if (in_level_[level] == 0) {
+	    continue;
+	}
+	size_t current = slot_of(tick_, level);
+	for (size_t i = 1; i <= NUM_SLOTS; i++) {
+	    auto &l = wheel_[level][(current + i) & (NUM_SLOTS - 1)];
+	    if (l.first != nullptr) {
+		for (auto *task = l.first; task != nullptr; task = task->queue_next_) {
+		    consider(task);
+		}
+		break;
+	    }
+	}
+    }
+    return earliest;
+}
+
+void task_queue::started(out_task *task)
+{
+    num_started_++;
+    auto when = task->get_when();
+    auto now = utime::now();
+    if (when.is_zero() || when >= now) {
+	return;
+    }
+    uint64_t lateness = (now - when).in_us();
+    total_lateness_us_ += lateness;
+    if (lateness > max_lateness_us_) {
+	max_lateness_us_ = lateness;
+    }
+    if (lateness >= TICK_US) {
+	num_late_++;
+    }
+}
+
+void task_queue::for_each(const std::function<void (out_task *)> &fn) const
+{
+    for (size_t p = 0; p < out_task::NUM_PRIORITIES; p++) {
+	// A copy, as fn may remove the task
+	auto ready = ready_[p];
+	for (auto *task : ready) {
+	    fn(task);
+	}
+    }
+    for (size_t level = 0; level < NUM_LEVELS; level++) {
+	for (size_t slot = 0; slot < NUM_SLOTS; slot++) {
+	    for (auto *task = wheel_[level][slot].first; task != nullptr;) {
+		auto *next = task->queue_next_;
+		fn(task);
+		task = next;
+	    }
+	}
+    }
+}
+
+void task_queue::clear()
+{
+    std::vector<out_task *> all;
+    for_each([&](out_task *task) { all.push_back(task); });
+    for (auto *task : all) {
+	remove(task);
+    }
+}
+
+}}
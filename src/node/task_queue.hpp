@@ -0,0 +1,122 @@
+#pragma once
+
+#ifndef _node_task_queue_hpp
+#define _node_task_queue_hpp
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "../common/utime.hpp"
+#include "task.hpp"
+
+namespace prologcoin { namespace node {
+
+//
+// task_queue. The scheduled tasks of an out_connection.
+//
+// Tasks that aren't due yet live in a hierarchical timer wheel
+// (NUM_LEVELS levels of NUM_SLOTS slots, TICK_US per tick at the
+// lowest level) so that scheduling and cancelling a task is O(1), no
+// matter how many heartbeats, info and publish tasks are pending. As
+// time advances, tasks move down the levels until they expire into
+// the ready heap of their priority (ordered by when, and then by the
+// order they were scheduled), so that is O(log n) too.
+//
+// top() is the ready task of highest priority (or nullptr if no task
+// is due.) Once the top task has left the IDLE state it's the one
+// being processed, and it stays on top until it is popped, so a new
+// urgent task never gets in the way of a send/receive in progress.
+//
+// The queue is not thread safe; it is guarded by the work lock of its
+// connection.
+//
+class task_queue {
+public:
+    using utime = common::utime;
+
+    static const size_t NUM_LEVELS = 4;
+    static const size_t SLOT_BITS = 6;
+    static const size_t NUM_SLOTS = static_cast<size_t>(1) << SLOT_BITS;
+    static const uint64_t TICK_US = 1000;
+
+    task_queue();
+
+    inline bool empty() const { return size_ == 0; }
+    inline size_t size() const { return size_; }
+    inline size_t size(out_task::priority_t p) const
+    { return size_by_priority_[p]; }
+
+    void push(out_task *task);
+    void remove(out_task *task);
+    out_task * top();
+    void pop();
+
+    // Earliest when of all tasks (zero if empty, but a task scheduled
+    // with reschedule_next() has zero as its when too.)
+    utime next_when();
+
+    // Record that task is about to be processed (for lateness.)
+    void started(out_task *task);
+
+    void for_each(const std::function<void (out_task *)> &fn) const;
+    void clear();
+
+    // Statistics
+    inline size_t max_size() const { return max_size_; }
+    inline uint64_t num_started() const { return num_started_; }
+    inline uint64_t num_late() const { return num_late_; }
+    inline uint64_t total_lateness_us() const { return total_lateness_us_; }
+    inline uint64_t max_lateness_us() const { return max_lateness_us_; }
+
+private:
+    struct list {
+	out_task *first;
+	out_task *last;
+    };
+
+    static const int16_t NOT_QUEUED = -2;
+    static const int16_t READY = -1;
+
+    inline static uint64_t level_span(size_t level)
+    { return static_cast<uint64_t>(1) << (SLOT_BITS * level); }
+    inline static size_t slot_of(uint64_t tick, size_t level)
+    { return static_cast<size_t>(tick >> (SLOT_BITS * level)) & (NUM_SLOTS - 1); }
+
+    void link_last(list &l, out_task *task);
+    void link_before(list &l, out_task *before, out_task *task);
+    void unlink(list &l, out_task *task);
+    list & list_of(out_task *task);
+
+    inline static bool earlier(const out_task *a, const out_task *b)
+    { return a->get_when() < b->get_when() ||
+	     (a->get_when() == b->get_when() && a->queue_seq_ < b->queue_seq_); }
+    inline static void heap_set(std::vector<out_task *> &heap, size_t i, out_task *task)
+    { heap[i] = task; task->queue_index_ = i; }
+    static void heap_up(std::vector<out_task *> &heap, size_t i);
+    static void heap_down(std::vector<out_task *> &heap, size_t i);
+
+    void insert(out_task *task);
+    void insert_ready(out_task *task);
+    void advance(uint64_t now_tick);
+    void cascade(size_t level, size_t slot);
+    void expire(size_t slot);
+
+    list wheel_[NUM_LEVELS][NUM_SLOTS];
+    size_t in_level_[NUM_LEVELS];
+    std::vector<out_task *> ready_[out_task::NUM_PRIORITIES];
+    uint64_t tick_;
+    uint64_t seq_;
+    out_task *head_;
+
+    size_t size_;
+    size_t size_by_priority_[out_task::NUM_PRIORITIES];
+    size_t max_size_;
+    uint64_t num_started_;
+    uint64_t num_late_;
+    uint64_t total_lateness_us_;
+    uint64_t max_lateness_us_;
+};
+
+}}
+
+#endif
@@ -120,12 +120,71 @@ static void test_operator_at_simple()
     network.stop();
 }
 
+static void test_operator_at_fanout()
+{
+    header("test_operator_at_fanout");
+
+    setup_nodes network({ { "apple", 8000, (test_dir / "db8000").string() },
+  	                  { "pear", 8001, (test_dir / "db8001").string() },
+		          { "banana", 8002, (test_dir /"db8002").string() } } );
+
+    network.start();
+
+    auto tm = network.new_terminal("apple");
+
+    // Helpers so that only the interesting variable gets printed
+    bool r = tm->execute("assert((fan_all(L) :- fanout(X is 6*7, [pear,banana,cherry], 0, 5000, R), findall(P-V, member(P-(V is _), R), L0), sort(L0, L))).");
+    assert(r);
+    tm->flush_text();
+    r = tm->execute("assert((fan_quorum(N) :- fanout(member(_,[1,2]), [pear,banana], 1, 5000, R), length(R, N))).");
+    assert(r);
+    tm->flush_text();
+    r = tm->execute("assert((fan_timeout(R) :- fanout(sleep(2000), [pear], 0, 100, R))).");
+    assert(r);
+    tm->flush_text();
+
+    // All peers (cherry doesn't exist and fails)
+    {
+	bool r = tm->execute("fan_all(L).");
+	assert(r);
+	network.check_result(tm, { "L = [banana-42, pear-42]" });
+    }
+
+    // First of two is enough
+    {
+	bool r = tm->execute("fan_quorum(N).");
+	assert(r);
+	network.check_result(tm, { "N = 1" });
+    }
+
+    // Peer doesn't answer in time
+    {
+	bool r = tm->execute("fan_timeout(R).");
+	assert(r);
+	network.check_result(tm, { "R = [pear-timeout]" });
+    }
+
+    // Replies have been recorded
+    {
+	bool r = tm->execute("fanout_latency(H), H \\= [].");
+	assert(r);
+	tm->flush_text();
+    }
+
+    tm->close();
+
+    utime::sleep(utime::ss(1));
+
+    network.stop();
+}
+
 int main(int argc, char *argv[])
 {
     std::string home_dir = find_home_dir(argv[0]);
     test_dir = boost::filesystem::path(home_dir) / "bin" / "test" / "node" / "triedb";
   
     test_operator_at_simple();
+    test_operator_at_fanout();
 
     return 0;
 }
@@ -0,0 +1,212 @@
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include <node/task_queue.hpp>
+
+using namespace prologcoin::common;
+using namespace prologcoin::node;
+
+static void header( const std::string &str )
+{
+    std::cout << "\n";
+    std::cout << "--- [" + str + "] " + std::string(60 - str.length(), '-') << "\n";
+    std::cout << "\n";
+}
+
+// A task without a connection; the queue only looks at when and priority.
+class test_task : public out_task {
+public:
+    test_task(size_t id, out_task::priority_t p, utime when)
+	: out_task("test", TYPE_NONE, nullptr), id_(id) {
+	set_priority(p);
+	set_when(when);
+    }
+
+    virtual void process() override { }
+
+    inline size_t id() const { return id_; }
+
+private:
+    size_t id_;
+};
+
+typedef std::vector<std::unique_ptr<test_task> > tasks_t;
+
+static test_task * new_task(tasks_t &tasks, out_task::priority_t p, utime when)
+{
+    tasks.push_back(std::unique_ptr<test_task>(new test_task(tasks.size(), p, when)));
+    return tasks.back().get();
+}
+
+static test_task * pop_top(task_queue &q)
+{
+    auto *task = static_cast<test_task *>(q.top());
+    if (task != nullptr) {
+	q.pop();
+    }
+    return task;
+}
+
+// Pop all tasks, waiting for them to become due, and return their ids.
+static std::vector<size_t> drain(task_queue &q)
+{
+    std::vector<size_t> ids;
+    auto deadline = utime::now() + utime::ss(10);
+    while (!q.empty() && utime::now() < deadline) {
+	auto *task = pop_top(q);
+	if (task == nullptr) {
+	    boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+	    continue;
+	}
+	assert(task->get_when() <= utime::now());
+	ids.push_back(task->id());
+    }
+    return ids;
+}
+
+static void test_insert()
+{
+    header("test_insert");
+
+    tasks_t tasks;
+    task_queue q;
+
+    utime past = utime::now() - utime::ss(1);
+    utime future = utime::now() + utime::ss(60);
+
+    new_task(tasks, out_task::PRIORITY_LOW, past);
+    new_task(tasks, out_task::PRIORITY_NORMAL, past + utime::us(10));
+    new_task(tasks, out_task::PRIORITY_HIGH, past + utime::us(20));
+    new_task(tasks, out_task::PRIORITY_NORMAL, past + utime::us(5));
+    new_task(tasks, out_task::PRIORITY_HIGH, future);
+    for (auto &t : tasks) {
+	q.push(t.get());
+    }
+    assert(q.size() == 5);
+    assert(q.size(out_task::PRIORITY_HIGH) == 2);
+    assert(q.size(out_task::PRIORITY_NORMAL) == 2);
+    assert(q.size(out_task::PRIORITY_LOW) == 1);
+    assert(q.next_when() == past);
+
+    // Highest priority first, then by when; the future task isn't due.
+    std::vector<size_t> order;
+    while (auto *task = pop_top(q)) {
+	order.push_back(task->id());
+    }
+    std::cout << "Popped:";
+    for (auto id : order) std::cout << " " << id;
+    std::cout << std::endl;
+    assert((order == std::vector<size_t>{2, 3, 1, 0}));
+    assert(q.size() == 1);
+    assert(q.next_when() == future);
+
+    q.clear();
+    assert(q.empty());
+}
+
+static void test_cancel()
+{
+    header("test_cancel");
+
+    tasks_t tasks;
+    task_queue q;
+
+    auto now = utime::now();
+    auto *ready0 = new_task(tasks, out_task::PRIORITY_NORMAL, now - utime::ms(3));
+    auto *ready1 = new_task(tasks, out_task::PRIORITY_NORMAL, now - utime::ms(2));
+    auto *ready2 = new_task(tasks, out_task::PRIORITY_NORMAL, now - utime::ms(1));
+    auto *near = new_task(tasks, out_task::PRIORITY_NORMAL, now + utime::ms(20));
+    auto *far = new_task(tasks, out_task::PRIORITY_NORMAL, now + utime::ss(30));
+    for (auto &t : tasks) {
+	q.push(t.get());
+    }
+
+    std::cout << "Cancel ready and scheduled tasks..." << std::endl;
+    q.remove(ready0);
+    q.remove(ready0); // Not queued; nothing happens
+    q.remove(far);
+    q.remove(near);
+    assert(q.size() == 2);
+    assert(q.top() == ready1);
+    q.remove(ready1);
+    assert(q.top() == ready2);
+
+    // Rescheduling a queued task moves it
+    ready2->set_when(utime::now() + utime::ms(5));
+    q.push(ready2);
+    assert(q.size() == 1);
+    assert(q.top() == nullptr);
+
+    auto ids = drain(q);
+    assert((ids == std::vector<size_t>{2}));
+    assert(q.empty());
+}
+
+static void test_rollover()
+{
+    header("test_rollover");
+
+    tasks_t tasks;
+    task_queue q;
+
+    // Deadlines around the slot and level boundaries of the wheel
+    // (level 0 covers 64 ticks, level 1 covers 4096 ticks.)
+    const uint64_t tick = task_queue::TICK_US;
+    const uint64_t offsets[] = { 130, 1, 63, 64, 200, 65, 2, 127, 128, 129,
+				 4100, 62, 300 };
+    auto now = utime::now();
+    for (auto off : offsets) {
+	new_task(tasks, out_task::PRIORITY_NORMAL, now + utime::us(off * tick));
+    }
+    for (auto &t : tasks) {
+	q.push(t.get());
+    }
+    assert(q.top() == nullptr || q.top()->get_when() <= utime::now());
+
+    std::cout << "Wait for " << tasks.size() << " tasks to expire..." << std::endl;
+    auto ids = drain(q);
+    assert(ids.size() == tasks.size());
+    for (size_t i = 1; i < ids.size(); i++) {
+	assert(tasks[ids[i-1]]->get_when() <= tasks[ids[i]]->get_when());
+    }
+    assert(q.empty());
+}
+
+static void test_equal_deadlines()
+{
+    header("test_equal_deadlines");
+
+    tasks_t tasks;
+    task_queue q;
+
+    const size_t N = 100;
+
+    // Tasks with the same when come out in the order they were
+    // scheduled, whether they were due at once or expired from the wheel.
+    utime past = utime::now() - utime::ms(1);
+    utime future = utime::now() + utime::ms(70);
+    for (size_t i = 0; i < N; i++) {
+	new_task(tasks, out_task::PRIORITY_NORMAL, (i % 2 == 0) ? past : future);
+    }
+    for (size_t i = 0; i < N; i++) {
+	q.push(tasks[i].get());
+    }
+    auto ids = drain(q);
+    assert(ids.size() == N);
+    for (size_t i = 0; i < N; i++) {
+	size_t expect = (i < N / 2) ? 2 * i : 2 * (i - N / 2) + 1;
+	assert(ids[i] == expect);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    test_insert();
+    test_cancel();
+    test_rollover();
+    test_equal_deadlines();
+
+    return 0;
+}
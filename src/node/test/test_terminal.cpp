@@ -6,6 +6,9 @@
 #include <node/self_node.hpp>
 #include <terminal/terminal.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
 
 using namespace prologcoin::common;
 using namespace prologcoin::node;
@@ -73,11 +76,219 @@ static void test_terminal()
     node.join();
 }
 
+static void test_terminal_pipelined()
+{
+    header("test_terminal_pipelined()");
+
+    global::erase_db(test_dir);
+
+    self_node node(test_dir, 8000);
+    node.start();
+
+    terminal tm(8000);
+    bool r = tm.connect();
+    assert(r);
+
+    const size_t N = 100;
+    auto query = [&](size_t i) {
+	std::stringstream ss;
+	ss << "X is " << i << "*" << i << ".";
+	return tm.parse(ss.str());
+    };
+    auto expect = [](size_t i) {
+	return boost::lexical_cast<std::string>(i*i);
+    };
+
+    auto start = boost::posix_time::microsec_clock::local_time();
+    for (size_t i = 0; i < N; i++) {
+	r = tm.execute(query(i), false);
+	assert(r);
+	assert(tm.get_result_string("X") == expect(i));
+    }
+    auto stop = boost::posix_time::microsec_clock::local_time();
+    auto sequential_us = (stop - start).total_microseconds();
+
+    // Send all queries before waiting for any result, then collect
+    // the results in reverse order.
+    start = boost::posix_time::microsec_clock::local_time();
+    std::vector<int64_t> ids;
+    for (size_t i = 0; i < N; i++) {
+	auto id = tm.send_execute(query(i), false);
+	assert(id >= 0);
+	ids.push_back(id);
+    }
+    for (size_t i = N; i-- > 0;) {
+	r = tm.wait_result(ids[i]);
+	assert(r);
+	assert(tm.get_result_string("X") == expect(i));
+    }
+    stop = boost::posix_time::microsec_clock::local_time();
+    auto pipelined_us = (stop - start).total_microseconds();
+    assert(tm.num_in_flight() == 0);
+
+    std::cout << N << " queries: sequential " << sequential_us << " us, "
+	      << "pipelined " << pipelined_us << " us" << std::endl;
+
+    tm.close();
+
+    node.stop();
+    node.join();
+}
+
+static void test_interpreter_pool()
+{
+    header("test_interpreter_pool()");
+
+    global::erase_db(test_dir);
+
+    self_node node(test_dir, 8000);
+    node.set_timer_interval(utime::ms(50));
+    node.set_time_to_live(utime::ms(100));
+    auto &pool = node.interpreter_pool();
+    pool.set_warm_size(1);
+    node.start();
+
+    // Set up when the node started
+    assert(pool.size() == 1);
+    assert(pool.num_setups() == 1);
+
+    // Run a query in a new session, close it and wait for the session
+    // to expire and its interpreter to be released (i.e. recycled or
+    // discarded.)
+    auto run_session = [&](const std::string &query) {
+	auto released = [&]() {
+	    return pool.size() + pool.num_discarded() + pool.num_hits();
+	};
+	auto before = released();
+	terminal tm(8000);
+	bool r = tm.connect();
+	assert(r);
+	r = tm.execute(query);
+	tm.close();
+	for (size_t j = 0; j < 100 && released() == before; j++) {
+	    utime::sleep(utime::ms(50));
+	}
+	assert(released() == before + 1);
+	std::cout << query << " -> " << (r ? "true" : "false")
+		  << ": hits=" << pool.num_hits()
+		  << " misses=" << pool.num_misses()
+		  << " discarded=" << pool.num_discarded()
+		  << " setups=" << pool.num_setups()
+		  << " (" << pool.total_setup_us() << " us)" << std::endl;
+	return r;
+    };
+
+    // Reuses the warm interpreter, then recycles it
+    assert(run_session("member(X, [1,2,3]), X > 1."));
+    assert(pool.num_hits() == 1 && pool.num_misses() == 0);
+    assert(pool.size() == 1);
+
+    // A modified program can't be recycled...
+    assert(run_session("assert(foo(1))."));
+    assert(pool.num_hits() == 2 && pool.num_discarded() == 1);
+    assert(pool.size() == 0);
+
+    // ...so the next session gets a new interpreter, which doesn't
+    // know about foo/1
+    assert(!run_session("current_predicate(foo/1)."));
+    assert(pool.num_misses() == 1);
+    assert(pool.num_setups() == 2);
+    assert(pool.size() == 1);
+
+    assert(!run_session("current_predicate(foo/1)."));
+    assert(pool.num_hits() == 3);
+    assert(pool.num_setups() == 2);
+
+    // Shrinking the pool drops idle interpreters
+    pool.set_max_size(0);
+    assert(pool.size() == 0);
+
+    node.stop();
+    node.join();
+}
+
+//
+// Drive a number of terminals in parallel against one node and report
+// the throughput for different sizes of the node's worker pool.
+//
+static void run_terminal_load(size_t num_workers, size_t num_terminals,
+			      size_t num_queries)
+{
+    global::erase_db(test_dir);
+
+    self_node node(test_dir, 8010);
+    node.set_num_workers(num_workers);
+    node.start();
+
+    std::vector<boost::thread> clients;
+    // One char per client (not vector<bool>, which packs them in shared
+    // words) as the clients write their slot concurrently.
+    std::vector<char> ok(num_terminals, false);
+
+    auto start = boost::posix_time::microsec_clock::local_time();
+
+    for (size_t i = 0; i < num_terminals; i++) {
+	clients.push_back(boost::thread([&ok, i, num_queries]() {
+	    terminal tm(8010);
+	    if (!tm.connect()) {
+		return;
+	    }
+	    bool all = true;
+	    for (size_t j = 0; j < num_queries && all; j++) {
+		all = tm.execute("findall(Y, (member(Y, [3,1,2,5,4]), "
+				 "member(_, [1,2,3,4,5,6,7,8])), L), "
+				 "sort(L, [X|_]).") &&
+		      tm.get_result_string("X") == "1";
+	    }
+	    tm.close();
+	    ok[i] = all;
+	}));
+    }
+    for (auto &client : clients) {
+	client.join();
+    }
+
+    auto stop = boost::posix_time::microsec_clock::local_time();
+    auto dt_ms = (stop - start).total_milliseconds();
+
+    node.stop();
+    node.join();
+
+    for (size_t i = 0; i < num_terminals; i++) {
+	assert(ok[i]);
+    }
+
+    auto total = num_terminals * num_queries;
+    std::cout << "Workers " << std::setw(2) << num_workers
+	      << ": " << total << " queries in " << dt_ms << " ms"
+	      << " (" << (dt_ms > 0 ? 1000 * total / dt_ms : total)
+	      << " queries/s)" << std::endl;
+}
+
+static void test_terminal_load()
+{
+    header("test_terminal_load()");
+
+    const size_t NUM_TERMINALS = 8;
+    const size_t NUM_QUERIES = 50;
+
+    size_t max_workers = std::max(static_cast<size_t>(self_node::MIN_NUM_WORKERS),
+				  static_cast<size_t>(boost::thread::hardware_concurrency()));
+
+    for (size_t w = 1; w < max_workers; w *= 2) {
+	run_terminal_load(w, NUM_TERMINALS, NUM_QUERIES);
+    }
+    run_terminal_load(max_workers, NUM_TERMINALS, NUM_QUERIES);
+}
+
 int main(int argc, char *argv[])
 {
     std::string home_dir = find_home_dir(argv[0]);
     test_dir = (boost::filesystem::path(home_dir) / "bin" / "test" / "node" / "triedb").string();
     
     test_terminal();
+    test_terminal_pipelined();
+    test_interpreter_pool();
+    test_terminal_load();
     return 0;
 }
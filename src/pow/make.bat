@@ -3,6 +3,6 @@ SET ROOT=..\..
 SET SUBDIR=pow
 SET DOLIB=pow
 SET DOEXE=
-SET DEPENDS=
+SET DEPENDS=common
 SET CC_EXTRA=/arch:AVX2
 CALL ..\..\env\make.bat %*
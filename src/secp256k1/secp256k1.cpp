@@ -17,6 +17,20 @@ extern "C" {
 #define ENABLE_MODULE_SURJECTIONPROOF
   
 #include "../../../secp256k1-zkp/src/basic-config.h"
+
+// Size of the precomputed tables. They're built once per process (see
+// ec::secp256k1_ctx::shared) so bigger tables (faster verification and
+// signing) are affordable. Set at build time, e.g.
+//   make ECMULT_WINDOW_SIZE=18 ECMULT_GEN_PREC_BITS=8
+#ifdef PROLOGCOIN_ECMULT_WINDOW_SIZE
+#undef ECMULT_WINDOW_SIZE
+#define ECMULT_WINDOW_SIZE PROLOGCOIN_ECMULT_WINDOW_SIZE
+#endif
+#ifdef PROLOGCOIN_ECMULT_GEN_PREC_BITS
+#undef ECMULT_GEN_PREC_BITS
+#define ECMULT_GEN_PREC_BITS PROLOGCOIN_ECMULT_GEN_PREC_BITS
+#endif
+
 #include "../../../secp256k1-zkp/include/secp256k1.h"
 #include "../../../secp256k1-zkp/src/secp256k1.c"
 
@@ -15,6 +15,8 @@ terminal::terminal(unsigned short port, const std::string &ip_address)
     socket_(ioservice_),
     buffer_(MAX_BUFFER_SIZE, ' '),
     buffer_len_(sizeof(cell)),
+    next_request_id_(0),
+    num_in_flight_(0),
     has_more_(false),
     at_end_(false),    
     result_to_text_(true),
@@ -454,12 +456,74 @@ void terminal::handle_error(const std::string &msg)
     }
 }
 
+int64_t terminal::send_execute(term query, bool silent)
+{
+    while (num_in_flight_ >= MAX_IN_FLIGHT) {
+	if (!read_pending_reply()) {
+	    return -1;
+	}
+    }
+    uint64_t cost = 0;
+    auto &e = env_;
+    term s_query = e.copy(query, env_, cost);
+    con_cell silent_con = silent ? con_cell("true",0) : con_cell("false",0);
+    auto q = e.new_term(e.functor("query",2), {s_query, silent_con});
+    auto id = next_request_id_++;
+    if (!send_query(e.new_term(con_cell("req",2), {int_cell(id), q}))) {
+	return -1;
+    }
+    num_in_flight_++;
+    return id;
+}
+
+// Read one rep(Id, Reply) and keep it until someone waits for it.
+bool terminal::read_pending_reply()
+{
+    auto &e = env_;
+    auto reply = read_reply();
+    if (reply == term()) {
+	return false;
+    }
+    if (reply.tag() != tag_t::STR || e.functor(reply) != con_cell("rep",2)) {
+	add_error("Unexpected reply (expected rep/2) from node: " + e.to_string(reply));
+	return false;
+    }
+    auto id_term = e.arg(reply,0);
+    if (id_term.tag() != tag_t::INT) {
+	add_error("Unexpected request id from node: " + e.to_string(id_term));
+	return false;
+    }
+    auto id = reinterpret_cast<int_cell &>(id_term).value();
+    pending_replies_[id] = e.arg(reply,1);
+    num_in_flight_--;
+    return true;
+}
+
+bool terminal::wait_result(int64_t id)
+{
+    auto it = pending_replies_.find(id);
+    while (it == pending_replies_.end()) {
+	if (num_in_flight_ == 0 || !read_pending_reply()) {
+	    return false;
+	}
+	it = pending_replies_.find(id);
+    }
+    auto reply = it->second;
+    pending_replies_.erase(it);
+    return process_query_reply(reply);
+}
+
 bool terminal::process_query_reply()
 {
     auto reply = read_reply();
     if (reply == term()) {
 	return false;
     }
+    return process_query_reply(reply);
+}
+
+bool terminal::process_query_reply(term reply)
+{
     auto &e = env_;
 
     if (e.functor(reply) == con_cell("error",1)) {
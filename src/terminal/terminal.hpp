@@ -77,6 +77,19 @@ public:
 
     inline bool execute(term t, bool silent) { return execute_query(t, silent); }
 
+    // Pipelining. send_execute() sends a query tagged with a request id
+    // and returns the id (or -1 on failure) without waiting for the
+    // reply, so many queries can be in flight (at most MAX_IN_FLIGHT;
+    // if there are that many it waits for one of the replies first.)
+    // wait_result(id) then processes the reply of that query like
+    // execute() does, so get_result() etc. refer to it. Replies are
+    // matched by id and may be waited for in any order. Don't mix with
+    // execute() while queries are in flight.
+    static const size_t MAX_IN_FLIGHT = 16;
+    int64_t send_execute(term query, bool silent);
+    bool wait_result(int64_t id);
+    inline size_t num_in_flight() const { return num_in_flight_; }
+
     inline bool has_more() const { return has_more_; }
     inline bool at_end() const { return at_end_; }
     inline bool next() { if (!has_more_) { return false; } else return execute_in_query(";"); }
@@ -116,6 +129,8 @@ private:
     bool execute_in_query(const std::string &cmd);
     void handle_error(const std::string &msg);
     bool process_query_reply();
+    bool process_query_reply(term reply);
+    bool read_pending_reply();
 
     void error(const std::string &cmd,
 	       int column,
@@ -134,6 +149,10 @@ private:
     std::queue<std::string> errors_;
 
     std::string session_id_;
+
+    int64_t next_request_id_;
+    size_t num_in_flight_;
+    std::unordered_map<int64_t, term> pending_replies_;
     bool has_more_;
     bool at_end_;
 
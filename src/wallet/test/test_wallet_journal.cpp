@@ -0,0 +1,130 @@
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <common/test/test_home_dir.hpp>
+#include <wallet/wallet.hpp>
+
+using namespace prologcoin::common;
+using namespace prologcoin::wallet;
+
+std::string home_dir;
+std::string test_dir;
+
+static void header( const std::string &str )
+{
+    std::cout << "\n";
+    std::cout << "--- [" + str + "] " + std::string(60 - str.length(), '-') << "\n";
+    std::cout << "\n";
+}
+
+static int64_t count_solutions(wallet &w, const std::string &query)
+{
+    int64_t n = 0;
+    if (!w.execute(w.parse(query))) {
+	return 0;
+    }
+    do {
+	n++;
+    } while (w.has_more() && w.next());
+    w.reset();
+    return n;
+}
+
+static void test_wallet_journal()
+{
+    header("test_wallet_journal");
+
+    boost::filesystem::create_directories(test_dir);
+    auto path = (boost::filesystem::path(test_dir) / "test_wallet_journal.pl").string();
+    wallet::erase(path);
+
+    {
+	wallet w(path);
+	w.set_auto_save(false);
+	w.load();
+	for (int i = 0; i < 10; i++) {
+	    w.execute("assert(wallet:item(" + boost::lexical_cast<std::string>(i) + ")).");
+	}
+	w.save();
+	auto snap_size = w.get_journal().snapshot_size();
+	std::cout << "Snapshot: " << snap_size << " bytes" << std::endl;
+	assert(snap_size > 0);
+	assert(boost::filesystem::exists(wallet_journal::snapshot_path(path)));
+
+	// These only go to the journal
+	w.execute("retract(wallet:item(3)).");
+	w.execute("asserta(wallet:item(42)).");
+	w.execute("retractall(wallet:item(7)).");
+	assert(w.get_journal().num_pending() == 3);
+	w.save();
+	assert(w.get_journal().num_pending() == 0);
+	assert(w.get_journal().snapshot_size() == snap_size);
+	std::cout << "Journal: " << w.get_journal().journal_size() << " bytes" << std::endl;
+    }
+
+    // Load the snapshot and replay the journal
+    {
+	wallet w(path);
+	w.load();
+	std::cout << "Replayed: " << w.get_journal().num_replayed() << std::endl;
+	assert(w.get_journal().num_replayed() == 3);
+	assert(count_solutions(w, "wallet:item(_).") == 9);
+	assert(count_solutions(w, "wallet:item(3).") == 0);
+	assert(count_solutions(w, "wallet:item(7).") == 0);
+	assert(w.execute(w.parse("wallet:item(X).")));
+	auto x = w.get_result_term("X");
+	assert(x == int_cell(42));
+	w.reset();
+    }
+
+    // A torn record at the end is dropped
+    {
+	auto jpath = wallet_journal::journal_path(path);
+	auto size = boost::filesystem::file_size(jpath);
+	{
+	    std::ofstream ofs(jpath, std::ios::binary | std::ios::app);
+	    ofs << "garbage";
+	}
+	wallet w(path);
+	w.load();
+	assert(w.get_journal().num_replayed() == 3);
+	assert(boost::filesystem::file_size(jpath) == size);
+	assert(count_solutions(w, "wallet:item(_).") == 9);
+    }
+
+    // A changed wallet file is loaded instead of the snapshot
+    {
+	{
+	    std::ofstream ofs(path, std::ios::app);
+	    ofs << "item(100)." << std::endl;
+	}
+	wallet w(path);
+	w.set_auto_save(false);
+	w.load();
+	assert(w.get_journal().num_replayed() == 0);
+	assert(!boost::filesystem::exists(wallet_journal::snapshot_path(path)));
+	// What was only journaled is not in the wallet file
+	assert(count_solutions(w, "wallet:item(_).") == 11);
+	w.save();
+	assert(boost::filesystem::exists(wallet_journal::snapshot_path(path)));
+    }
+    {
+	wallet w(path);
+	w.load();
+	assert(w.get_journal().num_replayed() == 0);
+	assert(boost::filesystem::exists(wallet_journal::snapshot_path(path)));
+	assert(count_solutions(w, "wallet:item(_).") == 11);
+    }
+
+    wallet::erase(path);
+}
+
+int main(int argc, char *argv[])
+{
+    home_dir = find_home_dir(argv[0]);
+    test_dir = (boost::filesystem::path(home_dir) / "bin" / "test" / "wallet").string();
+
+    test_wallet_journal();
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
 #include "wallet.hpp"
@@ -15,6 +16,7 @@ namespace prologcoin { namespace wallet {
 
 void wallet::erase(const std::string &wallet_file) {
     boost::filesystem::remove(wallet_file);
+    wallet_journal::erase(wallet_file);
 }
 
 void wallet::erase_all_test_wallets(const std::string &dir) {
@@ -59,46 +61,101 @@ const std::string & wallet::get_file() const {
 void wallet::set_file(const std::string &file) {
     wallet_file_ = file;
     new_file_ = true;
+    journal_.set_file("");
 }
 
 void wallet::load()
 {
+    static const con_cell WALLET("wallet",0);
     auto fullpath = interp().get_full_path(wallet_file_);
+    journal_.set_file(fullpath);
+    std::string source;
+    bool has_source = false;
     if (!fullpath.empty() && boost::filesystem::exists(fullpath)) {
         std::ifstream ifs(fullpath);
-	auto old_module = interp_.current_module();
-	interp_.set_current_module(con_cell("wallet",0));
-	interp_.load_program(ifs);
-	interp_.set_current_module(old_module);
+	source.assign(std::istreambuf_iterator<char>(ifs),
+		      std::istreambuf_iterator<char>());
+	has_source = true;
     }
+    if (!has_source || !journal_.load(interp_, WALLET, source)) {
+	// The snapshot (if any) is not of this wallet file; the file
+	// wins and the next save starts over with a new snapshot.
+	if (journal_.has_snapshot()) {
+	    wallet_journal::erase(fullpath);
+	}
+	if (has_source) {
+	    std::stringstream ss(source);
+	    auto old_module = interp_.current_module();
+	    interp_.set_current_module(WALLET);
+	    interp_.load_program(ss);
+	    interp_.set_current_module(old_module);
+	}
+    }
+    interp_.clear_unjournaled_changes();
+    interp_.clear_module_changed(WALLET);
     new_file_ = false;
 }
 
+void wallet::journal(term op)
+{
+    if (!wallet_file_.empty()) {
+	journal_.add(interp_, op);
+    }
+}
+
 void wallet::check_dirty()
 {
     if (!is_auto_save()) {
 	return;
     }
     auto &meta = interp_.get_module_meta(con_cell("wallet",0));
-    if (meta.has_changed()) {
+    if (meta.has_changed() || journal_.num_pending() > 0) {
         save();
     }
 }
 
 void wallet::save()
 {
+    static const con_cell WALLET("wallet",0);
     if (wallet_file_.empty()) {
         return;
     }
     auto fullpath = interp().get_full_path(wallet_file_);
     // Check if wallet is non empty first
-    auto &mod = interp().get_module(con_cell("wallet",0));
+    auto &mod = interp().get_module(WALLET);
     if (mod.empty()) {
 	// No need to save something empty
 	return;
     }
-    std::ofstream ofs(fullpath);
-    interp_.save_program(con_cell("wallet",0),ofs);
+
+    // Append what changed to the journal. Start over with a new
+    // snapshot if we can't (the journal doesn't know all changes) or
+    // the journal has grown too big.
+    bool snapshot = journal_.get_file() != fullpath ||
+	            !journal_.has_snapshot() ||
+	            interp_.has_unjournaled_changes();
+    if (!snapshot) {
+	journal_.flush();
+	snapshot = journal_.should_compact();
+    }
+    if (snapshot) {
+	if (journal_.get_file() != fullpath) {
+	    journal_.set_file(fullpath);
+	}
+	// The wallet file goes first. If we crash before the snapshot
+	// is written, the old snapshot won't match it and we load the
+	// file.
+	std::stringstream ss;
+	interp_.save_program(WALLET, ss);
+	auto source = ss.str();
+	{
+	    std::ofstream ofs(fullpath);
+	    ofs << source;
+	}
+	journal_.write_snapshot(interp_, WALLET, source);
+    }
+    interp_.clear_unjournaled_changes();
+    interp_.clear_module_changed(WALLET);
 }
 
 void wallet::connect_node(terminal *node_term)
@@ -6,6 +6,7 @@
 #include "../common/term_env.hpp"
 #include "../terminal/terminal.hpp"
 #include "wallet_interpreter.hpp"
+#include "wallet_journal.hpp"
 
 namespace prologcoin { namespace wallet {
 
@@ -28,6 +29,9 @@ public:
     static void erase_all_test_wallets(const std::string &dir);
   
     // Wallet file is some Prolog source code (.pl) representing a wallet.
+    // Once saved, the wallet is kept in a snapshot and journal next to
+    // it (see wallet_journal) and the .pl file is rewritten on every
+    // snapshot. If the .pl file is changed, it is loaded instead.
     wallet(const std::string &wallet_file = "");
     ~wallet();
 
@@ -48,6 +52,10 @@ public:
     void create(const std::string &passwd, common::term sentence);
     void check_dirty();
 
+    // Record an assert/retract on the wallet module (see wallet_journal)
+    void journal(common::term op);
+    inline const wallet_journal & get_journal() const { return journal_; }
+
     // Start the thread that will talk to the node.
     void connect_node(terminal *node_terminal);
     void node_pulse();
@@ -73,6 +81,7 @@ private:
     bool new_file_;
     bool auto_save_;
     wallet_interpreter interp_;
+    wallet_journal journal_;
     bool killed_;
 
     // This is the terminal to the node.
@@ -3,14 +3,15 @@
 #include "../coin/builtins.hpp"
 #include "wallet_interpreter.hpp"
 #include "wallet.hpp"
-#include <boost/filesystem/path.hpp>
+#include "../common/gcs_filter.hpp"
+#include <boost/filesystem.hpp>
 
 using namespace prologcoin::common;
 using namespace prologcoin::interp;
 
 namespace prologcoin { namespace wallet {
 
-wallet_interpreter::wallet_interpreter(wallet &w, const std::string &wallet_file) : interp::interpreter("wallet"), file_path_(wallet_file), wallet_(w), no_coin_security_(this->disable_coin_security()) {
+wallet_interpreter::wallet_interpreter(wallet &w, const std::string &wallet_file) : interp::interpreter("wallet"), file_path_(wallet_file), wallet_(w), journaling_(false), unjournaled_(false), no_coin_security_(this->disable_coin_security()) {
     init();
 }
 
@@ -20,10 +21,16 @@ void wallet_interpreter::init()
     load_builtins_file_io();
     ec::builtins::load(*this);
     coin::builtins::load(*this);
+    // Compiled code is cached next to the wallet file
+    if (!file_path_.empty()) {
+	auto dir = boost::filesystem::absolute(file_path_).parent_path();
+	set_code_cache((dir / "wam_code.cache").string());
+    }
     setup_standard_lib();
     set_current_module(con_cell("wallet",0));
     setup_local_builtins();
     setup_wallet_impl();
+    save_code_cache();
     // Make wallet inherit everything from wallet_impl
     use_module(functor("wallet_impl",0));
     set_auto_wam(true);
@@ -47,6 +54,23 @@ void wallet_interpreter::setup_local_builtins()
     load_builtin(M, functor("auto_save",1), &wallet_interpreter::auto_save_1);
     load_builtin(M, con_cell("load",0), &wallet_interpreter::load_0);
     load_builtin(M, con_cell("file",1), &wallet_interpreter::file_1);
+    load_builtin(M, functor("closure_filter_match",3), &wallet_interpreter::closure_filter_match_3);
+
+    // Changes to the wallet module are journaled (see wallet_journal)
+    static const con_cell S("system",0);
+    load_builtin(S, con_cell("asserta",1), &wallet_interpreter::asserta_1);
+    load_builtin(S, con_cell("assertz",1), &wallet_interpreter::assertz_1);
+    load_builtin(S, con_cell("assert",1), &wallet_interpreter::assertz_1);
+    load_builtin(S, con_cell("retract",1), &wallet_interpreter::retract_1);
+    load_builtin(S, functor("retractall",1), &wallet_interpreter::retractall_1);
+}
+
+void wallet_interpreter::updated_predicate_post(const qname &qn)
+{
+    interp::interpreter::updated_predicate_post(qn);
+    if (!journaling_ && qn.first == con_cell("wallet",0)) {
+	unjournaled_ = true;
+    }
 }
 
 void wallet_interpreter::setup_wallet_impl()
@@ -83,22 +107,78 @@ sync(N) :-
     
 
 %
-% Iterate through next 100 frozen closures to see if we have received
-% something we recognize.
+% Ask the node for the closures paying to our addresses since the last
+% sync (it keeps an index of them, so this is a single round trip no
+% matter how long the chain is.)
+%
+'$sync_addresses' :-
+    wallet:lastheap(H),
+    H1 is H + 1,
+    (current_predicate(cache:valid_address/2) ->
+        findall(A, cache:valid_address(A,_), Addrs) ; Addrs = []),
+    wallet:'@'(((frozen_by_address(Addrs, H1, HeapAddrs, Closures),
+                 frozenk(-1, 1, Top)) @ global), node),
+    wallet:'@'(discard, node),
+    ((Top = [LastH], LastH > H) ->
+        retract(wallet:lastheap(_)), assert(wallet:lastheap(LastH)) ; true),
+    forall('$member2'(Closure, HeapAddress, Closures, HeapAddrs),
+            ('$new_utxo_closure'(HeapAddress, Closure) ; true)).
+
+%
+% Sync the UTXOs for our addresses. (Use sync(N) to look at every frozen
+% closure, e.g. for transaction types recognized by wallet:new_utxo/4.)
 %
 sync :- 
-    '$cache_addresses', sync(100), !.
+    '$cache_addresses', '$sync_addresses', !.
 sync.
 
 sync_all :-
-    '$cache_addresses', sync_all0.
-sync_all0 :-
-    sync(100), !, sync_all0.
-sync_all0.
+    sync.
+
+%
+% Light sync. Fetch the closure filters of the blocks since the last
+% one we looked at and test our addresses against them here; only the
+% closures of the blocks that match are fetched, so the node never
+% learns which addresses are ours.
+%
+sync_filtered :-
+    '$cache_addresses', '$sync_filtered', !.
+sync_filtered.
+
+'$sync_filtered' :-
+    (current_predicate(wallet:lastheight/1) -> true
+   ; assert(wallet:lastheight(-1))),
+    wallet:lastheight(H),
+    H1 is H + 1,
+    wallet:'@'(((current_height(Top), closure_filters(H1, Top, Filters)) @ global), node),
+    wallet:'@'(discard, node),
+    Filters = [_|_], % At least one block!
+    (current_predicate(cache:valid_address/2) ->
+        findall(A, cache:valid_address(A,_), Addrs) ; Addrs = []),
+    forall(member(filter(Height, Start, End, Data), Filters),
+           ('$filter_matches'(Data, Height, Addrs) ->
+                '$sync_heap_range'(Start, End) ; true)),
+    last(Filters, filter(LastHeight, _, _, _)),
+    retract(wallet:lastheight(_)), assert(wallet:lastheight(LastHeight)),
+    (LastHeight < Top -> '$sync_filtered' ; true).
+
+% Blocks without a filter must be looked at
+'$filter_matches'(none, _, _) :- !.
+'$filter_matches'(Data, Height, Addrs) :-
+    closure_filter_match(Data, Height, Addrs).
+
+'$sync_heap_range'(Start, End) :-
+    Start < End, !,
+    wallet:'@'(((frozenk(Start, 255, HeapAddrs), frozen(HeapAddrs, Closures)) @ global), node),
+    wallet:'@'(discard, node),
+    forall(('$member2'(Closure, HeapAddress, Closures, HeapAddrs), HeapAddress < End),
+            ('$new_utxo_closure'(HeapAddress, Closure) ; true)),
+    ((length(HeapAddrs, 255), last(HeapAddrs, LastH), LastH + 1 < End) ->
+        Next is LastH + 1, '$sync_heap_range'(Next, End) ; true).
+'$sync_heap_range'(_, _).
 
 %
 % Restart wallet sweep. Clean UTXO database and start from heap address 0.
-% Call one sync step (which syncs 100 UTXOs)
 %
 resync :-
     retractall(wallet:utxo(_,_,_,_)),
@@ -117,15 +197,34 @@ resync :-
     retract(cache:last_address(_)),
     assert(cache:last_address(N)).
 
-'$cache_addresses_n'(N, N) :- !.
+'$cache_addresses_n'(I, N) :- I >= N, !.
+'$cache_addresses_n'(I, N) :-
+    % Keys derived from master_pubkey/1 (see wallet::create)
+    % are derived in batches.
+    current_predicate(wallet:master_pubkey/1), !,
+    wallet:master_pubkey(Master),
+    Count is min(N - I, 256),
+    ec:child_addresses(Master, I, Count, Addresses),
+    '$cache_address_list'(Addresses, I),
+    I1 is I + Count,
+    '$cache_addresses_n'(I1, N).
 '$cache_addresses_n'(I, N) :-
     wallet:pubkey(I, PubKey),
     ec:address(PubKey, Address),
-    (\+ current_predicate(cache:valid_address/2) -> assert(cache:valid_address(Address,I)) ; true),
-    (\+ cache:valid_address(Address,_) -> assert(cache:valid_address(Address,I)) ; true),
+    '$cache_address'(Address, I),
     I1 is I + 1,
     '$cache_addresses_n'(I1, N).
 
+'$cache_address_list'([], _).
+'$cache_address_list'([Address|Addresses], I) :-
+    '$cache_address'(Address, I),
+    I1 is I + 1,
+    '$cache_address_list'(Addresses, I1).
+
+'$cache_address'(Address, I) :-
+    (\+ current_predicate(cache:valid_address/2) -> assert(cache:valid_address(Address,I)) ; true),
+    (\+ cache:valid_address(Address,_) -> assert(cache:valid_address(Address,I)) ; true).
+
 
 %
 % Check this frozen closure for transaction type.
@@ -356,6 +455,55 @@ bool wallet_interpreter::operator_at_parallel_2(interpreter_base &interp, size_t
     return operator_at_impl(interp, arity, args, "@=/2", interp::MODE_PARALLEL);
 }
 
+//
+// asserta/1, assertz/1, retract/1 and retractall/1 as usual, but if
+// they change the wallet module the operation is journaled.
+//
+bool wallet_interpreter::journaled(interpreter_base &interp, con_cell op, interp::builtin_fn fn, term args[])
+{
+    auto &wi = reinterpret_cast<wallet_interpreter &>(interp);
+    auto t = interp.deref(args[0]);
+    bool is_wallet = (t.tag() == tag_t::STR || t.tag() == tag_t::CON) &&
+	             interp.clause_module(t) == con_cell("wallet",0);
+    term copy;
+    if (is_wallet) {
+	copy = interp.copy(args[0]);
+    }
+    bool r = false;
+    wi.journaling_ = true;
+    try {
+	r = fn(interp, 1, args);
+    } catch (...) {
+	wi.journaling_ = false;
+	throw;
+    }
+    wi.journaling_ = false;
+    if (r && is_wallet) {
+	wi.get_wallet().journal(interp.new_term(op, {copy}));
+    }
+    return r;
+}
+
+bool wallet_interpreter::asserta_1(interpreter_base &interp, size_t arity, term args[])
+{
+    return journaled(interp, con_cell("asserta",1), &prologcoin::interp::builtins::asserta_1, args);
+}
+
+bool wallet_interpreter::assertz_1(interpreter_base &interp, size_t arity, term args[])
+{
+    return journaled(interp, con_cell("assertz",1), &prologcoin::interp::builtins::assertz_1, args);
+}
+
+bool wallet_interpreter::retract_1(interpreter_base &interp, size_t arity, term args[])
+{
+    return journaled(interp, con_cell("retract",1), &prologcoin::interp::builtins::retract_1, args);
+}
+
+bool wallet_interpreter::retractall_1(interpreter_base &interp, size_t arity, term args[])
+{
+    return journaled(interp, interp.functor("retractall",1), &prologcoin::interp::builtins::retractall_1, args);
+}
+
 bool wallet_interpreter::save_0(interpreter_base &interp, size_t arity, term args[])
 {
     auto &w = reinterpret_cast<wallet_interpreter &>(interp).get_wallet();
@@ -457,4 +605,36 @@ bool wallet_interpreter::create_2(interpreter_base &interp, size_t arity, term a
     return interp.unify(args[1], sentence);
 }
     
+//
+// closure_filter_match(+Filter, +Height, +Addresses)
+// True if any of the addresses (probably) is in the closure filter of
+// the block at Height.
+//
+bool wallet_interpreter::closure_filter_match_3(interpreter_base &interp, size_t arity, term args[])
+{
+    if (args[0].tag() != tag_t::BIG) {
+	throw interp::interpreter_exception_wrong_arg_type("closure_filter_match/3: First argument, Filter, must be a bignum; was " + interp.to_string(args[0]));
+    }
+    if (args[1].tag() != tag_t::INT || reinterpret_cast<int_cell &>(args[1]).value() < 0) {
+	throw interp::interpreter_exception_wrong_arg_type("closure_filter_match/3: Second argument, Height, must be a non-negative integer; was " + interp.to_string(args[1]));
+    }
+    if (!interp.is_list(args[2])) {
+	throw interp::interpreter_exception_wrong_arg_type("closure_filter_match/3: Third argument, Addresses, must be a list; was " + interp.to_string(args[2]));
+    }
+
+    auto &big = reinterpret_cast<big_cell &>(args[0]);
+    std::vector<uint8_t> data(interp.num_bits(big) / 8);
+    interp.get_big(args[0], &data[0], data.size());
+    auto height = static_cast<uint64_t>(reinterpret_cast<int_cell &>(args[1]).value());
+
+    // Same keys as the node (see global::address_index)
+    std::vector<std::string> addresses;
+    for (term lst = args[2]; interp.is_dotted_pair(lst); lst = interp.arg(lst, 1)) {
+	addresses.push_back(interp.to_string(interp.arg(lst, 0)));
+    }
+
+    gcs_filter filter(height, &data[0], data.size());
+    return filter.match_any(addresses);
+}
+
 }}
@@ -22,6 +22,14 @@ public:
     void delete_instance_at(term_env &query_src, const std::string &where);
 
     wallet & get_wallet() { return wallet_; }
+
+    // Changes to the wallet module that were not journaled (e.g.
+    // clauses consulted from a file.) The next save is a snapshot.
+    inline bool has_unjournaled_changes() const { return unjournaled_; }
+    inline void clear_unjournaled_changes() { unjournaled_ = false; }
+
+protected:
+    virtual void updated_predicate_post(const interp::qname &qn) override;
   
 private:
     void init();
@@ -33,6 +41,12 @@ private:
     static bool load_0(interpreter_base &interp, size_t arity, term args[]);    
     static bool file_1(interpreter_base &interp, size_t arity, term args[]);
     static bool auto_save_1(interpreter_base &interp, size_t arity, term args[]);
+    static bool closure_filter_match_3(interpreter_base &interp, size_t arity, term args[]);
+    static bool journaled(interpreter_base &interp, con_cell op, interp::builtin_fn fn, term args[]);
+    static bool asserta_1(interpreter_base &interp, size_t arity, term args[]);
+    static bool assertz_1(interpreter_base &interp, size_t arity, term args[]);
+    static bool retract_1(interpreter_base &interp, size_t arity, term args[]);
+    static bool retractall_1(interpreter_base &interp, size_t arity, term args[]);
     static bool operator_at_impl(interpreter_base &interp, size_t arity, term args[], const std::string &name, interp::remote_execute_mode mode);
     static bool operator_at_2(interpreter_base &interp, size_t arity, term args[]);
     static bool operator_at_silent_2(interpreter_base &interp, size_t arity, term args[]);
@@ -40,6 +54,8 @@ private:
   
     std::string file_path_;
     wallet &wallet_;
+    bool journaling_;
+    bool unjournaled_;
 
     // This is ok, because the wallet interpreter is a local only thing
     // and not part of consensus.
@@ -0,0 +1,353 @@
+#include <fstream>
+#include <boost/filesystem.hpp>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "../common/crc32c.hpp"
+#include "../common/sha256.hpp"
+#include "../interp/builtins.hpp"
+#include "wallet_journal.hpp"
+
+using namespace prologcoin::common;
+using namespace prologcoin::interp;
+
+namespace prologcoin { namespace wallet {
+
+static const char SNAPSHOT_MAGIC[8] = { 'P','C','W','S','N','A','P','2' };
+static const char JOURNAL_MAGIC[8] = { 'P','C','W','J','R','N','L','1' };
+static const size_t HEADER_SIZE = 16;
+static const size_t RECORD_HEADER_SIZE = 8;
+
+static void put_u32(std::string &out, uint32_t v)
+{
+    for (size_t i = 0; i < 4; i++) {
+	out.push_back(static_cast<char>((v >> (8*i)) & 0xff));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+	   (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static std::string header(const char magic[8], uint64_t generation)
+{
+    std::string out(magic, 8);
+    put_u32(out, static_cast<uint32_t>(generation));
+    put_u32(out, static_cast<uint32_t>(generation >> 32));
+    return out;
+}
+
+static std::string record(const wallet_journal::buffer_t &payload)
+{
+    std::string out;
+    put_u32(out, static_cast<uint32_t>(payload.size()));
+    put_u32(out, crc32c::checksum(&payload[0], payload.size()));
+    out.append(reinterpret_cast<const char *>(&payload[0]), payload.size());
+    return out;
+}
+
+static wallet_journal::buffer_t source_digest(const std::string &source)
+{
+    wallet_journal::buffer_t digest(sha256::HASH_SIZE);
+    sha256 h;
+    h.update(source.data(), source.size());
+    h.finalize(&digest[0]);
+    return digest;
+}
+
+//
+// Make sure a file (or the directory entries of a directory) reached
+// the disk. Like in triedb we open it again since fstream doesn't give
+// us the file descriptor.
+//
+static void sync_path(const std::string &path, bool is_dir = false)
+{
+#if defined(_WIN32)
+    if (is_dir) {
+	return; // Not needed (nor possible) on Windows
+    }
+    int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd == -1 || _commit(fd) != 0) {
+	if (fd != -1) _close(fd);
+	throw std::runtime_error("Failed to sync " + path);
+    }
+    _close(fd);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+	throw std::runtime_error("Failed to open " + path + " for sync");
+    }
+    int r = ::fsync(fd);
+    ::close(fd);
+    if (r != 0 && !is_dir) {
+	throw std::runtime_error("Failed to sync " + path);
+    }
+#endif
+}
+
+static bool read_file(const std::string &path, std::vector<uint8_t> &bytes)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.good()) {
+	return false;
+    }
+    bytes.assign(std::istreambuf_iterator<char>(ifs),
+		 std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Parse header; returns false if the magic doesn't match
+static bool read_header(const std::vector<uint8_t> &bytes, const char magic[8],
+			uint64_t &generation)
+{
+    if (bytes.size() < HEADER_SIZE ||
+	memcmp(&bytes[0], magic, sizeof(SNAPSHOT_MAGIC)) != 0) {
+	return false;
+    }
+    generation = static_cast<uint64_t>(get_u32(&bytes[8])) |
+	         (static_cast<uint64_t>(get_u32(&bytes[12])) << 32);
+    return true;
+}
+
+// Next record at offset; returns false if it's missing or torn
+static bool read_record(const std::vector<uint8_t> &bytes, size_t &offset,
+			wallet_journal::buffer_t &payload)
+{
+    if (offset + RECORD_HEADER_SIZE > bytes.size()) {
+	return false;
+    }
+    size_t len = get_u32(&bytes[offset]);
+    uint32_t crc = get_u32(&bytes[offset+4]);
+    if (len == 0 || offset + RECORD_HEADER_SIZE + len > bytes.size()) {
+	return false;
+    }
+    const uint8_t *p = &bytes[offset + RECORD_HEADER_SIZE];
+    if (crc32c::checksum(p, len) != crc) {
+	return false;
+    }
+    payload.assign(p, p + len);
+    offset += RECORD_HEADER_SIZE + len;
+    return true;
+}
+
+wallet_journal::wallet_journal()
+    : generation_(0),
+      snapshot_size_(0),
+      journal_size_(0),
+      num_replayed_(0)
+{
+}
+
+void wallet_journal::erase(const std::string &wallet_path)
+{
+    boost::filesystem::remove(snapshot_path(wallet_path));
+    boost::filesystem::remove(journal_path(wallet_path));
+}
+
+void wallet_journal::set_file(const std::string &wallet_path)
+{
+    path_ = wallet_path;
+    generation_ = 0;
+    pending_.clear();
+    snapshot_size_ = 0;
+    journal_size_ = 0;
+
+    // Continue the generations of what's on disk, so that a stale
+    // journal never matches a snapshot we write.
+    if (!path_.empty()) {
+	std::ifstream ifs(snapshot_path(path_), std::ios::binary);
+	std::vector<uint8_t> bytes(HEADER_SIZE);
+	if (ifs.read(reinterpret_cast<char *>(&bytes[0]), HEADER_SIZE)) {
+	    read_header(bytes, SNAPSHOT_MAGIC, generation_);
+	}
+    }
+}
+
+bool wallet_journal::has_snapshot() const
+{
+    return !path_.empty() && boost::filesystem::exists(snapshot_path(path_));
+}
+
+bool wallet_journal::load(interpreter_base &interp, con_cell module,
+			  const std::string &source)
+{
+    std::vector<uint8_t> bytes;
+    uint64_t generation = 0;
+    if (path_.empty() || !read_file(snapshot_path(path_), bytes) ||
+	!read_header(bytes, SNAPSHOT_MAGIC, generation)) {
+	return false;
+    }
+    buffer_t payload;
+    size_t offset = HEADER_SIZE;
+    if (!read_record(bytes, offset, payload)) {
+	throw std::runtime_error("Wallet snapshot " + snapshot_path(path_) + " is corrupt");
+    }
+    if (payload != source_digest(source)) {
+	return false;
+    }
+    if (!read_record(bytes, offset, payload)) {
+	throw std::runtime_error("Wallet snapshot " + snapshot_path(path_) + " is corrupt");
+    }
+    generation_ = generation;
+    snapshot_size_ = bytes.size();
+
+    auto old_module = interp.current_module();
+    interp.set_current_module(module);
+    try {
+	term_serializer ser(interp);
+	term lst = ser.read(payload);
+	while (interp.is_dotted_pair(lst)) {
+	    interp.load_clause(interp.arg(lst, 0), LAST_CLAUSE);
+	    lst = interp.arg(lst, 1);
+	}
+
+	// Replay the journal (if it belongs to this snapshot)
+	num_replayed_ = 0;
+	journal_size_ = 0;
+	bytes.clear();
+	if (read_file(journal_path(path_), bytes) &&
+	    read_header(bytes, JOURNAL_MAGIC, generation) &&
+	    generation == generation_) {
+	    offset = HEADER_SIZE;
+	    while (read_record(bytes, offset, payload)) {
+		replay(interp, ser.read(payload));
+		num_replayed_++;
+	    }
+	    if (offset != bytes.size()) {
+		// Drop the torn tail so new records follow valid ones
+		boost::filesystem::resize_file(journal_path(path_), offset);
+	    }
+	    journal_size_ = offset;
+	} else {
+	    start_journal();
+	}
+    } catch (...) {
+	interp.set_current_module(old_module);
+	throw;
+    }
+    interp.set_current_module(old_module);
+    return true;
+}
+
+void wallet_journal::replay(interpreter_base &interp, term op)
+{
+    static const con_cell ASSERTA("asserta", 1);
+    static const con_cell ASSERTZ("assertz", 1);
+    static const con_cell RETRACT("retract", 1);
+    static const con_cell RETRACTALL("retractall", 1);
+
+    if (op.tag() != tag_t::STR) {
+	return;
+    }
+    auto f = interp.functor(op);
+    auto arg = interp.arg(op, 0);
+    if (f == ASSERTA) {
+	interp.load_clause(arg, FIRST_CLAUSE);
+    } else if (f == ASSERTZ) {
+	interp.load_clause(arg, LAST_CLAUSE);
+    } else if (f == RETRACT) {
+	builtins::retract(interp, "retract/1", arg, false);
+    } else if (f == RETRACTALL) {
+	builtins::retract(interp, "retractall/1", arg, true);
+    }
+}
+
+void wallet_journal::add(interpreter_base &interp, term op)
+{
+    term_serializer ser(interp);
+    buffer_t buf;
+    ser.write(buf, op);
+    pending_.push_back(buf);
+}
+
+void wallet_journal::start_journal()
+{
+    std::ofstream ofs(journal_path(path_), std::ios::binary | std::ios::trunc);
+    auto hdr = header(JOURNAL_MAGIC, generation_);
+    ofs.write(hdr.data(), hdr.size());
+    ofs.close();
+    if (!ofs) {
+	throw std::runtime_error("Failed to write wallet journal " + journal_path(path_));
+    }
+    sync_path(journal_path(path_));
+    journal_size_ = hdr.size();
+}
+
+void wallet_journal::flush()
+{
+    if (pending_.empty()) {
+	return;
+    }
+    std::string out;
+    for (auto &p : pending_) {
+	out += record(p);
+    }
+    std::ofstream ofs(journal_path(path_), std::ios::binary | std::ios::app);
+    ofs.write(out.data(), out.size());
+    ofs.flush();
+    if (!ofs.good()) {
+	throw std::runtime_error("Failed to write wallet journal " + journal_path(path_));
+    }
+    journal_size_ += out.size();
+    pending_.clear();
+}
+
+void wallet_journal::write_snapshot(interpreter_base &interp, con_cell module,
+				    const std::string &source)
+{
+    term lst = interpreter_base::EMPTY_LIST;
+    auto &qnames = interp.get_module(module);
+    for (auto it = qnames.rbegin(); it != qnames.rend(); ++it) {
+	if (interp.is_builtin(*it)) {
+	    continue;
+	}
+	auto &clauses = interp.get_predicate(*it).clauses();
+	for (auto c = clauses.rbegin(); c != clauses.rend(); ++c) {
+	    if (!c->is_erased()) {
+		lst = interp.new_dotted_pair(c->clause(), lst);
+	    }
+	}
+    }
+    term_serializer ser(interp);
+    buffer_t buf;
+    ser.write(buf, lst);
+
+    // Write it aside and move it in place, so there's always a
+    // complete snapshot on disk.
+    generation_++;
+    auto path = snapshot_path(path_);
+    auto tmp_path = path + ".tmp";
+    {
+	std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+	auto out = header(SNAPSHOT_MAGIC, generation_) +
+	           record(source_digest(source)) + record(buf);
+	ofs.write(out.data(), out.size());
+	ofs.close();
+	if (!ofs) {
+	    throw std::runtime_error("Failed to write wallet snapshot " + tmp_path);
+	}
+	snapshot_size_ = out.size();
+    }
+    // The contents must be on disk before the rename is, or a crash
+    // could leave an empty snapshot in place of the old one.
+    sync_path(tmp_path);
+    boost::filesystem::rename(tmp_path, path);
+    auto dir = boost::filesystem::absolute(path).parent_path();
+    sync_path(dir.string(), true);
+
+    pending_.clear();
+    start_journal();
+}
+
+bool wallet_journal::should_compact() const
+{
+    return journal_size_ > MIN_COMPACT_SIZE && journal_size_ > snapshot_size_;
+}
+
+}}
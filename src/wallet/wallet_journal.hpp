@@ -0,0 +1,98 @@
+#pragma once
+
+#ifndef _wallet_wallet_journal_hpp
+#define _wallet_wallet_journal_hpp
+
+#include <string>
+#include <vector>
+#include "../common/term_serializer.hpp"
+#include "../interp/interpreter_base.hpp"
+
+namespace prologcoin { namespace wallet {
+
+//
+// wallet_journal. Persistence of the wallet module, so that saving a
+// wallet costs in proportion to what changed and not to its size.
+//
+// Next to the wallet file (W) we keep a binary snapshot of all clauses
+// (W.snap) and an append-only journal (W.journal) of the asserts and
+// retracts done since. Loading deserializes the snapshot and replays
+// the journal; nothing is parsed. When the journal has grown larger
+// than the snapshot it is compacted into a new snapshot.
+//
+// Both files start with a magic and a generation number. A journal is
+// only replayed on top of the snapshot with the same generation, so a
+// crash between writing a new snapshot and starting a new journal does
+// not replay operations twice. Every record has a length and a CRC32C;
+// a torn record at the end of the journal (and anything after it) is
+// dropped.
+//
+// The snapshot also holds a digest of the wallet file it was taken
+// with. If the wallet file has changed since (edited by hand, or a
+// crash after rewriting it but before the new snapshot was in place)
+// the snapshot isn't used and the wallet is loaded from the file.
+//
+// The records are not encrypted. There is no wallet key to encrypt
+// them with: the wallet is loaded before any password is given and
+// the wallet file itself is plain text. The secrets (the seed) are
+// kept encrypted in the clauses themselves and the decrypted master
+// key is only asserted in '$secret', which isn't journaled.
+//
+class wallet_journal {
+public:
+    using buffer_t = common::term_serializer::buffer_t;
+    using term = common::term;
+
+    // Compact when the journal is bigger than this and the snapshot
+    static const size_t MIN_COMPACT_SIZE = 64*1024;
+
+    wallet_journal();
+
+    static std::string snapshot_path(const std::string &wallet_path)
+    { return wallet_path + ".snap"; }
+    static std::string journal_path(const std::string &wallet_path)
+    { return wallet_path + ".journal"; }
+    static void erase(const std::string &wallet_path);
+
+    void set_file(const std::string &wallet_path);
+    inline const std::string & get_file() const { return path_; }
+
+    bool has_snapshot() const;
+
+    // Load the snapshot into module and replay the journal. Returns
+    // false (and loads nothing) if there is no snapshot or it wasn't
+    // taken with this source (the contents of the wallet file.)
+    bool load(interp::interpreter_base &interp, common::con_cell module,
+	      const std::string &source);
+
+    // Record an operation: asserta(Clause), assertz(Clause),
+    // retract(Head) or retractall(Head). It's written by flush().
+    void add(interp::interpreter_base &interp, term op);
+    inline size_t num_pending() const { return pending_.size(); }
+
+    void flush();
+    // Source is what was written to the wallet file
+    void write_snapshot(interp::interpreter_base &interp, common::con_cell module,
+			const std::string &source);
+    bool should_compact() const;
+
+    // Statistics
+    inline size_t snapshot_size() const { return snapshot_size_; }
+    inline size_t journal_size() const { return journal_size_; }
+    inline size_t num_replayed() const { return num_replayed_; }
+
+private:
+    void replay(interp::interpreter_base &interp, term op);
+    void start_journal();
+
+    std::string path_;
+    uint64_t generation_;
+    std::vector<buffer_t> pending_;
+    size_t snapshot_size_;
+    size_t journal_size_;
+    size_t num_replayed_;
+};
+
+}}
+
+#endif